@@ -0,0 +1,12 @@
+// Reading and writing elements of a large array in a random order - elements
+// are a linked list, so each access used to walk through up to N elements
+var N = 2000;
+var a = [];
+for (var i=0;i<N;i++) a.push(i);
+var t = getTime(), s = 0;
+for (var k=0;k<5;k++)
+  for (var i=0;i<N;i++) s += a[(i*7919)%N];
+print("Read", 5*N, "elements in", ((getTime()-t)*1000).toFixed(1), "ms");
+t = getTime();
+for (var i=0;i<N;i++) a[(i*7919)%N] = i;
+print("Wrote", N, "elements in", ((getTime()-t)*1000).toFixed(1), "ms");
@@ -0,0 +1,11 @@
+// Calling small helper functions in a loop - each call used to create a new
+// execution scope and a Name for each parameter
+function add(a,b) { return a+b; }
+function lerp(a,b,t) { var d = b-a; return a + d*t; }
+function clamp(x,lo,hi,def) { if (x===undefined) return def; return x<lo ? lo : (x>hi ? hi : x); }
+var N = 20000, s = 0;
+var t = getTime();
+for (var i=0;i<N;i++) s += add(i, 1);
+for (var i=0;i<N;i++) s += lerp(0, 10, 0.5);
+for (var i=0;i<N;i++) s += clamp(i, 10, 100, 0);
+print("Made", 3*N, "calls in", ((getTime()-t)*1000).toFixed(1), "ms");
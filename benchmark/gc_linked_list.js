@@ -0,0 +1,7 @@
+// Build a 20k element linked list and time how long the garbage collector takes
+// to mark it. The list is kept alive so every GC has to walk all of it.
+var list = undefined;
+for (var i=0;i<20000;i++) list = {v:i, next:list};
+var t = getTime();
+for (var j=0;j<10;j++) process.memory(); // process.memory() runs a GC
+print("GC time", ((getTime()-t)*100).toFixed(2)+"ms");
@@ -0,0 +1,14 @@
+// Redrawing a full-screen 176x176 image (as Bangle.js apps do for backgrounds) and scrolling part of it with blit
+var src = Graphics.createArrayBuffer(176,176,4,{msb:true});
+for (var y=0;y<176;y+=8)
+  for (var x=0;x<176;x+=8)
+    src.setColor((x+y)>>3).fillRect(x,y,x+7,y+7);
+var img = src.asImage();
+var g = Graphics.createArrayBuffer(176,176,4,{msb:true});
+var t = getTime();
+for (var k=0;k<50;k++) g.drawImage(img,0,0);
+var tImage = getTime()-t;
+t = getTime();
+for (var k=0;k<50;k++) g.blit({x1:0,y1:24,w:176,h:152,x2:0,y2:0});
+var tBlit = getTime()-t;
+print("50x drawImage in", (tImage*1000).toFixed(1), "ms, 50x blit in", (tBlit*1000).toFixed(1), "ms");
@@ -0,0 +1,11 @@
+// Redrawing the same text in a vector font (as a Bangle.js clock does every minute)
+var g = Graphics.createArrayBuffer(176,176,4,{msb:true});
+g.setFont("Vector",40).setFontAlign(0,0);
+var t = getTime();
+for (var k=0;k<1000;k++) g.clearRect(0,60,175,115).drawString("12:"+(10+(k%50)),88,88);
+var tTime = getTime()-t;
+g.setFont("Vector",14).setFontAlign(-1,-1);
+t = getTime();
+for (var k=0;k<500;k++) g.clear().drawString("Mon 12 Jun\nSteps 12345\nHRM 72bpm\nBattery 85%\nTemp 21 C",0,0);
+var tText = getTime()-t;
+print("1000x time in", (tTime*1000).toFixed(1), "ms, 500x text in", (tText*1000).toFixed(1), "ms");
@@ -0,0 +1,21 @@
+// Filling polygons with lots of vertices (as watch faces do for hands/ticks/shapes)
+var g = Graphics.createArrayBuffer(176,176,4,{msb:true});
+function star(cx,cy,r1,r2,n,rot) {
+  var p = [];
+  for (var i=0;i<n*2;i++) {
+    var a = rot+i*Math.PI/n, r = (i&1)?r2:r1;
+    p.push(cx+r*Math.sin(a), cy-r*Math.cos(a));
+  }
+  return p;
+}
+var polys = [];
+for (var k=0;k<20;k++) polys.push(star(88,88,85,40+k,32,k*0.05));
+var t = getTime();
+for (var k=0;k<200;k++) g.fillPoly(polys[k%20]);
+var tStar = getTime()-t;
+g.setFont("Vector",30);
+t = getTime();
+g.setRotation(2); // rotated, so characters aren't drawn from the glyph cache
+for (var k=0;k<1000;k++) g.drawString("12:34\nWed 5",0,0);
+var tText = getTime()-t;
+print("200x 64 point fillPoly in", (tStar*1000).toFixed(1), "ms, 1000x vector text in", (tText*1000).toFixed(1), "ms");
@@ -0,0 +1,32 @@
+// POST a body made of lots of small chunks (Transfer-Encoding: chunked) to ourselves
+var http = require("http");
+var net = require("net");
+var CHUNKS = 4000;
+var chunk = "0123456789abcdef";
+
+var received = 0;
+var server = http.createServer(function (req, res) {
+  req.on('data', function(data) { received += data.length; });
+  req.on('end', function() {
+    res.writeHead(200, {'Content-Length': 2});
+    res.end("ok");
+  });
+});
+server.listen(8080);
+
+// build the request up front so we only time the server
+var request = "POST / HTTP/1.1\r\nHost: localhost\r\nTransfer-Encoding: chunked\r\n\r\n";
+var chunks = [];
+for (var i=0;i<CHUNKS;i++) chunks.push("10\r\n"+chunk+"\r\n");
+request = E.toString(request+chunks.join("")+"0\r\n\r\n");
+chunks = undefined;
+
+var t = getTime();
+var client = net.connect({host: "localhost", port: 8080}, function() {
+  client.write(request);
+});
+client.on('data', function() {
+  print("Received", received, "bytes in", CHUNKS, "chunks in", ((getTime()-t)*1000).toFixed(1), "ms");
+  client.end();
+  server.close();
+});
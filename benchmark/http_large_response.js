@@ -0,0 +1,23 @@
+// Serve a large HTTP response to ourselves and time how long it takes to arrive
+var http = require("http");
+var chunk = "";
+for (var i=0;i<1024;i++) chunk += String.fromCharCode(33+(i%90));
+chunk = E.toString(chunk); // flat string
+var CHUNKS = 512; // 512kB
+
+var server = http.createServer(function (req, res) {
+  res.writeHead(200, {'Content-Type': 'text/plain', 'Content-Length': chunk.length*CHUNKS});
+  for (var i=0;i<CHUNKS;i++) res.write(chunk);
+  res.end();
+});
+server.listen(8080);
+
+var t = getTime();
+var len = 0;
+http.get("http://localhost:8080/", function(res) {
+  res.on('data', function(data) { len += data.length; });
+  res.on('close', function() {
+    print("Received", len, "bytes in", ((getTime()-t)*1000).toFixed(1), "ms");
+    server.close();
+  });
+});
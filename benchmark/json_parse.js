@@ -0,0 +1,8 @@
+// Parsing a settings-file sized JSON object (as Storage.readJSON does) many times
+var settings = {};
+for (var i=0;i<40;i++)
+  settings["setting"+i] = { enabled:(i&1)==1, value:i*1234, scale:i/7, name:"Setting number "+i, list:[i,i+1,-i] };
+var json = JSON.stringify(settings);
+var t = getTime();
+for (var k=0;k<20;k++) JSON.parse(json);
+print("Parsed", json.length, "bytes x20 in", ((getTime()-t)*1000).toFixed(1), "ms");
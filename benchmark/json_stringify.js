@@ -0,0 +1,8 @@
+// Converting a settings-file sized object (as Storage.writeJSON does) to JSON many times
+var settings = {};
+for (var i=0;i<40;i++)
+  settings["setting"+i] = { enabled:(i&1)==1, value:i*1234, scale:i/7, name:"Setting \"number\" "+i, list:[i,i+1,-i] };
+var json;
+var t = getTime();
+for (var k=0;k<20;k++) json = JSON.stringify(settings);
+print("Stringified", json.length, "bytes x20 in", ((getTime()-t)*1000).toFixed(1), "ms");
@@ -0,0 +1,27 @@
+// benchmark/mandelbrot.js, but compiled with the JIT (needs USE_JIT=1)
+// x, y and i are only ever written with ints, so are kept unboxed
+function mandelbrot() {
+  "jit";
+  var x=0, y=0, i=0, count=0;
+  var Xr, Xi, Cr, Ci, t;
+  for (y=0;y<32;y++) {
+    for (x=0;x<32;x++) {
+      Xr=0;
+      Xi=0;
+      Cr=(4.0*x/32)-2.0;
+      Ci=(4.0*y/32)-2.0;
+      i=0;
+      while ((i<8) && ((Xr*Xr+Xi*Xi)<4)) {
+        t=Xr*Xr - Xi*Xi + Cr;
+        Xi=2*Xr*Xi+Ci;
+        Xr=t;
+        i++;
+      }
+      if (i&1) count++;
+    }
+  }
+  return count;
+}
+var t = getTime();
+var n = mandelbrot();
+print(n, "pixels set in", ((getTime()-t)*1000).toFixed(1), "ms");
@@ -0,0 +1,14 @@
+// Repeated member access on built-ins and prototypes - see jspGetNamedFieldCached
+function Point(x,y) { this.x = x; this.y = y; }
+Point.prototype.len = function() { return this.x+this.y; };
+
+var p = new Point(1,2);
+var buf = [];
+var t = getTime();
+var s = 0;
+for (var i=0;i<20000;i++) {
+  s += Math.sin(i) + p.len();
+  if (buf.length>100) buf = [];
+  buf.push(i);
+}
+print("Time: "+(getTime()-t));
@@ -0,0 +1,9 @@
+// Print a large JSON dump to the console - this used to be queued for
+// transmit (and on Linux, flushed to stdout) one character at a time
+var a = [];
+for (var i=0;i<2000;i++) a.push({index:i, name:"item"+i, ok:true});
+var json = JSON.stringify(a);
+var t = getTime();
+print(json);
+t = getTime()-t;
+print("Printed", json.length, "chars in", (t*1000).toFixed(1), "ms");
@@ -0,0 +1,16 @@
+// Looking up fields of many records with the same shape by name. Most
+// comparisons are between a name and a key that doesn't match
+var N = 200;
+var keys = ["timestamp","temperature","humidity","pressure","battery","latitude","longitude","altitude","heading","satellites"];
+var recs = [];
+var t = getTime();
+for (var i=0;i<N;i++)
+  recs.push({timestamp:i, temperature:i, humidity:i, pressure:i, battery:i, latitude:i, longitude:i, altitude:i, heading:i, satellites:i});
+print("Created", N, "records in", ((getTime()-t)*1000).toFixed(1), "ms");
+t = getTime();
+var s = 0;
+for (var k=0;k<20;k++) for (var i=0;i<N;i++) {
+  var r = recs[i];
+  for (var j=0;j<keys.length;j++) s += r[keys[j]];
+}
+print("Read", 20*N*keys.length, "fields in", ((getTime()-t)*1000).toFixed(1), "ms");
@@ -0,0 +1,16 @@
+// RegExps over long strings. The old backtracking matcher re-parsed the RegExp
+// at every position, and repeated quantifiers could take a very long time
+var s = "";
+for (var i=0;i<40;i++)
+  s += "$GPGGA,"+(123519+i)+",4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,*47\r\n";
+var t = getTime();
+var r = s.replace(/\$GPGGA,(\d+),([^,]*),([NS])/g, "$1:$2$3");
+var n = 0;
+s.split(/\r\n/).forEach(function(l) { if (/^\$GP[A-Z]+,/.test(l)) n++; });
+print(s.length, "chars", n, "sentences in", ((getTime()-t)*1000).toFixed(1), "ms");
+
+var a = "";
+for (var i=0;i<40;i++) a += "a";
+t = getTime();
+/a*a*a*a*a*b/.test(a);
+print("Repeated quantifiers on", a.length, "chars in", ((getTime()-t)*1000).toFixed(1), "ms");
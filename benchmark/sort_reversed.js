@@ -0,0 +1,8 @@
+// Sorting data that's already in reverse order - the quicksort used the first
+// element as its pivot, so this was O(n^2)
+var N = 1000;
+var a = [];
+for (var i=0;i<N;i++) a.push(N-i);
+var t = getTime();
+a.sort(function(x,y) { return x-y; });
+print("Sorted", N, "reversed elements in", ((getTime()-t)*1000).toFixed(1), "ms");
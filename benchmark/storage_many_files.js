@@ -0,0 +1,19 @@
+// Storage lookups with hundreds of files - on Linux this exercises the filename index
+var s = require("Storage");
+s.eraseAll();
+for (var i=0;i<600;i++)
+  s.write("file"+i, "exports.value="+i+";");
+var t = getTime();
+var n = 0;
+for (var i=0;i<10000;i++)
+  if (s.read("missing")===undefined) n++;
+print("Storage.read (missing file)", ((getTime()-t)*1000).toFixed(1), "ms", n);
+t = getTime();
+for (var i=0;i<10000;i++)
+  if (s.read("file599")) n++;
+print("Storage.read (last file)", ((getTime()-t)*1000).toFixed(1), "ms", n);
+t = getTime();
+for (var i=0;i<10000;i++)
+  if (s.read("file0")) n++;
+print("Storage.read (first file)", ((getTime()-t)*1000).toFixed(1), "ms", n);
+s.eraseAll();
@@ -0,0 +1,19 @@
+// Storage read/eval speed - on Linux this exercises the emulated flash
+var s = require("Storage");
+s.eraseAll();
+for (var i=0;i<20;i++)
+  s.write("file"+i, "exports.value="+i+";\n// "+"x".repeat(200));
+s.write("mod", "(function(a,b){return a+b;})");
+var t = getTime();
+var total = 0;
+for (var n=0;n<500;n++) {
+  for (var i=0;i<20;i++)
+    total += s.read("file"+i).length;
+  total += s.list().length;
+}
+print("Storage.read/list", ((getTime()-t)*1000).toFixed(1), "ms", total);
+t = getTime();
+for (var n=0;n<500;n++)
+  total += eval(s.read("mod"))(1,2);
+print("eval(Storage.read)", ((getTime()-t)*1000).toFixed(1), "ms", total);
+s.eraseAll();
@@ -0,0 +1,15 @@
+// Lots of timers waiting while a fast interval runs - each idle pass used to
+// update every timer, even if none of them were due
+var TIMERS = 500;
+var TICKS = 1000;
+for (var i=0;i<TIMERS;i++)
+  setTimeout(function() {}, 1000000+i);
+
+var ticks = 0;
+var t = getTime();
+var iv = setInterval(function() {
+  if (++ticks < TICKS) return;
+  clearInterval(iv);
+  print(TICKS, "ticks with", TIMERS, "timers waiting in", ((getTime()-t)*1000).toFixed(1), "ms");
+  clearTimeout();
+}, 0.1);
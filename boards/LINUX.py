@@ -35,6 +35,7 @@ info = {
      'DEFINES+=-DESPR_UNICODE_SUPPORT=1',
      'DEFINES+=-DUSE_FONT_6X8 -DGRAPHICS_PALETTED_IMAGES -DGRAPHICS_ANTIALIAS -DESPR_PBF_FONTS',
      'DEFINES+=-DSPIFLASH_BASE=0 -DSPIFLASH_LENGTH=FLASH_SAVED_CODE_LENGTH', # For Testing Flash Strings
+#     'DEFINES+=-DLINUX_FLASH_NO_MEMMAP=1', # Don't return pointers into the memory-mapped flash file, so Storage uses Flash Strings (or use --flash-no-memmap)
      'LINUX=1',
    ]
  }
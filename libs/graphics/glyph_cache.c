@@ -0,0 +1,99 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * Least-recently-used cache of rendered font glyphs
+ * ----------------------------------------------------------------------------
+ */
+
+#include "glyph_cache.h"
+
+#ifdef GRAPHICS_GLYPH_CACHE
+
+/* Glyphs are stored one after the other from the start of glyphCache. When
+ * there's no space for a new glyph we remove the least recently used glyph
+ * and move the ones after it down. */
+static uint32_t glyphCache[GRAPHICS_GLYPH_CACHE/4];
+static size_t glyphCacheUsed; ///< bytes of glyphCache in use
+static uint16_t glyphCacheTime; ///< incremented each time we use a glyph
+static uint16_t glyphCacheStringTime; ///< glyphCacheTime when we started drawing the current string
+
+/// Size of the whole entry, rounded up so the next header is aligned
+static size_t glyphCacheEntrySize(GlyphCacheEntry *e) {
+  return (sizeof(GlyphCacheEntry) + e->length + 3) & ~(size_t)3;
+}
+
+GlyphCacheEntry *glyphCacheFind(uint32_t font, uint32_t ch) {
+  unsigned char *p = (unsigned char*)glyphCache;
+  unsigned char *end = p + glyphCacheUsed;
+  while (p < end) {
+    GlyphCacheEntry *e = (GlyphCacheEntry*)p;
+    if (e->ch==ch && e->font==font) {
+      e->lastUsed = ++glyphCacheTime;
+      return e;
+    }
+    p += glyphCacheEntrySize(e);
+  }
+  return 0;
+}
+
+void glyphCacheRemove(GlyphCacheEntry *e) {
+  size_t size = glyphCacheEntrySize(e);
+  unsigned char *next = (unsigned char*)e + size;
+  memmove(e, next, (size_t)((unsigned char*)glyphCache + glyphCacheUsed - next));
+  glyphCacheUsed -= size;
+}
+
+/** Remove the glyph that was used longest ago. If that glyph has been used while drawing the current
+ * string then the string has more characters than fit in the cache, and throwing glyphs out would just
+ * mean every character got rendered again next time - so we keep what we have and return false. */
+static bool glyphCacheRemoveOldest() {
+  unsigned char *p = (unsigned char*)glyphCache;
+  unsigned char *end = p + glyphCacheUsed;
+  GlyphCacheEntry *oldest = 0;
+  uint16_t oldestAge = 0;
+  while (p < end) {
+    GlyphCacheEntry *e = (GlyphCacheEntry*)p;
+    uint16_t age = (uint16_t)(glyphCacheTime - e->lastUsed); // works even when glyphCacheTime wraps
+    if (!oldest || age > oldestAge) {
+      oldest = e;
+      oldestAge = age;
+    }
+    p += glyphCacheEntrySize(e);
+  }
+  if (!oldest || oldestAge < (uint16_t)(glyphCacheTime - glyphCacheStringTime)) return false;
+  glyphCacheRemove(oldest);
+  return true;
+}
+
+GlyphCacheEntry *glyphCacheAdd(uint32_t font, uint32_t ch, size_t length) {
+  size_t size = (sizeof(GlyphCacheEntry) + length + 3) & ~(size_t)3;
+  // don't let one big glyph throw everything else out
+  if (size > sizeof(glyphCache)/4) return 0;
+  while (glyphCacheUsed + size > sizeof(glyphCache))
+    if (!glyphCacheRemoveOldest()) return 0;
+  GlyphCacheEntry *e = (GlyphCacheEntry*)((unsigned char*)glyphCache + glyphCacheUsed);
+  glyphCacheUsed += size;
+  memset(e, 0, sizeof(GlyphCacheEntry));
+  e->font = font;
+  e->ch = ch;
+  e->length = (uint16_t)length;
+  e->lastUsed = ++glyphCacheTime;
+  return e;
+}
+
+void glyphCacheStartString() {
+  glyphCacheStringTime = glyphCacheTime;
+}
+
+void glyphCacheClear() {
+  glyphCacheUsed = 0;
+}
+
+#endif // GRAPHICS_GLYPH_CACHE
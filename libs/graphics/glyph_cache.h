@@ -0,0 +1,57 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * Least-recently-used cache of rendered font glyphs
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef GLYPH_CACHE_H
+#define GLYPH_CACHE_H
+
+#include "graphics.h"
+
+#ifdef GRAPHICS_GLYPH_CACHE
+
+/// Bit set in GlyphCacheEntry.font for Vector font glyphs (the rest is the size)
+#define GLYPH_CACHE_FONT_VECTOR 0x80000000U
+
+/// Header of a cached glyph - followed by 'length' bytes of data
+typedef struct {
+  uint32_t font;       ///< which font (and size) the glyph is from
+  uint32_t ch;         ///< character code
+  uint16_t length;     ///< bytes of data after this header
+  uint16_t lastUsed;   ///< when this glyph was last used (for deciding what to throw out)
+  int8_t x, y;         ///< offset of glyph data from where the character is drawn
+  uint8_t w, h;        ///< size of glyph data
+  uint8_t advance;     ///< how far to move on after drawing the character
+  uint8_t bpp;         ///< bits per pixel of glyph data
+} GlyphCacheEntry;
+
+/// Get the data stored after a glyph's header
+static ALWAYS_INLINE unsigned char *glyphCacheGetData(GlyphCacheEntry *e) {
+  return (unsigned char*)(e+1);
+}
+
+/// Find a glyph in the cache, or return 0
+GlyphCacheEntry *glyphCacheFind(uint32_t font, uint32_t ch);
+/** Add a glyph with 'length' bytes of data to the cache (throwing out old glyphs if needed)
+ * and return it so the header and data can be filled in. Returns 0 if it's too big to cache, or if
+ * we'd have to throw out glyphs used since glyphCacheStartString.
+ * The result is only valid until the next call to glyphCacheAdd */
+GlyphCacheEntry *glyphCacheAdd(uint32_t font, uint32_t ch, size_t length);
+/// Remove a glyph from the cache (eg. if it couldn't be rendered completely)
+void glyphCacheRemove(GlyphCacheEntry *e);
+/// Call before drawing a string, so glyphs it uses aren't thrown out to make space for others in it
+void glyphCacheStartString();
+/// Remove everything from the cache
+void glyphCacheClear();
+
+#endif // GRAPHICS_GLYPH_CACHE
+#endif // GLYPH_CACHE_H
@@ -62,6 +62,21 @@ void graphicsFallbackSetPixel(JsGraphics *gfx, int x, int y, unsigned int col) {
   NOT_USED(col);
 }
 
+void graphicsFallbackSetPixelRow(JsGraphics *gfx, int x, int y, int count, const unsigned char *data) {
+  int bpp = gfx->data.bpp;
+  unsigned int mask = (unsigned int)((1L<<bpp)-1L);
+  uint32_t colData = 0;
+  int bits = 0;
+  while (count--) {
+    while (bits < bpp) {
+      colData = (colData<<8) | *(data++);
+      bits += 8;
+    }
+    gfx->setPixel(gfx, x++, y, (colData>>(bits-bpp))&mask);
+    bits -= bpp;
+  }
+}
+
 unsigned int graphicsFallbackGetPixel(JsGraphics *gfx, int x, int y) {
   NOT_USED(gfx);
   NOT_USED(x);
@@ -77,10 +92,15 @@ void graphicsFallbackFillRect(JsGraphics *gfx, int x1, int y1, int x2, int y2, u
 }
 
 void graphicsFallbackBlit(JsGraphics *gfx, int x1, int y1, int w, int h, int x2, int y2) {
-  for (int y=0;y<h;y++)
-    for (int x=0;x<w;x++)
-      gfx->setPixel(gfx, (int)(x+x2),(int)(y+y2),
-        gfx->getPixel(gfx, (int)(x+x1),(int)(y+y1)));
+  // Work away from the destination so overlapping areas copy correctly
+  bool upwards = y2>y1, leftwards = y2==y1 && x2>x1;
+  for (int j=0;j<h;j++) {
+    int y = upwards ? h-1-j : j;
+    for (int i=0;i<w;i++) {
+      int x = leftwards ? w-1-i : i;
+      gfx->setPixel(gfx, x+x2, y+y2, gfx->getPixel(gfx, x+x1, y+y1));
+    }
+  }
 }
 
 void graphicsFallbackScrollX(JsGraphics *gfx, int xdir, int yfrom, int yto, int x1, int x2) {
@@ -149,17 +169,13 @@ void graphicsStructInit(JsGraphics *gfx, int width, int height, int bpp) {
   gfx->data.height = (unsigned short)height;
   gfx->data.bpp = (unsigned char)bpp;
   graphicsStructResetState(gfx);
-#ifndef NO_MODIFIED_AREA
-  gfx->data.modMaxX = -32768;
-  gfx->data.modMaxY = -32768;
-  gfx->data.modMinX = 32767;
-  gfx->data.modMinY = 32767;
-#endif
+  graphicsResetModified(gfx);
 }
 
 /// Set up the callbacks for this graphics instance (usually done by graphicsGetFromVar)
 bool graphicsSetCallbacks(JsGraphics *gfx) {
   gfx->setPixel = graphicsFallbackSetPixel;
+  gfx->setPixelRow = graphicsFallbackSetPixelRow;
   gfx->getPixel = graphicsFallbackGetPixel;
   gfx->fillRect = graphicsFallbackFillRect;
   gfx->blit = graphicsFallbackBlit;
@@ -304,6 +320,79 @@ unsigned short graphicsGetHeight(const JsGraphics *gfx) {
   return (gfx->data.flags & JSGRAPHICSFLAGS_SWAP_XY) ? gfx->data.width : gfx->data.height;
 }
 
+#if GRAPHICS_MODIFIED_RECTS>1
+/// Merge two modified rects if it'd mark no more than this many unmodified pixels as modified (about the cost of addressing another area of the screen)
+#define GRAPHICS_MODIFIED_RECT_COST 256
+
+static JsGraphicsClipRect graphicsModifiedRectUnion(JsGraphicsClipRect a, JsGraphicsClipRect b) {
+  if (b.x1 < a.x1) a.x1 = b.x1;
+  if (b.y1 < a.y1) a.y1 = b.y1;
+  if (b.x2 > a.x2) a.x2 = b.x2;
+  if (b.y2 > a.y2) a.y2 = b.y2;
+  return a;
+}
+
+static int graphicsModifiedRectArea(JsGraphicsClipRect r) {
+  return (1+r.x2-r.x1)*(1+r.y2-r.y1);
+}
+
+/// How many unmodified pixels would be marked as modified if we merged a and b (negative if they overlap)
+static int graphicsModifiedRectMergeCost(JsGraphicsClipRect a, JsGraphicsClipRect b) {
+  return graphicsModifiedRectArea(graphicsModifiedRectUnion(a,b)) - (graphicsModifiedRectArea(a) + graphicsModifiedRectArea(b));
+}
+
+/// Add an area (already clipped to the screen) to the list of modified rects, merging rects together where it's cheap to do so
+static void graphicsAddModifiedRect(JsGraphics *gfx, int x1, int y1, int x2, int y2) {
+  JsGraphicsData *d = &gfx->data;
+  int i, n = d->modRectCount;
+  // most of the time (eg. pixels of a line, characters of a string) we're drawing inside an area we already have
+  for (i=0;i<n;i++) {
+    if (x1>=d->modRects[i].x1 && y1>=d->modRects[i].y1 &&
+        x2<=d->modRects[i].x2 && y2<=d->modRects[i].y2) return;
+  }
+  JsGraphicsClipRect nr;
+  nr.x1 = (unsigned short)x1;
+  nr.y1 = (unsigned short)y1;
+  nr.x2 = (unsigned short)x2;
+  nr.y2 = (unsigned short)y2;
+  int r; // the rect that has changed
+  if (n < GRAPHICS_MODIFIED_RECTS) {
+    r = n++;
+    d->modRects[r] = nr;
+  } else { // no space - merge with whichever rect is cheapest
+    int bestCost = 0x7FFFFFFF;
+    r = 0;
+    for (i=0;i<n;i++) {
+      int cost = graphicsModifiedRectMergeCost(d->modRects[i], nr);
+      if (cost < bestCost) {
+        bestCost = cost;
+        r = i;
+      }
+    }
+    d->modRects[r] = graphicsModifiedRectUnion(d->modRects[r], nr);
+  }
+  // Now merge the changed rect with any others while it's cheap enough
+  while (n>1) {
+    int best = -1, bestCost = GRAPHICS_MODIFIED_RECT_COST+1;
+    for (i=0;i<n;i++) {
+      if (i==r) continue;
+      int cost = graphicsModifiedRectMergeCost(d->modRects[i], d->modRects[r]);
+      if (cost < bestCost) {
+        bestCost = cost;
+        best = i;
+      }
+    }
+    if (best<0) break;
+    d->modRects[r] = graphicsModifiedRectUnion(d->modRects[r], d->modRects[best]);
+    // remove 'best' by moving the last rect into its place
+    n--;
+    d->modRects[best] = d->modRects[n];
+    if (r==n) r = best;
+  }
+  d->modRectCount = (unsigned char)n;
+}
+#endif
+
 // Set the area modified by a draw command and also clip to the screen/clipping bounds. Returns true if clipped. If coordsRotatedAlready we assume the coordinates have gone through deviceToGraphicsCoordinates already
 bool graphicsSetModifiedAndClip(JsGraphics *gfx, int *x1, int *y1, int *x2, int *y2, bool coordsRotatedAlready) {
   bool modified = false;
@@ -333,6 +422,10 @@ bool graphicsSetModifiedAndClip(JsGraphics *gfx, int *x1, int *y1, int *x2, int
   if (*x2 > gfx->data.modMaxX) { gfx->data.modMaxX=(short)*x2; modified = true; }
   if (*y1 < gfx->data.modMinY) { gfx->data.modMinY=(short)*y1; modified = true; }
   if (*y2 > gfx->data.modMaxY) { gfx->data.modMaxY=(short)*y2; modified = true; }
+#endif
+#if GRAPHICS_MODIFIED_RECTS>1
+  if (*x1<=*x2 && *y1<=*y2)
+    graphicsAddModifiedRect(gfx, *x1, *y1, *x2, *y2);
 #endif
   return modified;
 }
@@ -345,6 +438,78 @@ void graphicsSetModified(JsGraphics *gfx, int x1, int y1, int x2, int y2) {
   if (y1 < gfx->data.modMinY) { gfx->data.modMinY=(short)y1; }
   if (y2 > gfx->data.modMaxY) { gfx->data.modMaxY=(short)y2; }
 #endif
+#if GRAPHICS_MODIFIED_RECTS>1
+  if (x1<0) x1=0;
+  if (y1<0) y1=0;
+  if (x2>=gfx->data.width) x2=gfx->data.width-1;
+  if (y2>=gfx->data.height) y2=gfx->data.height-1;
+  if (x1<=x2 && y1<=y2)
+    graphicsAddModifiedRect(gfx, x1, y1, x2, y2);
+#endif
+}
+
+// Clear the modified area (eg. once it has been sent to the screen)
+void graphicsResetModified(JsGraphics *gfx) {
+#ifndef NO_MODIFIED_AREA
+  gfx->data.modMaxX = -32768;
+  gfx->data.modMaxY = -32768;
+  gfx->data.modMinX = 32767;
+  gfx->data.modMinY = 32767;
+#endif
+#if GRAPHICS_MODIFIED_RECTS>1
+  gfx->data.modRectCount = 0;
+#endif
+}
+
+/// Get the modified areas in device coordinates. rects must have space for GRAPHICS_MODIFIED_RECTS - returns the number of rects
+int graphicsGetModifiedRects(JsGraphics *gfx, JsGraphicsClipRect *rects) {
+#ifndef NO_MODIFIED_AREA
+  if (gfx->data.modMinX > gfx->data.modMaxX || gfx->data.modMinY > gfx->data.modMaxY)
+    return 0; // nothing modified
+#if GRAPHICS_MODIFIED_RECTS>1
+  if (gfx->data.modRectCount) {
+    memcpy(rects, gfx->data.modRects, gfx->data.modRectCount*sizeof(JsGraphicsClipRect));
+    return gfx->data.modRectCount;
+  }
+#endif
+  // no list - just use the overall modified area
+  rects[0].x1 = (unsigned short)((gfx->data.modMinX<0) ? 0 : gfx->data.modMinX);
+  rects[0].y1 = (unsigned short)((gfx->data.modMinY<0) ? 0 : gfx->data.modMinY);
+  rects[0].x2 = (unsigned short)gfx->data.modMaxX;
+  rects[0].y2 = (unsigned short)gfx->data.modMaxY;
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+/// As graphicsGetModifiedRects, but merged into full-width bands of rows, sorted top to bottom (for displays that send whole lines)
+int graphicsGetModifiedRows(JsGraphics *gfx, JsGraphicsClipRect *rows) {
+  int i, n = graphicsGetModifiedRects(gfx, rows);
+  // sort by start row - there are only ever a few so insertion sort is fine
+  for (i=1;i<n;i++) {
+    JsGraphicsClipRect r = rows[i];
+    int j = i;
+    while (j>0 && rows[j-1].y1 > r.y1) {
+      rows[j] = rows[j-1];
+      j--;
+    }
+    rows[j] = r;
+  }
+  // join bands that overlap or touch
+  int count = 0;
+  for (i=0;i<n;i++) {
+    if (count && rows[i].y1 <= rows[count-1].y2+1) {
+      if (rows[i].y2 > rows[count-1].y2)
+        rows[count-1].y2 = rows[i].y2;
+    } else
+      rows[count++] = rows[i];
+  }
+  for (i=0;i<count;i++) {
+    rows[i].x1 = 0;
+    rows[i].x2 = (unsigned short)(gfx->data.width-1);
+  }
+  return count;
 }
 
 /// Get a setPixel function (assuming coordinates already clipped with graphicsSetModifiedAndClip) - if all is ok it can choose a faster draw function
@@ -434,6 +599,13 @@ static void graphicsSetPixelDevice(JsGraphics *gfx, int x, int y, unsigned int c
   if (x > gfx->data.modMaxX) gfx->data.modMaxX=(short)x;
   if (y < gfx->data.modMinY) gfx->data.modMinY=(short)y;
   if (y > gfx->data.modMaxY) gfx->data.modMaxY=(short)y;
+#if GRAPHICS_MODIFIED_RECTS>1
+  // quick check against the first rect as we're called a lot (and usually land in it)
+  if (!gfx->data.modRectCount ||
+      x<gfx->data.modRects[0].x1 || y<gfx->data.modRects[0].y1 ||
+      x>gfx->data.modRects[0].x2 || y>gfx->data.modRects[0].y2)
+    graphicsAddModifiedRect(gfx, x, y, x, y);
+#endif
 #else
   if (x<0 || y<0 || x>=gfx->data.width || y>=gfx->data.height) return;
 #endif
@@ -480,6 +652,9 @@ void graphicsFillRectDevice(JsGraphics *gfx, int x1, int y1, int x2, int y2, uns
   if (x2 > gfx->data.modMaxX) gfx->data.modMaxX=(short)x2;
   if (y1 < gfx->data.modMinY) gfx->data.modMinY=(short)y1;
   if (y2 > gfx->data.modMaxY) gfx->data.modMaxY=(short)y2;
+#endif
+#if GRAPHICS_MODIFIED_RECTS>1
+  graphicsAddModifiedRect(gfx, x1, y1, x2, y2);
 #endif
   if (x1==x2 && y1==y2) {
     gfx->setPixel(gfx,(int)x1,(int)y1,col);
@@ -785,7 +960,23 @@ void graphicsDrawCircleAA(JsGraphics *gfx, int x0, int y0, int r){
 
 #endif
 
-// Fill poly - each member of vertices is 1/16th pixel
+/// An edge of a polygon for graphicsFillPoly
+typedef struct {
+  short x1, y1; ///< the vertex the edge starts from
+  short x2, y2; ///< the vertex the edge ends at (y1!=y2)
+  unsigned short n; ///< which edge of the polygon this is
+} GfxPolyEdge;
+// The edge crosses scanlines where GFXPOLYEDGE_YMIN <= y < GFXPOLYEDGE_YMAX
+#define GFXPOLYEDGE_YMIN(e) (((e).y1<(e).y2) ? (e).y1 : (e).y2)
+#define GFXPOLYEDGE_YMAX(e) (((e).y1<(e).y2) ? (e).y2 : (e).y1)
+
+/* Fill poly - each member of vertices is 1/16th pixel
+
+We make a table of the polygon's (non-horizontal) edges sorted by their top,
+then go down the scanlines keeping a list of the edges that cross the current
+one (the 'active edge table'), sorted by where they cross. That way each
+scanline only looks at the edges that actually cross it, and between pairs of
+crossings we draw a whole horizontal span with graphicsFillRectDevice. */
 void graphicsFillPoly(JsGraphics *gfx, int points, short *vertices) {
   typedef struct {
     short x,y;
@@ -815,55 +1006,82 @@ void graphicsFillPoly(JsGraphics *gfx, int points, short *vertices) {
   if (maxy>=gfx->data.height) maxy=(int)(gfx->data.height-1);
 #endif
 
-  const int MAX_CROSSES = 64;
+  // Make the edge table, sorted by ymin (insertion sort - there aren't many edges)
+  GfxPolyEdge *edges = (GfxPolyEdge*)alloca(sizeof(GfxPolyEdge)*(size_t)points);
+  int edgeCount = 0;
+  j = points-1;
+  for (i=0;i<points;i++) {
+    // don't do horiz lines - rely on the ends of the lines that join onto them
+    if (v[j].y != v[i].y) {
+      GfxPolyEdge e;
+      e.x1 = v[i].x;
+      e.y1 = v[i].y;
+      e.x2 = v[j].x;
+      e.y2 = v[j].y;
+      e.n = (unsigned short)i;
+      int k = edgeCount++;
+      // sort is stable, so edges that start together stay in polygon order
+      while (k>0 && GFXPOLYEDGE_YMIN(edges[k-1]) > GFXPOLYEDGE_YMIN(e)) {
+        edges[k] = edges[k-1];
+        k--;
+      }
+      edges[k] = e;
+    }
+    j = i;
+  }
+
+  /* The active edge table - indices into 'edges' of the edges crossing this
+  scanline, and where they cross. We keep it sorted by crossing (and then by
+  polygon order so edges crossing at the same point are always in the same order) */
+  unsigned short *active = (unsigned short*)alloca(sizeof(unsigned short)*(size_t)edgeCount);
+  short *cross = (short*)alloca(sizeof(short)*(size_t)edgeCount);
+  int activeCount = 0;
+  int nextEdge = 0;
 
   // for each scanline
   for (y=miny<<4;y<=maxy<<4;y+=16) {
     int yl = y>>4;
-    short cross[MAX_CROSSES];
-    bool slopes[MAX_CROSSES];
-    int crosscnt = 0;
-    // work out all the times lines cross the scanline
-    j = points-1;
-    for (i=0;i<points;i++) {
-      if ((v[i].y<=y && v[j].y>y) || (v[j].y<=y && v[i].y>y)) {
-        if (crosscnt < MAX_CROSSES) {
-          int l = v[j].y - v[i].y;
-          if (l) { // don't do horiz lines - rely on the ends of the lines that join onto them
-            cross[crosscnt] = (short)(v[i].x + ((y - v[i].y) * (v[j].x-v[i].x)) / l);
-            slopes[crosscnt] = (l>1)?1:0;
-            crosscnt++;
-          }
-        }
-      }
-      j = i;
+    // remove edges that have finished
+    for (i=0,j=0;i<activeCount;i++) {
+      if (GFXPOLYEDGE_YMAX(edges[active[i]]) > y)
+        active[j++] = active[i];
     }
-
-    // bubble sort
-    for (i=0;i<crosscnt-1;) {
-      if (cross[i]>cross[i+1]) {
-        short t=cross[i];
-        cross[i]=cross[i+1];
-        cross[i+1]=t;
-        bool ts=slopes[i];
-        slopes[i]=slopes[i+1];
-        slopes[i+1]=ts;
-        if (i) i--;
-      } else i++;
+    activeCount = j;
+    // add edges that start on or before this scanline
+    while (nextEdge<edgeCount && GFXPOLYEDGE_YMIN(edges[nextEdge])<=y) {
+      if (GFXPOLYEDGE_YMAX(edges[nextEdge]) > y)
+        active[activeCount++] = (unsigned short)nextEdge;
+      nextEdge++;
+    }
+    // work out where the edges cross the scanline, and keep them sorted (they
+    // only change order when edges cross, so this is nearly always in order already)
+    for (i=0;i<activeCount;i++) {
+      GfxPolyEdge *e = &edges[active[i]];
+      short x = (short)(e->x1 + ((y - e->y1) * (e->x2 - e->x1)) / (e->y2 - e->y1));
+      unsigned short a = active[i];
+      j = i;
+      while (j>0 && (cross[j-1]>x || (cross[j-1]==x && edges[active[j-1]].n>e->n))) {
+        cross[j] = cross[j-1];
+        active[j] = active[j-1];
+        j--;
+      }
+      cross[j] = x;
+      active[j] = a;
     }
 
     //  Fill the pixels between node pairs.
     int x = 0,s = 0;
-    for (i=0;i<crosscnt;i++) {
+    for (i=0;i<activeCount;i++) {
       if (s==0) x=cross[i];
-      if (slopes[i]) s++; else s--;
-      if (!s || i==crosscnt-1) {
+      GfxPolyEdge *e = &edges[active[i]];
+      if (e->y2 - e->y1 > 1) s++; else s--;
+      if (!s || i==activeCount-1) {
         int x1 = (x+15)>>4;
         int x2 = (cross[i]+15)>>4;
         if (x2>x1) graphicsFillRectDevice(gfx,x1,yl,x2-1,yl,gfx->data.fgColor);
       }
-      if (jspIsInterrupted()) break;
     }
+    if (jspIsInterrupted()) break;
   }
 }
 
@@ -27,11 +27,18 @@
 #ifndef ESPRUINOBOARD
   #define GRAPHICS_DRAWIMAGE_ROTATED // Allow rotating images
   #define GRAPHICS_THEME // Keep a 'theme'
+  #define GRAPHICS_MODIFIED_RECTS 4 // Keep a list of up to 4 modified rectangles as well as the overall modified area
 #endif
 #endif
+#ifndef GRAPHICS_MODIFIED_RECTS
+  #define GRAPHICS_MODIFIED_RECTS 1 // just the overall modified area
+#endif
 
 #if defined(LINUX) || defined(BANGLEJS)
 #define GRAPHICS_FAST_PATHS // execute more optimised code when no rotation/etc
+#ifndef GRAPHICS_GLYPH_CACHE
+#define GRAPHICS_GLYPH_CACHE 2048 // bytes of RAM used to keep recently drawn Vector/PBF font characters (see glyph_cache.c)
+#endif
 #endif
 
 typedef enum {
@@ -123,6 +130,10 @@ typedef struct {
   JsGraphicsClipRect clipRect;
   short modMinX, modMinY, modMaxX, modMaxY; ///< area that has been modified
 #endif
+#if GRAPHICS_MODIFIED_RECTS>1
+  unsigned char modRectCount; ///< number of entries in modRects
+  JsGraphicsClipRect modRects[GRAPHICS_MODIFIED_RECTS]; ///< separate modified areas (all inside modMin/Max)
+#endif
 } PACKED_FLAGS JsGraphicsData;
 
 typedef struct JsGraphics {
@@ -131,6 +142,7 @@ typedef struct JsGraphics {
   void *backendData; ///< Data used by the graphics backend
 
   void (*setPixel)(struct JsGraphics *gfx, int x, int y, unsigned int col); ///< x/y guaranteed to be in range
+  void (*setPixelRow)(struct JsGraphics *gfx, int x, int y, int count, const unsigned char *data); ///< set count pixels from x,y to data, packed MSB-first at this Graphics' bpp - x/y guaranteed to be in range
   void (*fillRect)(struct JsGraphics *gfx, int x1, int y1, int x2, int y2, unsigned int col); ///< x/y guaranteed to be in range
   unsigned int (*getPixel)(struct JsGraphics *gfx, int x, int y); ///< x/y guaranteed to be in range
   void (*blit)(struct JsGraphics *gfx, int x1, int y1, int w, int h, int x2, int y2); ///< blit a WxH area of x1y1 to x2y2 - all guaranteed to be in range
@@ -138,6 +150,8 @@ typedef struct JsGraphics {
 } PACKED_FLAGS JsGraphics;
 typedef void (*JsGraphicsSetPixelFn)(struct JsGraphics *gfx, int x, int y, unsigned int col);
 
+#define GRAPHICS_ROW_BUFFER_SIZE 32 ///< Bytes of packed pixel data we buffer up for each setPixelRow call
+
 #ifdef GRAPHICS_THEME
 #if LCD_BPP && LCD_BPP<=16
 typedef unsigned short JsGraphicsThemeColor;
@@ -197,6 +211,12 @@ unsigned short graphicsGetHeight(const JsGraphics *gfx);
 bool graphicsSetModifiedAndClip(JsGraphics *gfx, int *x1, int *y1, int *x2, int *y2, bool coordsRotatedAlready);
 // Set the area modified by a draw command
 void graphicsSetModified(JsGraphics *gfx, int x1, int y1, int x2, int y2);
+// Clear the modified area (eg. once it has been sent to the screen)
+void graphicsResetModified(JsGraphics *gfx);
+/// Get the modified areas in device coordinates. rects must have space for GRAPHICS_MODIFIED_RECTS - returns the number of rects
+int graphicsGetModifiedRects(JsGraphics *gfx, JsGraphicsClipRect *rects);
+/// As graphicsGetModifiedRects, but merged into full-width bands of rows, sorted top to bottom (for displays that send whole lines)
+int graphicsGetModifiedRows(JsGraphics *gfx, JsGraphicsClipRect *rows);
 /// Get a setPixel function (assuming coordinates already clipped with graphicsSetModifiedAndClip) - if all is ok it can choose a faster draw function
 JsGraphicsSetPixelFn graphicsGetSetPixelFn(JsGraphics *gfx);
 /// Get a setPixel function and set modified area (assuming no clipping) (inclusive of x2,y2) - if all is ok it can choose a faster draw function
@@ -236,6 +256,8 @@ void graphicsIdle(); ///< called when idling
 #define GRAPHICS_COL_RGB_TO_16(R,G,B) ((((R)&0xF8)<<8)|(((G)&0xFC)<<3)|(((B)&0xF8)>>3))
 
 void graphicsFallbackSetPixel(JsGraphics *gfx, int x, int y, unsigned int col); ///< Does nothing, used when not implemented
+void graphicsFallbackSetPixelRow(JsGraphics *gfx, int x, int y, int count, const unsigned char *data); ///< Unpacks data and calls setPixel for each pixel
+void graphicsFallbackBlit(JsGraphics *gfx, int x1, int y1, int w, int h, int x2, int y2); ///< Blits with getPixel/setPixel
 unsigned int graphicsFallbackGetPixel(JsGraphics *gfx, int x, int y); ///< Does nothing, used when not implemented
 
 #endif // GRAPHICS_H
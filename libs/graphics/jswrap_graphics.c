@@ -41,6 +41,7 @@
 #include "bitmap_font_4x6.h"
 #include "bitmap_font_6x8.h"
 #include "vector_font.h"
+#include "glyph_cache.h"
 #ifdef ESPR_PBF_FONTS
 #include "pbf_font.h"
 #endif
@@ -420,21 +421,51 @@ NO_INLINE void _jswrap_drawImageSimple(JsGraphics *gfx, int xPos, int yPos, GfxD
   } else // onscreen. y1!=yPos if clipped - ensure we skip enough bytes
     bits = -(y1-yPos)*img->bpp*img->width;
 #endif
-  JsGraphicsSetPixelFn setPixel = graphicsGetSetPixelUnclippedFn(gfx, xPos, y1, xPos+img->width-1, y2, true);
-  for (int y=y1;y<=y2;y++) {
-    for (int x=xPos;x<xPos+img->width;x++) {
-      // Get the data we need...
-      while (bits < img->bpp) {
-        colData = (colData<<8) | ((unsigned char)jsvStringIteratorGetUTF8CharAndNext(it));
-        bits += 8;
+#ifndef SAVE_ON_FLASH
+  if (img->bpp==gfx->data.bpp && !img->palettePtr && img->transparentCol>img->bitMask &&
+      !(gfx->data.flags & JSGRAPHICSFLAGS_MAPPEDXY)) {
+    /* Image data is already in the format we want, and we don't need to touch
+    individual pixels - so write whole rows of packed pixel data at once */
+    unsigned char data[GRAPHICS_ROW_BUFFER_SIZE];
+    int chunk = (GRAPHICS_ROW_BUFFER_SIZE*8) / img->bpp; // pixels per setPixelRow call
+    for (int y=y1;y<=y2;y++) {
+      bits -= (x1-xPos)*img->bpp; // skip pixels clipped on the left
+      for (int x=x1;x<=x2;x+=chunk) {
+        int count = x2+1-x;
+        if (count>chunk) count = chunk;
+        int bytes = (count*img->bpp+7)>>3;
+        for (int i=0;i<bytes;i++) {
+          while (bits < 8) {
+            colData = (colData<<8) | ((unsigned char)jsvStringIteratorGetUTF8CharAndNext(it));
+            bits += 8;
+          }
+          data[i] = (unsigned char)(colData>>(bits-8));
+          bits -= 8;
+        }
+        bits += bytes*8 - count*img->bpp; // we may have read part of the next pixel - put it back
+        gfx->setPixelRow(gfx, x, y, count, data);
       }
-      // extract just the bits we want
-      unsigned int col = (colData>>(bits-img->bpp))&img->bitMask;
-      bits -= img->bpp;
-      // Try and write pixel!
-      if (img->transparentCol!=col) {
-        if (img->palettePtr) col = img->palettePtr[col&img->paletteMask];
-        setPixel(gfx, x, y, col);
+      bits -= (xPos+img->width-1-x2)*img->bpp; // skip pixels clipped on the right
+    }
+  } else
+#endif
+  {
+    JsGraphicsSetPixelFn setPixel = graphicsGetSetPixelUnclippedFn(gfx, xPos, y1, xPos+img->width-1, y2, true);
+    for (int y=y1;y<=y2;y++) {
+      for (int x=xPos;x<xPos+img->width;x++) {
+        // Get the data we need...
+        while (bits < img->bpp) {
+          colData = (colData<<8) | ((unsigned char)jsvStringIteratorGetUTF8CharAndNext(it));
+          bits += 8;
+        }
+        // extract just the bits we want
+        unsigned int col = (colData>>(bits-img->bpp))&img->bitMask;
+        bits -= img->bpp;
+        // Try and write pixel!
+        if (img->transparentCol!=col) {
+          if (img->palettePtr) col = img->palettePtr[col&img->paletteMask];
+          setPixel(gfx, x, y, col);
+        }
       }
     }
   }
@@ -442,7 +473,7 @@ NO_INLINE void _jswrap_drawImageSimple(JsGraphics *gfx, int xPos, int yPos, GfxD
   if (parseFullImage) {
     /* If we didn't render the last bit of the image, and the caller needs
     the StringIterator to point to the end of the image, skip forward */
-    bits += img->bpp-(yPos+img->height-(1+y2))*img->bpp*img->width;
+    bits -= (yPos+img->height-(1+y2))*img->bpp*img->width;
     while (bits < 0) {
       jsvStringIteratorNextUTF8(it);
       bits += 8;
@@ -564,6 +595,10 @@ void jswrap_graphics_init() {
   graphicsTheme.bgH = (JsGraphicsThemeColor)0;
   graphicsTheme.dark = true;
 #endif
+#ifdef GRAPHICS_GLYPH_CACHE
+  // fonts in Storage may have been moved or rewritten, so cached glyphs may not match any more
+  glyphCacheClear();
+#endif
 }
 
 /*JSON{
@@ -2176,7 +2211,12 @@ static int _jswrap_graphics_getCharWidth(JsGraphicsFontInfo *info, int ch) {
 #ifdef ESPR_PBF_FONTS
     if ((info->font & JSGRAPHICS_FONTSIZE_FONT_MASK)==JSGRAPHICS_FONTSIZE_CUSTOM_PBF) {
       PbfFontLoaderGlyph result;
+#ifdef GRAPHICS_GLYPH_CACHE
+      const unsigned char *data;
+      if (jspbfFontFindGlyphCached(&info->pbfInfo, ch, &result, &data))
+#else
       if (jspbfFontFindGlyph(&info->pbfInfo, ch, &result))
+#endif
         return info->scalex*result.advance;
       else
         return 0;
@@ -2600,6 +2640,9 @@ JsVar *jswrap_graphics_drawString(JsVar *parent, JsVar *var, int x, int y, bool
   JsGraphicsFontInfo info;
   _jswrap_graphics_getFontInfo(&gfx, &info);
   int fontHeight = _jswrap_graphics_getFontHeightInternal(&gfx, &info);
+#ifdef GRAPHICS_GLYPH_CACHE
+  glyphCacheStartString();
+#endif
 
 #ifndef SAVE_ON_FLASH
   int customBPP = 1;
@@ -2691,7 +2734,14 @@ JsVar *jswrap_graphics_drawString(JsVar *parent, JsVar *var, int x, int y, bool
       if (x>minX-w && x<maxX  && y>minY-fontHeight && y<=maxY) {
         if (solidBackground)
           graphicsFillRect(&gfx,x,y,x+w-1,y+fontHeight-1, gfx.data.bgColor);
-        graphicsGetVectorChar((graphicsPolyCallback)graphicsFillPoly, &gfx, x, y, info.scalex, info.scaley, (char)ch);
+#ifdef GRAPHICS_GLYPH_CACHE
+        // cached characters are in device coordinates so can only be used if we're not rotated
+        GlyphCacheEntry *glyph = (gfx.data.flags & JSGRAPHICSFLAGS_MAPPEDXY) ? 0 : graphicsGetVectorCharCached(info.scalex, info.scaley, (char)ch);
+        if (glyph)
+          graphicsDrawVectorCharCached(&gfx, glyph, x, y);
+        else
+#endif
+          graphicsGetVectorChar((graphicsPolyCallback)graphicsFillPoly, &gfx, x, y, info.scalex, info.scaley, (char)ch);
       }
       x+=w;
 #endif
@@ -2709,8 +2759,13 @@ JsVar *jswrap_graphics_drawString(JsVar *parent, JsVar *var, int x, int y, bool
 #ifdef ESPR_PBF_FONTS
     } else if ((info.font & JSGRAPHICS_FONTSIZE_FONT_MASK)==JSGRAPHICS_FONTSIZE_CUSTOM_PBF) {
       PbfFontLoaderGlyph glyph;
+      const unsigned char *glyphData = 0;
+#ifdef GRAPHICS_GLYPH_CACHE
+      if (jspbfFontFindGlyphCached(&info.pbfInfo, ch, &glyph, &glyphData)) {
+#else
       if (jspbfFontFindGlyph(&info.pbfInfo, ch, &glyph)) {
-        jspbfFontRenderGlyph(&info.pbfInfo, &glyph, &gfx,
+#endif
+        jspbfFontRenderGlyph(&info.pbfInfo, &glyph, glyphData, &gfx,
                 x+glyph.x*info.scalex, y+glyph.y*info.scaley,
                 solidBackground, info.scalex, info.scaley);
         x+=glyph.advance*info.scalex;
@@ -3945,10 +4000,7 @@ JsVar *jswrap_graphics_getModified(JsVar *parent, bool reset) {
     }
   }
   if (reset) {
-    gfx.data.modMaxX = -32768;
-    gfx.data.modMaxY = -32768;
-    gfx.data.modMinX = 32767;
-    gfx.data.modMinY = 32767;
+    graphicsResetModified(&gfx);
     graphicsSetVar(&gfx);
   }
   return obj;
@@ -3957,6 +4009,50 @@ JsVar *jswrap_graphics_getModified(JsVar *parent, bool reset) {
 #endif
 }
 
+/*JSON{
+  "type" : "method",
+  "class" : "Graphics",
+  "name" : "getModifiedRects",
+  "ifndef" : "SAVE_ON_FLASH",
+  "generate" : "jswrap_graphics_getModifiedRects",
+  "params" : [
+    ["reset","bool","Whether to reset the modified area or not"]
+  ],
+  "return" : ["JsVar","An array of objects {x1,y1,x2,y2}, one for each modified area (empty if not modified)"],
+  "typescript" : "getModifiedRects(reset?: boolean): { x1: number, y1: number, x2: number, y2: number }[];"
+}
+Like `g.getModified()`, but rather than one rectangle covering every area that
+has been modified this returns a list of up to 4 separate rectangles (which may
+overlap). Areas that are close together are merged, but if you draw in two
+opposite corners of the screen you'll get two small rectangles rather than
+one covering the whole screen.
+
+The coordinates are device coordinates (so are not affected by `g.setRotation`).
+This is what's used on displays like Bangle.js to only send the parts of the
+screen that have changed.
+*/
+JsVar *jswrap_graphics_getModifiedRects(JsVar *parent, bool reset) {
+  JsGraphics gfx; if (!graphicsGetFromVar(&gfx, parent)) return 0;
+  JsVar *arr = jsvNewEmptyArray();
+  if (!arr) return 0;
+  JsGraphicsClipRect rects[GRAPHICS_MODIFIED_RECTS];
+  int i, n = graphicsGetModifiedRects(&gfx, rects);
+  for (i=0;i<n;i++) {
+    JsVar *obj = jsvNewObject();
+    if (!obj) break;
+    jsvObjectSetChildAndUnLock(obj, "x1", jsvNewFromInteger(rects[i].x1));
+    jsvObjectSetChildAndUnLock(obj, "y1", jsvNewFromInteger(rects[i].y1));
+    jsvObjectSetChildAndUnLock(obj, "x2", jsvNewFromInteger(rects[i].x2));
+    jsvObjectSetChildAndUnLock(obj, "y2", jsvNewFromInteger(rects[i].y2));
+    jsvArrayPushAndUnLock(arr, obj);
+  }
+  if (reset) {
+    graphicsResetModified(&gfx);
+    graphicsSetVar(&gfx);
+  }
+  return arr;
+}
+
 /*JSON{
   "type" : "method",
   "class" : "Graphics",
@@ -4061,10 +4157,10 @@ JsVar *jswrap_graphics_blit(JsVar *parent, JsVar *options) {
   if (ex > 0) w -= ex;
   ex = (y2+h) - sh;
   if (ex > 0) h -= ex;
-  if (w>0 || h>0) {
+  if (w>0 && h>0) {
     gfx.blit(&gfx, x1,y1,w,h,x2,y2);
     if (setModified) {
-      graphicsSetModified(&gfx, x2,y2,x2+w,y2+h);
+      graphicsSetModified(&gfx, x2,y2,x2+w-1,y2+h-1);
       graphicsSetVar(&gfx);
     }
   }
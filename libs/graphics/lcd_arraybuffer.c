@@ -232,6 +232,90 @@ void lcdSetPixel_ArrayBuffer_flat(JsGraphics *gfx, int x, int y, unsigned int co
   lcdSetPixels_ArrayBuffer_flat(gfx, x, y, 1, col);
 }
 
+/// Write nBits of MSB-first data from 'src' into 'dst' starting at bit dstBit
+static void lcdWriteBits_ArrayBuffer(unsigned char *dst, unsigned int dstBit, unsigned int nBits, const unsigned char *src) {
+  dst += dstBit>>3;
+  unsigned int shift = dstBit&7;
+  if (!shift) { // byte aligned - just copy
+    memcpy(dst, src, nBits>>3);
+    if (nBits&7) {
+      unsigned int mask = 0xFF00U >> (nBits&7);
+      dst[nBits>>3] = (unsigned char)((dst[nBits>>3] & ~mask) | (src[nBits>>3] & mask));
+    }
+    return;
+  }
+  unsigned int end = shift+nBits; // bit index in dst after the last one we write
+  unsigned int dstBytes = (end+7)>>3, srcBytes = (nBits+7)>>3;
+  unsigned int prev = 0;
+  for (unsigned int i=0;i<dstBytes;i++) {
+    unsigned int cur = (i<srcBytes) ? src[i] : 0;
+    unsigned int v = (prev<<(8-shift)) | (cur>>shift);
+    prev = cur;
+    unsigned int mask = 0xFF;
+    if (i==0) mask &= 0xFFU>>shift;
+    if (i==dstBytes-1 && (end&7)) mask &= 0xFF00U>>(end&7);
+    dst[i] = (unsigned char)((dst[i] & ~mask) | (v & mask));
+  }
+}
+
+/// Read nBits of MSB-first data from 'src' starting at bit srcBit into 'dst'
+static void lcdReadBits_ArrayBuffer(const unsigned char *src, unsigned int srcBit, unsigned int nBits, unsigned char *dst) {
+  src += srcBit>>3;
+  unsigned int shift = srcBit&7, bytes = (nBits+7)>>3;
+  if (!shift) { // byte aligned - just copy
+    memcpy(dst, src, bytes);
+    return;
+  }
+  for (unsigned int i=0;i<bytes;i++) {
+    unsigned int v = (unsigned int)src[i]<<shift;
+    if (i*8+8-shift < nBits) v |= (unsigned int)src[i+1]>>(8-shift); // only read the next byte if we need it
+    dst[i] = (unsigned char)v;
+  }
+}
+
+// Write a row of pixels packed MSB-first (as they are in images) into a flat memory area
+void lcdSetPixelRow_ArrayBuffer_flat(JsGraphics *gfx, int x, int y, int count, const unsigned char *data) {
+  int bpp = gfx->data.bpp;
+  bool isMSB = (gfx->data.flags & JSGRAPHICSFLAGS_ARRAYBUFFER_MSB) || bpp==8;
+  if ((gfx->data.flags & JSGRAPHICSFLAGS_NONLINEAR) || (!isMSB && (bpp&7)))
+    return graphicsFallbackSetPixelRow(gfx, x, y, count, data);
+  unsigned int bitIdx = (unsigned int)((x + y*gfx->data.width)*bpp);
+  if (isMSB) {
+    lcdWriteBits_ArrayBuffer((unsigned char*)gfx->backendData, bitIdx, (unsigned int)(count*bpp), data);
+  } else { // whole bytes, but least significant byte first
+    unsigned char *ptr = &((unsigned char*)gfx->backendData)[bitIdx>>3];
+    int bytes = bpp>>3;
+    while (count--) {
+      for (int i=bytes-1;i>=0;i--)
+        *(ptr++) = data[i];
+      data += bytes;
+    }
+  }
+}
+
+// Blit by copying rows of bits rather than individual pixels
+void lcdBlit_ArrayBuffer_flat(JsGraphics *gfx, int x1, int y1, int w, int h, int x2, int y2) {
+  int bpp = gfx->data.bpp;
+  // byte order doesn't matter when copying whole bytes, but sub-byte LSB pixels aren't stored in order
+  if ((gfx->data.flags & JSGRAPHICSFLAGS_NONLINEAR) || ((bpp&7) && !(gfx->data.flags & JSGRAPHICSFLAGS_ARRAYBUFFER_MSB)))
+    return graphicsFallbackBlit(gfx, x1, y1, w, h, x2, y2);
+  unsigned char *pixels = (unsigned char*)gfx->backendData;
+  unsigned char buf[GRAPHICS_ROW_BUFFER_SIZE];
+  int chunk = (GRAPHICS_ROW_BUFFER_SIZE*8) / bpp; // pixels we can copy at once
+  // Work away from the destination so overlapping areas copy correctly
+  bool upwards = y2>y1, leftwards = y2==y1 && x2>x1;
+  for (int j=0;j<h;j++) {
+    int y = upwards ? h-1-j : j;
+    for (int i=0;i<w;i+=chunk) {
+      int n = w-i;
+      if (n>chunk) n = chunk;
+      int x = leftwards ? w-i-n : i;
+      lcdReadBits_ArrayBuffer(pixels, (unsigned int)((x1+x + (y1+y)*gfx->data.width)*bpp), (unsigned int)(n*bpp), buf);
+      lcdWriteBits_ArrayBuffer(pixels, (unsigned int)((x2+x + (y2+y)*gfx->data.width)*bpp), (unsigned int)(n*bpp), buf);
+    }
+  }
+}
+
 // Faster implementation for where we have a flat memory area
 void  lcdFillRect_ArrayBuffer_flat(struct JsGraphics *gfx, int x1, int y1, int x2, int y2, unsigned int col) {
   int y;
@@ -454,6 +538,8 @@ void lcdSetCallbacks_ArrayBuffer(JsGraphics *gfx) {
 #ifdef GRAPHICS_ARRAYBUFFER_OPTIMISATIONS
   if (dataPtr && len>=graphicsGetMemoryRequired(gfx) && !(gfx->data.flags & JSGRAPHICSFLAGS_ARRAYBUFFER_ZIGZAG)) {
     gfx->backendData = dataPtr;
+    gfx->setPixelRow = lcdSetPixelRow_ArrayBuffer_flat;
+    gfx->blit = lcdBlit_ArrayBuffer_flat;
 #ifdef GRAPHICS_FAST_PATHS
     if (gfx->data.bpp==1 &&
         (gfx->data.flags & JSGRAPHICSFLAGS_ARRAYBUFFER_MSB) &&
@@ -279,15 +279,17 @@ void lcdMemLCD_flip_spi_callback() {
 }
 // send the data to the screen
 void lcdMemLCD_flip(JsGraphics *gfx) {
-  if (gfx->data.modMinY > gfx->data.modMaxY) return; // nothing to do!
+  // Each line we send has its own address, so we only send the bands of lines that were modified
+  JsGraphicsClipRect rows[GRAPHICS_MODIFIED_RECTS];
+  int rowCount = graphicsGetModifiedRows(gfx, rows);
+  if (!rowCount) return; // nothing to do!
 #ifdef EMULATED
   EMSCRIPTEN_GFX_CHANGED = true;
 #endif
   lcdMemLCD_waitForSendComplete();
 
-  int y1 = gfx->data.modMinY;
-  int y2 = gfx->data.modMaxY;
-  int l = 1+y2-y1;
+  int y1 = rows[0].y1;
+  int y2 = rows[rowCount-1].y2;
 
   bool hasOverlay = false;
   GfxDrawImageInfo overlayImg;
@@ -302,10 +304,8 @@ void lcdMemLCD_flip(JsGraphics *gfx) {
      *
      * We use an extra line added to the end of lcdBuffer for this, which
      * allows us to use lcdMemLCD_setPixel to do color conversion and dither
-     * without loads of duplicate code.
-     *
-     * Optimisation: we could just send any non-overlaid stuff above or below
-     * the overlay...
+     * without loads of duplicate code. Lines without the overlay on are sent
+     * straight from lcdBuffer.
      */
     // Take account of rotation - only check for a full 180 rotation - doing 90 is too hard
     bool isRotated180 = (graphicsInternal.data.flags & (JSGRAPHICSFLAGS_SWAP_XY | JSGRAPHICSFLAGS_INVERT_X | JSGRAPHICSFLAGS_INVERT_Y)) ==
@@ -328,21 +328,42 @@ void lcdMemLCD_flip(JsGraphics *gfx) {
     jsvStringIteratorNew(&l.it, l.img.buffer, (size_t)l.img.bitmapOffset);
     _jswrap_drawImageLayerInit(&l);
     _jswrap_drawImageLayerSetStart(&l, 0, y1);
+    int row = 0;
+    bool skipped = false;
     for (int y=y1;y<=y2;y++) {
+      if (y > rows[row].y2) row++;
+      if (y < rows[row].y1) { // line not modified - skip it
+        _jswrap_drawImageLayerNextY(&l);
+        skipped = true;
+        continue;
+      }
+      if (y<ovY || y>=ovY+overlayImg.height) { // no overlay on this line - send it straight from the buffer
+        _jswrap_drawImageLayerNextY(&l);
+#ifdef EMULATED
+        memcpy(&fakeLCDBuffer[LCD_STRIDE*y], &lcdBuffer[LCD_STRIDE*y], LCD_STRIDE);
+#else
+        jshSPISendMany(LCD_SPI, &lcdBuffer[LCD_STRIDE*y], NULL, LCD_STRIDE, lcdMemLCD_flip_spi_ovr_callback);
+#endif
+        continue;
+      }
       int bufferLine = LCD_HEIGHT + (y&1); // alternate lines so we still get dither AND we can send while calculating next line
       unsigned char *buf = &lcdBuffer[LCD_STRIDE*bufferLine]; // point to line right on the end of gfx
+      if (skipped) { // if we skipped a line, the last line we sent may still be sending from this buffer
+#ifndef EMULATED
+        jshSPIWait(LCD_SPI);
+#endif
+        skipped = false;
+      }
       // copy original line in
       memcpy(buf, &lcdBuffer[LCD_STRIDE*y], LCD_STRIDE);
       // overwrite areas with overlay image
-      if (y>=ovY && y<ovY+overlayImg.height) {
-        _jswrap_drawImageLayerStartX(&l);
-        for (int x=0;x<overlayImg.width;x++) {
-          uint32_t c;
-          int ox = x+lcdOverlayX;
-          if (_jswrap_drawImageLayerGetPixel(&l, &c) && (ox < LCD_WIDTH) && (ox >= 0))
-            lcdMemLCD_setPixel(NULL, ox, bufferLine, c);
-          _jswrap_drawImageLayerNextX(&l);
-        }
+      _jswrap_drawImageLayerStartX(&l);
+      for (int x=0;x<overlayImg.width;x++) {
+        uint32_t c;
+        int ox = x+lcdOverlayX;
+        if (_jswrap_drawImageLayerGetPixel(&l, &c) && (ox < LCD_WIDTH) && (ox >= 0))
+          lcdMemLCD_setPixel(NULL, ox, bufferLine, c);
+        _jswrap_drawImageLayerNextX(&l);
       }
       _jswrap_drawImageLayerNextY(&l);
       // send the line
@@ -367,16 +388,18 @@ void lcdMemLCD_flip(JsGraphics *gfx) {
     memcpy(fakeLCDBuffer, lcdBuffer, LCD_HEIGHT*LCD_STRIDE);
 #else
     lcdIsBusy = true;
-    if (!jshSPISendMany(LCD_SPI, &lcdBuffer[LCD_STRIDE*y1], NULL, (l*LCD_STRIDE)+2, lcdMemLCD_flip_spi_callback))
+    // send all but the last band without waiting - jshSPISendMany waits for the previous send before starting the next
+    for (int i=0;i<rowCount-1;i++)
+      jshSPISendMany(LCD_SPI, &lcdBuffer[LCD_STRIDE*rows[i].y1], NULL, (1+rows[i].y2-rows[i].y1)*LCD_STRIDE, lcdMemLCD_flip_spi_ovr_callback);
+    // the last band has 2 extra bytes to finish the transfer
+    int l = 1+y2-rows[rowCount-1].y1;
+    if (!jshSPISendMany(LCD_SPI, &lcdBuffer[LCD_STRIDE*rows[rowCount-1].y1], NULL, (l*LCD_STRIDE)+2, lcdMemLCD_flip_spi_callback))
       lcdMemLCD_flip_spi_callback();
     // lcdMemLCD_flip_spi_callback will call jshPinSetValue(LCD_SPI_CS, 0); when done and set lcdIsBusy=false
 #endif
   }
   // Reset modified-ness
-  gfx->data.modMaxX = -32768;
-  gfx->data.modMaxY = -32768;
-  gfx->data.modMinX = 32767;
-  gfx->data.modMinY = 32767;
+  graphicsResetModified(gfx);
 }
 
 void lcdMemLCD_init(JsGraphics *gfx) {
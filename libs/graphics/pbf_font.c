@@ -15,6 +15,9 @@
 #ifdef ESPR_PBF_FONTS
 
 #include "pbf_font.h"
+#ifdef GRAPHICS_GLYPH_CACHE
+#include "glyph_cache.h"
+#endif
 
 // https://github.com/pebble-dev/wiki/wiki/Firmware-Font-Format
 
@@ -70,6 +73,21 @@ void jspbfFontNew(PbfFontLoaderInfo *info, JsVar *font) {
   }
   info->offsetTableOffset = (uint32_t)(info->hashTableOffset + info->hashTableSize*4);
   info->glyphTableOffset = (uint32_t)(info->offsetTableOffset + (info->glyphCount*info->offsetTableEntrySize));
+#ifdef GRAPHICS_GLYPH_CACHE
+  /* Only fonts that are memory-mapped (eg. from Storage) get cached. We identify them by
+   * where their data is and what's in the header, so a different font that later ends up
+   * in the same place doesn't use the same cached glyphs. A font in RAM could be freed and
+   * another one allocated in the same variable at any time, so we don't cache those. */
+  info->cacheId = 0;
+  if (jsvIsNativeString(font) || jsvIsFlashString(font)) {
+    uint32_t header[4] = { (uint32_t)(size_t)font->varData.nativeStr.ptr, info->glyphTableOffset, info->glyphCount, ((uint32_t)info->version<<8) | info->lineHeight };
+    uint32_t hash = JS_HASH_INITIAL;
+    for (unsigned int i=0;i<sizeof(header);i++)
+      hash = jsHashChar(hash, ((char*)header)[i]);
+    info->cacheId = hash & ~GLYPH_CACHE_FONT_VECTOR;
+    if (!info->cacheId) info->cacheId = 1;
+  }
+#endif
 }
 
 void jspbfFontFree(PbfFontLoaderInfo *info) {
@@ -121,16 +139,51 @@ bool jspbfFontFindGlyph(PbfFontLoaderInfo *info, int codepoint, PbfFontLoaderGly
   return false;
 }
 
-void jspbfFontRenderGlyph(PbfFontLoaderInfo *info, PbfFontLoaderGlyph *glyph, JsGraphics *gfx, int x, int y, bool solidBackground, int scalex, int scaley) {
+#ifdef GRAPHICS_GLYPH_CACHE
+/** As jspbfFontFindGlyph, but keep glyphs in the glyph cache so we don't have to look them up next time.
+ * If the glyph is cached *data is set to its bitmap, otherwise it's 0 and the iterator is left pointing to the glyph */
+bool jspbfFontFindGlyphCached(PbfFontLoaderInfo *info, int codepoint, PbfFontLoaderGlyph *result, const unsigned char **data) {
+  *data = 0;
+  if (!info->cacheId) return jspbfFontFindGlyph(info, codepoint, result);
+  GlyphCacheEntry *e = glyphCacheFind(info->cacheId, (uint32_t)codepoint);
+  if (!e) {
+    if (!jspbfFontFindGlyph(info, codepoint, result)) return false;
+    e = glyphCacheAdd(info->cacheId, (uint32_t)codepoint, (size_t)(result->w*result->h*result->bpp + 7) >> 3);
+    if (!e) return true; // too big to cache - just use it from the font
+    e->x = result->x;
+    e->y = result->y;
+    e->w = result->w;
+    e->h = result->h;
+    e->advance = (uint8_t)result->advance;
+    e->bpp = result->bpp;
+    unsigned char *d = glyphCacheGetData(e);
+    for (int i=0;i<e->length;i++)
+      d[i] = jspbfGetU8(&info->it);
+  }
+  result->x = e->x;
+  result->y = e->y;
+  result->w = e->w;
+  result->h = e->h;
+  result->advance = (int8_t)e->advance;
+  result->bpp = e->bpp;
+  *data = glyphCacheGetData(e);
+  return true;
+}
+#endif
+
+/// Render a glyph from jspbfFontFindGlyph. If data is set, the bitmap is read from it rather than the font
+void jspbfFontRenderGlyph(PbfFontLoaderInfo *info, PbfFontLoaderGlyph *glyph, const unsigned char *data, JsGraphics *gfx, int x, int y, bool solidBackground, int scalex, int scaley) {
   //bmpOffset *= ch * customBPP;
   // now render character
   int bmpOffset = 0;
   int bpp = glyph->bpp;
   int bppRange = (1<<bpp)-1;
   int cx,cy;
-  int citdata = jsvStringIteratorGetCharAndNext(&info->it);
+  int citdata = 0;
   for (cy=0;cy<glyph->h;cy++) {
     for (cx=0;cx<glyph->w;cx++) {
+      if (!bmpOffset) // read the next byte only when we need it, so we don't read past the end of the glyph
+        citdata = data ? *(data++) : jsvStringIteratorGetCharAndNext(&info->it);
       int col = citdata&bppRange;
       if (solidBackground || col)
         graphicsFillRect(gfx,
@@ -141,10 +194,8 @@ void jspbfFontRenderGlyph(PbfFontLoaderInfo *info, PbfFontLoaderGlyph *glyph, Js
             graphicsBlendGfxColor(gfx, (256*col)/bppRange));
       bmpOffset += bpp;
       citdata >>= bpp;
-      if (bmpOffset>=8) {
+      if (bmpOffset>=8)
         bmpOffset=0;
-        citdata = jsvStringIteratorGetCharAndNext(&info->it);
-      }
     }
   }
 }
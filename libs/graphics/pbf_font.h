@@ -33,6 +33,9 @@ typedef struct {
   uint32_t offsetTableOffset;
   uint32_t glyphTableOffset;
   bool hashTableValueAsTopBits;
+#ifdef GRAPHICS_GLYPH_CACHE
+  uint32_t cacheId; ///< identifies this font in the glyph cache, or 0 if it is not cached
+#endif
 } PbfFontLoaderInfo;
 
 typedef struct {
@@ -51,7 +54,14 @@ void jspbfFontFree(PbfFontLoaderInfo *info);
 // Find the font glyph, fill PbfFontLoaderGlyph with info. Iterator is left pointing to glyph
 bool jspbfFontFindGlyph(PbfFontLoaderInfo *info, int codepoint, PbfFontLoaderGlyph *result);
 
-void jspbfFontRenderGlyph(PbfFontLoaderInfo *info, PbfFontLoaderGlyph *glyph, JsGraphics *gfx, int x, int y, bool solidBackground, int scalex, int scaley);
+#ifdef GRAPHICS_GLYPH_CACHE
+/** As jspbfFontFindGlyph, but keep glyphs in the glyph cache so we don't have to look them up next time.
+ * If the glyph is cached *data is set to its bitmap, otherwise it's 0 and the iterator is left pointing to the glyph */
+bool jspbfFontFindGlyphCached(PbfFontLoaderInfo *info, int codepoint, PbfFontLoaderGlyph *result, const unsigned char **data);
+#endif
+
+/// Render a glyph from jspbfFontFindGlyph. If data is set, the bitmap is read from it rather than the font
+void jspbfFontRenderGlyph(PbfFontLoaderInfo *info, PbfFontLoaderGlyph *glyph, const unsigned char *data, JsGraphics *gfx, int x, int y, bool solidBackground, int scalex, int scaley);
 
 #endif // PBF_FONT_H
 #endif // ESPR_PBF_FONTS
\ No newline at end of file
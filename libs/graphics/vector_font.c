@@ -14,6 +14,7 @@
 
 #ifndef NO_VECTOR_FONT
 #include "vector_font.h"
+#include "jsparse.h" // for jspIsInterrupted
 
 const uint8_t vfFirstChar = 33;
 const uint8_t vfLastChar = 255;
@@ -487,4 +488,115 @@ unsigned int graphicsGetVectorChar(graphicsPolyCallback callback, void *callback
   return vfGetCharFromPtr(callback, callbackData, x1, y1, sizex, sizey, charPtr, charLen);
 }
 
+#ifdef GRAPHICS_GLYPH_CACHE
+#define VF_CACHE_ORIGIN 8 // where we draw characters when rendering them for the cache (so they don't get clipped)
+
+typedef struct {
+  JsGraphics gfx; ///< Graphics we fill the character's polygons into
+  int x1, y1, x2, y2; ///< area covered by the character's polygons
+  uint8_t *data; ///< 1bpp bitmap we're drawing into
+  int stride; ///< bytes per row of data
+} VfCacheRender;
+
+/// Work out the area covered by a polygon
+static void vfCacheBounds(void *data, int points, short *vertices) {
+  VfCacheRender *r = (VfCacheRender*)data;
+  for (int i=0;i<points*2;i+=2) {
+    int x = vertices[i], y = vertices[i+1];
+    if ((x>>4) < r->x1) r->x1 = x>>4;
+    if (((x+15)>>4) > r->x2) r->x2 = (x+15)>>4;
+    if ((y>>4) < r->y1) r->y1 = y>>4;
+    if (((y+15)>>4) > r->y2) r->y2 = (y+15)>>4;
+  }
+}
+
+static void vfCacheFillRect(JsGraphics *gfx, int x1, int y1, int x2, int y2, unsigned int col) {
+  NOT_USED(col);
+  VfCacheRender *r = (VfCacheRender*)gfx->backendData;
+  if (x1<r->x1) x1 = r->x1;
+  if (x2>r->x2) x2 = r->x2;
+  if (y1<r->y1) y1 = r->y1;
+  if (y2>r->y2) y2 = r->y2;
+  for (int y=y1;y<=y2;y++) {
+    uint8_t *row = &r->data[(y-r->y1)*r->stride];
+    for (int x=x1-r->x1;x<=x2-r->x1;x++)
+      row[x>>3] |= (uint8_t)(1<<(x&7));
+  }
+}
+
+static void vfCacheSetPixel(JsGraphics *gfx, int x, int y, unsigned int col) {
+  vfCacheFillRect(gfx, x, y, x, y, col);
+}
+
+static void vfCachePoly(void *data, int points, short *vertices) {
+  graphicsFillPoly(&((VfCacheRender*)data)->gfx, points, vertices);
+}
+
+/* Get a character from the glyph cache, rendering it if it's not there. Returns 0 if it can't be cached.
+ * Filled polygons are the same shape wherever they're drawn (as long as Graphics isn't rotated) so we
+ * store a 1bpp bitmap of the pixels that graphicsFillPoly would have drawn. */
+GlyphCacheEntry *graphicsGetVectorCharCached(int sizex, int sizey, char ch) {
+  if (sizex<0 || sizex>0x7FFF || sizey<0 || sizey>0xFFFF) return 0;
+  uint32_t font = GLYPH_CACHE_FONT_VECTOR | ((uint32_t)sizex<<16) | (uint32_t)sizey;
+  GlyphCacheEntry *e = glyphCacheFind(font, (unsigned char)ch);
+  if (e) return e;
+  unsigned int advance = graphicsVectorCharWidth((unsigned int)sizex, ch);
+  if (advance>255) return 0;
+  // first find out how big the character is
+  VfCacheRender r;
+  r.x1 = r.y1 = 0x7FFF;
+  r.x2 = r.y2 = -0x7FFF;
+  graphicsGetVectorChar(vfCacheBounds, &r, VF_CACHE_ORIGIN, VF_CACHE_ORIGIN, sizex, sizey, ch);
+  if (r.x1>r.x2) r.x1 = r.x2 = r.y1 = r.y2 = VF_CACHE_ORIGIN; // nothing drawn (eg. space)
+  int w = r.x2+1-r.x1, h = r.y2+1-r.y1;
+  if (r.x1<0 || r.y1<0 || r.x1-VF_CACHE_ORIGIN>127 || r.y1-VF_CACHE_ORIGIN>127 || w>255 || h>255)
+    return 0; // too big to store
+  r.stride = (w+7)>>3;
+  e = glyphCacheAdd(font, (unsigned char)ch, (size_t)(r.stride*h));
+  if (!e) return 0;
+  e->x = (int8_t)(r.x1-VF_CACHE_ORIGIN);
+  e->y = (int8_t)(r.y1-VF_CACHE_ORIGIN);
+  e->w = (uint8_t)w;
+  e->h = (uint8_t)h;
+  e->advance = (uint8_t)advance;
+  e->bpp = 1;
+  r.data = glyphCacheGetData(e);
+  memset(r.data, 0, (size_t)(r.stride*h));
+  // now fill the polygons into the bitmap
+  memset(&r.gfx, 0, sizeof(r.gfx));
+  graphicsStructInit(&r.gfx, r.x2+1, r.y2+1, 1);
+  r.gfx.data.fgColor = 1;
+  r.gfx.setPixel = vfCacheSetPixel;
+  r.gfx.fillRect = vfCacheFillRect;
+  r.gfx.backendData = &r;
+  graphicsGetVectorChar(vfCachePoly, &r, VF_CACHE_ORIGIN, VF_CACHE_ORIGIN, sizex, sizey, ch);
+  if (jspIsInterrupted()) { // graphicsFillPoly stopped early, so we only have part of the glyph
+    glyphCacheRemove(e);
+    return 0;
+  }
+  return e;
+}
+
+/// Draw a character from graphicsGetVectorCharCached at x,y (in device coordinates)
+void graphicsDrawVectorCharCached(JsGraphics *gfx, GlyphCacheEntry *e, int x, int y) {
+  const uint8_t *row = glyphCacheGetData(e);
+  int stride = (e->w+7)>>3;
+  x += e->x;
+  y += e->y;
+  for (int cy=0;cy<e->h;cy++,row+=stride) {
+    int cx = 0;
+    while (cx<e->w) {
+      if (!(row[cx>>3] & (1<<(cx&7)))) {
+        cx = (!(cx&7) && !row[cx>>3]) ? cx+8 : cx+1; // skip empty bytes quickly
+        continue;
+      }
+      // fill each horizontal run of set bits in one go
+      int x1 = cx;
+      while (cx<e->w && (row[cx>>3] & (1<<(cx&7)))) cx++;
+      graphicsFillRectDevice(gfx, x+x1, y+cy, x+cx-1, y+cy, gfx->data.fgColor);
+    }
+  }
+}
+#endif
+
 #endif
@@ -24,4 +24,12 @@ typedef void(*graphicsPolyCallback)(void *data, int points, short *vertices);
 
 // prints character by calling callback with the data (x16), returns width
 unsigned int graphicsGetVectorChar(graphicsPolyCallback callback, void *callbackData, int x1, int y1, int sizex, int sizey, char ch);
+
+#ifdef GRAPHICS_GLYPH_CACHE
+#include "glyph_cache.h"
+// Get a character from the glyph cache, rendering it if it's not there. Returns 0 if it can't be cached
+GlyphCacheEntry *graphicsGetVectorCharCached(int sizex, int sizey, char ch);
+// Draw a character from graphicsGetVectorCharCached at x,y (in device coordinates)
+void graphicsDrawVectorCharCached(JsGraphics *gfx, GlyphCacheEntry *e, int x, int y);
+#endif
 #endif
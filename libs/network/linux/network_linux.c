@@ -13,6 +13,7 @@
  */
 #include "network.h"
 #include "network_linux.h"
+#include "jshardware.h"
 
 #include <string.h> // for memset
 
@@ -198,6 +199,9 @@ int net_linux_createsocket(JsNetwork *net, SocketType socketType, uint32_t host,
   if (setsockopt(sckt,SOL_SOCKET,SO_NOSIGPIPE,(const char *)&optval,sizeof(optval))<0)
     jsWarn("setsockopt(SO_NOSIGPIPE) failed\n");
 #endif
+#ifdef LINUX_USE_EPOLL
+  jshLinuxWatchFd(sckt, true); // wake up from jshSleep when there's data
+#endif
 
   return sckt;
 }
@@ -205,6 +209,9 @@ int net_linux_createsocket(JsNetwork *net, SocketType socketType, uint32_t host,
 /// destroys the given socket
 void net_linux_closesocket(JsNetwork *net, int sckt) {
   NOT_USED(net);
+#ifdef LINUX_USE_EPOLL
+  jshLinuxWatchFd(sckt, false);
+#endif
   closesocket(sckt);
 }
 
@@ -223,6 +230,9 @@ int net_linux_accept(JsNetwork *net, int sckt) {
   if (n>0) {
     // we have a client waiting to connect... try to connect and see what happens
     int theClient = accept(sckt,0,0);
+#ifdef LINUX_USE_EPOLL
+    jshLinuxWatchFd(theClient, true);
+#endif
     return theClient;
   }
   return -1;
@@ -29,6 +29,7 @@ static char *socketErrors[] = {
   "SSL handshake failed",
   "invalid SSL data",
   "no response",
+  "invalid HTTP data",
 };
 
 char *socketErrorString(int error) {
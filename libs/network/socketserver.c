@@ -18,8 +18,6 @@
 #include "jshardware.h"
 #include "jswrap_net.h"
 #include "jswrap_stream.h"
-#include "jswrap_string.h"
-#include "jswrap_functions.h"
 
 #define HTTP_NAME_SOCKETTYPE "type" // normal socket or HTTP
 #define HTTP_NAME_PORT "port"
@@ -27,8 +25,13 @@
 #define HTTP_NAME_HAD_HEADERS "hdrs"
 #define HTTP_NAME_ENDED "endd"
 #define HTTP_NAME_RECEIVE_DATA "dRcv"
-#define HTTP_NAME_RECEIVE_COUNT "cRcv"
+#define HTTP_NAME_RECEIVE_COUNT "cRcv" // body or chunk bytes left (or chunk size while parsing it)
+#define HTTP_NAME_PARSE_STATE "hPs"   // HttpParseState
+#define HTTP_NAME_PARSE_POS "hPp"     // how far into dRcv we have looked for the end of the headers
+#define HTTP_NAME_KEEPALIVE "kA"      // boolean: keep the connection open after this request
 #define HTTP_NAME_SEND_DATA "dSnd"
+#define HTTP_NAME_SEND_QUEUE "dSq"   // array of Strings to send (in order) before dSnd
+#define HTTP_NAME_SEND_OFFSET "dSo"  // how much of the first item in dSq has been sent
 #define HTTP_NAME_RESPONSE_VAR "res"
 #define HTTP_NAME_OPTIONS_VAR "opt"
 #define HTTP_NAME_SERVER_VAR "svr"
@@ -49,6 +52,42 @@
 #define HTTP_ARRAY_HTTP_SERVERS "HttpS"
 #define HTTP_ARRAY_HTTP_SERVER_CONNECTIONS "HttpSC"
 
+/// Incremental HTTP parser state, stored in HTTP_NAME_PARSE_STATE of the request/response being received
+typedef enum {
+  HTTPS_HEADERS,          ///< waiting for the end of the headers
+  HTTPS_BODY,             ///< HTTP_NAME_RECEIVE_COUNT bytes of body left
+  HTTPS_BODY_UNTIL_CLOSE, ///< no length given, so the body ends when the connection closes
+  HTTPS_CHUNK_SIZE,       ///< reading a hex chunk size into HTTP_NAME_RECEIVE_COUNT
+  HTTPS_CHUNK_EXT,        ///< skipping a chunk extension up to the end of the line
+  HTTPS_CHUNK_DATA,       ///< HTTP_NAME_RECEIVE_COUNT bytes of chunk data left
+  HTTPS_CHUNK_DATA_END,   ///< skipping the CRLF after chunk data
+  HTTPS_TRAILER_START,    ///< at the start of a trailer line - an empty line ends the message
+  HTTPS_TRAILER,          ///< in a trailer line
+  HTTPS_DONE,             ///< message complete - anything after it is the next (pipelined) request
+  HTTPS_ERROR,            ///< the message was invalid (eg. a huge chunk size), so the connection will be closed
+} HttpParseState;
+
+/* Most network devices can't wake us up when data arrives, so we keep the idle loop
+ * busy (polling) while any sockets are open. On Linux jshSleep wakes up as soon as a
+ * Linux socket has data, so for those we only need to be busy if we actually did
+ * something. Other networks on Linux (eg. NetworkJS) have no fd to watch, so they poll. */
+#ifdef LINUX_USE_EPOLL
+#define SOCKET_IDLE_RESULT(net, hadSockets, wasBusy) (((net)->data.type==JSNETWORKTYPE_SOCKET) ? (wasBusy) : (hadSockets))
+#else
+#define SOCKET_IDLE_RESULT(net, hadSockets, wasBusy) (NOT_USED(net), NOT_USED(wasBusy), (hadSockets))
+#endif
+
+/* Strings at least this long are queued by reference in HTTP_NAME_SEND_QUEUE rather than
+ * being copied onto the end of HTTP_NAME_SEND_DATA */
+#define SOCKET_SEND_REFERENCE_MIN 128
+/* When we have a pointer to the data we don't need a stack buffer, so we can hand netSend
+ * more than chunkSize bytes. Only Linux is known to cope with that. */
+#ifdef LINUX
+#define SOCKET_SEND_DIRECT_MAX 65536
+#else
+#define SOCKET_SEND_DIRECT_MAX ((size_t)net->chunkSize)
+#endif
+
 #ifdef ESP8266
 // esp8266 debugging, need to remove this eventually
 extern int os_printf_plus(const char *format, ...)  __attribute__((format(printf, 1, 2)));
@@ -93,12 +132,14 @@ static void httpAppendHeaders(JsVar *string, JsVar *headerObject) {
 // httpParseHeaders(&receiveData, reqVar, true) // server
 // httpParseHeaders(&receiveData, resVar, false) // client
 bool httpParseHeaders(JsVar **receiveData, JsVar *objectForData, bool isServer) {
-  // find /r/n/r/n
+  // find /r/n/r/n - carrying on from where we got to last time
   int newlineIdx = 0;
-  int strIdx = 0;
+  int strIdx = (int)jsvGetIntegerAndUnLock(jsvObjectGetChildIfExists(objectForData, HTTP_NAME_PARSE_POS));
   int headerEnd = -1;
+  if (strIdx>3) strIdx -= 3; // in case we stopped part way through /r/n/r/n
+  else strIdx = 0;
   JsvStringIterator it;
-  jsvStringIteratorNew(&it, *receiveData, 0);
+  jsvStringIteratorNew(&it, *receiveData, (size_t)strIdx);
   while (jsvStringIteratorHasChar(&it)) {
     char ch = jsvStringIteratorGetCharAndNext(&it);
     if (ch == '\r') {
@@ -115,7 +156,11 @@ bool httpParseHeaders(JsVar **receiveData, JsVar *objectForData, bool isServer)
   }
   jsvStringIteratorFree(&it);
   // skip if we have no header
-  if (headerEnd<0) return false;
+  if (headerEnd<0) {
+    jsvObjectSetChildAndUnLock(objectForData, HTTP_NAME_PARSE_POS, jsvNewFromInteger(strIdx));
+    return false;
+  }
+  jsvObjectRemoveChild(objectForData, HTTP_NAME_PARSE_POS);
   // Now parse the header
   JsVar *vHeaders = jsvNewObject();
   if (!vHeaders) return true;
@@ -130,7 +175,7 @@ bool httpParseHeaders(JsVar **receiveData, JsVar *objectForData, bool isServer)
   int valueStart = 0;
   //jsiConsolePrintStringVar(receiveData);
   jsvStringIteratorNew(&it, *receiveData, 0);
-    while (jsvStringIteratorHasChar(&it)) {
+    while (strIdx<headerEnd && jsvStringIteratorHasChar(&it)) {
       char ch = jsvStringIteratorGetCharAndNext(&it);
       if (ch==' ' || ch=='\r') {
         if (firstSpace<0) firstSpace = strIdx;
@@ -163,15 +208,37 @@ bool httpParseHeaders(JsVar **receiveData, JsVar *objectForData, bool isServer)
       strIdx++;
     }
     jsvStringIteratorFree(&it);
-  // flag the req/response if Transfer-Encoding:chunked was set
-  JsVarInt contentToReceive;
+  // HTTP/1.1 connections stay open unless asked not to, HTTP/1.0 ones only if asked
+  bool keepAlive = false;
+  if (isServer && secondSpace>0) {
+    JsVar *connection = jsvObjectGetChildI(vHeaders, "Connection");
+    if (jsvIsStringEqualOrStartsWithOffset(*receiveData, "HTTP/1.1", true, (size_t)(secondSpace+1), false))
+      keepAlive = !jsvIsStringIEqualAndUnLock(connection, "close");
+    else
+      keepAlive = jsvIsStringIEqualAndUnLock(connection, "keep-alive");
+  }
+  // work out how the body is delimited
+  HttpParseState state;
+  JsVarInt contentToReceive = 0;
   if (compareTransferEncodingAndUnlock(jsvObjectGetChildI(vHeaders, "Transfer-Encoding"), "chunked")) {
+    // flag the req/response if Transfer-Encoding:chunked was set
     jsvObjectSetChildAndUnLock(objectForData, HTTP_NAME_CHUNKED, jsvNewFromBool(true));
-    contentToReceive = 1;
+    state = HTTPS_CHUNK_SIZE;
   } else {
-    contentToReceive = jsvGetIntegerAndUnLock(jsvObjectGetChildI(vHeaders,"Content-Length"));
+    JsVar *contentLength = jsvObjectGetChildI(vHeaders,"Content-Length");
+    contentToReceive = jsvGetInteger(contentLength);
+    if (contentToReceive > 0)
+      state = HTTPS_BODY;
+    else if (contentLength || keepAlive)
+      state = HTTPS_DONE; // requests without a length have no body
+    else
+      state = HTTPS_BODY_UNTIL_CLOSE;
+    jsvUnLock(contentLength);
   }
   jsvObjectSetChildAndUnLock(objectForData, HTTP_NAME_RECEIVE_COUNT, jsvNewFromInteger(contentToReceive));
+  jsvObjectSetChildAndUnLock(objectForData, HTTP_NAME_PARSE_STATE, jsvNewFromInteger(state));
+  if (keepAlive)
+    jsvObjectSetChildAndUnLock(objectForData, HTTP_NAME_KEEPALIVE, jsvNewFromBool(true));
   jsvUnLock(vHeaders);
   // try and pull out methods/etc
   if (isServer) {
@@ -260,48 +327,233 @@ NO_INLINE static void _socketCloseAllConnections(JsNetwork *net) {
   _socketCloseAllConnectionsFor(net, HTTP_ARRAY_HTTP_SERVERS);
 }
 
-// returns 0 on success and a (negative) error number on failure
+/// Do we have anything left to send on this connection?
+static bool socketHasDataToSend(JsVar *connection, JsVar *sendData) {
+  if (sendData && !jsvIsEmptyString(sendData)) return true;
+  JsVar *queue = jsvObjectGetChildIfExists(connection, HTTP_NAME_SEND_QUEUE);
+  bool hasQueue = queue!=0;
+  jsvUnLock(queue);
+  return hasQueue;
+}
+
+/** Add the String 'str' to the data to be sent. Small Strings are appended to sendData,
+ * but bigger ones are queued by reference so we never have to copy them. Strings are
+ * immutable once something else references them, so this is safe. */
+static void socketAppendSendData(JsVar *connection, JsVar **sendData, JsVar *str) {
+  JsVar *queue = 0;
+  if (jsvGetStringLength(str) >= SOCKET_SEND_REFERENCE_MIN)
+    queue = jsvObjectGetChild(connection, HTTP_NAME_SEND_QUEUE, JSV_ARRAY);
+  JsVar *newSendData = queue ? jsvNewFromEmptyString() : 0;
+  if (!newSendData) { // small, or out of memory
+    jsvUnLock(queue);
+    jsvAppendStringVarComplete(*sendData, str);
+    return;
+  }
+  // anything already in sendData has to go out first
+  if (!jsvIsEmptyString(*sendData))
+    jsvArrayPush(queue, *sendData);
+  jsvArrayPush(queue, str);
+  jsvObjectSetChild(connection, HTTP_NAME_SEND_DATA, newSendData);
+  jsvUnLock2(queue, *sendData);
+  *sendData = newSendData;
+}
+
+/// Send what we can of the first String in the send queue. Returns the amount sent, or <0 on error
+static int socketSendQueuedData(JsNetwork *net, JsVar *connection, SocketType socketType, int sckt, JsVar *queue) {
+  JsVar *item = jsvLock(jsvGetFirstChild(queue));
+  JsVar *data = jsvSkipName(item);
+  size_t offset = (size_t)jsvGetIntegerAndUnLock(jsvObjectGetChildIfExists(connection, HTTP_NAME_SEND_OFFSET));
+  size_t len;
+  char *ptr = jsvGetDataPointer(data, &len);
+  if (!ptr) {
+    /* We can't get a pointer (it's a normal String spread over many JsVars). Rather than
+     * iterating from the start each time, turn what's left into a flat String once. */
+    JsVar *flat = jsvNewFlatStringFromStringVar(data, offset, JSVAPPENDSTRINGVAR_MAXLENGTH);
+    if (flat) {
+      jsvSetValueOfName(item, flat);
+      jsvUnLock(data);
+      data = flat;
+      offset = 0;
+      ptr = jsvGetDataPointer(data, &len);
+    }
+  }
+  int num;
+  if (ptr) {
+    size_t sndLen = len - offset;
+    if (sndLen > SOCKET_SEND_DIRECT_MAX) sndLen = SOCKET_SEND_DIRECT_MAX;
+    num = netSend(net, socketType, sckt, &ptr[offset], sndLen);
+  } else { // out of memory for a flat String - copy out a chunk instead
+    len = jsvGetStringLength(data);
+    char *buf = alloca((size_t)net->chunkSize); // allocate on stack
+    size_t bufLen = jsvGetStringChars(data, offset, buf, (size_t)net->chunkSize);
+    num = netSend(net, socketType, sckt, buf, bufLen);
+  }
+  DBG("socketSendQueuedData (%d/%d -> %d)\n", offset, len, num);
+  if (num > 0) {
+    offset += (size_t)num;
+    if (offset >= len) { // finished with this one
+      jsvUnLock(jsvArrayPopFirst(queue));
+      offset = 0;
+      if (!jsvGetFirstChild(queue))
+        jsvObjectRemoveChild(connection, HTTP_NAME_SEND_QUEUE);
+    }
+    if (offset) jsvObjectSetChildAndUnLock(connection, HTTP_NAME_SEND_OFFSET, jsvNewFromInteger((JsVarInt)offset));
+    else jsvObjectRemoveChild(connection, HTTP_NAME_SEND_OFFSET);
+  }
+  jsvUnLock2(data, item);
+  return num;
+}
+
+/** Send what we can of the data queued on this connection (see socketHasDataToSend).
+ * Returns 0 on success and a (negative) error number on failure */
 int socketSendData(JsNetwork *net, JsVar *connection, int sckt, JsVar **sendData) {
   SocketType socketType = socketGetType(connection);
 
-  assert(!jsvIsEmptyString(*sendData));
-
-  size_t sndBufLen;
-  if ((socketType&ST_TYPE_MASK)==ST_UDP) {
-      sndBufLen = (size_t)jsvGetStringLength(*sendData);
-      if (sndBufLen+1024 > jsuGetFreeStack()) {
-          jsExceptionHere(JSET_ERROR, "Not enough stack memory for data");
-          return -1;
-      }
+  int num;
+  JsVar *queue = jsvObjectGetChildIfExists(connection, HTTP_NAME_SEND_QUEUE);
+  if (queue) {
+    num = socketSendQueuedData(net, connection, socketType, sckt, queue);
+    jsvUnLock(queue);
   } else {
-      sndBufLen = (size_t)net->chunkSize;
+    assert(!jsvIsEmptyString(*sendData));
+    size_t sndBufLen;
+    if ((socketType&ST_TYPE_MASK)==ST_UDP) {
+        sndBufLen = (size_t)jsvGetStringLength(*sendData);
+        if (sndBufLen+1024 > jsuGetFreeStack()) {
+            jsExceptionHere(JSET_ERROR, "Not enough stack memory for data");
+            return -1;
+        }
+    } else {
+        sndBufLen = (size_t)net->chunkSize;
+    }
+    char *buf = alloca(sndBufLen); // allocate on stack
+
+    size_t bufLen = httpStringGet(*sendData, buf, sndBufLen);
+    num = netSend(net, socketType, sckt, buf, bufLen);
+    DBG("socketSendData %x:%d (%d -> %d)\n", *(uint32_t*)buf, *(unsigned short*)(buf+sizeof(uint32_t)), bufLen, num);
+    if (num > 0) {
+      JsVar *newSendData = 0;
+      if (num < (int)jsvGetStringLength(*sendData)) {
+        /* we didn't send all of it. Rather than making a copy of what's left, move sendData
+         * into the queue and remember how far we got */
+        queue = jsvObjectGetChild(connection, HTTP_NAME_SEND_QUEUE, JSV_ARRAY);
+        if (queue) newSendData = jsvNewFromEmptyString();
+        if (newSendData) {
+          jsvArrayPush(queue, *sendData);
+          jsvObjectSetChildAndUnLock(connection, HTTP_NAME_SEND_OFFSET, jsvNewFromInteger(num));
+        } else { // out of memory - cut out what we did send
+          jsvObjectRemoveChild(connection, HTTP_NAME_SEND_QUEUE);
+          newSendData = jsvNewFromStringVar(*sendData, (size_t)num, JSVAPPENDSTRINGVAR_MAXLENGTH);
+        }
+        jsvUnLock(queue);
+      } else {
+        newSendData = jsvNewFromEmptyString();
+      }
+      jsvUnLock(*sendData);
+      *sendData = newSendData;
+    }
   }
-  char *buf = alloca(sndBufLen); // allocate on stack
-
-  size_t bufLen = httpStringGet(*sendData, buf, sndBufLen);
-  int num = netSend(net, socketType, sckt, buf, bufLen);
-  DBG("socketSendData %x:%d (%d -> %d)\n", *(uint32_t*)buf, *(unsigned short*)(buf+sizeof(uint32_t)), bufLen, num);
   if (num < 0) return num; // an error occurred
-  // Now cut what we managed to send off the beginning of sendData
-  if (num > 0) {
-    JsVar *newSendData = 0;
-    if (num < (int)jsvGetStringLength(*sendData)) {
-      // we didn't send all of it... cut out what we did send
-      newSendData = jsvNewFromStringVar(*sendData, (size_t)num, JSVAPPENDSTRINGVAR_MAXLENGTH);
-    } else {
-      // we sent all of it! Issue a drain event, unless we want to close, then we shouldn't
-      // callback for more data
-      bool wantClose = jsvGetBoolAndUnLock(jsvObjectGetChildIfExists(connection,HTTP_NAME_CLOSE));
-      if (!wantClose) {
-        jsiQueueObjectCallbacks(connection, HTTP_NAME_ON_DRAIN, &connection, 1);
+  // we sent all of it! Issue a drain event, unless we want to close, then we shouldn't
+  // callback for more data
+  if (num > 0 && !socketHasDataToSend(connection, *sendData)) {
+    bool wantClose = jsvGetBoolAndUnLock(jsvObjectGetChildIfExists(connection,HTTP_NAME_CLOSE));
+    if (!wantClose) {
+      jsiQueueObjectCallbacks(connection, HTTP_NAME_ON_DRAIN, &connection, 1);
+    }
+  }
+  return 0;
+}
+
+/** Has all of the HTTP request/response being read by 'reader' arrived? If untilCloseIsComplete,
+ * a body with no length (which ends when the connection closes) counts as complete. */
+static bool httpReceiveComplete(JsVar *reader, bool untilCloseIsComplete) {
+  HttpParseState state = (HttpParseState)jsvGetIntegerAndUnLock(jsvObjectGetChildIfExists(reader, HTTP_NAME_PARSE_STATE));
+  return state==HTTPS_DONE || (untilCloseIsComplete && state==HTTPS_BODY_UNTIL_CLOSE);
+}
+
+/* Run received data (after the headers) through the HTTP parser (see HttpParseState), pushing
+ * body data to 'reader' as we go. This only ever looks at each byte once. Anything we couldn't
+ * push yet, or that is after the end of this message (a pipelined request), is left in receiveData */
+static void httpPushReceiveData(JsVar *reader, JsVar **receiveData, bool force) {
+  HttpParseState state = (HttpParseState)jsvGetIntegerAndUnLock(jsvObjectGetChildIfExists(reader, HTTP_NAME_PARSE_STATE));
+  JsVarInt count = jsvGetIntegerAndUnLock(jsvObjectGetChildIfExists(reader, HTTP_NAME_RECEIVE_COUNT));
+  size_t len = jsvGetStringLength(*receiveData);
+  size_t idx = 0;
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, *receiveData, 0);
+  while (idx<len && state!=HTTPS_DONE && state!=HTTPS_ERROR) {
+    if (state==HTTPS_BODY || state==HTTPS_BODY_UNTIL_CLOSE || state==HTTPS_CHUNK_DATA) {
+      size_t dataLen = len-idx;
+      if (state!=HTTPS_BODY_UNTIL_CLOSE && (size_t)count<dataLen) dataLen = (size_t)count;
+      // If all we have is body, pass it on as-is rather than copying it
+      JsVar *data = (idx==0 && dataLen==len) ? jsvLockAgain(*receiveData) : jsvNewFromStringVar(*receiveData, idx, dataLen);
+      if (!data) break; // out of memory
+      bool pushed = jswrap_stream_pushData(reader, data, force) || force;
+      jsvUnLock(data);
+      if (!pushed) break; // no space - try again later
+      DBG("D:%d (%d)\n", dataLen, state);
+      idx += dataLen;
+      if (state!=HTTPS_BODY_UNTIL_CLOSE) {
+        count -= (JsVarInt)dataLen;
+        if (!count) state = (state==HTTPS_BODY) ? HTTPS_DONE : HTTPS_CHUNK_DATA_END;
       }
-      newSendData = jsvNewFromEmptyString();
+      jsvStringIteratorGoto(&it, *receiveData, idx);
+      continue;
     }
-    jsvUnLock(*sendData);
-    *sendData = newSendData;
+    char ch = jsvStringIteratorGetCharAndNext(&it);
+    idx++;
+    switch (state) {
+      case HTTPS_CHUNK_SIZE: {
+        int digit = chtod(ch);
+        if (digit>=0 && digit<16) {
+          if (count > (INT32_MAX-digit)/16) { // too big for a JsVarInt
+            state = HTTPS_ERROR;
+            break;
+          }
+          count = count*16 + digit;
+          break;
+        }
+        state = HTTPS_CHUNK_EXT; // ';' (extension) or '\r'
+        if (ch!='\n') break;
+      } // fall through
+      case HTTPS_CHUNK_EXT:
+        if (ch=='\n') state = count ? HTTPS_CHUNK_DATA : HTTPS_TRAILER_START;
+        break;
+      case HTTPS_CHUNK_DATA_END:
+        if (ch=='\n') {
+          state = HTTPS_CHUNK_SIZE;
+          count = 0;
+        }
+        break;
+      case HTTPS_TRAILER_START:
+        if (ch=='\n') state = HTTPS_DONE;
+        else if (ch!='\r') state = HTTPS_TRAILER;
+        break;
+      case HTTPS_TRAILER:
+        if (ch=='\n') state = HTTPS_TRAILER_START;
+        break;
+      default: break;
+    }
+  }
+  jsvStringIteratorFree(&it);
+  jsvObjectSetChildAndUnLock(reader, HTTP_NAME_PARSE_STATE, jsvNewFromInteger(state));
+  jsvObjectSetChildAndUnLock(reader, HTTP_NAME_RECEIVE_COUNT, jsvNewFromInteger(count));
+  // Only a keep-alive connection can have anything useful after the end of the message
+  if ((state==HTTPS_DONE && !jsvGetBoolAndUnLock(jsvObjectGetChildIfExists(reader, HTTP_NAME_KEEPALIVE))) ||
+      state==HTTPS_ERROR)
+    idx = len;
+  // cut off what we used
+  if (idx) {
+    JsVar *rest = (idx<len) ? jsvNewFromStringVar(*receiveData, idx, JSVAPPENDSTRINGVAR_MAXLENGTH) : 0;
+    jsvUnLock(*receiveData);
+    *receiveData = rest;
   }
+}
 
-  return 0;
+/// Did the HTTP parser find that the message 'reader' is receiving was invalid?
+static bool httpReceiveFailed(JsVar *reader) {
+  return jsvGetIntegerAndUnLock(jsvObjectGetChildIfExists(reader, HTTP_NAME_PARSE_STATE))==HTTPS_ERROR;
 }
 
 void socketPushReceiveData(JsVar *reader, JsVar **receiveData, bool isHttp, bool force) {
@@ -309,78 +561,16 @@ void socketPushReceiveData(JsVar *reader, JsVar **receiveData, bool isHttp, bool
     // no data available (after headers)
     return;
   }
-
-  JsVar *nextChunk = 0;
-  JsVar *partialChunk = 0;
-
-  // Keep track of how much we received (so we can close once we have it)
   if (isHttp) {
-    size_t len = (size_t)jsvGetStringLength(*receiveData);
-    if (jsvGetBoolAndUnLock(jsvObjectGetChildIfExists(reader, HTTP_NAME_CHUNKED))) {
-      // check for incomplete chunk, at least "0\r\n\r\n"
-      if (len < 5) return; // incomplete, wait for more data
-
-      JsVar *crlf = jsvNewFromString("\r\n");
-      JsVar *zero = jsvNewFromInteger(0);
-      size_t startIdx = (size_t)jswrap_string_indexOf(*receiveData, crlf, zero, false);
-      jsvUnLock2(crlf, zero);
-
-      JsVar *sixteen = jsvNewFromInteger(16);
-      int chunkLen = jsvGetIntegerAndUnLock(jswrap_parseInt(*receiveData, sixteen));
-      jsvUnLock(sixteen);
-      DBG("D:%d\n", chunkLen);
-
-      // for 'chunked' set the counter to 1 to read on or 0 if at last chunk
-      jsvObjectSetChildAndUnLock(reader, HTTP_NAME_RECEIVE_COUNT, jsvNewFromInteger(chunkLen ? 1 : 0));
-      if (!chunkLen) { // no 'data' callback
-        // clear received data
-        jsvUnLock(*receiveData);
-        *receiveData = 0;
-        return;
-      }
-
-      startIdx += 2; // skip the CRLF
-      size_t nextIdx = startIdx + (size_t)chunkLen + 2; // CRLF at the end
-      if (nextIdx < len) { // there is another chunk in the buffer
-        DBG("D:nextIdx %d %d\n", nextIdx, len);
-        nextChunk = jsvNewFromEmptyString();
-        if (!nextChunk) return; // out of memory
-        jsvAppendStringVar(nextChunk, *receiveData, nextIdx, len-nextIdx);
-      } else if (nextIdx > len) { // chunk not complete
-        DBG("D:partialIdx %d %d %d\n", len - startIdx, nextIdx - len - 2, len);
-        if (nextIdx - len < 3) return; // just CRLF missing, wait
-        // use the data available, write remaining length, wait
-        partialChunk = jsvNewFromEmptyString();
-        if (!partialChunk) return; // out of memory
-        jsvAppendPrintf(partialChunk, "%x\r\n", nextIdx - len - 2);
-      }
-
-      JsVar *chunkData = jsvNewFromEmptyString();
-      if (!chunkData) return; // out of memory
-      jsvAppendStringVar(chunkData, *receiveData, startIdx, (size_t)chunkLen);
-      jsvUnLock(*receiveData);
-      *receiveData = chunkData;
-    } else {
-      jsvObjectSetChildAndUnLock(reader, HTTP_NAME_RECEIVE_COUNT,
-        jsvNewFromInteger(
-          jsvGetIntegerAndUnLock(jsvObjectGetChild(reader, HTTP_NAME_RECEIVE_COUNT, JSV_INTEGER)) - (JsVarInt)len)
-        );
-    }
+    httpPushReceiveData(reader, receiveData, force);
+    return;
   }
-
   // execute 'data' callback or save data
-  if (!jswrap_stream_pushData(reader, *receiveData, force)) {
-    jsvUnLock2(nextChunk, partialChunk);
+  if (!jswrap_stream_pushData(reader, *receiveData, force))
     return;
-  }
-
   // clear received data
   jsvUnLock(*receiveData);
-  *receiveData = nextChunk ? nextChunk : partialChunk;
-
-  if (nextChunk) { // process following chunks if any
-    socketPushReceiveData(reader, receiveData, isHttp, force);
-  }
+  *receiveData = 0;
 }
 
 void socketReceivedUDP(JsVar *connection, JsVar **receiveData) {
@@ -427,11 +617,26 @@ void socketReceived(JsVar *connection, JsVar *socket, SocketType socketType, JsV
 
       // on connect only when just parsed the HTTP headers
       if (isServer) {
+        if (jsvGetBoolAndUnLock(jsvObjectGetChildIfExists(reader, HTTP_NAME_KEEPALIVE))) {
+          // The client wants to reuse the connection, so drop our default 'Connection: close'.
+          // serverResponseWriteHead decides whether we really can.
+          JsVar *headers = jsvObjectGetChildIfExists(socket, HTTP_NAME_HEADERS);
+          if (headers) jsvObjectRemoveChild(headers, "Connection");
+          jsvUnLock(headers);
+          jsvObjectSetChildAndUnLock(socket, HTTP_NAME_KEEPALIVE, jsvNewFromBool(true));
+        }
         JsVar *server = jsvObjectGetChildIfExists(connection,HTTP_NAME_SERVER_VAR);
         JsVar *args[2] = { connection, socket };
         jsiQueueObjectCallbacks(server, HTTP_NAME_ON_CONNECT, args, isHttp ? 2 : 1);
         jsvUnLock(server);
       } else {
+        // responses to HEAD, and 204/304 responses never have a body
+        JsVar *options = jsvObjectGetChildIfExists(connection, HTTP_NAME_OPTIONS_VAR);
+        JsVarInt statusCode = jsvGetIntegerAndUnLock(jsvObjectGetChildIfExists(socket, "statusCode"));
+        if (jsvIsStringIEqualAndUnLock(jsvObjectGetChildIfExists(options, "method"), "HEAD") ||
+            statusCode==204 || statusCode==304)
+          jsvObjectSetChildAndUnLock(socket, HTTP_NAME_PARSE_STATE, jsvNewFromInteger(HTTPS_DONE));
+        jsvUnLock(options);
         jsiQueueObjectCallbacks(connection, HTTP_NAME_ON_CONNECT, &socket, 1);
       }
     }
@@ -486,6 +691,65 @@ static bool fireErrorEvent(int error, JsVar *obj1, JsVar *obj2) {
 
 // -----------------------------
 
+/// Create a new HTTP server request (with its response in HTTP_NAME_RESPONSE_VAR) for the given socket
+static JsVar *httpServerNewRequest(JsVar *server, int sckt) {
+  JsVar *req = jspNewObject(0, "httpSRq");
+  JsVar *res = jspNewObject(0, "httpSRs");
+  if (!res || !req) { // out of memory?
+    jsvUnLock2(req, res);
+    return 0;
+  }
+  socketSetType(req, ST_HTTP);
+  jsvObjectSetChild(req, HTTP_NAME_RESPONSE_VAR, res);
+  jsvObjectSetChild(req, HTTP_NAME_SERVER_VAR, server);
+  jsvObjectSetChildAndUnLock(req, HTTP_NAME_SOCKET, jsvNewFromInteger(sckt+1));
+  jsvObjectSetChildAndUnLock(res, HTTP_NAME_SOCKET, jsvNewFromInteger(sckt+1));
+  // Auto-add connection close header (in HTTP/1.0 this seemed implicit, now it must be explicit)
+  // This can always be overwritten with setHeader or writeHead
+  JsVar *name = jsvNewFromString("Connection");
+  JsVar *value = jsvNewFromString("close");
+  serverResponseSetHeader(res, name, value);
+  jsvUnLock3(name, value, res);
+  return req;
+}
+
+/* The response on a keep-alive connection has been sent. Give the socket to a new request/response
+ * in place of 'connection' in the list, and start on any request that was pipelined after this one.
+ * Returns false if we couldn't (out of memory), in which case the connection should be closed. */
+static bool httpServerNextRequest(JsvObjectIterator *it, JsVar **connection, JsVar **socket) {
+  JsVar *server = jsvObjectGetChildIfExists(*connection, HTTP_NAME_SERVER_VAR);
+  int sckt = (int)jsvGetIntegerAndUnLock(jsvObjectGetChildIfExists(*connection,HTTP_NAME_SOCKET))-1;
+  JsVar *req = httpServerNewRequest(server, sckt);
+  jsvUnLock(server);
+  if (!req) return false;
+  JsVar *res = jsvObjectGetChildIfExists(req, HTTP_NAME_RESPONSE_VAR);
+  JsVar *connectionName = jsvObjectIteratorGetKey(it);
+  jsvSetValueOfName(connectionName, req);
+  jsvUnLock(connectionName);
+  // the old request/response no longer own the socket - fire the same events as if it had closed
+  jsvObjectRemoveChild(*connection, HTTP_NAME_SOCKET);
+  jsvObjectRemoveChild(*socket, HTTP_NAME_SOCKET);
+  jsvObjectSetChildAndUnLock(*connection, HTTP_NAME_CLOSE, jsvNewFromBool(true));
+  jsiQueueObjectCallbacks(*socket, HTTP_NAME_ON_END, NULL, 0);
+  JsVar *params[1] = { jsvNewFromBool(false) };
+  jsiQueueObjectCallbacks(*connection, HTTP_NAME_ON_CLOSE, params, 1);
+  jsiQueueObjectCallbacks(*socket, HTTP_NAME_ON_CLOSE, params, 1);
+  jsvUnLock(params[0]);
+  // anything left over is the start of the next request
+  JsVar *receiveData = jsvObjectGetChildIfExists(*connection, HTTP_NAME_RECEIVE_DATA);
+  jsvObjectRemoveChild(*connection, HTTP_NAME_RECEIVE_DATA);
+  jsvUnLock2(*connection, *socket);
+  *connection = req;
+  *socket = res;
+  if (receiveData) {
+    DBG("Pipelined request\n");
+    socketReceived(req, res, ST_HTTP, &receiveData, true);
+    jsvObjectSetChild(req, HTTP_NAME_RECEIVE_DATA, receiveData);
+    jsvUnLock(receiveData);
+  }
+  return true;
+}
+
 bool socketServerConnectionsIdle(JsNetwork *net) {
   char *buf = alloca((size_t)net->chunkSize); // allocate on stack
 
@@ -493,6 +757,7 @@ bool socketServerConnectionsIdle(JsNetwork *net) {
   if (!arr) return false;
 
   bool hadSockets = false;
+  bool wasBusy = false;
   JsvObjectIterator it;
   jsvObjectIteratorNew(&it, arr);
   while (jsvObjectIteratorHasValue(&it)) {
@@ -507,9 +772,15 @@ bool socketServerConnectionsIdle(JsNetwork *net) {
     int sckt = (int)jsvGetIntegerAndUnLock(jsvObjectGetChildIfExists(connection,HTTP_NAME_SOCKET))-1; // so -1 if undefined
     bool closeConnectionNow = jsvGetBoolAndUnLock(jsvObjectGetChildIfExists(connection, HTTP_NAME_CLOSENOW));
     int error = 0;
+    // checked the next time around after we received it, so the request's handlers have been added
+    if (isHttp && httpReceiveFailed(connection)) {
+      closeConnectionNow = true;
+      error = SOCKET_ERR_BAD_HTTP;
+    }
 
     if (!closeConnectionNow) {
       int num = netRecv(net, socketType, sckt, buf, (size_t)net->chunkSize);
+      if (num!=0) wasBusy = true;
       if (num<0) {
         // we probably disconnected so just get rid of this
         closeConnectionNow = true;
@@ -529,7 +800,8 @@ bool socketServerConnectionsIdle(JsNetwork *net) {
 
       // send data if possible
       JsVar *sendData = jsvObjectGetChildIfExists(socket,HTTP_NAME_SEND_DATA);
-      if (sendData && !jsvIsEmptyString(sendData)) {
+      if (socketHasDataToSend(socket, sendData)) {
+        wasBusy = true; // we don't get woken when we can send, so keep polling
         int sent = socketSendData(net, socket, sckt, &sendData);
         // FIXME? checking for errors is a bit iffy. With the esp8266 network that returns
         // varied error codes we'd want to skip SOCKET_ERR_CLOSED and let the recv side deal
@@ -543,17 +815,23 @@ bool socketServerConnectionsIdle(JsNetwork *net) {
         jsvObjectSetChild(socket, HTTP_NAME_SEND_DATA, sendData); // socketSendData updated sendData
       }
       // only close if we want to close, have no data to send, and aren't receiving data
-      if ((!sendData || jsvIsEmptyString(sendData)) && num<=0) {
+      if (!socketHasDataToSend(socket, sendData) && num<=0) {
         bool reallyCloseNow = jsvGetBoolAndUnLock(jsvObjectGetChildIfExists(socket,HTTP_NAME_CLOSE));
         if (isHttp) {
-          bool hadHeaders = jsvGetBoolAndUnLock(jsvObjectGetChildIfExists(connection,HTTP_NAME_HAD_HEADERS));
-          JsVarInt contentToReceive = jsvGetIntegerAndUnLock(jsvObjectGetChildIfExists(connection, HTTP_NAME_RECEIVE_COUNT));
-          if (contentToReceive > 0 || !hadHeaders) {
-            reallyCloseNow = false;
+          if (!httpReceiveComplete(connection, true)) {
+            // still waiting for the request - but if the client went before sending one, close
+            reallyCloseNow = error && !jsvGetBoolAndUnLock(jsvObjectGetChildIfExists(connection,HTTP_NAME_HAD_HEADERS));
           } else if (!jsvGetBoolAndUnLock(jsvObjectGetChildIfExists(connection,HTTP_NAME_ENDED))) {
             jsvObjectSetChildAndUnLock(connection, HTTP_NAME_ENDED, jsvNewFromBool(true));
             jsiQueueObjectCallbacks(connection, HTTP_NAME_ON_END, NULL, 0);
-            DBG("ONEND %d (%d)\n", contentToReceive, reallyCloseNow);
+            DBG("ONEND (%d)\n", reallyCloseNow);
+          }
+          // response sent on a keep-alive connection? Wait for the next request rather than closing
+          if (reallyCloseNow &&
+              jsvGetBoolAndUnLock(jsvObjectGetChildIfExists(socket, HTTP_NAME_KEEPALIVE)) &&
+              httpServerNextRequest(&it, &connection, &socket)) {
+            reallyCloseNow = false;
+            wasBusy = true;
           }
         }
         closeConnectionNow = reallyCloseNow;
@@ -563,6 +841,7 @@ bool socketServerConnectionsIdle(JsNetwork *net) {
     }
     if (closeConnectionNow) {
       DBG("CLOSE NOW\n");
+      wasBusy = true;
 
       // send out any data that we were POSTed
       bool hadHeaders = jsvGetBoolAndUnLock(jsvObjectGetChildIfExists(connection,HTTP_NAME_HAD_HEADERS));
@@ -597,7 +876,7 @@ bool socketServerConnectionsIdle(JsNetwork *net) {
   jsvObjectIteratorFree(&it);
   jsvUnLock(arr);
 
-  return hadSockets;
+  return SOCKET_IDLE_RESULT(net, hadSockets, wasBusy);
 }
 
 
@@ -608,6 +887,7 @@ bool socketClientConnectionsIdle(JsNetwork *net) {
   if (!arr) return false;
 
   bool hadSockets = false;
+  bool wasBusy = false;
   JsvObjectIterator it;
   jsvObjectIteratorNew(&it, arr);
   while (jsvObjectIteratorHasValue(&it)) {
@@ -626,6 +906,12 @@ bool socketClientConnectionsIdle(JsNetwork *net) {
     bool closeConnectionNow = jsvGetBoolAndUnLock(jsvObjectGetChildIfExists(connection, HTTP_NAME_CLOSENOW));
     bool alreadyConnected = jsvGetBoolAndUnLock(jsvObjectGetChildIfExists(connection, HTTP_NAME_CONNECTED));
     int sckt = (int)jsvGetIntegerAndUnLock(jsvObjectGetChildIfExists(connection,HTTP_NAME_SOCKET))-1; // so -1 if undefined
+    if (isHttp && httpReceiveFailed(socket)) { // see socketServerConnectionsIdle
+      closeConnectionNow = true;
+      error = SOCKET_ERR_BAD_HTTP;
+    }
+    if ((!alreadyConnected && !isHttp) || closeConnectionNow)
+      wasBusy = true; // we don't get woken when a connection completes, so keep polling
     if (sckt>=0) {
       if (isHttp)
         hadHeaders = jsvGetBoolAndUnLock(jsvObjectGetChildIfExists(socket,HTTP_NAME_HAD_HEADERS));
@@ -635,13 +921,16 @@ bool socketClientConnectionsIdle(JsNetwork *net) {
 
       /* We do this up here because we want to wait until we have been once
        * around the idle loop (=callbacks have been executed) before we run this */
-      if (hadHeaders)
+      if (hadHeaders && receiveData) {
         socketPushReceiveData(socket, &receiveData, isHttp, false);
+        jsvObjectSetChild(connection, HTTP_NAME_RECEIVE_DATA, receiveData);
+      }
 
       if (!closeConnectionNow) {
         JsVar *sendData = jsvObjectGetChildIfExists(connection,HTTP_NAME_SEND_DATA);
         // send data if possible
-        if (sendData && !jsvIsEmptyString(sendData)) {
+        if (socketHasDataToSend(connection, sendData)) {
+          wasBusy = true; // we don't get woken when we can send, so keep polling
           // don't try to send if we're already in error state
           int num = 0;
           if (error == 0) {
@@ -662,26 +951,25 @@ bool socketClientConnectionsIdle(JsNetwork *net) {
           if (jsvGetBoolAndUnLock(jsvObjectGetChildIfExists(connection, HTTP_NAME_CLOSE)))
             closeConnectionNow = true;
           if (isHttp) {
-            JsVarInt contentToReceive = jsvGetIntegerAndUnLock(jsvObjectGetChildIfExists(socket, HTTP_NAME_RECEIVE_COUNT));
-            if (contentToReceive > 0 || !hadHeaders) {
+            if (!httpReceiveComplete(socket, false)) {
               closeConnectionNow = false;
             } else if (!jsvGetBoolAndUnLock(jsvObjectGetChildIfExists(socket,HTTP_NAME_ENDED))) {
               jsvObjectSetChildAndUnLock(socket, HTTP_NAME_ENDED, jsvNewFromBool(true));
               jsiQueueObjectCallbacks(socket, HTTP_NAME_ON_END, NULL, 0);
-              DBG("onEnd %d (%d) %d\n", contentToReceive, closeConnectionNow, hadHeaders);
+              DBG("onEnd (%d) %d\n", closeConnectionNow, hadHeaders);
             }
           }
         }
         // Now read data if possible (and we have space for it)
         int num = netRecv(net, socketType, sckt, buf, (size_t)net->chunkSize);
+        if (num!=0) wasBusy = true;
         if (!alreadyConnected && num == SOCKET_ERR_NO_CONN) {
           ; // ignore... it's just telling us we're not connected yet
         } else if (num < 0) {
           closeConnectionNow = true;
           // only error out when the response was not completely received
           if (num == SOCKET_ERR_CLOSED) {
-            JsVarInt contentToReceive = jsvGetIntegerAndUnLock(jsvObjectGetChildIfExists(socket, HTTP_NAME_RECEIVE_COUNT));
-            if (!isHttp || contentToReceive > 0 || !hadHeaders) {
+            if (!isHttp || !httpReceiveComplete(socket, true)) {
               error = num;
               // disconnected without headers? error.
               if (!hadHeaders) error = SOCKET_ERR_NO_RESP;
@@ -696,7 +984,7 @@ bool socketClientConnectionsIdle(JsNetwork *net) {
             jsvObjectSetChildAndUnLock(connection, HTTP_NAME_CONNECTED, jsvNewFromBool(true));
             alreadyConnected = true;
             // if we do not have any data to send, issue a drain event
-            if (!sendData || (int)jsvGetStringLength(sendData) == 0)
+            if (!socketHasDataToSend(connection, sendData))
               jsiQueueObjectCallbacks(connection, HTTP_NAME_ON_DRAIN, &connection, 1);
           }
           // got data add it to our receive buffer
@@ -716,12 +1004,13 @@ bool socketClientConnectionsIdle(JsNetwork *net) {
 
     if (closeConnectionNow) {
       DBG("close now\n");
+      wasBusy = true;
 
       socketPushReceiveData(socket, &receiveData, isHttp, true);
       if (!receiveData || jsvIsEmptyString(receiveData)) {
         // If we had data to send but the socket closed, this is an error
         JsVar *sendData = jsvObjectGetChildIfExists(connection,HTTP_NAME_SEND_DATA);
-        if (sendData && jsvGetStringLength(sendData) > 0 && error == SOCKET_ERR_CLOSED)
+        if (socketHasDataToSend(connection, sendData) && error == SOCKET_ERR_CLOSED)
           error = SOCKET_ERR_UNSENT_DATA;
         jsvUnLock(sendData);
 
@@ -756,7 +1045,7 @@ bool socketClientConnectionsIdle(JsNetwork *net) {
   }
   jsvUnLock(arr);
 
-  return hadSockets;
+  return SOCKET_IDLE_RESULT(net, hadSockets, wasBusy);
 }
 
 
@@ -767,6 +1056,7 @@ bool socketIdle(JsNetwork *net) {
     return false;
   }
   bool hadSockets = false;
+  bool wasBusy = false;
   JsVar *arr = socketGetArray(HTTP_ARRAY_HTTP_SERVERS,false);
   if (arr) {
     JsvObjectIterator it;
@@ -784,28 +1074,17 @@ bool socketIdle(JsNetwork *net) {
           theClient = netAccept(net, sckt);
       }
       if (theClient >= 0) { // We have a new connection
+        wasBusy = true;
         if ((socketType&ST_TYPE_MASK) == ST_HTTP) {
-          JsVar *req = jspNewObject(0, "httpSRq");
-          JsVar *res = jspNewObject(0, "httpSRs");
-          if (res && req) { // out of memory?
-            socketSetType(req, ST_HTTP);
+          JsVar *req = httpServerNewRequest(server, theClient);
+          if (req) { // out of memory?
             JsVar *arr = socketGetArray(HTTP_ARRAY_HTTP_SERVER_CONNECTIONS, true);
             if (arr) {
               jsvArrayPush(arr, req);
               jsvUnLock(arr);
             }
-            jsvObjectSetChild(req, HTTP_NAME_RESPONSE_VAR, res);
-            jsvObjectSetChild(req, HTTP_NAME_SERVER_VAR, server);
-            jsvObjectSetChildAndUnLock(req, HTTP_NAME_SOCKET, jsvNewFromInteger(theClient+1));
-            jsvObjectSetChildAndUnLock(res, HTTP_NAME_SOCKET, jsvNewFromInteger(theClient+1));
-            // Auto-add connection close header (in HTTP/1.0 this seemed implicit, now it must be explicit)
-            // This can always be overwritten with setHeader or writeHead
-            JsVar *name = jsvNewFromString("Connection");
-            JsVar *value = jsvNewFromString("close");
-            serverResponseSetHeader(res, name, value);
-            jsvUnLock2(name, value);
+            jsvUnLock(req);
           }
-          jsvUnLock2(req, res);
         } else {
           // Normal sockets
           JsVar *sock = jspNewObject(0, "Socket");
@@ -830,10 +1109,10 @@ bool socketIdle(JsNetwork *net) {
     jsvUnLock(arr);
   }
 
-  if (socketServerConnectionsIdle(net)) hadSockets = true;
-  if (socketClientConnectionsIdle(net)) hadSockets = true;
+  if (socketServerConnectionsIdle(net)) hadSockets = wasBusy = true;
+  if (socketClientConnectionsIdle(net)) hadSockets = wasBusy = true;
   netCheckError(net);
-  return hadSockets;
+  return SOCKET_IDLE_RESULT(net, hadSockets, wasBusy);
 }
 
 // -----------------------------
@@ -990,7 +1269,9 @@ void clientRequestWrite(JsNetwork *net, JsVar *httpClientReqVar, JsVar *data, Js
       if (jsvGetBoolAndUnLock(jsvObjectGetChildIfExists(httpClientReqVar, HTTP_NAME_CHUNKED))) {
         // If we asked to send 'chunked' data, we need to wrap it up,
         // prefixed with the length
-        jsvAppendPrintf(sendData, "%x\r\n%v\r\n", jsvGetStringLength(s), s);
+        jsvAppendPrintf(sendData, "%x\r\n", jsvGetStringLength(s));
+        socketAppendSendData(httpClientReqVar, &sendData, s);
+        jsvAppendString(sendData, "\r\n");
       } else {
         if ((socketType&ST_TYPE_MASK) == ST_UDP) {
           char hostName[128];
@@ -1000,8 +1281,10 @@ void clientRequestWrite(JsNetwork *net, JsVar *httpClientReqVar, JsVar *data, Js
           header.port = portNumber;
           header.length = (uint16_t)jsvGetStringLength(s);
           jsvAppendStringBuf(sendData, (const char*)&header, sizeof(header));
-        }
-        jsvAppendStringVarComplete(sendData,s);
+          // UDP packets must go out in one go, so always copy into sendData
+          jsvAppendStringVarComplete(sendData,s);
+        } else
+          socketAppendSendData(httpClientReqVar, &sendData, s);
       }
       jsvUnLock(s);
     }
@@ -1085,7 +1368,7 @@ void clientRequestEnd(JsNetwork *net, JsVar *httpClientReqVar) {
   } else {
     // if we never sent any data, make sure we close 'now'
     JsVar *sendData = jsvObjectGetChildIfExists(httpClientReqVar, HTTP_NAME_SEND_DATA);
-    if (!sendData || jsvIsEmptyString(sendData))
+    if (!socketHasDataToSend(httpClientReqVar, sendData))
       jsvObjectSetChildAndUnLock(httpClientReqVar, HTTP_NAME_CLOSENOW, jsvNewFromBool(true));
     jsvUnLock(sendData);
   }
@@ -1128,11 +1411,23 @@ void serverResponseWriteHead(JsVar *httpServerResponseVar, int statusCode, JsVar
 
   sendData = jsvVarPrintf("HTTP/1.1 %d OK\r\nServer: Espruino "JS_VERSION"\r\n", statusCode);
   if (headers) {
-    httpAppendHeaders(sendData, headers);
     // if Transfer-Encoding:chunked was set, subsequent writes need to 'chunk' the data that is sent
-    if (compareTransferEncodingAndUnlock(jsvObjectGetChildI(headers, "Transfer-Encoding"), "chunked")) {
+    bool chunked = compareTransferEncodingAndUnlock(jsvObjectGetChildI(headers, "Transfer-Encoding"), "chunked");
+    if (chunked) {
       jsvObjectSetChildAndUnLock(httpServerResponseVar, HTTP_NAME_CHUNKED, jsvNewFromBool(true));
     }
+    if (jsvGetBoolAndUnLock(jsvObjectGetChildIfExists(httpServerResponseVar, HTTP_NAME_KEEPALIVE))) {
+      // The client asked to keep the connection open, but we can only do that if it can tell where the response ends
+      JsVar *connection = jsvObjectGetChildI(headers, "Connection");
+      JsVar *contentLength = jsvObjectGetChildI(headers, "Content-Length");
+      bool keepAlive = (chunked || contentLength) && !jsvIsStringIEqualAndUnLock(jsvLockAgainSafe(connection), "close");
+      if (!connection)
+        jsvObjectSetChildAndUnLock(headers, "Connection", jsvNewFromString(keepAlive ? "keep-alive" : "close"));
+      if (!keepAlive)
+        jsvObjectRemoveChild(httpServerResponseVar, HTTP_NAME_KEEPALIVE);
+      jsvUnLock2(connection, contentLength);
+    }
+    httpAppendHeaders(sendData, headers);
   }
   jsvUnLock(headers);
   // finally add ending newline
@@ -1162,9 +1457,11 @@ void serverResponseWrite(JsVar *httpServerResponseVar, JsVar *data) {
       if (jsvGetBoolAndUnLock(jsvObjectGetChildIfExists(httpServerResponseVar, HTTP_NAME_CHUNKED))) {
         // If we asked to send 'chunked' data, we need to wrap it up,
         // prefixed with the length
-        jsvAppendPrintf(sendData, "%x\r\n%v\r\n", jsvGetStringLength(s), s);
+        jsvAppendPrintf(sendData, "%x\r\n", jsvGetStringLength(s));
+        socketAppendSendData(httpServerResponseVar, &sendData, s);
+        jsvAppendString(sendData, "\r\n");
       } else {
-        jsvAppendStringVarComplete(sendData,s);
+        socketAppendSendData(httpServerResponseVar, &sendData, s);
       }
     }
     jsvUnLock(s);
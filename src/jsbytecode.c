@@ -0,0 +1,1519 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * Bytecode compiler and VM for loops
+ *
+ * Normally loops are executed by seeking back to the start of the loop's
+ * source code and parsing it again for each iteration. Instead, once the first
+ * iteration has run, we compile the loop into a simple stack-based bytecode
+ * (stored in a flat string) and run that. Variables are looked up once when
+ * compiling, and numbers are kept on the VM's stack rather than allocating
+ * JsVars for them.
+ *
+ * Only a subset of JS is handled - if we find anything else in the loop we
+ * give up and let the parser carry on executing it as it did before.
+ * ----------------------------------------------------------------------------
+ */
+#include "jsbytecode.h"
+#include "jslex.h"
+#include "jswrap_math.h" // for jswrap_math_mod
+
+#ifndef ESPR_NO_BYTECODE
+
+#ifndef JSB_MAX_CODE_SIZE
+#define JSB_MAX_CODE_SIZE 512 ///< Biggest loop we'll compile (in bytes of bytecode)
+#endif
+#define JSB_MAX_VARS 32 ///< Most different variables a loop can use (others are looked up by name each time)
+#define JSB_MAX_STACK 16 ///< Deepest the VM's stack can get
+#define JSB_MAX_ARGS 8 ///< Most arguments in a function call
+#define JSB_MAX_JUMPS 8 ///< Most `break` or `continue` statements in one loop
+#define JSB_MAX_ITER_SIZE 64 ///< Biggest `for` loop iterator expression (in bytes of bytecode)
+#define JSB_MAX_STRING_LENGTH 64 ///< Longest string literal we'll compile
+#define JSB_FAILED_LOOPS 8 ///< How many loops we remember that we couldn't compile
+
+typedef enum {
+  JSBO_END,          ///< The loop has finished
+  JSBO_PUSH_UNDEFINED,
+  JSBO_PUSH_NULL,
+  JSBO_PUSH_TRUE,
+  JSBO_PUSH_FALSE,
+  JSBO_PUSH_INT,     ///< int32 follows
+  JSBO_PUSH_FLOAT,   ///< JsVarFloat follows
+  JSBO_PUSH_STRING,  ///< uint8 length, then characters follow
+  JSBO_PUSH_THIS,
+  JSBO_POP,
+  JSBO_GET_VAR,      ///< uint8 variable follows. -> value
+  JSBO_SET_VAR,      ///< uint8 variable follows. value -> value
+  JSBO_REF_VAR,      ///< uint8 variable follows. -> name
+  JSBO_ASSIGN_OP_VAR,///< uint8 variable, then uint8 op follow. value -> value
+  JSBO_INC_VAR,      ///< uint8 variable, then JsbIncFlags follow. -> value
+  JSBO_GET_DYN,      ///< name follows. -> value
+  JSBO_REF_DYN,      ///< name follows. -> name
+  JSBO_GET_MEMBER,   ///< uint32 position then name follow. object -> value
+  JSBO_REF_MEMBER,   ///< uint32 position then name follow. object -> name
+  JSBO_METHOD_MEMBER,///< uint32 position then name follow. object -> object, name
+  JSBO_GET_INDEX,    ///< object, index -> value
+  JSBO_REF_INDEX,    ///< object, index -> name
+  JSBO_METHOD_INDEX, ///< object, index -> object, name
+  JSBO_ASSIGN,       ///< name, value -> value
+  JSBO_ASSIGN_OP,    ///< uint8 op follows. name, value -> value
+  JSBO_INC,          ///< JsbIncFlags follow. name -> value
+  JSBO_CALL,         ///< uint8 argument count follows. this, function name, args... -> result
+  JSBO_NOT,          ///< value -> value
+  JSBO_BITNOT,       ///< value -> value
+  JSBO_NEGATE,       ///< value -> value
+  JSBO_TO_NUMBER,    ///< value -> value
+  JSBO_MATHS,        ///< uint8 op follows. a, b -> result
+  JSBO_JUMP,         ///< int16 offset (from the end of the instruction) follows
+  JSBO_JUMP_IF_FALSE,///< int16 offset follows. value ->
+  JSBO_JUMP_IF_FALSE_KEEP, ///< int16 offset follows. Jump if false, or pop the value (for `&&`)
+  JSBO_JUMP_IF_TRUE_KEEP,  ///< int16 offset follows. Jump if true, or pop the value (for `||`)
+  JSBO_LOOP,         ///< int16 offset follows. Jump back to the start of a loop
+  JSBO_LOOP_OUTER,   ///< int16 offset follows. Jump back to the start of the loop we were called for
+  JSBO_RETURN,       ///< value ->
+} PACKED_FLAGS JsbOpcode;
+
+typedef enum {
+  JSBI_DECREMENT = 1, ///< `--` rather than `++`
+  JSBI_POSTFIX = 2,   ///< `a++` rather than `++a`
+} PACKED_FLAGS JsbIncFlags;
+
+/// Header of a compiled program. Followed by pointers to its variables, then the code itself
+typedef struct {
+  uint16_t codeLength;
+  uint8_t varCount;
+} PACKED_FLAGS JsbProgram;
+
+// ----------------------------------------------------------------------------
+//                                                                     COMPILER
+
+/// What an expression we have compiled refers to. We only know what code to emit when we know how it's used
+typedef enum {
+  JSBR_VALUE,  ///< its value is on the stack
+  JSBR_VAR,    ///< a variable we found when compiling
+  JSBR_DYN,    ///< a variable we didn't find, so must look up by name each time
+  JSBR_MEMBER, ///< `object.name` - object is on the stack
+  JSBR_INDEX,  ///< `object[index]` - object and index are on the stack
+} JsbRefType;
+
+typedef struct {
+  JsbRefType type;
+  uint8_t var;       ///< JSBR_VAR
+  uint32_t position; ///< JSBR_MEMBER - position of the name in the code
+  char name[JSLEX_MAX_TOKEN_LENGTH]; ///< JSBR_DYN/JSBR_MEMBER
+} JsbRef;
+
+typedef struct JsbLoop {
+  uint16_t breaks[JSB_MAX_JUMPS];    ///< offsets of jumps for `break`
+  uint16_t continues[JSB_MAX_JUMPS]; ///< offsets of jumps for `continue`
+  uint8_t breakCount, continueCount;
+  bool isOuter;                      ///< is this the loop we were called for?
+} JsbLoop;
+
+/// State of the compiler. Compiling never executes JS, so this can't be re-entered
+static struct {
+  uint8_t code[JSB_MAX_CODE_SIZE];
+  unsigned int codeLength;
+  JsVar *vars[JSB_MAX_VARS];
+  unsigned int varCount;
+  uint32_t declared; ///< bit for each of vars that a `var` statement declared, but that isn't in the scope yet
+  int stack;     ///< depth of the VM's stack at this point in the code
+  JsbLoop *loop; ///< the innermost loop
+  bool failed;   ///< we found something we couldn't compile
+} jsbc;
+
+/** Loops we couldn't compile - so we don't try again each time they're run. The code var
+ * could be freed and its ref reused for different code, so we also keep a hash of the loop's
+ * source up to where compiling failed (which is what made it fail) */
+static struct {
+  JsVarRef code;
+  size_t position;
+  uint16_t length; ///< characters of source in hash
+  uint32_t hash;
+} jsbFailedLoops[JSB_FAILED_LOOPS];
+static unsigned char jsbFailedLoopIdx = 0;
+
+static void jsbcFail() {
+  jsbc.failed = true;
+}
+
+static void jsbcMatch(int tk) {
+  if (lex->tk!=tk || jsbc.failed) {
+    jsbcFail();
+    return;
+  }
+  jslGetNextToken();
+}
+
+static void jsbcEmitData(const void *data, size_t length) {
+  if (jsbc.codeLength+length > JSB_MAX_CODE_SIZE) {
+    jsbcFail();
+    return;
+  }
+  memcpy(&jsbc.code[jsbc.codeLength], data, length);
+  jsbc.codeLength += (unsigned int)length;
+}
+
+/// Emit an opcode, and say how many items it adds to (or removes from) the stack
+static void jsbcEmit(JsbOpcode op, int stackChange) {
+  uint8_t b = (uint8_t)op;
+  jsbcEmitData(&b, 1);
+  jsbc.stack += stackChange;
+  if (jsbc.stack > JSB_MAX_STACK) jsbcFail();
+}
+
+static void jsbcEmitByte(int b) {
+  uint8_t v = (uint8_t)b;
+  if (b<0 || b>255) jsbcFail();
+  jsbcEmitData(&v, 1);
+}
+
+/// Emit a name as a length, then null-terminated characters
+static void jsbcEmitName(const char *name) {
+  size_t l = strlen(name);
+  jsbcEmitByte((int)l);
+  jsbcEmitData(name, l+1);
+}
+
+/// Emit a jump to somewhere we don't know yet, and return where to patch it with jsbcPatchJump
+static uint16_t jsbcEmitJump(JsbOpcode op, int stackChange) {
+  jsbcEmit(op, stackChange);
+  uint16_t patch = (uint16_t)jsbc.codeLength;
+  int16_t offset = 0;
+  jsbcEmitData(&offset, sizeof(offset));
+  return patch;
+}
+
+/// Make the jump we emitted at 'patch' go to 'target'
+static void jsbcPatchJumpTo(uint16_t patch, unsigned int target) {
+  int offset = (int)target - (int)(patch+sizeof(int16_t));
+  if (jsbc.failed) return;
+  if (offset<-32768 || offset>32767) {
+    jsbcFail();
+    return;
+  }
+  int16_t o = (int16_t)offset;
+  memcpy(&jsbc.code[patch], &o, sizeof(o));
+}
+
+static void jsbcPatchJump(uint16_t patch) {
+  jsbcPatchJumpTo(patch, jsbc.codeLength);
+}
+
+/// Emit a jump back to 'target' at the end of a loop
+static void jsbcEmitLoop(unsigned int target) {
+  jsbcPatchJumpTo(jsbcEmitJump(jsbc.loop->isOuter ? JSBO_LOOP_OUTER : JSBO_LOOP, 0), target);
+}
+
+/// Add a (locked) variable name, and return its index. Unlocks the name if we had it already
+static uint8_t jsbcAddVar(JsVar *name) {
+  unsigned int i;
+  for (i=0;i<jsbc.varCount;i++) {
+    if (jsbc.vars[i]==name) {
+      jsvUnLock(name);
+      return (uint8_t)i;
+    }
+  }
+  if (jsbc.varCount>=JSB_MAX_VARS) {
+    jsvUnLock(name);
+    jsbcFail();
+    return 0;
+  }
+  jsbc.vars[jsbc.varCount] = name;
+  return (uint8_t)jsbc.varCount++;
+}
+
+/// Get the scope that `var` declares variables in (locked)
+static JsVar *jsbcGetVarScope() {
+#ifndef ESPR_NO_LET_SCOPING
+  return jsvLockAgain(execInfo.baseScope);
+#else
+  return jspeiGetTopScope();
+#endif
+}
+
+/// Find a variable that a `var` statement in the loop has declared (but that isn't in the scope yet)
+static JsVar *jsbcFindDeclared(const char *name) {
+  unsigned int i;
+  for (i=0;i<jsbc.varCount;i++)
+    if ((jsbc.declared & (1u<<i)) && jsvIsStringEqual(jsbc.vars[i], name))
+      return jsvLockAgain(jsbc.vars[i]);
+  return 0;
+}
+
+/// Emit code to put the value of ref on the stack
+static void jsbcGetValue(JsbRef *r) {
+  switch (r->type) {
+  case JSBR_VALUE: break;
+  case JSBR_VAR:
+    jsbcEmit(JSBO_GET_VAR, 1);
+    jsbcEmitByte(r->var);
+    break;
+  case JSBR_DYN:
+    jsbcEmit(JSBO_GET_DYN, 1);
+    jsbcEmitName(r->name);
+    break;
+  case JSBR_MEMBER:
+    jsbcEmit(JSBO_GET_MEMBER, 0);
+    jsbcEmitData(&r->position, sizeof(r->position));
+    jsbcEmitName(r->name);
+    break;
+  case JSBR_INDEX:
+    jsbcEmit(JSBO_GET_INDEX, -1);
+    break;
+  }
+  r->type = JSBR_VALUE;
+}
+
+/// Emit code to put the name that ref refers to on the stack (so it can be assigned to)
+static void jsbcGetName(JsbRef *r) {
+  switch (r->type) {
+  case JSBR_VALUE:
+    jsbcFail(); // can't assign to a value
+    break;
+  case JSBR_VAR:
+    jsbcEmit(JSBO_REF_VAR, 1);
+    jsbcEmitByte(r->var);
+    break;
+  case JSBR_DYN:
+    jsbcEmit(JSBO_REF_DYN, 1);
+    jsbcEmitName(r->name);
+    break;
+  case JSBR_MEMBER:
+    jsbcEmit(JSBO_REF_MEMBER, 0);
+    jsbcEmitData(&r->position, sizeof(r->position));
+    jsbcEmitName(r->name);
+    break;
+  case JSBR_INDEX:
+    jsbcEmit(JSBO_REF_INDEX, -1);
+    break;
+  }
+  r->type = JSBR_VALUE;
+}
+
+static void jsbcExpression();
+static void jsbcAssignment();
+static void jsbcStatement();
+
+static void jsbcFactor(JsbRef *r) {
+  r->type = JSBR_VALUE;
+  if (lex->tk==LEX_ID) {
+    const char *name = jslGetTokenValueAsString();
+    if (!strcmp(name, "eval")) { // could add variables to our scope
+      jsbcFail();
+      return;
+    }
+    JsVar *v = jspeiFindInScopes(name);
+    if (!v) v = jsbcFindDeclared(name);
+    if (v) {
+      r->type = JSBR_VAR;
+      r->var = jsbcAddVar(v);
+    } else {
+      r->type = JSBR_DYN;
+      strncpy(r->name, name, sizeof(r->name));
+    }
+    jsbcMatch(LEX_ID);
+    if (lex->tk==LEX_ARROW_FUNCTION || lex->tk==LEX_TEMPLATE_LITERAL)
+      jsbcFail();
+  } else if (lex->tk==LEX_INT) {
+    long long v = stringToInt(jslGetTokenValueAsString());
+    if (v>=-2147483648LL && v<=2147483647LL) {
+      int32_t i = (int32_t)v;
+      jsbcEmit(JSBO_PUSH_INT, 1);
+      jsbcEmitData(&i, sizeof(i));
+    } else {
+      JsVarFloat f = (JsVarFloat)v;
+      jsbcEmit(JSBO_PUSH_FLOAT, 1);
+      jsbcEmitData(&f, sizeof(f));
+    }
+    jsbcMatch(LEX_INT);
+  } else if (lex->tk==LEX_FLOAT) {
+    JsVarFloat f = stringToFloat(jslGetTokenValueAsString());
+    jsbcEmit(JSBO_PUSH_FLOAT, 1);
+    jsbcEmitData(&f, sizeof(f));
+    jsbcMatch(LEX_FLOAT);
+  } else if (lex->tk==LEX_STR) {
+#ifdef ESPR_UNICODE_SUPPORT
+    if (lex->isUTF8) jsbcFail();
+#endif
+    JsVar *s = jslGetTokenValueAsVar();
+    size_t l = jsvGetStringLength(s);
+    if (l <= JSB_MAX_STRING_LENGTH) {
+      char buf[JSB_MAX_STRING_LENGTH];
+      jsvGetStringChars(s, 0, buf, l);
+      jsbcEmit(JSBO_PUSH_STRING, 1);
+      jsbcEmitByte((int)l);
+      jsbcEmitData(buf, l);
+    } else
+      jsbcFail();
+    jsvUnLock(s);
+    jsbcMatch(LEX_STR);
+  } else if (lex->tk=='(') {
+    jsbcMatch('(');
+    jsbcExpression();
+    jsbcMatch(')');
+    if (lex->tk==LEX_ARROW_FUNCTION) jsbcFail();
+  } else if (lex->tk==LEX_R_TRUE) {
+    jsbcEmit(JSBO_PUSH_TRUE, 1);
+    jsbcMatch(LEX_R_TRUE);
+  } else if (lex->tk==LEX_R_FALSE) {
+    jsbcEmit(JSBO_PUSH_FALSE, 1);
+    jsbcMatch(LEX_R_FALSE);
+  } else if (lex->tk==LEX_R_NULL) {
+    jsbcEmit(JSBO_PUSH_NULL, 1);
+    jsbcMatch(LEX_R_NULL);
+  } else if (lex->tk==LEX_R_UNDEFINED) {
+    jsbcEmit(JSBO_PUSH_UNDEFINED, 1);
+    jsbcMatch(LEX_R_UNDEFINED);
+  } else if (lex->tk==LEX_R_THIS) {
+    jsbcEmit(JSBO_PUSH_THIS, 1);
+    jsbcMatch(LEX_R_THIS);
+  } else {
+    // object/array literals, functions, regex, templates, typeof, delete, etc
+    jsbcFail();
+  }
+}
+
+static void jsbcMember(JsbRef *r) {
+  while (!jsbc.failed && (lex->tk=='.' || lex->tk=='[')) {
+    if (lex->tk=='.') {
+      jsbcMatch('.');
+      if (!jslIsIDOrReservedWord()) {
+        jsbcFail();
+        return;
+      }
+      jsbcGetValue(r);
+      r->type = JSBR_MEMBER;
+      r->position = (uint32_t)lex->tokenStart;
+      strncpy(r->name, jslGetTokenValueAsString(), sizeof(r->name));
+      jslGetNextToken();
+    } else {
+      jsbcMatch('[');
+      jsbcGetValue(r);
+      jsbcAssignment();
+      jsbcMatch(']');
+      r->type = JSBR_INDEX;
+    }
+  }
+}
+
+static void jsbcFactorCall(JsbRef *r) {
+  jsbcFactor(r);
+  jsbcMember(r);
+  while (!jsbc.failed && lex->tk=='(') {
+    // stack has 'this', then the function's name
+    switch (r->type) {
+    case JSBR_MEMBER:
+      jsbcEmit(JSBO_METHOD_MEMBER, 1);
+      jsbcEmitData(&r->position, sizeof(r->position));
+      jsbcEmitName(r->name);
+      break;
+    case JSBR_INDEX:
+      jsbcEmit(JSBO_METHOD_INDEX, 0);
+      break;
+    case JSBR_VAR:
+    case JSBR_DYN:
+      jsbcEmit(JSBO_PUSH_UNDEFINED, 1);
+      jsbcGetName(r);
+      break;
+    default:
+      jsbcFail();
+      return;
+    }
+    jsbcMatch('(');
+    int args = 0;
+    while (!jsbc.failed && lex->tk!=')') {
+      jsbcAssignment();
+      args++;
+      if (lex->tk!=')') jsbcMatch(',');
+    }
+    jsbcMatch(')');
+    if (args > JSB_MAX_ARGS) jsbcFail();
+    jsbcEmit(JSBO_CALL, -(args+1));
+    jsbcEmitByte(args);
+    r->type = JSBR_VALUE;
+    jsbcMember(r);
+  }
+}
+
+/// Emit code to increment/decrement r, and leave the result on the stack
+static void jsbcIncrement(JsbRef *r, int flags) {
+  if (r->type==JSBR_VAR) {
+    jsbcEmit(JSBO_INC_VAR, 1);
+    jsbcEmitByte(r->var);
+  } else {
+    jsbcGetName(r);
+    jsbcEmit(JSBO_INC, 0);
+  }
+  jsbcEmitByte(flags);
+  r->type = JSBR_VALUE;
+}
+
+static void jsbcPostfix(JsbRef *r) {
+  if (lex->tk==LEX_PLUSPLUS || lex->tk==LEX_MINUSMINUS) {
+    int flags = (lex->tk==LEX_MINUSMINUS) ? JSBI_DECREMENT : 0;
+    jslGetNextToken();
+    jsbcPostfix(r);
+    jsbcIncrement(r, flags);
+  } else
+    jsbcFactorCall(r);
+  if (lex->tk==LEX_PLUSPLUS || lex->tk==LEX_MINUSMINUS) {
+    int flags = JSBI_POSTFIX | ((lex->tk==LEX_MINUSMINUS) ? JSBI_DECREMENT : 0);
+    jslGetNextToken();
+    jsbcIncrement(r, flags);
+    if (lex->tk==LEX_PLUSPLUS || lex->tk==LEX_MINUSMINUS) jsbcFail();
+  }
+}
+
+static void jsbcUnary(JsbRef *r) {
+  JsbOpcode op;
+  switch (lex->tk) {
+  case '!': op = JSBO_NOT; break;
+  case '~': op = JSBO_BITNOT; break;
+  case '-': op = JSBO_NEGATE; break;
+  case '+': op = JSBO_TO_NUMBER; break;
+  default:
+    jsbcPostfix(r);
+    return;
+  }
+  jslGetNextToken();
+  jsbcUnary(r);
+  jsbcGetValue(r);
+  jsbcEmit(op, 0);
+}
+
+/// The same as jspeGetBinaryExpressionPrecedence, but without the operators we can't compile
+static unsigned int jsbcGetPrecedence(int op) {
+  switch (op) {
+  case LEX_OROR: return 1;
+  case LEX_ANDAND: return 2;
+  case '|' : return 3;
+  case '^' : return 4;
+  case '&' : return 5;
+  case LEX_EQUAL:
+  case LEX_NEQUAL:
+  case LEX_TYPEEQUAL:
+  case LEX_NTYPEEQUAL: return 6;
+  case LEX_LEQUAL:
+  case LEX_GEQUAL:
+  case '<':
+  case '>': return 7;
+  case LEX_LSHIFT:
+  case LEX_RSHIFT:
+  case LEX_RSHIFTUNSIGNED: return 8;
+  case '+':
+  case '-': return 9;
+  case '*':
+  case '/':
+  case '%': return 10;
+  default: return 0;
+  }
+}
+
+static void jsbcBinary(JsbRef *r, unsigned int lastPrecedence) {
+  jsbcUnary(r);
+  unsigned int precedence = jsbcGetPrecedence(lex->tk);
+  while (!jsbc.failed && precedence && precedence>lastPrecedence) {
+    int op = lex->tk;
+    jslGetNextToken();
+    jsbcGetValue(r);
+    JsbRef b;
+    if (op==LEX_ANDAND || op==LEX_OROR) {
+      uint16_t j = jsbcEmitJump(op==LEX_ANDAND ? JSBO_JUMP_IF_FALSE_KEEP : JSBO_JUMP_IF_TRUE_KEEP, -1);
+      jsbcBinary(&b, precedence);
+      jsbcGetValue(&b);
+      jsbcPatchJump(j);
+    } else {
+      jsbcBinary(&b, precedence);
+      jsbcGetValue(&b);
+      jsbcEmit(JSBO_MATHS, -1);
+      jsbcEmitByte(op);
+    }
+    precedence = jsbcGetPrecedence(lex->tk);
+  }
+}
+
+static void jsbcConditional(JsbRef *r) {
+  jsbcBinary(r, 0);
+  if (lex->tk=='?') {
+    jsbcMatch('?');
+    jsbcGetValue(r);
+    uint16_t jFalse = jsbcEmitJump(JSBO_JUMP_IF_FALSE, -1);
+    jsbcAssignment();
+    jsbcMatch(':');
+    uint16_t jEnd = jsbcEmitJump(JSBO_JUMP, -1); // the other branch pushes the value instead
+    jsbcPatchJump(jFalse);
+    jsbcAssignment();
+    jsbcPatchJump(jEnd);
+  }
+}
+
+/// Parse an assignment expression, leaving its value on the stack
+static void jsbcAssignment() {
+  JsbRef r;
+  jsbcConditional(&r);
+  int op = lex->tk;
+  switch (op) {
+  case '=': break;
+  case LEX_PLUSEQUAL: op='+'; break;
+  case LEX_MINUSEQUAL: op='-'; break;
+  case LEX_MULEQUAL: op='*'; break;
+  case LEX_DIVEQUAL: op='/'; break;
+  case LEX_MODEQUAL: op='%'; break;
+  case LEX_ANDEQUAL: op='&'; break;
+  case LEX_OREQUAL: op='|'; break;
+  case LEX_XOREQUAL: op='^'; break;
+  case LEX_RSHIFTEQUAL: op=LEX_RSHIFT; break;
+  case LEX_LSHIFTEQUAL: op=LEX_LSHIFT; break;
+  case LEX_RSHIFTUNSIGNEDEQUAL: op=LEX_RSHIFTUNSIGNED; break;
+  default:
+    jsbcGetValue(&r);
+    return;
+  }
+  jslGetNextToken();
+  if (r.type==JSBR_VAR) {
+    jsbcAssignment();
+    if (op=='=') {
+      jsbcEmit(JSBO_SET_VAR, 0);
+      jsbcEmitByte(r.var);
+    } else {
+      jsbcEmit(JSBO_ASSIGN_OP_VAR, 0);
+      jsbcEmitByte(r.var);
+      jsbcEmitByte(op);
+    }
+  } else {
+    // like the parser, we find what we're assigning to before we work out the value
+    jsbcGetName(&r);
+    jsbcAssignment();
+    if (op=='=') {
+      jsbcEmit(JSBO_ASSIGN, -1);
+    } else {
+      jsbcEmit(JSBO_ASSIGN_OP, -1);
+      jsbcEmitByte(op);
+    }
+  }
+}
+
+/// Parse an expression (which may contain commas), leaving its value on the stack
+static void jsbcExpression() {
+  jsbcAssignment();
+  while (!jsbc.failed && lex->tk==',') {
+    jsbcMatch(',');
+    jsbcEmit(JSBO_POP, -1);
+    jsbcAssignment();
+  }
+}
+
+static void jsbcStatementVar() {
+  jsbcMatch(LEX_R_VAR);
+  bool hasComma = true;
+  while (!jsbc.failed && hasComma) {
+    if (lex->tk!=LEX_ID) {
+      jsbcFail();
+      return;
+    }
+    /* The parser would have defined the variable already if it had got here, but we
+     * only add it to the scope once we know the loop compiled (see jsbCompileLoop) */
+    const char *name = jslGetTokenValueAsString();
+    JsVar *scope = jsbcGetVarScope();
+    JsVar *a = jsvFindChildFromString(scope, name);
+    jsvUnLock(scope);
+    if (!a) a = jsbcFindDeclared(name);
+    bool isNew = !a;
+    if (isNew) a = jsvNewNameFromString(name);
+    if (!a) { // out of memory
+      jsbcFail();
+      return;
+    }
+    uint8_t var = jsbcAddVar(a);
+    if (isNew && !jsbc.failed) jsbc.declared |= 1u<<var;
+    jsbcMatch(LEX_ID);
+    if (lex->tk=='=') {
+      jsbcMatch('=');
+      jsbcAssignment();
+      jsbcEmit(JSBO_SET_VAR, 0);
+      jsbcEmitByte(var);
+      jsbcEmit(JSBO_POP, -1);
+    }
+    hasComma = lex->tk==',';
+    if (hasComma) jsbcMatch(',');
+  }
+}
+
+static void jsbcStatementIf() {
+  jsbcMatch(LEX_R_IF);
+  jsbcMatch('(');
+  jsbcExpression();
+  jsbcMatch(')');
+  uint16_t jElse = jsbcEmitJump(JSBO_JUMP_IF_FALSE, -1);
+  if (lex->tk!=';')
+    jsbcStatement();
+  if (lex->tk==';') jsbcMatch(';');
+  if (lex->tk==LEX_R_ELSE) {
+    jsbcMatch(LEX_R_ELSE);
+    uint16_t jEnd = jsbcEmitJump(JSBO_JUMP, 0);
+    jsbcPatchJump(jElse);
+    if (lex->tk!=';')
+      jsbcStatement();
+    jsbcPatchJump(jEnd);
+  } else
+    jsbcPatchJump(jElse);
+}
+
+static void jsbcLoopStart(JsbLoop *loop) {
+  loop->breakCount = 0;
+  loop->continueCount = 0;
+  loop->isOuter = jsbc.loop==0;
+}
+
+/// Point all the loop's `break` and `continue` statements at the right place
+static void jsbcLoopEnd(JsbLoop *loop, unsigned int continueTarget) {
+  int i;
+  for (i=0;i<loop->continueCount;i++)
+    jsbcPatchJumpTo(loop->continues[i], continueTarget);
+  for (i=0;i<loop->breakCount;i++)
+    jsbcPatchJump(loop->breaks[i]);
+}
+
+/// Compile a loop body (ending with a `continue` target that `continue` jumps to)
+static void jsbcLoopBody(JsbLoop *loop) {
+  JsbLoop *parentLoop = jsbc.loop;
+  jsbc.loop = loop;
+  jsbcStatement();
+  jsbc.loop = parentLoop;
+}
+
+/// `while (` has been parsed
+static void jsbcWhileRest() {
+  JsbLoop loop;
+  jsbcLoopStart(&loop);
+  unsigned int top = jsbc.codeLength;
+  jsbcExpression();
+  jsbcMatch(')');
+  uint16_t jEnd = jsbcEmitJump(JSBO_JUMP_IF_FALSE, -1);
+  jsbcLoopBody(&loop);
+  JsbLoop *parentLoop = jsbc.loop;
+  jsbc.loop = &loop;
+  jsbcEmitLoop(top);
+  jsbc.loop = parentLoop;
+  jsbcPatchJump(jEnd);
+  jsbcLoopEnd(&loop, top);
+}
+
+/// `do` has been parsed
+static void jsbcDoWhileRest() {
+  JsbLoop loop;
+  jsbcLoopStart(&loop);
+  unsigned int top = jsbc.codeLength;
+  jsbcLoopBody(&loop);
+  jsbcMatch(LEX_R_WHILE);
+  jsbcMatch('(');
+  unsigned int cond = jsbc.codeLength;
+  jsbcExpression();
+  jsbcMatch(')');
+  uint16_t jEnd = jsbcEmitJump(JSBO_JUMP_IF_FALSE, -1);
+  JsbLoop *parentLoop = jsbc.loop;
+  jsbc.loop = &loop;
+  jsbcEmitLoop(top);
+  jsbc.loop = parentLoop;
+  jsbcPatchJump(jEnd);
+  jsbcLoopEnd(&loop, cond);
+}
+
+/// `for (init;` has been parsed
+static void jsbcForRest() {
+  JsbLoop loop;
+  jsbcLoopStart(&loop);
+  unsigned int top = jsbc.codeLength;
+  uint16_t jEnd = 0;
+  bool hasCondition = lex->tk!=';';
+  if (hasCondition) {
+    jsbcExpression();
+    jEnd = jsbcEmitJump(JSBO_JUMP_IF_FALSE, -1);
+  }
+  jsbcMatch(';');
+  /* The iterator comes before the body in the code, but has to run after it. Compile it,
+   * then take it out and put it back after the body. It's fine to move it as jumps are relative */
+  unsigned int iterStart = jsbc.codeLength;
+  if (lex->tk!=')') {
+    jsbcExpression();
+    jsbcEmit(JSBO_POP, -1);
+  }
+  jsbcMatch(')');
+  uint8_t iter[JSB_MAX_ITER_SIZE];
+  unsigned int iterLength = jsbc.codeLength - iterStart;
+  if (jsbc.failed || iterLength > sizeof(iter)) {
+    jsbcFail();
+    return;
+  }
+  memcpy(iter, &jsbc.code[iterStart], iterLength);
+  jsbc.codeLength = iterStart;
+  jsbcLoopBody(&loop);
+  unsigned int cont = jsbc.codeLength;
+  jsbcEmitData(iter, iterLength);
+  JsbLoop *parentLoop = jsbc.loop;
+  jsbc.loop = &loop;
+  jsbcEmitLoop(top);
+  jsbc.loop = parentLoop;
+  if (hasCondition) jsbcPatchJump(jEnd);
+  jsbcLoopEnd(&loop, cont);
+}
+
+static void jsbcStatementFor() {
+  jsbcMatch(LEX_R_FOR);
+  jsbcMatch('(');
+  if (lex->tk==LEX_R_VAR) {
+    jsbcStatementVar();
+  } else if (lex->tk!=';') {
+    jsbcExpression();
+    jsbcEmit(JSBO_POP, -1);
+  }
+  // for..in, for..of and let/const will fail here
+  jsbcMatch(';');
+  jsbcForRest();
+}
+
+static void jsbcBreakOrContinue(bool isBreak) {
+  jslGetNextToken();
+  JsbLoop *loop = jsbc.loop;
+  uint8_t *count = isBreak ? &loop->breakCount : &loop->continueCount;
+  if (*count >= JSB_MAX_JUMPS) {
+    jsbcFail();
+    return;
+  }
+  uint16_t j = jsbcEmitJump(JSBO_JUMP, 0);
+  if (isBreak) loop->breaks[(*count)++] = j;
+  else loop->continues[(*count)++] = j;
+}
+
+static void jsbcStatement() {
+  if (jsbc.failed) return;
+  switch (lex->tk) {
+  case LEX_ID:
+  case LEX_INT:
+  case LEX_FLOAT:
+  case LEX_STR:
+  case LEX_R_NULL:
+  case LEX_R_UNDEFINED:
+  case LEX_R_TRUE:
+  case LEX_R_FALSE:
+  case LEX_R_THIS:
+  case LEX_PLUSPLUS:
+  case LEX_MINUSMINUS:
+  case '!':
+  case '-':
+  case '+':
+  case '~':
+  case '(':
+    jsbcExpression();
+    jsbcEmit(JSBO_POP, -1);
+    break;
+  case '{':
+    jsbcMatch('{');
+    while (!jsbc.failed && lex->tk!='}') {
+      if (lex->tk==LEX_EOF) jsbcFail();
+      jsbcStatement();
+    }
+    jsbcMatch('}');
+    break;
+  case ';':
+    jsbcMatch(';');
+    break;
+  case LEX_R_VAR:
+    jsbcStatementVar();
+    break;
+  case LEX_R_IF:
+    jsbcStatementIf();
+    break;
+  case LEX_R_WHILE:
+    jsbcMatch(LEX_R_WHILE);
+    jsbcMatch('(');
+    jsbcWhileRest();
+    break;
+  case LEX_R_DO:
+    jsbcMatch(LEX_R_DO);
+    jsbcDoWhileRest();
+    break;
+  case LEX_R_FOR:
+    jsbcStatementFor();
+    break;
+  case LEX_R_BREAK:
+    jsbcBreakOrContinue(true);
+    break;
+  case LEX_R_CONTINUE:
+    jsbcBreakOrContinue(false);
+    break;
+  case LEX_R_RETURN:
+    jsbcMatch(LEX_R_RETURN);
+    if (lex->tk!=';' && lex->tk!='}')
+      jsbcExpression();
+    else
+      jsbcEmit(JSBO_PUSH_UNDEFINED, 1);
+    jsbcEmit(JSBO_RETURN, -1);
+    break;
+  default: // let/const, functions, switch, try, throw, etc
+    jsbcFail();
+    break;
+  }
+}
+
+static void jsbcFreeVars() {
+  unsigned int i;
+  for (i=0;i<jsbc.varCount;i++)
+    jsvUnLock(jsbc.vars[i]);
+  jsbc.varCount = 0;
+}
+
+/// Compile the loop the lexer is at, and return a flat string containing the program (or 0)
+static JsVar *jsbCompileLoop(JsbLoopType type) {
+  jsbc.codeLength = 0;
+  jsbc.varCount = 0;
+  jsbc.declared = 0;
+  jsbc.stack = 0;
+  jsbc.loop = 0;
+  jsbc.failed = false;
+  switch (type) {
+  case JSBLT_FOR: jsbcForRest(); break;
+  case JSBLT_WHILE: jsbcWhileRest(); break;
+  case JSBLT_DO_WHILE: jsbcDoWhileRest(); break;
+  }
+  jsbcEmit(JSBO_END, 0);
+  assert(jsbc.failed || jsbc.stack==0);
+  JsVar *program = 0;
+  if (!jsbc.failed && !jspHasError()) {
+    size_t varsSize = jsbc.varCount*sizeof(JsVar*);
+    program = jsvNewFlatStringOfLength((unsigned int)(sizeof(JsbProgram) + varsSize + jsbc.codeLength));
+    if (program) {
+      char *p = jsvGetFlatStringPointer(program);
+      JsbProgram header;
+      header.codeLength = (uint16_t)jsbc.codeLength;
+      header.varCount = (uint8_t)jsbc.varCount;
+      memcpy(p, &header, sizeof(header));
+      // the program keeps the locks on the variables
+      memcpy(p+sizeof(header), jsbc.vars, varsSize);
+      memcpy(p+sizeof(header)+varsSize, jsbc.code, jsbc.codeLength);
+      // now we know we'll run it, add any variables the loop declared
+      if (jsbc.declared) {
+        JsVar *scope = jsbcGetVarScope();
+        unsigned int i;
+        for (i=0;i<jsbc.varCount;i++)
+          if (jsbc.declared & (1u<<i)) jsvAddName(scope, jsbc.vars[i]);
+        jsvUnLock(scope);
+      }
+      jsbc.varCount = 0;
+    }
+  }
+  jsbcFreeVars();
+  return program;
+}
+
+// ----------------------------------------------------------------------------
+//                                                                           VM
+
+typedef enum {
+  JSBV_VAR,   ///< a locked JsVar (which may be 0 for undefined, or a name)
+  JSBV_INT,
+  JSBV_FLOAT,
+  JSBV_BOOL,
+} PACKED_FLAGS JsbValueType;
+
+/// A value on the VM's stack. Numbers are stored directly to avoid allocating JsVars for them
+typedef struct {
+  JsbValueType type;
+  union {
+    JsVar *var;
+    JsVarInt i;
+    JsVarFloat f;
+    bool b;
+  } v;
+} JsbValue;
+
+static void jsbFree(JsbValue *v) {
+  if (v->type==JSBV_VAR) jsvUnLock(v->v.var);
+}
+
+/// Set the value to the (locked) JsVar, and take ownership of it
+static void jsbSetVar(JsbValue *v, JsVar *var) {
+  JsVarFlags t = var ? (var->flags&JSV_VARTYPEMASK) : JSV_UNUSED;
+  if (t==JSV_INTEGER) {
+    v->type = JSBV_INT;
+    v->v.i = var->varData.integer;
+    jsvUnLock(var);
+  } else if (t==JSV_FLOAT) {
+    v->type = JSBV_FLOAT;
+    v->v.f = var->varData.floating;
+    jsvUnLock(var);
+  } else if (t==JSV_BOOLEAN) {
+    v->type = JSBV_BOOL;
+    v->v.b = var->varData.integer!=0;
+    jsvUnLock(var);
+  } else {
+    v->type = JSBV_VAR;
+    v->v.var = var;
+  }
+}
+
+static void jsbSetLongInteger(JsbValue *v, long long i) {
+  if (i>=-2147483648LL && i<=2147483647LL) {
+    v->type = JSBV_INT;
+    v->v.i = (JsVarInt)i;
+  } else {
+    v->type = JSBV_FLOAT;
+    v->v.f = (JsVarFloat)i;
+  }
+}
+
+/// Return a locked JsVar for the value (the value is no longer valid)
+static JsVar *jsbGetVar(JsbValue *v) {
+  switch (v->type) {
+  case JSBV_INT: return jsvNewFromInteger(v->v.i);
+  case JSBV_FLOAT: return jsvNewFromFloat(v->v.f);
+  case JSBV_BOOL: return jsvNewFromBool(v->v.b);
+  default: return v->v.var;
+  }
+}
+
+/// Get the value as a boolean, and free it
+static bool jsbGetBool(JsbValue *v) {
+  switch (v->type) {
+  case JSBV_INT: return v->v.i!=0;
+  case JSBV_FLOAT: return !isnan(v->v.f) && v->v.f!=0.0;
+  case JSBV_BOOL: return v->v.b;
+  default: return jsvGetBoolAndUnLock(v->v.var);
+  }
+}
+
+/// Can this name store an integer value itself? See jsvSetValueOfName
+static bool jsbIsNameWithInteger(JsVar *name) {
+  return jsvIsNameWithValue(name) && !jsvIsNameIntBool(name);
+}
+
+/// Set the value to whatever 'name' points to (doesn't unlock name)
+static void jsbSetFromName(JsbValue *v, JsVar *name, JsVar *parent) {
+  if (jsbIsNameWithInteger(name)) {
+    v->type = JSBV_INT;
+    v->v.i = (JsVarInt)jsvGetFirstChildSigned(name);
+  } else
+    jsbSetVar(v, jsvSkipNameWithParent(name, true, parent));
+}
+
+/// Store a value in a name (the value is no longer valid)
+static void jsbAssign(JsVar *name, JsbValue *v, bool addToRoot) {
+  long long i = (v->type==JSBV_INT) ? v->v.i : 0;
+  if (v->type==JSBV_INT && jsvIsString(name) && jsbIsNameWithInteger(name) && !jsvIsConstant(name) &&
+      !jsvIsNewChild(name) && i>=JSVARREF_MIN && i<=JSVARREF_MAX) {
+    // the name already stores an integer, so we can just change it
+    jsvSetFirstChild(name, (JsVarRef)v->v.i);
+    return;
+  }
+  JsVar *var = jsbGetVar(v);
+  if (addToRoot) jsvReplaceWithOrAddToRoot(name, var);
+  else jsvReplaceWith(name, var);
+  jsvUnLock(var);
+}
+
+/// a = a op b (b is freed). This does the same as jsvMathsOp, but avoids allocating for numbers
+static void jsbMaths(JsbValue *a, JsbValue *b, int op) {
+  if (a->type==JSBV_INT && b->type==JSBV_INT) {
+    JsVarInt da = a->v.i, db = b->v.i;
+    switch (op) {
+    case '+': jsbSetLongInteger(a, (long long)da + (long long)db); return;
+    case '-': jsbSetLongInteger(a, (long long)da - (long long)db); return;
+    case '*': jsbSetLongInteger(a, (long long)da * (long long)db); return;
+    case '/': a->type = JSBV_FLOAT; a->v.f = (JsVarFloat)da/(JsVarFloat)db; return;
+    case '&': a->v.i = da&db; return;
+    case '|': a->v.i = da|db; return;
+    case '^': a->v.i = da^db; return;
+    case '%':
+      if (db<0) db=-db; // fix SIGFPE
+      if (db) a->v.i = da%db;
+      else {
+        a->type = JSBV_FLOAT;
+        a->v.f = NAN;
+      }
+      return;
+    case LEX_LSHIFT: a->v.i = da << db; return;
+    case LEX_RSHIFT: a->v.i = da >> db; return;
+    case LEX_RSHIFTUNSIGNED: jsbSetLongInteger(a, ((JsVarIntUnsigned)da) >> db); return;
+    case LEX_EQUAL:
+    case LEX_TYPEEQUAL: a->type = JSBV_BOOL; a->v.b = da==db; return;
+    case LEX_NEQUAL:
+    case LEX_NTYPEEQUAL: a->type = JSBV_BOOL; a->v.b = da!=db; return;
+    case '<': a->type = JSBV_BOOL; a->v.b = da<db; return;
+    case LEX_LEQUAL: a->type = JSBV_BOOL; a->v.b = da<=db; return;
+    case '>': a->type = JSBV_BOOL; a->v.b = da>db; return;
+    case LEX_GEQUAL: a->type = JSBV_BOOL; a->v.b = da>=db; return;
+    }
+  } else if ((a->type==JSBV_INT || a->type==JSBV_FLOAT) &&
+             (b->type==JSBV_INT || b->type==JSBV_FLOAT)) {
+    JsVarFloat da = (a->type==JSBV_INT) ? (JsVarFloat)a->v.i : a->v.f;
+    JsVarFloat db = (b->type==JSBV_INT) ? (JsVarFloat)b->v.i : b->v.f;
+    bool handled = true;
+    switch (op) {
+    case '+': a->v.f = da+db; break;
+    case '-': a->v.f = da-db; break;
+    case '*': a->v.f = da*db; break;
+    case '/': a->v.f = da/db; break;
+    case '%': a->v.f = jswrap_math_mod(da, db); break;
+    default: handled = false;
+    }
+    if (handled) {
+      a->type = JSBV_FLOAT;
+      return;
+    }
+    handled = true;
+    switch (op) {
+    case LEX_EQUAL:
+    case LEX_TYPEEQUAL: a->v.b = da==db; break;
+    case LEX_NEQUAL:
+    case LEX_NTYPEEQUAL: a->v.b = da!=db; break;
+    case '<': a->v.b = da<db; break;
+    case LEX_LEQUAL: a->v.b = da<=db; break;
+    case '>': a->v.b = da>db; break;
+    case LEX_GEQUAL: a->v.b = da>=db; break;
+    default: handled = false;
+    }
+    if (handled) {
+      a->type = JSBV_BOOL;
+      return;
+    }
+  }
+  // Anything else - do it the same way as the parser
+  JsVar *pa = jsbGetVar(a);
+  JsVar *pb = jsbGetVar(b);
+  JsVar *va = jsvGetValueOf(pa);
+  JsVar *vb = jsvGetValueOf(pb);
+  jsvUnLock2(pa, pb);
+  jsbSetVar(a, jsvMathsOp(va, vb, op));
+  jsvUnLock2(va, vb);
+}
+
+/// `name op= value` - leaves the result in value
+static void jsbAssignOp(JsVar *name, JsbValue *value, int op, bool readBack) {
+  if (op=='+' && value->type==JSBV_VAR && jsvIsName(name)) {
+    JsVar *currentValue = jsvSkipName(name);
+    if (jsvIsBasicString(currentValue) && jsvGetRefs(currentValue)==1 && value->v.var!=currentValue) {
+      /* A special case for string += where this is the only use of the string
+       * and we're not appending to ourselves - see __jspeAssignmentExpression */
+      JsVar *str = jsvAsString(value->v.var);
+      jsvAppendStringVarComplete(currentValue, str);
+      jsvUnLock2(str, value->v.var);
+      if (readBack) jsbSetVar(value, currentValue);
+      else jsvUnLock(currentValue);
+      return;
+    }
+    jsvUnLock(currentValue);
+  }
+  JsbValue current;
+  jsbSetFromName(&current, name, 0);
+  jsbMaths(&current, value, op);
+  if (readBack && jsbIsNameWithInteger(name)) {
+    // it's a variable, so no need to read it back
+    *value = current;
+    if (value->type==JSBV_VAR) jsvLockAgain(value->v.var);
+    jsbAssign(name, &current, false);
+    return;
+  }
+  jsbAssign(name, &current, false);
+  if (readBack) jsbSetFromName(value, name, 0);
+}
+
+/// `++name`, `name--`, etc. Puts the result in 'result'
+static void jsbIncrement(JsVar *name, int flags, JsbValue *result) {
+  JsbValue current, one;
+  jsbSetFromName(&current, name, 0);
+  if (current.type==JSBV_INT && jsvIsString(name) && jsbIsNameWithInteger(name) && !jsvIsConstant(name) &&
+      !jsvIsNewChild(name)) {
+    // Fast path for a variable that contains an integer
+    long long v = (long long)current.v.i + ((flags&JSBI_DECREMENT) ? -1 : 1);
+    if (v>=JSVARREF_MIN && v<=JSVARREF_MAX) {
+      jsvSetFirstChild(name, (JsVarRef)v);
+      if (!(flags&JSBI_POSTFIX)) current.v.i = (JsVarInt)v;
+      *result = current;
+      return;
+    }
+  }
+  if (flags&JSBI_POSTFIX) { // keep the old value (but converted to a number)
+    if (current.type==JSBV_VAR || current.type==JSBV_BOOL)
+      jsbSetVar(&current, jsvAsNumberAndUnLock(jsbGetVar(&current)));
+    *result = current; // now always a number, so it's fine to copy
+  }
+  one.type = JSBV_INT;
+  one.v.i = 1;
+  jsbMaths(&current, &one, (flags&JSBI_DECREMENT) ? '-' : '+');
+  jsbAssign(name, &current, false);
+  if (!(flags&JSBI_POSTFIX))
+    jsbSetFromName(result, name, 0);
+}
+
+/// Get the value as a locked JsVar for use as an object (the value is no longer valid)
+#define JSB_GET_OBJECT(V) jsbGetVar(V)
+
+/** Run the given program. Returns true if the loop finished, or false if
+ * we stopped at the start of an iteration for the parser to carry on */
+static bool jsbExecute(JsVar *program) {
+  char *p = jsvGetFlatStringPointer(program);
+  JsbProgram header;
+  memcpy(&header, p, sizeof(header));
+  // variables follow the header, but may not be aligned so copy them out
+  JsVar *vars[JSB_MAX_VARS];
+  memcpy(vars, p+sizeof(header), header.varCount*sizeof(JsVar*));
+  const uint8_t *code = (const uint8_t*)(p+sizeof(header)+header.varCount*sizeof(JsVar*));
+  const uint8_t *pc = code;
+  JsbValue stack[JSB_MAX_STACK];
+  JsbValue *sp = stack; // points to the next free item
+  bool finished = true;
+  bool running = true;
+
+  while (running && JSP_SHOULD_EXECUTE) {
+    JsbOpcode op = (JsbOpcode)*(pc++);
+    switch (op) {
+    case JSBO_END:
+      running = false;
+      break;
+    case JSBO_PUSH_UNDEFINED:
+      sp->type = JSBV_VAR;
+      sp->v.var = 0;
+      sp++;
+      break;
+    case JSBO_PUSH_NULL:
+      sp->type = JSBV_VAR;
+      sp->v.var = jsvNewWithFlags(JSV_NULL);
+      sp++;
+      break;
+    case JSBO_PUSH_TRUE:
+    case JSBO_PUSH_FALSE:
+      sp->type = JSBV_BOOL;
+      sp->v.b = op==JSBO_PUSH_TRUE;
+      sp++;
+      break;
+    case JSBO_PUSH_INT: {
+      int32_t i;
+      memcpy(&i, pc, sizeof(i));
+      pc += sizeof(i);
+      sp->type = JSBV_INT;
+      sp->v.i = (JsVarInt)i;
+      sp++;
+    } break;
+    case JSBO_PUSH_FLOAT: {
+      memcpy(&sp->v.f, pc, sizeof(JsVarFloat));
+      pc += sizeof(JsVarFloat);
+      sp->type = JSBV_FLOAT;
+      sp++;
+    } break;
+    case JSBO_PUSH_STRING: {
+      uint8_t l = *(pc++);
+      // always a new string, as strings can be appended to (see jsbAssignOp)
+      sp->type = JSBV_VAR;
+      sp->v.var = jsvNewStringOfLength(l, (const char*)pc);
+      pc += l;
+      sp++;
+    } break;
+    case JSBO_PUSH_THIS:
+      sp->type = JSBV_VAR;
+      sp->v.var = jsvLockAgain(execInfo.thisVar ? execInfo.thisVar : execInfo.root);
+      sp++;
+      break;
+    case JSBO_POP:
+      jsbFree(--sp);
+      break;
+    case JSBO_GET_VAR:
+      jsbSetFromName(sp++, vars[*(pc++)], 0);
+      break;
+    case JSBO_SET_VAR: {
+      JsVar *name = vars[*(pc++)];
+      if (*pc==JSBO_POP) { // result not needed
+        pc++;
+        jsbAssign(name, --sp, true);
+      } else {
+        JsbValue v = sp[-1];
+        if (v.type==JSBV_VAR) jsvLockAgainSafe(v.v.var);
+        jsbAssign(name, &v, true);
+      }
+    } break;
+    case JSBO_REF_VAR:
+      sp->type = JSBV_VAR;
+      sp->v.var = jsvLockAgain(vars[*(pc++)]);
+      sp++;
+      break;
+    case JSBO_ASSIGN_OP_VAR: {
+      JsVar *name = vars[*(pc++)];
+      int mop = *(pc++);
+      bool readBack = *pc!=JSBO_POP;
+      if (!readBack) pc++;
+      jsbAssignOp(name, &sp[-1], mop, readBack);
+      if (!readBack) sp--;
+    } break;
+    case JSBO_INC_VAR: {
+      JsVar *name = vars[*(pc++)];
+      int flags = *(pc++);
+      jsbIncrement(name, flags, sp);
+      if (*pc==JSBO_POP) { // result not needed
+        pc++;
+        jsbFree(sp);
+      } else sp++;
+    } break;
+    case JSBO_GET_DYN:
+    case JSBO_REF_DYN: {
+      uint8_t l = *(pc++);
+      JsVar *name = jspGetNamedVariable((const char*)pc);
+      pc += l+1;
+      if (op==JSBO_GET_DYN) {
+        jsbSetFromName(sp, name, 0);
+        jsvUnLock(name);
+      } else {
+        sp->type = JSBV_VAR;
+        sp->v.var = name;
+      }
+      sp++;
+    } break;
+    case JSBO_GET_MEMBER:
+    case JSBO_REF_MEMBER:
+    case JSBO_METHOD_MEMBER: {
+      uint32_t position;
+      memcpy(&position, pc, sizeof(position));
+      pc += sizeof(position);
+      uint8_t l = *(pc++);
+      const char *name = (const char*)pc;
+      pc += l+1;
+      JsVar *object = JSB_GET_OBJECT(&sp[-1]);
+      JsVar *child = jspGetMemberName(object, name, position);
+      if (op==JSBO_GET_MEMBER) {
+        jsbSetVar(&sp[-1], jsvSkipNameWithParent(child, true, object));
+        jsvUnLock2(child, object);
+      } else if (op==JSBO_REF_MEMBER) {
+        sp[-1].type = JSBV_VAR;
+        sp[-1].v.var = jspNameWithParentAndUnLock(child, object);
+        jsvUnLock(object);
+      } else {
+        sp[-1].type = JSBV_VAR;
+        sp[-1].v.var = object;
+        sp->type = JSBV_VAR;
+        sp->v.var = child;
+        sp++;
+      }
+    } break;
+    case JSBO_GET_INDEX:
+    case JSBO_REF_INDEX:
+    case JSBO_METHOD_INDEX: {
+      JsbValue *objectValue = &sp[-2];
+      JsbValue *indexValue = &sp[-1];
+      if (op==JSBO_GET_INDEX && indexValue->type==JSBV_INT &&
+          objectValue->type==JSBV_VAR && jsvIsArrayBuffer(objectValue->v.var)) {
+        // Reading from a typed array - no need to create an ArrayBufferName
+        JsVar *object = objectValue->v.var;
+        jsbSetVar(objectValue, jsvArrayBufferGet(object, (size_t)indexValue->v.i));
+        jsvUnLock(object);
+        sp--;
+        break;
+      }
+      JsVar *object = JSB_GET_OBJECT(objectValue);
+      JsVar *index = jsvAsArrayIndexAndUnLock(jsbGetVar(indexValue));
+      JsVar *child = jspGetMemberNameVar(object, index);
+      jsvUnLock(index);
+      if (op==JSBO_GET_INDEX) {
+        jsbSetVar(objectValue, jsvSkipNameWithParent(child, true, object));
+        jsvUnLock2(child, object);
+        sp--;
+      } else if (op==JSBO_REF_INDEX) {
+        objectValue->type = JSBV_VAR;
+        objectValue->v.var = jspNameWithParentAndUnLock(child, object);
+        jsvUnLock(object);
+        sp--;
+      } else {
+        objectValue->type = JSBV_VAR;
+        objectValue->v.var = object;
+        indexValue->type = JSBV_VAR;
+        indexValue->v.var = child;
+      }
+    } break;
+    case JSBO_ASSIGN: {
+      JsVar *name = sp[-2].v.var;
+      sp--;
+      jsbAssign(name, sp, true);
+      if (*pc==JSBO_POP) { // result not needed
+        pc++;
+        sp--;
+      } else // the parser returns what was actually stored
+        jsbSetFromName(&sp[-1], name, 0);
+      jsvUnLock(name);
+    } break;
+    case JSBO_ASSIGN_OP: {
+      int mop = *(pc++);
+      JsVar *name = sp[-2].v.var;
+      bool readBack = *pc!=JSBO_POP;
+      if (!readBack) pc++;
+      jsbAssignOp(name, &sp[-1], mop, readBack);
+      jsvUnLock(name);
+      if (readBack) sp[-2] = sp[-1];
+      sp -= readBack ? 1 : 2;
+    } break;
+    case JSBO_INC: {
+      int flags = *(pc++);
+      JsVar *name = sp[-1].v.var;
+      jsbIncrement(name, flags, &sp[-1]);
+      jsvUnLock(name);
+      if (*pc==JSBO_POP) { // result not needed
+        pc++;
+        jsbFree(--sp);
+      }
+    } break;
+    case JSBO_CALL: {
+      int argCount = *(pc++);
+      JsVar *args[JSB_MAX_ARGS];
+      int i;
+      sp -= argCount;
+      for (i=0;i<argCount;i++)
+        args[i] = jsbGetVar(&sp[i]);
+      JsVar *functionName = jsbGetVar(&sp[-1]);
+      JsVar *thisVar = jsbGetVar(&sp[-2]);
+      JsVar *function = jsvSkipName(functionName);
+      JsVar *result = jspeFunctionCall(function, functionName, thisVar, false, argCount, args);
+      jsvUnLockMany((unsigned int)argCount, args);
+      jsvUnLock3(function, functionName, thisVar);
+      sp--;
+      if (*pc==JSBO_POP) { // result not needed
+        pc++;
+        jsvUnLock(result);
+        sp--;
+      } else
+        jsbSetVar(&sp[-1], result);
+    } break;
+    case JSBO_NOT: {
+      bool b = !jsbGetBool(&sp[-1]);
+      sp[-1].type = JSBV_BOOL;
+      sp[-1].v.b = b;
+    } break;
+    case JSBO_BITNOT:
+      if (sp[-1].type!=JSBV_INT) {
+        JsVarInt i = jsvGetIntegerAndUnLock(jsbGetVar(&sp[-1]));
+        sp[-1].type = JSBV_INT;
+        sp[-1].v.i = i;
+      }
+      sp[-1].v.i = ~sp[-1].v.i;
+      break;
+    case JSBO_NEGATE:
+      if (sp[-1].type==JSBV_INT)
+        jsbSetLongInteger(&sp[-1], -(long long)sp[-1].v.i);
+      else if (sp[-1].type==JSBV_FLOAT)
+        sp[-1].v.f = 0-sp[-1].v.f; // not -f, as the parser doesn't do -0
+      else
+        jsbSetVar(&sp[-1], jsvNegateAndUnLock(jsbGetVar(&sp[-1])));
+      break;
+    case JSBO_TO_NUMBER:
+      if (sp[-1].type!=JSBV_INT && sp[-1].type!=JSBV_FLOAT)
+        jsbSetVar(&sp[-1], jsvAsNumberAndUnLock(jsbGetVar(&sp[-1])));
+      break;
+    case JSBO_MATHS:
+      sp--;
+      jsbMaths(&sp[-1], sp, *(pc++));
+      break;
+    case JSBO_JUMP:
+    case JSBO_JUMP_IF_FALSE:
+    case JSBO_JUMP_IF_FALSE_KEEP:
+    case JSBO_JUMP_IF_TRUE_KEEP:
+    case JSBO_LOOP:
+    case JSBO_LOOP_OUTER: {
+      int16_t offset;
+      memcpy(&offset, pc, sizeof(offset));
+      pc += sizeof(offset);
+      bool jump = true;
+      if (op==JSBO_JUMP_IF_FALSE) {
+        jump = !jsbGetBool(--sp);
+      } else if (op==JSBO_JUMP_IF_FALSE_KEEP || op==JSBO_JUMP_IF_TRUE_KEEP) {
+        // the parser gets the value of objects before checking them (see __jspeBinaryExpression)
+        if (sp[-1].type==JSBV_VAR && jsvIsObject(sp[-1].v.var)) {
+          JsVar *o = sp[-1].v.var;
+          jsbSetVar(&sp[-1], jsvGetValueOf(o));
+          jsvUnLock(o);
+        }
+        JsbValue v = sp[-1];
+        if (v.type==JSBV_VAR) jsvLockAgainSafe(v.v.var);
+        jump = jsbGetBool(&v) == (op==JSBO_JUMP_IF_TRUE_KEEP);
+        if (!jump) jsbFree(--sp);
+      } else if (op==JSBO_LOOP_OUTER) {
+        assert(sp==stack);
+#ifdef USE_DEBUGGER
+        if (execInfo.execute & (EXEC_CTRL_C_WAIT|EXEC_DEBUGGER_MASK)) {
+          // let the parser run the loop, so the debugger can step through it
+          finished = false;
+          running = false;
+          jump = false;
+        }
+#endif
+      }
+      if (jump) pc += offset;
+    } break;
+    case JSBO_RETURN: {
+      JsVar *result = jsbGetVar(--sp);
+      JsVar *resultVar = jspeiFindInScopes(JSPARSE_RETURN_VAR);
+      if (resultVar) {
+        jsvReplaceWith(resultVar, result);
+        jsvUnLock(resultVar);
+        execInfo.execute |= EXEC_RETURN; // Stop anything else in this function executing
+      } else {
+        jsExceptionHere(JSET_SYNTAXERROR, "RETURN statement, but not in a function.");
+      }
+      jsvUnLock(result);
+    } break;
+    default:
+      assert(0);
+      running = false;
+      break;
+    }
+  }
+  // if we stopped because of an error, free what was left on the stack
+  while (sp>stack) jsbFree(--sp);
+  // and unlock the variables the program used
+  jsvUnLockMany(header.varCount, vars);
+  return finished;
+}
+
+/// Hash 'length' characters of the code we're executing, from 'position'
+static uint32_t jsbHashSource(size_t position, size_t length) {
+  uint32_t hash = JS_HASH_INITIAL;
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, lex->sourceVar, position);
+  while (length-- && jsvStringIteratorHasChar(&it)) {
+    hash = jsHashChar(hash, jsvStringIteratorGetChar(&it));
+    jsvStringIteratorNext(&it);
+  }
+  jsvStringIteratorFree(&it);
+  return hash;
+}
+
+bool jsbExecuteLoop(JsbLoopType type, JslCharPos *start) {
+  if (!lex->sourceVar || (execInfo.execute & (EXEC_CTRL_C_WAIT|EXEC_DEBUGGER_MASK)))
+    return false;
+  jslSeekToP(start);
+  JsVarRef code = jsvGetRef(lex->sourceVar);
+  size_t position = lex->tokenStart;
+  int i;
+  for (i=0;i<JSB_FAILED_LOOPS;i++)
+    if (jsbFailedLoops[i].code==code && jsbFailedLoops[i].position==position &&
+        jsbFailedLoops[i].hash==jsbHashSource(position, jsbFailedLoops[i].length))
+      return false;
+  JsVar *program = jsbCompileLoop(type);
+  if (!program) {
+    size_t length = jsvStringIteratorGetIndex(&lex->it) - position; // up to and including the token we failed at
+    if (length>0xFFFF) length = 0xFFFF;
+    jsbFailedLoops[jsbFailedLoopIdx].code = code;
+    jsbFailedLoops[jsbFailedLoopIdx].position = position;
+    jsbFailedLoops[jsbFailedLoopIdx].length = (uint16_t)length;
+    jsbFailedLoops[jsbFailedLoopIdx].hash = jsbHashSource(position, length);
+    jsbFailedLoopIdx = (unsigned char)((jsbFailedLoopIdx+1) % JSB_FAILED_LOOPS);
+    return false;
+  }
+  bool finished = jsbExecute(program);
+  jsvUnLock(program);
+  return finished;
+}
+
+#endif /* ESPR_NO_BYTECODE */
@@ -0,0 +1,46 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * Bytecode compiler and VM for loops
+ * ----------------------------------------------------------------------------
+ */
+#ifndef JSBYTECODE_H_
+#define JSBYTECODE_H_
+
+#include "jsparse.h"
+
+#if defined(JSPARSE_MAX_LOOP_ITERATIONS) && !defined(ESPR_NO_BYTECODE)
+#define ESPR_NO_BYTECODE // the VM doesn't count iterations
+#endif
+
+#ifndef ESPR_NO_BYTECODE
+
+typedef enum {
+  JSBLT_FOR,      ///< `for (..;cond;iter) body` - starts just after the first ';'
+  JSBLT_WHILE,    ///< `while (cond) body` - starts just after the '('
+  JSBLT_DO_WHILE, ///< `do body while (cond)` - starts just after the 'do'
+} JsbLoopType;
+
+/** Called by the parser once it has executed the first iteration of a loop
+ * (and the loop should carry on). Compile the loop that starts at 'start' and
+ * run the rest of it as bytecode, rather than re-lexing its source for every
+ * iteration.
+ *
+ * Returns true if the loop was finished (because it ended, we had a `break`/`return`,
+ * or there was an error), or false if it couldn't be compiled or wants the parser
+ * to carry on executing it (eg. for the debugger) - in which case the parser
+ * should just continue from the start of the next iteration.
+ *
+ * Either way the lexer is left in an undefined position, so the parser must seek
+ * to the end of the loop afterwards. */
+bool jsbExecuteLoop(JsbLoopType type, JslCharPos *start);
+
+#endif /* ESPR_NO_BYTECODE */
+#endif /* JSBYTECODE_H_ */
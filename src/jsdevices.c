@@ -177,14 +177,16 @@ void jshResetDevices() {
 // ----------------------------------------------------------------------------
 
 /**
- * Queue a character for transmission.
+ * Queue a block of data for transmission.
  */
-void jshTransmit(
+void jshTransmitBuf(
     IOEventFlags device, //!< The device to be used for transmission.
-    unsigned char data   //!< The character to transmit.
+    const char *data,    //!< The data to transmit.
+    size_t len           //!< The number of bytes to transmit.
   ) {
+  if (!len) return;
   if (device==EV_LOOPBACKA || device==EV_LOOPBACKB) {
-    jshPushIOCharEvent(device==EV_LOOPBACKB ? EV_LOOPBACKA : EV_LOOPBACKB, (char)data);
+    jshPushIOCharEvents(device==EV_LOOPBACKB ? EV_LOOPBACKA : EV_LOOPBACKB, (char*)data, (unsigned int)len);
     return;
   }
   //if (device==EV_USBSERIAL)
@@ -193,14 +195,14 @@ void jshTransmit(
   if (device == EV_TELNET) {
     // gross hack to avoid deadlocking on the network here
     extern void telnetSendChar(char c);
-    telnetSendChar((char)data);
+    while (len--) telnetSendChar(*(data++));
     return;
   }
 #endif
 #ifdef USE_TERMINAL
   if (device==EV_TERMINAL) {
     extern void terminalSendChar(char c);
-    terminalSendChar((char)data);
+    while (len--) terminalSendChar(*(data++));
     return;
   }
 #endif
@@ -219,7 +221,7 @@ void jshTransmit(
 #endif
 #else // if PC, just put to stdout
   if (device==DEFAULT_CONSOLE_DEVICE) {
-    fputc(data, stdout);
+    fwrite(data, 1, len, stdout);
     fflush(stdout);
     return;
   }
@@ -227,48 +229,65 @@ void jshTransmit(
   // If the device is EV_NONE then there is nowhere to send the data.
   if (device==EV_NONE) return;
 
-  // The txHead global points to the current item in the txBuffer.  Since we are adding a new
-  // character, we increment the head pointer.   If it has caught up with the tail, then that means
-  // we have filled the array backing the list.  What we do next is to wait for space to free up.
-  unsigned char txHeadNext = (unsigned char)((txHead+1)&TXBUFFERMASK);
-  if (txHeadNext==txTail) {
-    jsiSetBusy(BUSY_TRANSMIT, true);
-    bool wasConsoleLimbo = device==EV_LIMBO && jsiGetConsoleDevice()==EV_LIMBO;
-    while (txHeadNext==txTail) {
-      // wait for send to finish as buffer is about to overflow
-      if (jshIsInInterrupt()) {
-        // if we're printing from an IRQ, don't wait - it's unlikely TX will ever finish
-        jsErrorFlags |= JSERR_BUFFER_FULL;
-        return;
-      }
-      jshBusyIdle();
+  while (len) {
+    // The txHead global points to the next free item in the txBuffer. If moving it on would make it
+    // catch up with the tail, then that means we have filled the array backing the list. What we
+    // do next is to wait for space to free up.
+    unsigned char txHeadNext = (unsigned char)((txHead+1)&TXBUFFERMASK);
+    if (txHeadNext==txTail) {
+      jsiSetBusy(BUSY_TRANSMIT, true);
+      bool wasConsoleLimbo = device==EV_LIMBO && jsiGetConsoleDevice()==EV_LIMBO;
+      while (txHeadNext==txTail) {
+        // wait for send to finish as buffer is about to overflow
+        if (jshIsInInterrupt()) {
+          // if we're printing from an IRQ, don't wait - it's unlikely TX will ever finish
+          jsErrorFlags |= JSERR_BUFFER_FULL;
+          return;
+        }
+        jshBusyIdle();
 #ifdef USB
-      // just in case USB was unplugged while we were waiting!
-      if (!jshIsUSBSERIALConnected()) jshTransmitClearDevice(EV_USBSERIAL);
+        // just in case USB was unplugged while we were waiting!
+        if (!jshIsUSBSERIALConnected()) jshTransmitClearDevice(EV_USBSERIAL);
 #endif
+      }
+      if (wasConsoleLimbo && jsiGetConsoleDevice()!=EV_LIMBO) {
+        /* It was 'Limbo', but now it's not - see jsiOneSecondAfterStartup.
+        Basically we must have printed a bunch of stuff to LIMBO and blocked
+        with our output buffer full. But then jsiOneSecondAfterStartup
+        switches to the right console device and swaps everything we wrote
+        over to that device too. Only we're now here, still writing to the
+        old device when really we should be writing to the new one. */
+        device = jsiGetConsoleDevice();
+      }
+      jsiSetBusy(BUSY_TRANSMIT, false);
     }
-    if (wasConsoleLimbo && jsiGetConsoleDevice()!=EV_LIMBO) {
-      /* It was 'Limbo', but now it's not - see jsiOneSecondAfterStartup.
-      Basically we must have printed a bunch of stuff to LIMBO and blocked
-      with our output buffer full. But then jsiOneSecondAfterStartup
-      switches to the right console device and swaps everything we wrote
-      over to that device too. Only we're now here, still writing to the
-      old device when really we should be writing to the new one. */
-      device = jsiGetConsoleDevice();
-    }
-    jsiSetBusy(BUSY_TRANSMIT, false);
+    // Save the device and data for as many characters as will fit, then move the head on once
+    unsigned char head = txHead;
+    do {
+      txBuffer[head].flags = device;
+      txBuffer[head].data = (unsigned char)*(data++);
+      head = txHeadNext;
+      txHeadNext = (unsigned char)((head+1)&TXBUFFERMASK);
+    } while (--len && txHeadNext!=txTail);
+    txHead = head;
+
+    jshUSARTKick(device); // set up interrupts if required
   }
-  // Save the device and data for the new character to be transmitted.
-  txBuffer[txHead].flags = device;
-  txBuffer[txHead].data = data;
-  txHead = txHeadNext;
+}
 
-  jshUSARTKick(device); // set up interrupts if required
+/**
+ * Queue a character for transmission.
+ */
+void jshTransmit(
+    IOEventFlags device, //!< The device to be used for transmission.
+    unsigned char data   //!< The character to transmit.
+  ) {
+  jshTransmitBuf(device, (const char *)&data, 1);
 }
 
 static void jshTransmitPrintfCallback(const char *str, void *user_data) {
   IOEventFlags device = (IOEventFlags)user_data;
-  while (*str) jshTransmit(device, (unsigned char)*(str++));
+  jshTransmitBuf(device, str, strlen(str));
 }
 
 void jshTransmitPrintf(IOEventFlags device, const char *fmt, ...) {
@@ -323,6 +342,34 @@ int jshGetCharToTransmit(IOEventFlags device) {
   return -1; // no data :(
 }
 
+/**
+ * Get up to maxLen bytes for transmission on a device in one go, so drivers
+ * can write or DMA whole blocks rather than a character at a time.
+ * \return The number of bytes written into buf.
+ */
+unsigned int jshGetTransmitBlock(IOEventFlags device, unsigned char *buf, unsigned int maxLen) {
+  unsigned int len = 0;
+  while (len<maxLen) {
+    bool flowControlPending = DEVICE_HAS_DEVICE_STATE(device) &&
+        (jshSerialDeviceStates[TO_SERIAL_DEVICE_STATE(device)]&(SDS_XOFF_PENDING|SDS_XON_PENDING));
+    if (!flowControlPending && txHead!=txTail && IOEVENTFLAGS_GETTYPE(txBuffer[txTail].flags)==device) {
+      // Our data is at the back of the queue - copy the whole run of it and move the tail once
+      unsigned char tail = txTail;
+      do {
+        buf[len++] = txBuffer[tail].data;
+        tail = (unsigned char)((tail+1)&TXBUFFERMASK);
+      } while (len<maxLen && tail!=txHead && IOEVENTFLAGS_GETTYPE(txBuffer[tail].flags)==device);
+      txTail = tail;
+    } else {
+      // Flow control characters, or data queued behind another device's
+      int ch = jshGetCharToTransmit(device);
+      if (ch<0) break;
+      buf[len++] = (unsigned char)ch;
+    }
+  }
+  return len;
+}
+
 /// Wait for all data in the transmit queue to be written
 void jshTransmitFlush() {
   jsiSetBusy(BUSY_TRANSMIT, true);
@@ -216,6 +216,8 @@ JsVar *jshGetDeviceObject(IOEventFlags device);
 //                                                         DATA TRANSMIT BUFFER
 /// Queue a character for transmission
 void jshTransmit(IOEventFlags device, unsigned char data);
+/// Queue a block of data for transmission
+void jshTransmitBuf(IOEventFlags device, const char *data, size_t len);
 // Queue a formatted string for transmission
 void jshTransmitPrintf(IOEventFlags device, const char *fmt, ...);
 /// Wait for transmit to finish
@@ -232,6 +234,8 @@ bool jshHasTransmitData();
 IOEventFlags jshGetDeviceToTransmit();
 /// Try and get a character for transmission - could just return -1 if nothing
 int jshGetCharToTransmit(IOEventFlags device);
+/// Get up to maxLen bytes for transmission on a device into buf, returning the number of bytes
+unsigned int jshGetTransmitBlock(IOEventFlags device, unsigned char *buf, unsigned int maxLen);
 
 
 /// Set whether the host should transmit or not
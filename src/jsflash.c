@@ -139,6 +139,10 @@ static uint32_t jsfCreateFile(JsfFileName name, uint32_t size, JsfFileFlags flag
 #ifdef ESPR_STORAGE_FILENAME_TABLE
 static uint32_t jsfBankCreateFileTable(uint32_t startAddr);
 #endif
+static void jsfIndexInvalidate();
+static void jsfIndexAdd(JsfFileName *name, uint32_t addr);
+static void jsfIndexRemove(JsfFileName *name, uint32_t addr);
+static uint32_t jsfIndexFind(JsfFileName name, char drive, JsfFileHeader *returnedHeader);
 
 /// Aligns a block, pushing it along in memory until it reaches the required alignment
 static uint32_t jsfAlignAddress(uint32_t addr) {
@@ -268,6 +272,7 @@ static bool jsfIsEqual(uint32_t addr, const unsigned char *data, uint32_t len) {
 bool jsfEraseAll() {
   jsDebug(DBG_INFO,"EraseAll\n");
   jsfCacheClear();
+  jsfIndexInvalidate();
 #ifdef ESPR_STORAGE_FILENAME_TABLE
   jsfFilenameTableBank1Addr = 0;
   jsfFilenameTableBank1Size = 0;
@@ -281,6 +286,7 @@ bool jsfEraseAll() {
 /// When a file is found in memory, erase it (by setting first bytes of name to 0). addr=ptr to data, NOT header
 static void jsfEraseFileInternal(uint32_t addr, JsfFileHeader *header, bool createFilenameTable) {
   jsDebug(DBG_INFO,"EraseFile 0x%08x\n", addr);
+  jsfIndexRemove(&header->name, addr);
 
   addr -= (uint32_t)sizeof(JsfFileHeader);
   addr += (uint32_t)((char*)&header->name.firstChars - (char*)header);
@@ -391,6 +397,153 @@ static uint32_t jsfGetAddressOfNextStartPage(uint32_t addr) {
   return next;
 }
 
+#if ESPR_STORAGE_INDEX
+/* Searching for a file means walking every header in a bank, which gets slow once there
+are hundreds of files (even with the FILENAME_TABLE, as everything added after it still
+has to be scanned). Instead we can keep a hash index in RAM of the address of every file.
+
+Each entry is just the file's address and a hash of its name - when the hash matches we
+still read the header back from flash to check the name, so the index only needs
+ESPR_STORAGE_INDEX*8 bytes of RAM. The index is built with one scan of Storage when a
+file is first looked up, and then kept up to date when files are created or erased.
+Compaction moves files around, so that just throws the index away and it gets rebuilt
+the next time it's needed. If more than 3/4 of the entries would be used we give up and
+go back to scanning flash.
+
+To use this, add '-DESPR_STORAGE_INDEX=256' or some other power of 2 to the BOARD.py file
+*/
+#define JSF_INDEX_DELETED 0xFFFFFFFF // 'addr' for an entry that was removed (0 = unused)
+#define JSF_INDEX_MAX_USED ((ESPR_STORAGE_INDEX*3)/4)
+
+typedef struct {
+  uint32_t addr; ///< Address of the file data (as returned by jsfFindFile), 0 if unused or JSF_INDEX_DELETED
+  uint32_t hash; ///< Hash of the file's name
+} JsfIndexEntry;
+
+typedef enum {
+  JSFI_INVALID, ///< Index needs to be rebuilt from flash before use
+  JSFI_VALID,   ///< Index contains every file in Storage
+  JSFI_FULL,    ///< Too many files - don't use the index until Storage is compacted/erased
+} JsfIndexState;
+
+JsfIndexEntry jsfIndex[ESPR_STORAGE_INDEX];
+uint16_t jsfIndexUsed = 0; ///< Number of entries that are used or deleted
+JsfIndexState jsfIndexState = JSFI_INVALID;
+
+static uint32_t jsfIndexHash(JsfFileName *name) {
+  return jsHashString(name->c, sizeof(name->c));
+}
+
+/// Throw the index away - it'll be rebuilt the next time we look up a file
+static void jsfIndexInvalidate() {
+  jsfIndexState = JSFI_INVALID;
+}
+
+static void jsfIndexInsert(JsfFileName *name, uint32_t addr) {
+  if (jsfIndexUsed >= JSF_INDEX_MAX_USED) {
+    jsfIndexState = JSFI_FULL;
+    return;
+  }
+  uint32_t hash = jsfIndexHash(name);
+  unsigned int i = hash & (ESPR_STORAGE_INDEX-1);
+  while (jsfIndex[i].addr && jsfIndex[i].addr!=JSF_INDEX_DELETED)
+    i = (i+1) & (ESPR_STORAGE_INDEX-1);
+  if (!jsfIndex[i].addr) jsfIndexUsed++; // deleted entries are already counted
+  jsfIndex[i].addr = addr;
+  jsfIndex[i].hash = hash;
+}
+
+static void jsfIndexBuildBank(uint32_t addr) {
+  JsfFileHeader header;
+  if (jsfGetFileHeader(addr, &header, true)) do {
+    // FILENAME_TABLE is added too, as jsfBankCreateFileTable uses jsfFindFile to find the old one
+    if (header.name.firstChars != 0)
+      jsfIndexInsert(&header.name, addr+(uint32_t)sizeof(JsfFileHeader));
+  } while (jsfIndexState==JSFI_VALID && jsfGetNextFileHeader(&addr, &header, GNFH_GET_ALL));
+}
+
+/// Scan all of Storage and add every file that hasn't been erased to the index
+static void jsfIndexBuild() {
+  memset(jsfIndex, 0, sizeof(jsfIndex));
+  jsfIndexUsed = 0;
+  jsfIndexState = JSFI_VALID;
+  jsfIndexBuildBank(JSF_START_ADDRESS);
+#ifdef JSF_BANK2_START_ADDRESS
+  if (jsfIndexState==JSFI_VALID)
+    jsfIndexBuildBank(JSF_BANK2_START_ADDRESS);
+#endif
+  jsDebug(DBG_INFO,"jsfIndexBuild %d files\n", jsfIndexUsed);
+}
+
+/// Add a newly created file to the index
+static void jsfIndexAdd(JsfFileName *name, uint32_t addr) {
+  if (jsfIndexState!=JSFI_VALID) return;
+  if (jsfIndexUsed >= JSF_INDEX_MAX_USED) {
+    // too many deleted entries? rebuilding will clear them out (and pick up this file)
+    jsfIndexBuild();
+    return;
+  }
+  jsfIndexInsert(name, addr);
+}
+
+/// Remove a file that is being erased from the index
+static void jsfIndexRemove(JsfFileName *name, uint32_t addr) {
+  if (jsfIndexState!=JSFI_VALID) return;
+  unsigned int i = jsfIndexHash(name) & (ESPR_STORAGE_INDEX-1);
+  while (jsfIndex[i].addr) {
+    if (jsfIndex[i].addr==addr) {
+      jsfIndex[i].addr = JSF_INDEX_DELETED;
+      return;
+    }
+    i = (i+1) & (ESPR_STORAGE_INDEX-1);
+  }
+}
+
+/// When looking for a file, should we use the one at 'addr' rather than the one we 'found' already (or 0)?
+static bool jsfIndexIsBetterMatch(uint32_t addr, uint32_t found, char drive) {
+#ifdef JSF_BANK2_START_ADDRESS
+  bool inBank2 = jsfGetBankEndAddress(addr)==JSF_BANK2_END_ADDRESS;
+  if (drive) { // only look in the bank we were asked for (same as jsfGetDriveBankAddress)
+    if (inBank2 == ((drive&(~0x20)) == 'C')) return false;
+  } else if (found && inBank2!=(jsfGetBankEndAddress(found)==JSF_BANK2_END_ADDRESS))
+    return !inBank2; // files in bank 1 take priority
+#else
+  NOT_USED(drive);
+#endif
+  // If there are two files with the same name, pick the one a scan of flash would have found first
+  return !found || addr<found;
+}
+
+/** Find a file using the index. 'name' should have had any drive stripped off - if 'drive' is nonzero
+ * only that bank is searched. Returns JSF_CACHE_NOT_FOUND if the index can't be used, or 0 if the
+ * file definitely doesn't exist. */
+static uint32_t jsfIndexFind(JsfFileName name, char drive, JsfFileHeader *returnedHeader) {
+  if (jsfIndexState==JSFI_INVALID) jsfIndexBuild();
+  if (jsfIndexState!=JSFI_VALID) return JSF_CACHE_NOT_FOUND;
+  uint32_t hash = jsfIndexHash(&name);
+  uint32_t found = 0;
+  JsfFileHeader header;
+  unsigned int i = hash & (ESPR_STORAGE_INDEX-1);
+  while (jsfIndex[i].addr) {
+    uint32_t addr = jsfIndex[i].addr;
+    if (jsfIndex[i].hash==hash && addr!=JSF_INDEX_DELETED &&
+        jsfIndexIsBetterMatch(addr, found, drive) &&
+        jsfGetFileHeader(addr-(uint32_t)sizeof(JsfFileHeader), &header, true) &&
+        jsfIsNameEqual(header.name, name)) {
+      found = addr;
+      if (returnedHeader) *returnedHeader = header;
+    }
+    i = (i+1) & (ESPR_STORAGE_INDEX-1);
+  }
+  return found;
+}
+#else // no index, just stub with code that does nothing
+static void jsfIndexInvalidate() {}
+static void jsfIndexAdd(JsfFileName *name, uint32_t addr) {}
+static void jsfIndexRemove(JsfFileName *name, uint32_t addr) {}
+static uint32_t jsfIndexFind(JsfFileName name, char drive, JsfFileHeader *returnedHeader) { return JSF_CACHE_NOT_FOUND; }
+#endif
+
 /// Get info about the current filesystem
 JsfStorageStats jsfGetStorageStats(uint32_t addr, bool allPages) {
   if (!addr) addr=JSF_DEFAULT_START_ADDRESS;
@@ -637,6 +790,7 @@ bool jsfCompact(bool showMessage) {
   }
 #endif
   jsfCacheClear();
+  jsfIndexInvalidate(); // files will move
 #ifdef ESPR_STORAGE_FILENAME_TABLE
   jsfFilenameTableBank1Addr = 0;
   jsfFilenameTableBank1Size = 0;
@@ -749,6 +903,7 @@ static uint32_t jsfCreateFile(JsfFileName name, uint32_t size, JsfFileFlags flag
   if (returnedHeader) *returnedHeader = header;
   addr += (uint32_t)sizeof(JsfFileHeader); // address of actual file data
   jsfCachePut(&header, addr);
+  jsfIndexAdd(&header.name, addr);
   return addr;
 }
 
@@ -816,28 +971,28 @@ static uint32_t jsfBankFindFile(uint32_t bankAddress, uint32_t bankEndAddress, J
 
 /// Find a 'file' in the memory store. Return the address of data start (and header if returnedHeader!=0). Returns 0 if not found
 uint32_t jsfFindFile(JsfFileName name, JsfFileHeader *returnedHeader) {
-#ifdef JSF_BANK2_START_ADDRESS
-  char drive =
-#endif
-    jsfStripDriveFromName(&name, true/* ensure we search both drive if not explicitly requested */);
+  char drive = jsfStripDriveFromName(&name, true/* ensure we search both drive if not explicitly requested */);
   uint32_t a = jsfCacheFind(name, returnedHeader);
   if (a!=JSF_CACHE_NOT_FOUND) return a;
   JsfFileHeader header;
-
+  a = jsfIndexFind(name, drive, &header);
+  if (a==JSF_CACHE_NOT_FOUND) { // no index, so search through flash
 #ifdef JSF_BANK2_START_ADDRESS
-  if (drive) {
-    // if more banks defined search only in one determined from drive letter
-    uint32_t startAddress,endAddress;
-    jsfGetDriveBankAddress(drive,&startAddress,&endAddress);
-    a = jsfBankFindFile(startAddress, endAddress, name, &header);
-  } else {
-    // if no drive letter specified, search in both
-    a = jsfBankFindFile(JSF_START_ADDRESS, JSF_END_ADDRESS, name, &header);
-    if (!a) a = jsfBankFindFile(JSF_BANK2_START_ADDRESS, JSF_BANK2_END_ADDRESS, name, &header);
-  }
+    if (drive) {
+      // if more banks defined search only in one determined from drive letter
+      uint32_t startAddress,endAddress;
+      jsfGetDriveBankAddress(drive,&startAddress,&endAddress);
+      a = jsfBankFindFile(startAddress, endAddress, name, &header);
+    } else {
+      // if no drive letter specified, search in both
+      a = jsfBankFindFile(JSF_START_ADDRESS, JSF_END_ADDRESS, name, &header);
+      if (!a) a = jsfBankFindFile(JSF_BANK2_START_ADDRESS, JSF_BANK2_END_ADDRESS, name, &header);
+    }
 #else
-  a = jsfBankFindFile(JSF_START_ADDRESS, JSF_END_ADDRESS, name, &header);
+    NOT_USED(drive);
+    a = jsfBankFindFile(JSF_START_ADDRESS, JSF_END_ADDRESS, name, &header);
 #endif
+  }
   if (!a) header.name = name;
   jsfCachePut(&header, a); // we put the file in even if it's not found, as that's handy too
   if (returnedHeader) *returnedHeader = header;
@@ -1031,16 +1186,17 @@ JsVar* jsvAddressToVar(size_t addr, uint32_t length) {
   }
 #endif
 #ifdef LINUX
-  // linux fakes flash with a file, so we can't just return a pointer to it!
-  uint32_t alignedSize = jsfAlignAddress((uint32_t)length);
-  char *d = (char*)malloc(alignedSize);
-  jshFlashRead(d, (size_t)addr, alignedSize);
-  JsVar *v = jsvNewStringOfLength((uint32_t)length, d);
-  free(d);
-  return v;
-#else
-  return jsvNewNativeString((char*)mappedAddr, length);
+  if (!mappedAddr) {
+    // linux fakes flash with a file - if it couldn't be memory-mapped we can't just return a pointer to it!
+    uint32_t alignedSize = jsfAlignAddress((uint32_t)length);
+    char *d = (char*)malloc(alignedSize);
+    jshFlashRead(d, (size_t)addr, alignedSize);
+    JsVar *v = jsvNewStringOfLength((uint32_t)length, d);
+    free(d);
+    return v;
+  }
 #endif
+  return jsvNewNativeString((char*)mappedAddr, length);
 }
 
 bool jsfWriteFile(JsfFileName name, JsVar *data, JsfFileFlags flags, JsVarInt offset, JsVarInt _size) {
@@ -25,6 +25,9 @@
 
 #ifdef LINUX // for testing...
 #define ESPR_STORAGE_FILENAME_TABLE
+#ifndef ESPR_STORAGE_INDEX
+#define ESPR_STORAGE_INDEX 1024 // RAM index of filenames (must be a power of 2) - see jsflash.c
+#endif
 #endif
 
 
@@ -28,6 +28,9 @@
 
 #ifdef LINUX
 #include <inttypes.h>
+#if defined(__linux__) && !defined(LINUX_NO_EPOLL)
+#define LINUX_USE_EPOLL // jshSleep blocks with epoll until something happens, rather than polling
+#endif
 #endif
 
 
@@ -60,6 +63,21 @@ bool jshSleep(JsSysTime timeUntilWake);
  * where GPIO that have been exported may need unexporting, and so on. */
 void jshKill();
 
+#ifdef LINUX_USE_EPOLL
+/// Make jshSleep wake up when the given file descriptor (eg. a socket) has data, or stop doing so
+void jshLinuxWatchFd(int fd, bool watch);
+/// Are any file descriptors being watched with jshLinuxWatchFd?
+bool jshLinuxHasWatchedFds();
+/** If no timers are due and no sockets are open, should jshSleep wait for input forever? This
+ * is only set at the interactive console - scripts exit once there's nothing left to do */
+extern bool jshLinuxSleepUntilInput;
+#endif
+#if defined(LINUX) && !defined(__MINGW32__)
+/** If set, jshFlashGetMemMapAddress returns 0 like it does on boards without memory-mapped flash,
+ * so the tests can cover Storage's copying/Flash String path. Defaults to set if LINUX_FLASH_NO_MEMMAP */
+extern bool jshLinuxFlashNoMemMap;
+#endif
+
 /** Get this IC's serial number. Passed max # of chars and a pointer to write to.
  * Returns # of chars of non-null-terminated string.
  *
@@ -371,7 +389,7 @@ void jshResetRTCTimer();
 void jshClearUSBIdleTimeout();
 #endif
 
-#if defined(NRF51_SERIES) || defined(NRF52_SERIES)
+#if defined(NRF51_SERIES) || defined(NRF52_SERIES) || defined(LINUX_USE_EPOLL)
 /// Called when we have had an event that means we should execute JS
 extern void jshHadEvent();
 #else
@@ -272,8 +272,14 @@ NO_INLINE void jsiConsolePrintChar(char data) {
  */
 NO_INLINE void jsiConsolePrintString(const char *str) {
   while (*str) {
-    if (*str == '\n') jsiConsolePrintChar('\r');
-    jsiConsolePrintChar(*(str++));
+    // send everything up to the next newline in one go
+    const char *start = str;
+    while (*str && *str != '\n') str++;
+    jshTransmitBuf(consoleDevice, start, (size_t)(str-start));
+    if (*str == '\n') {
+      jshTransmitBuf(consoleDevice, "\r\n", 2);
+      str++;
+    }
   }
 }
 
@@ -337,15 +343,22 @@ void jsiConsolePrintStringVarUntilEOL(JsVar *v, size_t fromCharacter, size_t max
 /** Print the contents of a string var - directly - starting from the given character, and
  * using newLineCh to prefix new lines (if it is not 0). */
 void jsiConsolePrintStringVarWithNewLineChar(JsVar *v, size_t fromCharacter, char newLineCh) {
+  char buf[32]; // batch up characters so we can send them as a block
+  size_t len = 0;
   JsvStringIterator it;
   jsvStringIteratorNew(&it, v, fromCharacter);
   while (jsvStringIteratorHasChar(&it)) {
+    if (len+3 > sizeof(buf)) { // a newline could add 3 characters
+      jshTransmitBuf(consoleDevice, buf, len);
+      len = 0;
+    }
     char ch = jsvStringIteratorGetCharAndNext(&it);
-    if (ch == '\n') jsiConsolePrintChar('\r');
-    jsiConsolePrintChar(ch);
-    if (ch == '\n' && newLineCh) jsiConsolePrintChar(newLineCh);
+    if (ch == '\n') buf[len++] = '\r';
+    buf[len++] = ch;
+    if (ch == '\n' && newLineCh) buf[len++] = newLineCh;
   }
   jsvStringIteratorFree(&it);
+  jshTransmitBuf(consoleDevice, buf, len);
 }
 
 /**
@@ -478,6 +491,312 @@ void jsiSetSleep(JsiSleepType isSleep) {
 #endif
 }
 
+/* Timers in timerArray are keyed by the ID returned from setTimeout, and their
+ * 'time' is the absolute system time at which they should next run. To avoid
+ * scanning every timer on each idle pass we also keep a binary min-heap of
+ * {time,id} in a flat string. When a timer is cleared or rescheduled we don't
+ * remove its old entry - instead entries are checked against timerArray as
+ * they reach the top, and ignored if they're stale. The heap is rebuilt from
+ * timerArray when it fills up, or after jsiTimersChanged is called. If there
+ * isn't enough memory for it we just scan timerArray instead.
+ *
+ * After the heap entries, the same flat string holds an open-addressed hash
+ * table of refs to the timers' names in timerArray, so we can go from an ID to
+ * its timer (when it's due, or for clearTimeout/changeInterval) and from a
+ * timer to its ID (jsiTimerSetTime) without searching timerArray. Each name is
+ * in the table twice - hashed by its ID and by the timer it points to. Entries
+ * are checked against the name they point to, and the table is rebuilt along
+ * with the heap (and after a defrag, which moves names). */
+#ifndef ESPR_NO_TIMER_HEAP
+typedef struct {
+  JsSysTime time;
+  JsVarInt id;
+} JsiTimerHeapEntry;
+
+static JsVarRef timerHeap = 0; ///< Flat string of JsiTimerHeapEntry, then the map of timers (or 0)
+static unsigned int timerHeapCount = 0; ///< How many entries of timerHeap are used
+static unsigned int timerHeapCapacity = 0; ///< How many entries timerHeap has space for
+static unsigned int timerMapSize = 0; ///< How many JsVarRefs the map after the heap entries has (a power of 2)
+static unsigned int timerMapUsed = 0; ///< How many of the map's slots aren't empty (including removed ones)
+
+#define JSI_TIMER_MAP_REMOVED ((JsVarRef)~(JsVarRef)0)
+
+// Flat string data isn't always aligned, so copy entries in and out
+static void jsiTimerHeapGet(const char *heap, unsigned int i, JsiTimerHeapEntry *e) {
+  memcpy(e, &heap[i*sizeof(JsiTimerHeapEntry)], sizeof(JsiTimerHeapEntry));
+}
+static void jsiTimerHeapSet(char *heap, unsigned int i, const JsiTimerHeapEntry *e) {
+  memcpy(&heap[i*sizeof(JsiTimerHeapEntry)], e, sizeof(JsiTimerHeapEntry));
+}
+/// Timers due at the same time run in the order they were added
+static bool jsiTimerHeapLess(const JsiTimerHeapEntry *a, const JsiTimerHeapEntry *b) {
+  return a->time < b->time || (a->time == b->time && a->id < b->id);
+}
+
+static void jsiTimerHeapSiftDown(char *heap, unsigned int i) {
+  JsiTimerHeapEntry e, child, other;
+  jsiTimerHeapGet(heap, i, &e);
+  while (i*2+1 < timerHeapCount) {
+    unsigned int c = i*2+1;
+    jsiTimerHeapGet(heap, c, &child);
+    if (c+1 < timerHeapCount) {
+      jsiTimerHeapGet(heap, c+1, &other);
+      if (jsiTimerHeapLess(&other, &child)) {
+        c++;
+        child = other;
+      }
+    }
+    if (!jsiTimerHeapLess(&child, &e)) break;
+    jsiTimerHeapSet(heap, i, &child);
+    i = c;
+  }
+  jsiTimerHeapSet(heap, i, &e);
+}
+
+// The map's slots aren't always aligned either
+static JsVarRef jsiTimerMapGetSlot(const char *map, unsigned int slot) {
+  JsVarRef ref;
+  memcpy(&ref, &map[slot*sizeof(JsVarRef)], sizeof(JsVarRef));
+  return ref;
+}
+static void jsiTimerMapSetSlot(char *map, unsigned int slot, JsVarRef ref) {
+  memcpy(&map[slot*sizeof(JsVarRef)], &ref, sizeof(JsVarRef));
+}
+/// Get the map, which follows the heap entries in timerHeap
+static char *jsiTimerMapGet(JsVar *heapVar) {
+  return &jsvGetFlatStringPointer(heapVar)[timerHeapCapacity*sizeof(JsiTimerHeapEntry)];
+}
+/// The first slot to look in for a timer ID, or (if isTimer) the ref of a timer
+static unsigned int jsiTimerMapHash(JsVarInt key, bool isTimer) {
+  return (unsigned int)((uint32_t)key * (isTimer ? 2246822519u : 2654435761u)) & (timerMapSize-1);
+}
+
+static void jsiTimerMapAdd(char *map, unsigned int slot, JsVarRef timerNameRef) {
+  JsVarRef ref;
+  while ((ref = jsiTimerMapGetSlot(map, slot)) && ref!=JSI_TIMER_MAP_REMOVED)
+    slot = (slot+1) & (timerMapSize-1);
+  if (!ref) timerMapUsed++;
+  jsiTimerMapSetSlot(map, slot, timerNameRef);
+}
+static void jsiTimerMapRemove(char *map, unsigned int slot, JsVarRef timerNameRef) {
+  JsVarRef ref;
+  while ((ref = jsiTimerMapGetSlot(map, slot))) {
+    if (ref==timerNameRef) {
+      jsiTimerMapSetSlot(map, slot, JSI_TIMER_MAP_REMOVED);
+      return;
+    }
+    slot = (slot+1) & (timerMapSize-1);
+  }
+}
+/// Add a timer's name in timerArray to the map, by both its ID and its timer
+static void jsiTimerMapAddName(char *map, JsVar *timerName) {
+  JsVarRef timerNameRef = jsvGetRef(timerName);
+  jsiTimerMapAdd(map, jsiTimerMapHash(timerName->varData.integer, false), timerNameRef);
+  jsiTimerMapAdd(map, jsiTimerMapHash((JsVarInt)jsvGetFirstChild(timerName), true), timerNameRef);
+}
+
+static void jsiTimerHeapFree() {
+  if (!timerHeap) return;
+  jsvObjectRemoveChild(execInfo.hiddenRoot, JSI_TIMER_HEAP_NAME);
+  jsvUnRefRef(timerHeap);
+  timerHeap = 0;
+  timerHeapCount = 0;
+  timerHeapCapacity = 0;
+  timerMapSize = 0;
+  timerMapUsed = 0;
+}
+
+/// Rebuild the timer heap and map from timerArray, resizing them if needed
+static void jsiTimerHeapRebuild(JsVar *timerArrayPtr) {
+  unsigned int timerCount = (unsigned int)jsvGetChildren(timerArrayPtr);
+  unsigned int capacity = timerHeapCapacity;
+  /* Leave space for at least timerCount/2 more entries so we're not
+   * rebuilding all the time, but don't hang on to lots of unused memory */
+  if (!timerCount || capacity < timerCount+timerCount/2+4 || capacity > timerCount*4+32) {
+    jsiTimerHeapFree();
+    if (!timerCount) return;
+    capacity = timerCount*2+8;
+    // Each timer is in the map twice, so this keeps it at most half full
+    unsigned int mapSize = 16;
+    while (mapSize < capacity*4) mapSize <<= 1;
+    JsVar *heapVar = jsvNewFlatStringOfLength(capacity*(unsigned int)sizeof(JsiTimerHeapEntry) + mapSize*(unsigned int)sizeof(JsVarRef));
+    if (!heapVar) return; // not enough memory - we'll just scan timerArray
+    jsvObjectSetChild(execInfo.hiddenRoot, JSI_TIMER_HEAP_NAME, heapVar);
+    timerHeap = jsvGetRef(jsvRef(heapVar));
+    timerHeapCapacity = capacity;
+    timerMapSize = mapSize;
+    jsvUnLock(heapVar);
+  }
+  JsVar *heapVar = jsvLock(timerHeap);
+  char *heap = jsvGetFlatStringPointer(heapVar);
+  char *map = jsiTimerMapGet(heapVar);
+  memset(map, 0, timerMapSize*sizeof(JsVarRef));
+  timerMapUsed = 0;
+  timerHeapCount = 0;
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, timerArrayPtr);
+  while (jsvObjectIteratorHasValue(&it) && timerHeapCount<capacity) {
+    JsVar *timerName = jsvObjectIteratorGetKey(&it);
+    JsVar *timerPtr = jsvObjectIteratorGetValue(&it);
+    JsiTimerHeapEntry e;
+    e.id = jsvGetInteger(timerName);
+    e.time = (JsSysTime)jsvGetLongIntegerAndUnLock(jsvObjectGetChildIfExists(timerPtr, "time"));
+    jsiTimerHeapSet(heap, timerHeapCount++, &e);
+    jsiTimerMapAddName(map, timerName);
+    jsvUnLock2(timerPtr, timerName);
+    jsvObjectIteratorNext(&it);
+  }
+  jsvObjectIteratorFree(&it);
+  for (unsigned int i=timerHeapCount/2;i-->0;)
+    jsiTimerHeapSiftDown(heap, i);
+  jsvUnLock(heapVar);
+}
+#endif
+
+/// The timer with the given ID will next run at 'time' - add it to the heap
+static void jsiTimerHeapPush(JsSysTime time, JsVarInt id) {
+#ifndef ESPR_NO_TIMER_HEAP
+  if (jsiStatus & JSIS_TIMERS_CHANGED) return; // we'll rebuild the heap anyway
+  if (!timerHeap) {
+    jsiTimersChanged(); // allocate one
+    return;
+  }
+  if (timerHeapCount >= timerHeapCapacity) {
+    jsiTimersChanged(); // full - rebuild (which also removes stale entries)
+    return;
+  }
+  JsVar *heapVar = jsvLock(timerHeap);
+  char *heap = jsvGetFlatStringPointer(heapVar);
+  JsiTimerHeapEntry e, parent;
+  e.time = time;
+  e.id = id;
+  unsigned int i = timerHeapCount++;
+  while (i>0) {
+    jsiTimerHeapGet(heap, (i-1)/2, &parent);
+    if (!jsiTimerHeapLess(&e, &parent)) break;
+    jsiTimerHeapSet(heap, i, &parent);
+    i = (i-1)/2;
+  }
+  jsiTimerHeapSet(heap, i, &e);
+  jsvUnLock(heapVar);
+#else
+  NOT_USED(time);
+  NOT_USED(id);
+#endif
+}
+
+/// Remove the entry returned by jsiTimerGetNext from the heap
+static void jsiTimerHeapPop() {
+#ifndef ESPR_NO_TIMER_HEAP
+  if (!timerHeap || !timerHeapCount) return;
+  JsVar *heapVar = jsvLock(timerHeap);
+  char *heap = jsvGetFlatStringPointer(heapVar);
+  JsiTimerHeapEntry e;
+  jsiTimerHeapGet(heap, --timerHeapCount, &e);
+  if (timerHeapCount) {
+    jsiTimerHeapSet(heap, 0, &e);
+    jsiTimerHeapSiftDown(heap, 0);
+  }
+  jsvUnLock(heapVar);
+#endif
+}
+
+/// If jsiTimersChanged was called, rebuild the heap and map
+static void jsiTimersRebuildIfChanged(JsVar *timerArrayPtr) {
+  if (jsiStatus & JSIS_TIMERS_CHANGED) {
+    jsiStatus &= (JsiStatus)~JSIS_TIMERS_CHANGED;
+#ifndef ESPR_NO_TIMER_HEAP
+    jsiTimerHeapRebuild(timerArrayPtr);
+#else
+    NOT_USED(timerArrayPtr);
+#endif
+  }
+}
+
+/** Find the name in timerArray of the timer with the given ID - or if timerPtr
+ * is set, of that timer. Returns a locked name, or 0 if there isn't one */
+static JsVar *jsiTimerFind(JsVar *timerArrayPtr, JsVarInt id, JsVar *timerPtr) {
+  jsiTimersRebuildIfChanged(timerArrayPtr);
+#ifndef ESPR_NO_TIMER_HEAP
+  if (timerHeap) {
+    JsVarRef timerRef = timerPtr ? jsvGetRef(timerPtr) : 0;
+    unsigned int slot = timerPtr ? jsiTimerMapHash((JsVarInt)timerRef, true) : jsiTimerMapHash(id, false);
+    JsVar *heapVar = jsvLock(timerHeap);
+    char *map = jsiTimerMapGet(heapVar);
+    JsVar *timerName = 0;
+    JsVarRef ref;
+    while (!timerName && (ref = jsiTimerMapGetSlot(map, slot))) {
+      if (ref!=JSI_TIMER_MAP_REMOVED) {
+        timerName = jsvLock(ref);
+        // timers are objects, so their names are always plain JSV_NAME_INT
+        if ((timerName->flags&JSV_VARTYPEMASK)!=JSV_NAME_INT ||
+            (timerPtr ? jsvGetFirstChild(timerName)!=timerRef : timerName->varData.integer!=id)) {
+          jsvUnLock(timerName);
+          timerName = 0;
+        }
+      }
+      slot = (slot+1) & (timerMapSize-1);
+    }
+    jsvUnLock(heapVar);
+    return timerName;
+  }
+#endif
+  return timerPtr ? jsvGetIndexOf(timerArrayPtr, timerPtr, true) : jsvGetArrayIndex(timerArrayPtr, id);
+}
+
+/** Get the time and ID of the timer that should run next. Returns false if
+ * there are no timers. The entry may be stale, so check it against timerArray */
+static bool jsiTimerGetNext(JsVar *timerArrayPtr, JsSysTime *time, JsVarInt *id) {
+  jsiTimersRebuildIfChanged(timerArrayPtr);
+#ifndef ESPR_NO_TIMER_HEAP
+  if (timerHeap) {
+    if (!timerHeapCount) return false;
+    JsVar *heapVar = jsvLock(timerHeap);
+    JsiTimerHeapEntry e;
+    jsiTimerHeapGet(jsvGetFlatStringPointer(heapVar), 0, &e);
+    jsvUnLock(heapVar);
+    *time = e.time;
+    *id = e.id;
+    return true;
+  }
+#endif
+  // No heap - just search for the earliest timer
+  bool found = false;
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, timerArrayPtr);
+  while (jsvObjectIteratorHasValue(&it)) {
+    JsVar *timerPtr = jsvObjectIteratorGetValue(&it);
+    JsSysTime timerTime = (JsSysTime)jsvGetLongIntegerAndUnLock(jsvObjectGetChildIfExists(timerPtr, "time"));
+    jsvUnLock(timerPtr);
+    if (!found || timerTime < *time) {
+      found = true;
+      *time = timerTime;
+      *id = jsvGetIntegerAndUnLock(jsvObjectIteratorGetKey(&it));
+    }
+    jsvObjectIteratorNext(&it);
+  }
+  jsvObjectIteratorFree(&it);
+  return found;
+}
+
+/// Add 'diff' to the time of every timer (eg. if the system time was changed)
+void jsiTimersAddTime(JsSysTime diff) {
+  if (!timerArray) return;
+  JsVar *timerArrayPtr = jsvLock(timerArray);
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, timerArrayPtr);
+  while (jsvObjectIteratorHasValue(&it)) {
+    JsVar *timerPtr = jsvObjectIteratorGetValue(&it);
+    JsSysTime timerTime = (JsSysTime)jsvGetLongIntegerAndUnLock(jsvObjectGetChildIfExists(timerPtr, "time"));
+    jsvObjectSetChildAndUnLock(timerPtr, "time", jsvNewFromLongInteger(timerTime + diff));
+    jsvUnLock(timerPtr);
+    jsvObjectIteratorNext(&it);
+  }
+  jsvObjectIteratorFree(&it);
+  jsvUnLock(timerArrayPtr);
+  jsiTimersChanged();
+}
+
 static JsVarRef _jsiInitNamedArray(const char *name) {
   JsVar *array = jsvObjectGetChild(execInfo.hiddenRoot, name, JSV_ARRAY);
   JsVarRef arrayRef = 0;
@@ -511,6 +830,16 @@ void jsiSoftInit(bool hasBeenReset) {
   // Make sure we set up lastIdleTime, as this could be used
   // when adding an interval from onInit (called below)
   jsiLastIdleTime = jshGetSystemTime();
+  // Timers are saved with times relative to jsiLastIdleTime, so make them absolute again
+  if (timerArray) {
+    jsiTimersAddTime(jsiLastIdleTime);
+    jsiStatus &= (JsiStatus)~JSIS_TIMERS_CHANGED;
+#ifndef ESPR_NO_TIMER_HEAP
+    JsVar *timerArrayPtr = jsvLock(timerArray);
+    jsiTimerHeapRebuild(timerArrayPtr);
+    jsvUnLock(timerArrayPtr);
+#endif
+  }
 #ifndef EMBEDDED
   jsiTimeSinceCtrlC = 0xFFFFFFFF;
 #endif
@@ -552,9 +881,6 @@ void jsiSoftInit(bool hasBeenReset) {
     jsvUnLock(watchArrayPtr);
   }
 
-  // Timers are stored by time in the future now, so no need
-  // to fiddle with them.
-
   // Execute `init` events on `E`
   jsiExecuteEventCallbackOn("E", INIT_CALLBACK_NAME, 0, 0);
   // Execute the `onInit` function
@@ -791,6 +1117,11 @@ void jsiSoftKill() {
     events=0;
   }
   if (timerArray) {
+    // Make timer times relative to jsiLastIdleTime again so they still work after a save/load
+    jsiTimersAddTime(-jsiLastIdleTime);
+#ifndef ESPR_NO_TIMER_HEAP
+    jsiTimerHeapFree();
+#endif
     jsvUnRefRef(timerArray);
     timerArray=0;
   }
@@ -2224,8 +2555,8 @@ void jsiIdle() {
             bool oldWatchState = jsvObjectGetBoolChild(watchPtr, "state");
             JsVar *timeout = jsvObjectGetChildIfExists(watchPtr, "timeout");
             if (timeout) { // if we had a timeout, update the callback time
-              JsSysTime timeoutTime = jsiLastIdleTime + (JsSysTime)jsvGetLongIntegerAndUnLock(jsvObjectGetChildIfExists(timeout, "time"));
-              jsvUnLock(jsvObjectSetChild(timeout, "time", jsvNewFromLongInteger((JsSysTime)(eventTime - jsiLastIdleTime) + debounce)));
+              JsSysTime timeoutTime = (JsSysTime)jsvGetLongIntegerAndUnLock(jsvObjectGetChildIfExists(timeout, "time"));
+              jsiTimerSetTime(timeout, eventTime + debounce);
               jsvObjectSetChildAndUnLock(timeout, "state", jsvNewFromBool(pinIsHigh));
               if (ignoreEvent || ((eventTime > timeoutTime) && (pinIsHigh!=oldWatchState))) {
                 // timeout should have fired, but we didn't get around to executing it!
@@ -2241,7 +2572,7 @@ void jsiIdle() {
               timeout = jsvNewObject();
               if (timeout) {
                 jsvObjectSetChild(timeout, "watch", watchPtr); // no unlock
-                jsvObjectSetChildAndUnLock(timeout, "time", jsvNewFromLongInteger((JsSysTime)(eventTime - jsiLastIdleTime) + debounce));
+                jsvObjectSetChildAndUnLock(timeout, "time", jsvNewFromLongInteger(eventTime + debounce));
                 jsvObjectSetChildAndUnLock(timeout, "cb", jsvObjectGetChildIfExists(watchPtr, "cb"));
                 jsvObjectSetChildAndUnLock(timeout, "lastTime", jsvObjectGetChildIfExists(watchPtr, "lastTime"));
                 jsvObjectSetChildAndUnLock(timeout, "pin", jsvNewFromPin(pin));
@@ -2321,132 +2652,119 @@ void jsiIdle() {
 #endif
 
   JsVar *timerArrayPtr = jsvLock(timerArray);
-  JsvObjectIterator it;
-  // Go through all intervals and decrement time
-  jsvObjectIteratorNew(&it, timerArrayPtr);
-  while (jsvObjectIteratorHasValue(&it)) {
-    JsVar *timerPtr = jsvObjectIteratorGetValue(&it);
-    JsSysTime timerTime = (JsSysTime)jsvGetLongIntegerAndUnLock(jsvObjectGetChildIfExists(timerPtr, "time"));
-    JsSysTime timeUntilNext = timerTime - timePassed;
-    jsvObjectSetChildAndUnLock(timerPtr, "time", jsvNewFromLongInteger(timeUntilNext));
-    jsvUnLock(timerPtr);
-    jsvObjectIteratorNext(&it);
-  }
-  jsvObjectIteratorFree(&it);
-  // Now go through intervals and execute if needed
-  do {
-    jsiStatus = jsiStatus & ~JSIS_TIMERS_CHANGED;
-    jsvObjectIteratorNew(&it, timerArrayPtr);
-    while (jsvObjectIteratorHasValue(&it) && !(jsiStatus & JSIS_TIMERS_CHANGED)) {
-      bool hasDeletedTimer = false;
-      JsVar *timerPtr = jsvObjectIteratorGetValue(&it);
-      JsSysTime timerTime = (JsSysTime)jsvGetLongIntegerAndUnLock(jsvObjectGetChildIfExists(timerPtr, "time"));
-      if (timerTime<=0) {
-        // we're now doing work
-        jsiSetBusy(BUSY_INTERACTIVE, true);
-        wasBusy = true;
-        JsVar *timerCallback = jsvObjectGetChildIfExists(timerPtr, "cb");
-        JsVar *watchPtr = jsvObjectGetChildIfExists(timerPtr, "watch"); // for debounce - may be undefined
-        bool exec = true;
-        JsVar *data = 0;
-        if (watchPtr) {
-          bool watchState = jsvObjectGetBoolChild(watchPtr, "state");
-          bool timerState = jsvObjectGetBoolChild(timerPtr, "state");
-          jsvObjectSetChildAndUnLock(watchPtr, "state", jsvNewFromBool(timerState));
-          exec = false;
-          if (watchState!=timerState) {
-            // Create the 'time' variable that will be passed to the user and stored as last time
-            JsVarInt delay = jsvObjectGetIntegerChild(watchPtr, "debounce");
-            JsVar *timePtr = jsvNewFromFloat(jshGetMillisecondsFromTime(jsiLastIdleTime+timerTime-delay)/1000);
-            // If it's the right edge...
-            if (jsiShouldExecuteWatch(watchPtr, timerState)) {
-              data = jsvNewObject();
-              // if we were from a watch then we were delayed by the debounce time...
-              if (data) {
-                exec = true;
-                // if it was a watch, set the last state up
-                jsvObjectSetChildAndUnLock(data, "state", jsvNewFromBool(timerState));
-                // set up the lastTime variable of data to what was in the watch
-                jsvObjectSetChildAndUnLock(data, "lastTime", jsvObjectGetChildIfExists(watchPtr, "lastTime"));
-                // set up the watches lastTime to this one
-                jsvObjectSetChild(data, "time", timePtr); // don't unlock - use this later
-                jsvObjectSetChildAndUnLock(data, "pin", jsvObjectGetChildIfExists(watchPtr, "pin"));
-              }
-            }
-            // Update lastTime regardless of which edge we're watching
-            jsvObjectSetChildAndUnLock(watchPtr, "lastTime", timePtr);
-          }
-        }
-        bool removeTimer = false;
-        if (exec) {
-          bool execResult;
+  JsSysTime timerTime;
+  JsVarInt timerId;
+  // Execute any timers that are due, earliest first
+  while (jsiTimerGetNext(timerArrayPtr, &timerTime, &timerId) && timerTime<=time) {
+    jsiTimerHeapPop();
+    JsVar *timerPtr = jsvSkipNameAndUnLock(jsiTimerFind(timerArrayPtr, timerId, 0));
+    // Skip stale heap entries - the timer may have been removed or rescheduled
+    if (!timerPtr || (JsSysTime)jsvGetLongIntegerAndUnLock(jsvObjectGetChildIfExists(timerPtr, "time"))!=timerTime) {
+      jsvUnLock(timerPtr);
+      continue;
+    }
+    // we're now doing work
+    jsiSetBusy(BUSY_INTERACTIVE, true);
+    wasBusy = true;
+    JsVar *timerCallback = jsvObjectGetChildIfExists(timerPtr, "cb");
+    JsVar *watchPtr = jsvObjectGetChildIfExists(timerPtr, "watch"); // for debounce - may be undefined
+    bool exec = true;
+    JsVar *data = 0;
+    if (watchPtr) {
+      bool watchState = jsvObjectGetBoolChild(watchPtr, "state");
+      bool timerState = jsvObjectGetBoolChild(timerPtr, "state");
+      jsvObjectSetChildAndUnLock(watchPtr, "state", jsvNewFromBool(timerState));
+      exec = false;
+      if (watchState!=timerState) {
+        // Create the 'time' variable that will be passed to the user and stored as last time
+        JsVarInt delay = jsvObjectGetIntegerChild(watchPtr, "debounce");
+        JsVar *timePtr = jsvNewFromFloat(jshGetMillisecondsFromTime(timerTime-delay)/1000);
+        // If it's the right edge...
+        if (jsiShouldExecuteWatch(watchPtr, timerState)) {
+          data = jsvNewObject();
+          // if we were from a watch then we were delayed by the debounce time...
           if (data) {
-            execResult = jsiExecuteEventCallback(0, timerCallback, 1, &data);
-          } else {
-            JsVar *argsArray = jsvObjectGetChildIfExists(timerPtr, "args");
-            execResult = jsiExecuteEventCallbackArgsArray(0, timerCallback, argsArray);
-            jsvUnLock(argsArray);
-          }
-          if (!execResult) {
-            JsVar *interval = jsvObjectGetChildIfExists(timerPtr, "intr");
-            if (interval) { // if interval then it's setInterval not setTimeout
-              jsvUnLock(interval);
-              jsError("Ctrl-C while processing interval - removing it.");
-              jsErrorFlags |= JSERR_CALLBACK;
-              removeTimer = true;
-            }
-          }
-        }
-        jsvUnLock(data);
-        if (watchPtr) { // if we had a watch pointer, be sure to remove us from it
-          jsvObjectRemoveChild(watchPtr, "timeout");
-          // Deal with non-recurring watches
-          if (exec) {
-            bool watchRecurring = jsvObjectGetBoolChild(watchPtr,  "recur");
-            if (!watchRecurring) {
-              JsVar *watchArrayPtr = jsvLock(watchArray);
-              JsVar *watchNamePtr = jsvGetIndexOf(watchArrayPtr, watchPtr, true);
-              if (watchNamePtr) {
-                jsvRemoveChildAndUnLock(watchArrayPtr, watchNamePtr);
-              }
-              jsvUnLock(watchArrayPtr);
-              Pin pin = jshGetPinFromVarAndUnLock(jsvObjectGetChildIfExists(watchPtr, "pin"));
-              if (!jsiIsWatchingPin(pin))
-                jshPinWatch(pin, false, JSPW_NONE);
-            }
+            exec = true;
+            // if it was a watch, set the last state up
+            jsvObjectSetChildAndUnLock(data, "state", jsvNewFromBool(timerState));
+            // set up the lastTime variable of data to what was in the watch
+            jsvObjectSetChildAndUnLock(data, "lastTime", jsvObjectGetChildIfExists(watchPtr, "lastTime"));
+            // set up the watches lastTime to this one
+            jsvObjectSetChild(data, "time", timePtr); // don't unlock - use this later
+            jsvObjectSetChildAndUnLock(data, "pin", jsvObjectGetChildIfExists(watchPtr, "pin"));
           }
-          jsvUnLock(watchPtr);
         }
-        // Load interval *after* executing code, in case it has changed
+        // Update lastTime regardless of which edge we're watching
+        jsvObjectSetChildAndUnLock(watchPtr, "lastTime", timePtr);
+      }
+    }
+    bool removeTimer = false, runningBehind = false;
+    if (exec) {
+      bool execResult;
+      if (data) {
+        execResult = jsiExecuteEventCallback(0, timerCallback, 1, &data);
+      } else {
+        JsVar *argsArray = jsvObjectGetChildIfExists(timerPtr, "args");
+        execResult = jsiExecuteEventCallbackArgsArray(0, timerCallback, argsArray);
+        jsvUnLock(argsArray);
+      }
+      if (!execResult) {
         JsVar *interval = jsvObjectGetChildIfExists(timerPtr, "intr");
-        if (!removeTimer && interval) {
-          timerTime = timerTime + jsvGetLongInteger(interval);
-          jsvObjectSetChildAndUnLock(timerPtr, "time", jsvNewFromLongInteger(timerTime));
-        } else {
-          // free
-          // Beware... may have already been removed!
-          jsvObjectIteratorRemoveAndGotoNext(&it, timerArrayPtr);
-          hasDeletedTimer = true;
-          timerTime = -1;
+        if (interval) { // if interval then it's setInterval not setTimeout
+          jsvUnLock(interval);
+          jsError("Ctrl-C while processing interval - removing it.");
+          jsErrorFlags |= JSERR_CALLBACK;
+          removeTimer = true;
         }
-        jsvUnLock2(timerCallback,interval);
       }
-      // update the time until the next timer
-      if (timerTime>=0 && timerTime < minTimeUntilNext)
-        minTimeUntilNext = timerTime;
-      // update the timer's time
-      if (!hasDeletedTimer)
-        jsvObjectIteratorNext(&it);
-      jsvUnLock(timerPtr);
     }
-    jsvObjectIteratorFree(&it);
-  } while (jsiStatus & JSIS_TIMERS_CHANGED);
+    jsvUnLock(data);
+    if (watchPtr) { // if we had a watch pointer, be sure to remove us from it
+      jsvObjectRemoveChild(watchPtr, "timeout");
+      // Deal with non-recurring watches
+      if (exec) {
+        bool watchRecurring = jsvObjectGetBoolChild(watchPtr,  "recur");
+        if (!watchRecurring) {
+          JsVar *watchArrayPtr = jsvLock(watchArray);
+          JsVar *watchNamePtr = jsvGetIndexOf(watchArrayPtr, watchPtr, true);
+          if (watchNamePtr) {
+            jsvRemoveChildAndUnLock(watchArrayPtr, watchNamePtr);
+          }
+          jsvUnLock(watchArrayPtr);
+          Pin pin = jshGetPinFromVarAndUnLock(jsvObjectGetChildIfExists(watchPtr, "pin"));
+          if (!jsiIsWatchingPin(pin))
+            jshPinWatch(pin, false, JSPW_NONE);
+        }
+      }
+      jsvUnLock(watchPtr);
+    }
+    // Load interval *after* executing code, in case it has changed
+    JsVar *interval = jsvObjectGetChildIfExists(timerPtr, "intr");
+    if (!removeTimer && interval) {
+      timerTime = timerTime + jsvGetLongInteger(interval);
+      jsvObjectSetChildAndUnLock(timerPtr, "time", jsvNewFromLongInteger(timerTime));
+      jsiTimerHeapPush(timerTime, timerId);
+      runningBehind = timerTime<=time;
+    } else {
+      // free
+      // Beware... may have already been removed!
+      JsVar *timerName = jsiTimerFind(timerArrayPtr, timerId, 0);
+      JsVar *timerValue = jsvSkipName(timerName);
+      if (timerValue == timerPtr)
+        jsiTimerRemove(timerName);
+      jsvUnLock2(timerValue, timerName);
+    }
+    jsvUnLock2(timerCallback,interval);
+    jsvUnLock(timerPtr);
+    /* If an interval is still due (because we're running behind) leave it
+     * for the next time around the idle loop so we don't starve everything else.
+     * `wasBusy` got set, so we know we're going to go around again before sleeping. */
+    if (runningBehind) break;
+  }
+  // work out the time until the next timer
+  if (jsiTimerGetNext(timerArrayPtr, &timerTime, &timerId))
+    minTimeUntilNext = (timerTime>time) ? timerTime-time : 0;
   jsvUnLock(timerArrayPtr);
-  /* We might have left the timers loop with stuff to do because the contents of it
-   * changed. It's not a big deal because it could only have changed because a timer
-   * got executed - so `wasBusy` got set and we know we're going to go around the
-   * loop again before sleeping.
-   */
 
   // Check for events that might need to be processed from other libraries
   if (jswIdle()) wasBusy = true;
@@ -2522,6 +2840,18 @@ void jsiIdle() {
   if (jsiStatus & JSIS_WATCHDOG_AUTO)
     jshKickWatchDog();
 
+#ifndef ESPR_NO_INCREMENTAL_GC
+  /* If we're part way through an incremental GC, do the next step of it.
+   * Each step is time limited, so we return and go around the idle loop
+   * again to handle any events that came in, rather than sleeping */
+  if (jsvGarbageCollectInProgress()) {
+    jsiSetBusy(BUSY_INTERACTIVE, true);
+    jsvGarbageCollectStep();
+    jsiSetBusy(BUSY_INTERACTIVE, false);
+    return;
+  }
+#endif
+
   /* if we've been around this loop, there is nothing to do, and
    * we have a spare 10ms then let's do some Garbage Collection
    * if we think we need to */
@@ -2529,7 +2859,12 @@ void jsiIdle() {
       minTimeUntilNext > jshGetTimeFromMilliseconds(10) &&
       !jsvMoreFreeVariablesThan(JS_VARS_BEFORE_IDLE_GC)) {
     jsiSetBusy(BUSY_INTERACTIVE, true);
-    jsvGarbageCollect();
+#ifndef ESPR_NO_INCREMENTAL_GC
+    if (jsvGetGarbageCollectBudget())
+      jsvGarbageCollectStep(); // start an incremental GC
+    else
+#endif
+      jsvGarbageCollect();
     jsiSetBusy(BUSY_INTERACTIVE, false);
     /* Return here so we run around the idle loop again
      * and check whether any events came in during GC. If not
@@ -2660,7 +2995,7 @@ void jsiDumpState(vcbprintf_callback user_callback, void *user_data) {
     JsVar *timerInterval = jsvObjectGetChildIfExists(timer, "intr");
     user_callback(timerInterval ? "setInterval(" : "setTimeout(", user_data);
     jsiDumpJSON(user_callback, user_data, timerCallback, 0);
-    cbprintf(user_callback, user_data, ", %f); // %v\n", jshGetMillisecondsFromTime(timerInterval ? jsvGetLongInteger(timerInterval) : jsvGetLongIntegerAndUnLock(jsvObjectGetChildIfExists(timer, "time"))), timerNumber);
+    cbprintf(user_callback, user_data, ", %f); // %v\n", jshGetMillisecondsFromTime(timerInterval ? jsvGetLongInteger(timerInterval) : (jsvGetLongIntegerAndUnLock(jsvObjectGetChildIfExists(timer, "time")) - jsiLastIdleTime)), timerNumber);
     jsvUnLock3(timerInterval, timerCallback, timerNumber);
     // next
     jsvUnLock(timer);
@@ -2708,10 +3043,61 @@ void jsiDumpState(vcbprintf_callback user_callback, void *user_data) {
 JsVarInt jsiTimerAdd(JsVar *timerPtr) {
   JsVar *timerArrayPtr = jsvLock(timerArray);
   JsVarInt itemIndex = jsvArrayAddToEnd(timerArrayPtr, timerPtr, 1) - 1;
+#ifndef ESPR_NO_TIMER_HEAP
+  // The new timer's name is the last in timerArray
+  if (itemIndex>=0 && timerHeap && !(jsiStatus & JSIS_TIMERS_CHANGED)) {
+    if ((timerMapUsed+2)*4 > timerMapSize*3) {
+      jsiTimersChanged(); // full of removed entries - rebuild
+    } else {
+      JsVar *heapVar = jsvLock(timerHeap);
+      JsVar *timerName = jsvLock(jsvGetLastChild(timerArrayPtr));
+      jsiTimerMapAddName(jsiTimerMapGet(heapVar), timerName);
+      jsvUnLock2(timerName, heapVar);
+    }
+  }
+#endif
   jsvUnLock(timerArrayPtr);
+  if (itemIndex>=0)
+    jsiTimerHeapPush((JsSysTime)jsvGetLongIntegerAndUnLock(jsvObjectGetChildIfExists(timerPtr, "time")), itemIndex);
   return itemIndex;
 }
 
+JsVar *jsiTimerFindName(JsVar *id) {
+  JsVar *timerArrayPtr = jsvLock(timerArray);
+  JsVar *timerName = 0;
+  if (jsvIsInt(id))
+    timerName = jsiTimerFind(timerArrayPtr, jsvGetInteger(id), 0);
+  else if (jsvIsBasic(id))
+    timerName = jsvFindChildFromVar(timerArrayPtr, id, false);
+  jsvUnLock(timerArrayPtr);
+  return timerName;
+}
+
+void jsiTimerRemove(JsVar *timerName) {
+  JsVar *timerArrayPtr = jsvLock(timerArray);
+#ifndef ESPR_NO_TIMER_HEAP
+  if (timerHeap && !(jsiStatus & JSIS_TIMERS_CHANGED)) {
+    JsVarRef timerNameRef = jsvGetRef(timerName);
+    JsVar *heapVar = jsvLock(timerHeap);
+    char *map = jsiTimerMapGet(heapVar);
+    jsiTimerMapRemove(map, jsiTimerMapHash(timerName->varData.integer, false), timerNameRef);
+    jsiTimerMapRemove(map, jsiTimerMapHash((JsVarInt)jsvGetFirstChild(timerName), true), timerNameRef);
+    jsvUnLock(heapVar);
+  }
+#endif
+  jsvRemoveChild(timerArrayPtr, timerName);
+  jsvUnLock(timerArrayPtr);
+}
+
+void jsiTimerSetTime(JsVar *timerPtr, JsSysTime time) {
+  jsvObjectSetChildAndUnLock(timerPtr, "time", jsvNewFromLongInteger(time));
+  JsVar *timerArrayPtr = jsvLock(timerArray);
+  JsVar *timerName = jsiTimerFind(timerArrayPtr, 0, timerPtr);
+  if (timerName)
+    jsiTimerHeapPush(time, jsvGetInteger(timerName));
+  jsvUnLock2(timerName, timerArrayPtr);
+}
+
 void jsiTimersChanged() {
   jsiStatus |= JSIS_TIMERS_CHANGED;
 }
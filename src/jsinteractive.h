@@ -19,6 +19,7 @@
 
 #define JSI_WATCHES_NAME "watches"
 #define JSI_TIMERS_NAME "timers"
+#define JSI_TIMER_HEAP_NAME "timerHeap"
 #define JSI_DEBUG_HISTORY_NAME "dbghist"
 #define JSI_HISTORY_NAME "history"
 #define JSI_INIT_CODE_NAME "init" ///< used to temporarily store initialisation JS code for state in save()
@@ -188,8 +189,12 @@ void jsiDumpState(vcbprintf_callback user_callback, void *user_data);
 extern JsVarRef timerArray; // Linked List of timers to check and run
 extern JsVarRef watchArray; // Linked List of input watches to check and run
 
-extern JsVarInt jsiTimerAdd(JsVar *timerPtr);
-extern void jsiTimersChanged(); // Flag timers changed so we can skip out of the loop if needed
+extern JsVarInt jsiTimerAdd(JsVar *timerPtr); // Add a timer (with 'time' set to the absolute time it should run) and return its ID
+extern void jsiTimerSetTime(JsVar *timerPtr, JsSysTime time); // Set the absolute time a timer in timerArray should next run
+extern JsVar *jsiTimerFindName(JsVar *id); // Find the name in timerArray of the timer with the given ID (or 0)
+extern void jsiTimerRemove(JsVar *timerName); // Remove a timer (given its name in timerArray)
+extern void jsiTimersAddTime(JsSysTime diff); // Add 'diff' to the time of every timer
+extern void jsiTimersChanged(); // Flag timers changed without using the functions above, so our index of them gets rebuilt
 // end for jswrap_interactive/io.c ------------------------------------------------
 
 #ifdef USE_DEBUGGER
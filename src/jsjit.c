@@ -25,6 +25,12 @@
 #define JSP_MATCH(TOKEN) if (!jslMatch((TOKEN))) return; // Match where the user could have given us the wrong token
 #define JSJ_PARSING (!(execInfo.execute&EXEC_EXCEPTION))
 
+// Values stored in jit.vars for each variable
+#define JSJ_VARINDEX_MASK      0xFFFF  // mask to return the actual var index
+#define JSJ_VARINDEX_NO_NAME   0x10000 // flag set if we're sure there is no name
+#define JSJ_VARINDEX_INT       0x20000 // flag set if we can keep this variable as an unboxed int
+#define JSJ_VARINDEX_INT_SHIFT 20      // the int variable's slot number (set at the start of the EMIT phase)
+
 // ----------------------------------------------------------------------------
 void jsjUnaryExpression();
 void jsjAssignmentExpression();
@@ -35,7 +41,7 @@ void jsjBlockOrStatement();
 // These are helper functions that get called FROM the JITed code
 
 /// Look up 'parent.a[index]'. Utility function called from JIT code
-uint64_t _jsjxObjectLookup(JsVar *index, JsVar *parent, JsVar *a) {
+JsjRegPair _jsjxObjectLookup(JsVar *index, JsVar *parent, JsVar *a) {
   JsVar *resultParent = jsvSkipNameWithParent(a,true,parent);
   jsvUnLock2(a, parent);
   JsVar *resultA = 0;
@@ -51,18 +57,25 @@ uint64_t _jsjxObjectLookup(JsVar *index, JsVar *parent, JsVar *a) {
     }
   }
   jsvUnLock(index);
-  return ((uint64_t)(size_t)resultA) | (((uint64_t)(size_t)resultParent)<<32);
+  return JSJ_REG_PAIR(resultA, resultParent);
 }
 
 // Like jspeFunctionCall but we unlock ALL the vars supplied
-NO_INLINE JsVar *_jsjxFunctionCallAndUnLock(JsVar *functionName, JsVar *thisArg, bool isParsing, int argCount, JsVar **argPtr) {
+NO_INLINE JsVar *_jsjxFunctionCallAndUnLock(JsVar *functionName, JsVar *thisArg, int argCount, JsVar **argPtr) {
   JsVar *function = jsvSkipName(functionName);
-  JsVar *r = jspeFunctionCall(function, functionName, thisArg, isParsing, argCount, argPtr);
+  JsVar *r = jspeFunctionCall(function, functionName, thisArg, false/*isParsing*/, argCount, argPtr);
   jsvUnLockMany(argCount, argPtr);
   jsvUnLock3(function, functionName, thisArg);
   return r;
 }
 
+// Create a float from its bits - so we don't care how the ABI passes doubles
+NO_INLINE JsVar *_jsxNewFromFloatBits(uint64_t bits) {
+  JsVarFloat f;
+  memcpy(&f, &bits, sizeof(f));
+  return jsvNewFromFloat(f);
+}
+
 // Call jsvReplaceWithOrAddToRoot but unlock (and skip names on) the second argument
 NO_INLINE JsVar *_jsxAssignment(JsVar *dst, JsVar *src) {
   src = jsvSkipNameAndUnLock(src);
@@ -146,6 +159,46 @@ NO_INLINE void _jsxArrayNewElement(JsVar *array, uint32_t index, JsVar *value) {
 NO_INLINE JsVar *_jsxGetThis() {
   return jsvLockAgain( execInfo.thisVar ? execInfo.thisVar : execInfo.root );
 }
+
+// Write the value of an int variable ('a op b', op is '+' or '-') back into its JsVar. Called when we have to box our ints
+NO_INLINE void _jsjxIntBox(JsVar *name, JsVarInt a, JsVarInt b, int op) {
+  long long v = (op=='-') ? (long long)a - b : (long long)a + b; // can't overflow
+  JsVar *value = jsvNewFromLongInteger(v);
+  jsvReplaceWith(name, value);
+  jsvUnLock(value);
+}
+
+// Maths on two ints, which could overflow a JsVarInt
+NO_INLINE JsVar *_jsjxIntMathsOp(JsVarInt a, JsVarInt b, int op) {
+  if (op=='+') return jsvNewFromLongInteger((long long)a + b);
+  if (op=='-') return jsvNewFromLongInteger((long long)a - b);
+  assert(op=='*');
+  return jsvNewFromLongInteger((long long)a * b);
+}
+
+// Compare an int with a JsVar (which is unlocked)
+NO_INLINE bool _jsjxIntCompareAndUnLock(JsVarInt a, JsVar *b, int op) {
+  b = jsvSkipNameAndUnLock(b);
+  bool r;
+  if (jsvIsInt(b)) { // fast path - no need to allocate anything
+    JsVarInt bi = b->varData.integer;
+    switch (op) {
+      case '<': r = a<bi; break;
+      case '>': r = a>bi; break;
+      case LEX_LEQUAL: r = a<=bi; break;
+      case LEX_GEQUAL: r = a>=bi; break;
+      case LEX_EQUAL:
+      case LEX_TYPEEQUAL: r = a==bi; break;
+      default: assert(op==LEX_NEQUAL || op==LEX_NTYPEEQUAL); r = a!=bi; break;
+    }
+  } else {
+    JsVar *av = jsvNewFromInteger(a);
+    r = jsvGetBoolAndUnLock(jsvMathsOp(av, b, op));
+    jsvUnLock(av);
+  }
+  jsvUnLock(b);
+  return r;
+}
 // ----------------------------------------------------------------------------
 
 void jsjPopAsVar(int reg) {
@@ -154,8 +207,8 @@ void jsjPopAsVar(int reg) {
 }
 
 void jsjPopNoName(int reg) {
-  if (jsjcGetTopType()==JSJVT_JSVAR_NO_NAME) {
-    // if we know we don't have a name here, we can skip jsvSkipNameAndUnLock
+  if (jsjcGetTopType()!=JSJVT_JSVAR) {
+    // if we know we don't have a name here (or we're converting an int/bool), we can skip jsvSkipNameAndUnLock
     jsjPopAsVar(reg);
     return;
   }
@@ -164,8 +217,32 @@ void jsjPopNoName(int reg) {
   if (reg != 0) jsjcMov(reg, 0);
 }
 
+/* Emit code to set r2 to 1 if the condition is true or 0 if not, for use after a jsjcCompareReg.
+ * This doesn't use jsjcCompareImm as some backends only compare the bottom 8 bits for that */
+void jsjConditionToBool(JsjAsmCondition cond) {
+  jsjcLiteral32(2, 1); // set r2 before the compare, as some backends set flags when loading a literal
+  jsjcCompareReg(0, 1);
+  JsVar *oldBlock = jsjcStartBlock();
+  jsjcLiteral32(2, 0);
+  JsVar *falseBlock = jsjcStopBlock(oldBlock);
+  jsjcBranchConditionalRelative(cond, jsvGetStringLength(falseBlock), JSJC_NONE);
+  jsjcEmitBlock(falseBlock);
+  jsvUnLock(falseBlock);
+}
+
 void jsjPopAsBool(int reg) {
-  // FIXME handle int/bool differently?
+  JsjValueType varType = jsjcGetTopType();
+  if (varType==JSJVT_BOOL) { // already what we want
+    jsjcPop(reg);
+    return;
+  }
+  if (varType==JSJVT_INT) { // just compare with 0
+    jsjcPop(0);
+    jsjcLiteral32(1, 0);
+    jsjConditionToBool(JSJAC_NE);
+    if (reg != 2) jsjcMov(reg, 2);
+    return;
+  }
   jsjPopNoName(0);
   jsjcCall(jsvGetBoolAndUnLock); // optimisation: we should know if we have a var or a name here, so can skip jsvSkipNameAndUnLock sometimes
   if (reg != 0) jsjcMov(reg, 0);
@@ -200,10 +277,21 @@ void jsjFunctionStart() {
   jsjcPushAll(); // Function start - push all registers since we're not meant to mess with r4..r7
 }
 
+/// Stack offset (in bytes) of the word that was pushed at position 'pos' (0 = the first thing pushed)
+int jsjStackOffset(int pos) {
+  return (jit.stackDepth - (pos+1)) * JSJ_WORD_SIZE;
+}
+
+/// Stack position of int variable 'slot' (or of the 'boxed' flag if slot==jit.intVarCount)
+#define JSJ_INTVAR_POS(slot) (jit.varCount + (slot))
+
 /// Code to add right at the end of the function (or when we return)
 void jsjFunctionReturn(bool isReturnStatement) {
   jsjcDebugPrintf("; Function return\n");
   int oldStackDepth = jit.stackDepth;
+  if (jit.intVarCount) { // pop off int variables and the 'boxed' flag - they don't need unlocking
+    jsjcAddSP(JSJ_WORD_SIZE*(jit.intVarCount+1));
+  }
   if (jit.varCount) {
     jsjcMov(4, 0); // save r0 (return value)
     jsjcMov(1, JSJAR_SP);
@@ -211,7 +299,7 @@ void jsjFunctionReturn(bool isReturnStatement) {
     for (int i=0;i<jit.stackDepth;i++) // we don't want to be trying to unlock ints!
       assert(jit.typeStack[i]==JSJVT_JSVAR || jit.typeStack[i]==JSJVT_JSVAR_NO_NAME);
     jsjcCall(jsvUnLockMany);
-    jsjcAddSP(4*jit.varCount); // pop off anything on the stack
+    jsjcAddSP(JSJ_WORD_SIZE*jit.varCount); // pop off anything on the stack
     jsjcMov(0, 4); // restore r0
   }
   // actual stack depth is stackDepth but at this point varCount==stackDepth we hope
@@ -223,13 +311,253 @@ void jsjFunctionReturn(bool isReturnStatement) {
     jit.stackDepth = oldStackDepth;
 }
 
+/* ----------------------------------------------------------------------------
+ Int variables
+
+ Variables declared at the top level of the function with an int literal
+ (`var i=0`) that are only ever written with `i++`/`i--`/`++i`/`--i`/`i+=INT`/
+ `i-=INT`/`i=INT` as a whole statement can be kept as unboxed ints in a slot
+ on the stack, rather than allocating a JsVar for every operation.
+
+ Each statement that uses them is emitted twice (see jsjIntVersioned) - one
+ version using the ints, and one treating them as normal JsVars. If an int
+ overflows we write all the ints back into their JsVars and set the 'boxed'
+ flag, and from then on the JsVar versions are run.
+ ---------------------------------------------------------------------------- */
+
+bool jsjIsAssignmentOp(int tk) {
+  return tk=='=' || tk==LEX_PLUSEQUAL || tk==LEX_MINUSEQUAL ||
+         tk==LEX_MULEQUAL || tk==LEX_DIVEQUAL || tk==LEX_MODEQUAL ||
+         tk==LEX_ANDEQUAL || tk==LEX_OREQUAL ||
+         tk==LEX_XOREQUAL || tk==LEX_RSHIFTEQUAL ||
+         tk==LEX_LSHIFTEQUAL || tk==LEX_RSHIFTUNSIGNEDEQUAL;
+}
+
+/* If we're at an int literal (optionally negated) that fits in a JsVarInt,
+ * parse it into 'value' and return true. If not, the lexer position is undefined */
+bool jsjGetIntLiteral(JsVarInt *value) {
+  bool negate = lex->tk=='-';
+  if (negate) jslGetNextToken();
+  if (lex->tk!=LEX_INT) return false;
+  long long v = stringToInt(jslGetTokenValueAsString());
+  jslGetNextToken();
+  if (negate) v = -v;
+  if (v<-2147483648LL || v>2147483647LL) return false;
+  *value = (JsVarInt)v;
+  return true;
+}
+
+// Are we at the end of a statement that writes an int variable?
+bool jsjIsIntStatementEnd() {
+  return lex->tk==';' || lex->tk==')' || lex->tk=='}' || lex->tk==LEX_EOF;
+}
+
+// In the SCAN phase - are we at '= INT' at the end of a declaration? The lexer position is unchanged
+bool jsjIsIntInitialiser() {
+  if (lex->tk!='=') return false;
+  size_t startPos = lex->tokenStart;
+  jslGetNextToken();
+  JsVarInt value;
+  bool isInt = jsjGetIntLiteral(&value) && (lex->tk==',' || jsjIsIntStatementEnd());
+  jslSeekTo(startPos);
+  return isInt;
+}
+
+// If 'name' is a variable we're keeping as an int, return its slot number, or -1 if not
+int jsjGetIntVarSlot(JsVar *name) {
+  JsVar *varIndex = jsvFindChildFromVar(jit.vars, name, false);
+  if (!varIndex) return -1;
+  int varIndexI = jsvGetIntegerAndUnLock(jsvSkipNameAndUnLock(varIndex));
+  return (varIndexI & JSJ_VARINDEX_INT) ? (varIndexI >> JSJ_VARINDEX_INT_SHIFT) : -1;
+}
+
+// Set the value for a variable in jit.vars
+void jsjSetVarIndex(JsVar *varIndex, int varIndexI) {
+  JsVar *varIndexVal = jsvNewFromInteger(varIndexI);
+  jsvSetValueOfName(varIndex, varIndexVal);
+  jsvUnLock(varIndexVal);
+}
+
+/* Called at the start of the EMIT phase. Give each variable that we can keep as an int a slot
+ * on the stack (starting at 0), followed by the 'boxed' flag */
+void jsjIntVarsStart() {
+  JsvObjectIterator it;
+  jsvObjectIteratorNew(&it, jit.vars);
+  while (jsvObjectIteratorHasValue(&it)) {
+    JsVar *varIndex = jsvObjectIteratorGetKey(&it);
+    int varIndexI = jsvGetIntegerAndUnLock(jsvObjectIteratorGetValue(&it));
+    if (varIndexI & JSJ_VARINDEX_INT) {
+      varIndexI &= ~JSJ_VARINDEX_INT;
+      // the int slots (and the flag) must fit on our type stack or they'd get converted to JsVars
+      if (jit.varCount + jit.intVarCount + 2 <= JSJ_TYPE_STACK_SIZE)
+        varIndexI |= JSJ_VARINDEX_INT | ((jit.intVarCount++) << JSJ_VARINDEX_INT_SHIFT);
+      jsjSetVarIndex(varIndex, varIndexI);
+    }
+    jsvUnLock(varIndex);
+    jsvObjectIteratorNext(&it);
+  }
+  jsvObjectIteratorFree(&it);
+  if (!jit.intVarCount) return;
+  jsjcDebugPrintf("; %d int variables + boxed flag\n", jit.intVarCount);
+  jsjcLiteral32(0, 0);
+  for (int i=0;i<=jit.intVarCount;i++)
+    jsjcPush(0, JSJVT_INT);
+}
+
+/* Emit code to write all int variables back to their JsVars and set the 'boxed' flag.
+ * Variable 'overflowSlot' has overflowed, and its value is r0 'op' r1 */
+void jsjIntBoxAll(int overflowSlot, int op) {
+  jsjcDebugPrintf("; int overflow - box all int variables\n");
+  jsjcMov(2, 1); // r2 = b
+  jsjcMov(1, 0); // r1 = a
+  jsjcLiteral8(3, (uint8_t)op);
+  for (int pass=0;pass<2;pass++) { // do overflowSlot first, as we have its value in registers
+    JsvObjectIterator it;
+    jsvObjectIteratorNew(&it, jit.vars);
+    while (jsvObjectIteratorHasValue(&it)) {
+      int varIndexI = jsvGetIntegerAndUnLock(jsvObjectIteratorGetValue(&it));
+      int slot = varIndexI >> JSJ_VARINDEX_INT_SHIFT;
+      if ((varIndexI & JSJ_VARINDEX_INT) && ((slot==overflowSlot) == (pass==0))) {
+        if (pass) {
+          jsjcLoadImm(1, JSJAR_SP, jsjStackOffset(JSJ_INTVAR_POS(slot))); // r1 = value
+          jsjcLiteral32(2, 0);
+          jsjcLiteral8(3, '+');
+        }
+        jsjcLoadImm(0, JSJAR_SP, jsjStackOffset(varIndexI & JSJ_VARINDEX_MASK)); // r0 = name
+        jsjcCall(_jsjxIntBox); // _jsjxIntBox(name, a, b, op)
+      }
+      jsvObjectIteratorNext(&it);
+    }
+    jsvObjectIteratorFree(&it);
+  }
+  jsjcLiteral32(0, 1);
+  jsjcStoreImm(0, JSJAR_SP, jsjStackOffset(JSJ_INTVAR_POS(jit.intVarCount))); // set the 'boxed' flag
+}
+
+// Emit code for 'var op= value' ('op' is '+', '-' or '=') on the int variable in 'slot'
+void jsjIntVarWrite(int slot, int op, JsVarInt value) {
+  int slotOffset = jsjStackOffset(JSJ_INTVAR_POS(slot));
+  jit.intVarUsed = true;
+  if (op=='=') {
+    jsjcLiteral32(0, (uint32_t)value);
+    jsjcStoreImm(0, JSJAR_SP, slotOffset);
+    return;
+  }
+  jsjcLoadImm(0, JSJAR_SP, slotOffset);
+  jsjcLiteral32(1, (uint32_t)value);
+  if (op=='+') jsjcAddReg(2, 0, 1);
+  else jsjcSubReg(2, 0, 1);
+  JsVar *oldBlock = jsjcStartBlock();
+  jsjcStoreImm(2, JSJAR_SP, slotOffset);
+  JsVar *storeBlock = jsjcStopBlock(oldBlock);
+  oldBlock = jsjcStartBlock();
+  jsjIntBoxAll(slot, op);
+  JsVar *boxBlock = jsjcStopBlock(oldBlock);
+  // if no overflow, store the result and jump over the code that boxes everything
+  jsjcBranchConditionalRelative(JSJAC_VS, jsvGetStringLength(storeBlock) + jsjcGetBranchRelativeLength(jsvGetStringLength(boxBlock), JSJC_NONE), JSJC_NONE);
+  jsjcEmitBlock(storeBlock);
+  jsjcBranchRelative(jsvGetStringLength(boxBlock), JSJC_NONE);
+  jsjcEmitBlock(boxBlock);
+  jsvUnLock2(storeBlock, boxBlock);
+}
+
+void jsjFactorIDAndUnLock(JsVar *name, LEX_TYPES creationOp);
+
+/* Handle a statement that only writes to an int variable ('i++', '--i', 'i+=2', 'i=0', ...).
+ * Returns false (with the lexer where it was) if the statement isn't one of these, or in the
+ * EMIT phase if it's not an int variable we're using unboxed */
+bool jsjIntStatement() {
+  if (jit.phase==JSJP_EMIT && jit.intVarsBoxed) return false;
+  if (lex->tk!=LEX_ID && lex->tk!=LEX_PLUSPLUS && lex->tk!=LEX_MINUSMINUS) return false;
+  size_t startPos = lex->tokenStart;
+  JsVar *name = 0;
+  int op = 0;
+  JsVarInt value = 1;
+  if (lex->tk==LEX_PLUSPLUS || lex->tk==LEX_MINUSMINUS) { // ++i
+    op = (lex->tk==LEX_PLUSPLUS) ? '+' : '-';
+    jslGetNextToken();
+    if (lex->tk==LEX_ID) {
+      name = jslGetTokenValueAsVar();
+      jslGetNextToken();
+    }
+  } else { // i++ / i+=INT / i=INT
+    name = jslGetTokenValueAsVar();
+    jslGetNextToken();
+    if (lex->tk==LEX_PLUSPLUS || lex->tk==LEX_MINUSMINUS) {
+      op = (lex->tk==LEX_PLUSPLUS) ? '+' : '-';
+      jslGetNextToken();
+    } else if (lex->tk=='=' || lex->tk==LEX_PLUSEQUAL || lex->tk==LEX_MINUSEQUAL) {
+      op = (lex->tk=='=') ? '=' : ((lex->tk==LEX_PLUSEQUAL) ? '+' : '-');
+      jslGetNextToken();
+      if (!jsjGetIntLiteral(&value)) op = 0;
+    }
+  }
+  int slot = -1;
+  if (name && op && jsjIsIntStatementEnd()) {
+    if (jit.phase==JSJP_SCAN) { // just make sure the variable is in our list
+      jsjFactorIDAndUnLock(name, LEX_ID);
+      return true;
+    }
+    slot = jsjGetIntVarSlot(name);
+  }
+  jsvUnLock(name);
+  if (slot<0) { // not something we can handle - go back to the start
+    jslSeekTo(startPos);
+    return false;
+  }
+  jsjcDebugPrintf("; int variable write\n");
+  jsjIntVarWrite(slot, op, value);
+  return true;
+}
+
+/* Parse a statement-sized unit of code (eg. an expression statement or an 'if' condition). If it
+ * used any int variables it's emitted twice: once using the unboxed ints and once treating them as
+ * normal JsVars, with a check of the 'boxed' flag to choose which to run. */
+void jsjIntVersioned(void (*unit)()) {
+  if (jit.phase!=JSJP_EMIT || !jit.intVarCount || !jit.intVarsBoxed) {
+    unit(); // no int variables, or we're already inside a unit
+    return;
+  }
+  size_t startPos = lex->tokenStart;
+  int startStackDepth = jit.stackDepth;
+  int flagOffset = jsjStackOffset(JSJ_INTVAR_POS(jit.intVarCount));
+  // Parse using int variables
+  jit.intVarsBoxed = false;
+  jit.intVarUsed = false;
+  JsVar *oldBlock = jsjcStartBlock();
+  unit();
+  JsVar *intBlock = jsjcStopBlock(oldBlock);
+  jit.intVarsBoxed = true;
+  if (!jit.intVarUsed || !JSJ_PARSING) { // no ints used - we only need one version
+    jsjcEmitBlock(intBlock);
+    jsvUnLock(intBlock);
+    return;
+  }
+  // Parse again, treating int variables as JsVars
+  int endStackDepth = jit.stackDepth;
+  jslSeekTo(startPos);
+  jit.stackDepth = startStackDepth;
+  oldBlock = jsjcStartBlock();
+  unit();
+  JsVar *boxedBlock = jsjcStopBlock(oldBlock);
+  assert(!JSJ_PARSING || jit.stackDepth == endStackDepth);
+  NOT_USED(endStackDepth);
+  // If the ints have been boxed, jump to the boxed version
+  jsjcDebugPrintf("; int variables - check boxed flag\n");
+  jsjcLoadImm(0, JSJAR_SP, flagOffset);
+  jsjcCompareImm(0, 0);
+  jsjcBranchConditionalRelative(JSJAC_NE, jsvGetStringLength(intBlock) + jsjcGetBranchRelativeLength(jsvGetStringLength(boxedBlock), JSJC_NONE), JSJC_NONE);
+  jsjcEmitBlock(intBlock);
+  jsjcBranchRelative(jsvGetStringLength(boxedBlock), JSJC_NONE);
+  jsjcEmitBlock(boxedBlock);
+  jsvUnLock2(intBlock, boxedBlock);
+}
+
 /* Called when we encounter an ID. This checks if it's in our 'jit.vars'
 list and if not either creates (creationOp==LEX_R_VAR/LET/CONST) or
 tries to find it (creationOp==LEX_ID) it in our global scope.
 hasInitialiser=true if an initial value is already on the stack */
 void jsjFactorIDAndUnLock(JsVar *name, LEX_TYPES creationOp) {
-  const int VARINDEX_MASK = 0xFFFF; // mask to return the actual var index
-  const int VARINDEX_NO_NAME = 0x10000; // flag set if we're sure there is no name
   // search for var in our list...
   JsVar *varIndex = jsvFindChildFromVar(jit.vars, name, true/*addIfNotFound*/);
   JsVar *varIndexVal = jsvSkipName(varIndex);
@@ -244,7 +572,7 @@ void jsjFactorIDAndUnLock(JsVar *name, LEX_TYPES creationOp) {
       JsVar *builtin = jswFindBuiltInFunction(0, tokenName);
       if (jsvIsNativeFunction(builtin)) { // it's a built-in function - just create it in place rather than searching
         jsjcDebugPrintf("; Native Function %j\n", name);
-        jsjcLiteral32(0, builtin->varData.native.ptr);
+        jsjcLiteralPtr(0, (void*)builtin->varData.native.ptr);
         jsjcLiteral16(1, false, builtin->varData.native.argTypes);
         jsjcCall(jsvNewNativeFunction); // JsVar *jsvNewNativeFunction(void (*ptr)(void), unsigned short argTypes)
         varType = JSJVT_JSVAR_NO_NAME;
@@ -269,21 +597,36 @@ void jsjFactorIDAndUnLock(JsVar *name, LEX_TYPES creationOp) {
     // Now add the index to our list
     int varIndexNumber = jit.varCount++;
     if (varType == JSJVT_JSVAR_NO_NAME)
-      varIndexNumber |= VARINDEX_NO_NAME; // if we're sure there's no name
+      varIndexNumber |= JSJ_VARINDEX_NO_NAME; // if we're sure there's no name
+    // A var declared outside of any if/loop can be an int if it's only ever written with ints (checked below)
+    if ((creationOp==LEX_R_VAR || creationOp==LEX_R_LET) && !jit.controlDepth)
+      varIndexNumber |= JSJ_VARINDEX_INT;
     varIndexVal = jsvNewFromInteger(varIndexNumber);
     jsvSetValueOfName(varIndex, varIndexVal);
   }
   // Now, we have the var already - just reference it
   int varIndexI = jsvGetIntegerAndUnLock(varIndexVal);
+  if (jit.phase == JSJP_SCAN && (varIndexI & JSJ_VARINDEX_INT) &&
+      ((creationOp==LEX_ID) ? jsjIsAssignmentOp(lex->tk) || lex->tk==LEX_PLUSPLUS || lex->tk==LEX_MINUSMINUS
+                            : !jsjIsIntInitialiser())) {
+    // it's written with something that's not an int literal (jsjIntStatement handles the ones we can do)
+    jsjSetVarIndex(varIndex, varIndexI & ~JSJ_VARINDEX_INT);
+  }
   if (jit.phase == JSJP_EMIT) {
-    JsjValueType varType = JSJVT_JSVAR;
-    if (varIndexI & VARINDEX_NO_NAME) // decode varType from the flags
-      varType = JSJVT_JSVAR_NO_NAME;
-    varIndexI &= VARINDEX_MASK;
-    jsjcDebugPrintf("; Reference var %j\n", name);
-    jsjcLoadImm(0, JSJAR_SP, (jit.stackDepth - (varIndexI+1)) * 4);
-    jsjcCall(jsvLockAgain);
-    jsjcPush(0, varType); // Push, with the type we got from the varIndex flags
+    if ((varIndexI & JSJ_VARINDEX_INT) && !jit.intVarsBoxed) {
+      jsjcDebugPrintf("; Reference int var %j\n", name);
+      jsjcLoadImm(0, JSJAR_SP, jsjStackOffset(JSJ_INTVAR_POS(varIndexI >> JSJ_VARINDEX_INT_SHIFT)));
+      jsjcPush(0, JSJVT_INT);
+      jit.intVarUsed = true;
+    } else {
+      JsjValueType varType = JSJVT_JSVAR;
+      if (varIndexI & JSJ_VARINDEX_NO_NAME) // decode varType from the flags
+        varType = JSJVT_JSVAR_NO_NAME;
+      jsjcDebugPrintf("; Reference var %j\n", name);
+      jsjcLoadImm(0, JSJAR_SP, jsjStackOffset(varIndexI & JSJ_VARINDEX_MASK));
+      jsjcCall(jsvLockAgain);
+      jsjcPush(0, varType); // Push, with the type we got from the varIndex flags
+    }
   }
   jsvUnLock2(varIndex, name);
 }
@@ -378,21 +721,23 @@ void jsjFactor() {
     int64_t v = stringToInt(jslGetTokenValueAsString());
     JSP_ASSERT_MATCH(LEX_INT);
     if (jit.phase == JSJP_EMIT) {
-      if (v>>32) {
+      if (v<-2147483648LL || v>2147483647LL) {
         jsjcLiteral64(0, (uint64_t)v);
         jsjcCall(jsvNewFromLongInteger);
+        jsjcPush(0, JSJVT_JSVAR_NO_NAME); // a value, not a NAME
       } else {
         jsjcLiteral32(0, (uint32_t)v);
-        jsjcCall(jsvNewFromInteger);
+        jsjcPush(0, JSJVT_INT); // only converted to a JsVar if it has to be
       }
-      jsjcPush(0, JSJVT_JSVAR_NO_NAME); // a value, not a NAME, FIXME - push an int and convert later
     }
   } else if (lex->tk==LEX_FLOAT) {
     double v = stringToFloat(jslGetTokenValueAsString());
     JSP_ASSERT_MATCH(LEX_FLOAT);
     if (jit.phase == JSJP_EMIT) {
-      jsjcLiteral64(0, *((uint64_t*)&v));
-      jsjcCall(jsvNewFromFloat);
+      uint64_t bits;
+      memcpy(&bits, &v, sizeof(bits));
+      jsjcLiteral64(0, bits);
+      jsjcCall(_jsxNewFromFloatBits);
       jsjcPush(0, JSJVT_JSVAR_NO_NAME); // a value, not a NAME
     }
   } else if (lex->tk=='(') {
@@ -546,13 +891,12 @@ void jsjFactorFunctionCall() {
       //  <top of stack> argN, ... arg2, arg1, funcName, [funcParent], <rest of stack>
       DEBUG_JIT("; FUNCTION CALL argPtr\n");
       jsjcMov(7, JSJAR_SP); // r7 = argPtr
-      jsjcPush(7, JSJVT_INT); // argPtr (5th arg - on stack)
       // Args are in the wrong order - we have to swap them around if we have >1!
       if (argCount>1) {
         DEBUG_JIT("; FUNCTION CALL reverse arguments\n");
         for (int i=0;i<argCount/2;i++) {
-          int a1 = i*4;
-          int a2 = (argCount-(i+1))*4;
+          int a1 = i*JSJ_WORD_SIZE;
+          int a2 = (argCount-(i+1))*JSJ_WORD_SIZE;
           jsjcLoadImm(0, 7, a1); // r0 = memory[argPtr+a1]
           jsjcLoadImm(1, 7, a2); // ...
           jsjcStoreImm(0, 7, a2);
@@ -565,17 +909,17 @@ void jsjFactorFunctionCall() {
       // Get function var and parent (r7 == SP)
 
       if (parentOnStack) { // parent
-        jsjcLoadImm(0, 7, 4*(argCount+1)); // r0 = funcName
-        jsjcLoadImm(1, 7, 4*(argCount));
+        jsjcLoadImm(0, 7, JSJ_WORD_SIZE*(argCount+1)); // r0 = funcName
+        jsjcLoadImm(1, 7, JSJ_WORD_SIZE*(argCount));
       } else { // no parent
-        jsjcLoadImm(0, 7, 4*argCount); // r0 = funcName
+        jsjcLoadImm(0, 7, JSJ_WORD_SIZE*argCount); // r0 = funcName
         jsjcLiteral32(1, 0);
       }
-      jsjcLiteral32(2, 0); // isParsing = false
-      jsjcLiteral32(3, argCount); // argCount 4th arg
-      jsjcCall(_jsjxFunctionCallAndUnLock); // a = _jsjxFunctionCallAndUnLock(funcName, thisArg/parent, isParsing, argCount, argPtr[on stack]);
+      jsjcLiteral32(2, argCount); // argCount 3rd arg
+      jsjcMov(3, 7); // argPtr 4th arg
+      jsjcCall(_jsjxFunctionCallAndUnLock); // a = _jsjxFunctionCallAndUnLock(funcName, thisArg/parent, argCount, argPtr);
       DEBUG_JIT("; FUNCTION CALL cleanup stack\n");
-      jsjcAddSP(4*(2+argCount+(parentOnStack?1:0))); // pop off argPtr + all the arguments + funcName + parent
+      jsjcAddSP(JSJ_WORD_SIZE*(1+argCount+(parentOnStack?1:0))); // pop off all the arguments + funcName + parent
       parentOnStack = false;
       jsjcPush(0, JSJVT_JSVAR); // push return value from jspeFunctionCall (FIXME: can we be sure this isn't a NAME so use JSJVT_JSVAR_NO_NAME? I think so)
       DEBUG_JIT("; FUNCTION CALL end\n");
@@ -608,6 +952,13 @@ void jsjPostfixExpression() {
     // PREFIX expression =>  ++i, --i
     int op = lex->tk;
     JSP_ASSERT_MATCH(op);
+    if (jit.phase == JSJP_SCAN && lex->tk==LEX_ID) { // we're writing to this, so it can't be an int
+      JsVar *name = jslGetTokenValueAsVar();
+      JsVar *varIndex = jsvFindChildFromVar(jit.vars, name, false);
+      if (varIndex)
+        jsjSetVarIndex(varIndex, jsvGetIntegerAndUnLock(jsvSkipName(varIndex)) & ~JSJ_VARINDEX_INT);
+      jsvUnLock2(varIndex, name);
+    }
     jsjPostfixExpression(); // recurse to get our var...
     if (jit.phase == JSJP_EMIT) {
       jsjPopAsVar(0); // old value -> r0
@@ -678,6 +1029,21 @@ unsigned int jsjGetBinaryExpressionPrecedence(int op) {
   }
 }
 
+// Get the condition to use after comparing two ints for a comparison operator, or -1 if it's not one
+int jsjGetIntCondition(int op) {
+  switch (op) {
+  case '<': return JSJAC_LT;
+  case '>': return JSJAC_GT;
+  case LEX_LEQUAL: return JSJAC_LE;
+  case LEX_GEQUAL: return JSJAC_GE;
+  case LEX_EQUAL:
+  case LEX_TYPEEQUAL: return JSJAC_EQ;
+  case LEX_NEQUAL:
+  case LEX_NTYPEEQUAL: return JSJAC_NE;
+  default: return -1;
+  }
+}
+
 void __jsjBinaryExpression(unsigned int lastPrecedence) {
   /* This one's a bit strange. Basically all the ops have their own precedence, it's not
    * like & and | share the same precedence. We don't want to recurse for each one,
@@ -715,6 +1081,10 @@ void __jsjBinaryExpression(unsigned int lastPrecedence) {
       }
       jsjUnaryExpression();
       __jsjBinaryExpression(precedence);
+      if (jit.phase == JSJP_EMIT && jsjcGetTopType()!=JSJVT_JSVAR && jsjcGetTopType()!=JSJVT_JSVAR_NO_NAME) {
+        jsjPopAsVar(0); // both blocks must leave the same type on the stack
+        jsjcPush(0, JSJVT_JSVAR_NO_NAME);
+      }
       JsVar *secondBlock = jsjcStopBlock(oldBlock);
       if (jit.phase == JSJP_EMIT) {
         DEBUG_JIT("; shortcitcuit jump\n");
@@ -760,11 +1130,48 @@ void __jsjBinaryExpression(unsigned int lastPrecedence) {
         }
         jsvUnLock2(av, bv);
       } else */if (jit.phase == JSJP_EMIT) {  // --------------------------------------------- NORMAL
-        jsjPopAsVar(1); // b -> r1
-        jsjPopAsVar(0); // a -> r0
-        jsjcLiteral8(2, op);
-        jsjcCall(_jsxMathsOpSkipNamesAndUnLock); // unlocks arguments
-        jsjcPush(0, JSJVT_JSVAR_NO_NAME); // push result - a value, not a NAME
+        JsjValueType typeA = jsjcGetTypeAt(1), typeB = jsjcGetTypeAt(0);
+        int cond = jsjGetIntCondition(op);
+        if (typeA==JSJVT_INT && typeB==JSJVT_INT && cond>=0) { // compare two ints
+          jsjcPop(1); // b -> r1
+          jsjcPop(0); // a -> r0
+          jsjConditionToBool((JsjAsmCondition)cond);
+          jsjcPush(2, JSJVT_BOOL);
+        } else if (typeA==JSJVT_INT && typeB==JSJVT_INT && op=='&') { // can't overflow
+          jsjcPop(1); // b -> r1
+          jsjcPop(0); // a -> r0
+          jsjcAND(0, 1);
+          jsjcPush(0, JSJVT_INT);
+        } else if (typeA==JSJVT_INT && typeB==JSJVT_INT && (op=='+' || op=='-' || op=='*')) { // could overflow
+          jsjcPop(1); // b -> r1
+          jsjcPop(0); // a -> r0
+          jsjcLiteral8(2, (uint8_t)op);
+          jsjcCall(_jsjxIntMathsOp);
+          jsjcPush(0, JSJVT_JSVAR_NO_NAME);
+        } else if ((typeA==JSJVT_INT) != (typeB==JSJVT_INT) && cond>=0 &&
+                   (typeA==JSJVT_INT || typeA==JSJVT_JSVAR || typeA==JSJVT_JSVAR_NO_NAME) &&
+                   (typeB==JSJVT_INT || typeB==JSJVT_JSVAR || typeB==JSJVT_JSVAR_NO_NAME)) { // compare an int with a JsVar
+          if (typeA==JSJVT_INT) {
+            jsjcPop(1); // b -> r1
+            jsjcPop(0); // a -> r0
+          } else { // int is on the right - swap the arguments around
+            jsjcPop(0); // b -> r0
+            jsjcPop(1); // a -> r1
+            if (op=='<') op='>';
+            else if (op=='>') op='<';
+            else if (op==LEX_LEQUAL) op=LEX_GEQUAL;
+            else if (op==LEX_GEQUAL) op=LEX_LEQUAL;
+          }
+          jsjcLiteral8(2, (uint8_t)op);
+          jsjcCall(_jsjxIntCompareAndUnLock); // unlocks the JsVar
+          jsjcPush(0, JSJVT_BOOL);
+        } else {
+          jsjPopAsVar(1); // b -> r1
+          jsjPopAsVar(0); // a -> r0
+          jsjcLiteral8(2, (uint8_t)op);
+          jsjcCall(_jsxMathsOpSkipNamesAndUnLock); // unlocks arguments
+          jsjcPush(0, JSJVT_JSVAR_NO_NAME); // push result - a value, not a NAME
+        }
       }
     }
     precedence = jsjGetBinaryExpressionPrecedence(lex->tk);
@@ -799,7 +1206,7 @@ void jsjConditionalExpression() {
     if (jit.phase == JSJP_EMIT) jsjPopNoName(0); // we pop to r0 here so we can push after and avoid confusing the stack size checker
     JsVar *falseBlock = jsjcStopBlock(oldBlock);
     // true block has a jump at the end which depends on the length of the false block!
-    int trueBlockLen = jsvGetStringLength(trueBlock) + jsjcGetBranchRelativeLength(jsvGetStringLength(falseBlock));
+    int trueBlockLen = jsvGetStringLength(trueBlock) + jsjcGetBranchRelativeLength(jsvGetStringLength(falseBlock), JSJC_NONE);
     if (jit.phase == JSJP_EMIT) {
       DEBUG_JIT("; ternary jump after condition\n");
       // if false, jump after true block (if an 'else' we need to jump over the jsjcBranchRelative
@@ -820,12 +1227,7 @@ NO_INLINE void jsjAssignmentExpression() {
   // parse LHS
   jsjConditionalExpression();
   if (!JSJ_PARSING) return;
-  if (lex->tk=='=' || lex->tk==LEX_PLUSEQUAL || lex->tk==LEX_MINUSEQUAL ||
-      lex->tk==LEX_MULEQUAL || lex->tk==LEX_DIVEQUAL || lex->tk==LEX_MODEQUAL ||
-      lex->tk==LEX_ANDEQUAL || lex->tk==LEX_OREQUAL ||
-      lex->tk==LEX_XOREQUAL || lex->tk==LEX_RSHIFTEQUAL ||
-      lex->tk==LEX_LSHIFTEQUAL || lex->tk==LEX_RSHIFTUNSIGNEDEQUAL) {
-
+  if (jsjIsAssignmentOp(lex->tk)) {
     int op = lex->tk;
     JSP_ASSERT_MATCH(op);
 
@@ -887,6 +1289,34 @@ void jsjBlock() {
   JSP_MATCH('}');
 }
 
+// A statement that's just an expression
+void jsjStatementExpression() {
+  if (jsjIntStatement()) return; // a write to an int variable
+  jsjExpression();
+  if (jit.phase == JSJP_EMIT)
+    jsjPopAndUnLock();
+}
+
+// Parse the condition for an if/for/while/do and leave it in r0 as a bool
+void jsjCondition() {
+  jsjExpression();
+  if (jit.phase == JSJP_EMIT)
+    jsjPopAsBool(0);
+}
+
+void jsjStatementReturn() {
+  JSP_ASSERT_MATCH(LEX_R_RETURN);
+  if (lex->tk != ';' && lex->tk != '}') {
+    jsjExpression();
+    DEBUG_JIT_EMIT("; RETURN r0\n");
+    if (jit.phase == JSJP_EMIT) jsjPopNoName(0); // a -> r0, we only want the value, so skip the name if there was one
+  } else {
+    DEBUG_JIT_EMIT("; RETURN undefined\n");
+    if (jit.phase == JSJP_EMIT) jsjcLiteral32(0, 0);
+  }
+  if (jit.phase == JSJP_EMIT) jsjFunctionReturn(true/*isReturnStatement*/);
+}
+
 void jsjStatementVar() {
   assert(lex->tk==LEX_R_VAR || lex->tk==LEX_R_LET || lex->tk==LEX_R_CONST);
   // FIXME: Ignore block scoping for now
@@ -898,10 +1328,23 @@ void jsjStatementVar() {
     JsVar *name = jslGetTokenValueAsVar();
     JSP_ASSERT_MATCH(LEX_ID);
     bool hasInitialiser = lex->tk == '=';
-    /* create the variable locally, and in our var table. If we're emitting now
-    and there's no initial value, we don't need to do anything */
-    if (hasInitialiser || jit.phase != JSJP_EMIT)
+    int intSlot = -1;
+    if (hasInitialiser && jit.phase == JSJP_EMIT && !jit.intVarsBoxed)
+      intSlot = jsjGetIntVarSlot(name);
+    if (intSlot >= 0) { // an int variable - we checked in the SCAN phase that this is an int literal
+      JSP_ASSERT_MATCH('=');
+      JsVarInt value = 0;
+      jsjGetIntLiteral(&value);
+      jsjcDebugPrintf("; Int variable decl %j\n", name);
+      jsjIntVarWrite(intSlot, '=', value);
+      jsvUnLock(name);
+      hasInitialiser = false;
+    } else if (hasInitialiser || jit.phase != JSJP_EMIT) {
+      /* create the variable locally, and in our var table. If we're emitting now
+      and there's no initial value, we don't need to do anything */
       jsjFactorIDAndUnLock(name, declType);
+    } else
+      jsvUnLock(name);
     if (hasInitialiser) { // sort out initialiser
       DEBUG_JIT_EMIT("; Variable's initialiser\n");
       JSP_ASSERT_MATCH('=');
@@ -923,13 +1366,12 @@ void jsjStatementIf() {
   JSP_ASSERT_MATCH(LEX_R_IF);
   DEBUG_JIT_EMIT("; IF condition\n");
   JSP_MATCH('(');
-  jsjExpression();
-  if (jit.phase == JSJP_EMIT) {
-    jsjPopAsBool(0);
+  jsjIntVersioned(jsjCondition);
+  if (jit.phase == JSJP_EMIT)
     jsjcCompareImm(0, 0);
-  }
   JSP_MATCH(')');
 
+  jit.controlDepth++;
   DEBUG_JIT_EMIT("; capture IF true block\n");
   JsVar *oldBlock = jsjcStartBlock();
   jsjBlockOrStatement();
@@ -943,11 +1385,12 @@ void jsjStatementIf() {
     jsjBlockOrStatement();
     falseBlock = jsjcStopBlock(oldBlock);
   }
+  jit.controlDepth--;
   if (jit.phase == JSJP_EMIT) {
     DEBUG_JIT("; IF jump after condition\n");
     // if false, jump after true block (if an 'else' we need to jump over the jsjcBranchRelative
     // true block has a jump at the end (if an 'else') and the size of that jump instr can change
-    int trueBlockLen = jsvGetStringLength(trueBlock) + (falseBlock?jsjcGetBranchRelativeLength(jsvGetStringLength(falseBlock)):0);
+    int trueBlockLen = jsvGetStringLength(trueBlock) + (falseBlock?jsjcGetBranchRelativeLength(jsvGetStringLength(falseBlock), JSJC_NONE):0);
     jsjcBranchConditionalRelative(JSJAC_EQ, trueBlockLen, JSJC_NONE);
     DEBUG_JIT("; IF true block\n");
     jsjcEmitBlock(trueBlock);
@@ -975,40 +1418,36 @@ void jsjStatementFor() {
   int codePosCondition = jsjcGetByteCount();
   DEBUG_JIT_EMIT("; FOR condition\n");
   if (lex->tk != ';') {
-    jsjExpression(); // condition
-    if (jit.phase == JSJP_EMIT) {
-      jsjPopAsBool(0);
+    jsjIntVersioned(jsjCondition);
+    if (jit.phase == JSJP_EMIT)
       jsjcCompareImm(0, 0);
-    }
     // We add a jump to the end after we've parsed everything and know the size
   }
   JSP_MATCH(';');
   DEBUG_JIT_EMIT("; Parsing FOR Iterator block\n");
   JsVar *oldBlock = jsjcStartBlock();
-  if (lex->tk != ')')  { // we could have 'for (;;)'
-    jsjExpression(); // iterator
-    if (jit.phase == JSJP_EMIT) {
-      jsjPopAndUnLock();
-    }
-  }
+  if (lex->tk != ')') // we could have 'for (;;)'
+    jsjIntVersioned(jsjStatementExpression); // iterator
   JsVar *iteratorBlock = jsjcStopBlock(oldBlock);
   JSP_MATCH(')'); // FIXME: clean up on exit
   // Now parse the actual code to execute
   DEBUG_JIT_EMIT("; Parsing FOR Main block\n");
+  jit.controlDepth++;
   oldBlock = jsjcStartBlock();
   jsjBlockOrStatement();
   JsVar *mainBlock = jsjcStopBlock(oldBlock);
+  jit.controlDepth--;
   DEBUG_JIT_EMIT("; Branch OVER main block to END\n");
   // Now figure out the jump length and jump (if condition is false)
   if (jit.phase == JSJP_EMIT) {
-    jsjcBranchConditionalRelative(JSJAC_EQ, jsvGetStringLength(iteratorBlock) + jsvGetStringLength(mainBlock) + 4, JSJC_FORCE_4BYTE);
+    jsjcBranchConditionalRelative(JSJAC_EQ, jsvGetStringLength(iteratorBlock) + jsvGetStringLength(mainBlock) + jsjcGetBranchRelativeLength(0, JSJC_FORCE_LONG), JSJC_FORCE_LONG);
     DEBUG_JIT_EMIT("; FOR Main block\n");
     jsjcEmitBlock(mainBlock);
     DEBUG_JIT_EMIT("; FOR Iterator block\n");
     jsjcEmitBlock(iteratorBlock);
     // after the iterator, jump back to condition
     DEBUG_JIT_EMIT("; FOR jump back to condition\n");
-    jsjcBranchRelative(codePosCondition - (jsjcGetByteCount()+4), JSJC_FORCE_4BYTE);
+    jsjcBranchRelative(codePosCondition - (jsjcGetByteCount()+jsjcGetBranchRelativeLength(0, JSJC_FORCE_LONG)), JSJC_FORCE_LONG);
     DEBUG_JIT_EMIT("; FOR end\n");
   }
   jsvUnLock2(mainBlock, iteratorBlock);
@@ -1020,39 +1459,39 @@ void jsjStatementDoOrWhile(bool isWhile) {
     JSP_ASSERT_MATCH(LEX_R_WHILE);
     DEBUG_JIT_EMIT("; WHILE condition\n");
     JSP_MATCH('(');
-    jsjExpression();
-    if (jit.phase == JSJP_EMIT) {
-      // do this here so our stack counter stays at the right level
-      jsjPopAsBool(0);
+    jsjIntVersioned(jsjCondition); // do this here so our stack counter stays at the right level
+    if (jit.phase == JSJP_EMIT)
       jsjcCompareImm(0, 0);
-    }
     JSP_MATCH(')');
     DEBUG_JIT_EMIT("; Parsing WHILE main block\n");
+    jit.controlDepth++;
     JsVar *oldBlock = jsjcStartBlock();
     jsjBlockOrStatement();
     JsVar *mainBlock = jsjcStopBlock(oldBlock);
+    jit.controlDepth--;
     if (jit.phase == JSJP_EMIT) {
       DEBUG_JIT_EMIT("; WHILE condition jump\n");
-      jsjcBranchConditionalRelative(JSJAC_EQ, jsvGetStringLength(mainBlock) + 4, JSJC_FORCE_4BYTE);
+      jsjcBranchConditionalRelative(JSJAC_EQ, jsvGetStringLength(mainBlock) + jsjcGetBranchRelativeLength(0, JSJC_FORCE_LONG), JSJC_FORCE_LONG);
       DEBUG_JIT_EMIT("; WHILE Main block\n");
       jsjcEmitBlock(mainBlock);
       DEBUG_JIT_EMIT("; WHILE jump back to condition\n");
-      jsjcBranchRelative(codePosStart - (jsjcGetByteCount()+4), JSJC_FORCE_4BYTE);
+      jsjcBranchRelative(codePosStart - (jsjcGetByteCount()+jsjcGetBranchRelativeLength(0, JSJC_FORCE_LONG)), JSJC_FORCE_LONG);
     }
     jsvUnLock(mainBlock);
   } else { // do..while loop
     JSP_ASSERT_MATCH(LEX_R_DO);
     DEBUG_JIT_EMIT("; DO Main block\n");
+    jit.controlDepth++;
     jsjBlockOrStatement();
+    jit.controlDepth--;
     JSP_ASSERT_MATCH(LEX_R_WHILE);
     DEBUG_JIT_EMIT("; DO condition\n");
     JSP_MATCH('(');
-    jsjExpression();
+    jsjIntVersioned(jsjCondition);
     JSP_MATCH(')');
     if (jit.phase == JSJP_EMIT) {
-      jsjPopAsBool(0);
       jsjcCompareImm(0, 0);
-      jsjcBranchConditionalRelative(JSJAC_NE, codePosStart - (jsjcGetByteCount()+4), JSJC_FORCE_4BYTE);
+      jsjcBranchConditionalRelative(JSJAC_NE, codePosStart - (jsjcGetByteCount()+jsjcGetBranchConditionalRelativeLength(0, JSJC_FORCE_LONG)), JSJC_FORCE_LONG);
     }
   }
 }
@@ -1083,9 +1522,7 @@ void jsjStatement() {
       lex->tk=='[' ||
       lex->tk=='(') {
     /* Execute a simple statement that only contains basic arithmetic... */
-    jsjExpression();
-    if (jit.phase == JSJP_EMIT)
-      jsjPopAndUnLock();
+    jsjIntVersioned(jsjStatementExpression);
   } else if (lex->tk=='{') {
     /* A block of code */
     jsjBlock();
@@ -1094,7 +1531,7 @@ void jsjStatement() {
   } else if (lex->tk==LEX_R_VAR ||
             lex->tk==LEX_R_LET ||
             lex->tk==LEX_R_CONST) {
-    return jsjStatementVar();
+    return jsjIntVersioned(jsjStatementVar);
   } else if (lex->tk==LEX_R_IF) {
     return jsjStatementIf();
   } else if (lex->tk==LEX_R_DO || lex->tk==LEX_R_WHILE) {
@@ -1104,16 +1541,7 @@ void jsjStatement() {
   /*} else if (lex->tk==LEX_R_TRY) {
     return jsjStatementTry();*/
   } else if (lex->tk==LEX_R_RETURN) {
-    JSP_ASSERT_MATCH(LEX_R_RETURN);
-    if (lex->tk != ';' && lex->tk != '}') {
-      jsjExpression();
-      DEBUG_JIT_EMIT("; RETURN r0\n");
-      if (jit.phase == JSJP_EMIT) jsjPopNoName(0); // a -> r0, we only want the value, so skip the name if there was one
-    } else {
-      DEBUG_JIT_EMIT("; RETURN undefined\n");
-      if (jit.phase == JSJP_EMIT) jsjcLiteral32(0, 0);
-    }
-    if (jit.phase == JSJP_EMIT) jsjFunctionReturn(true/*isReturnStatement*/);
+    jsjIntVersioned(jsjStatementReturn);
 /*} else if (lex->tk==LEX_R_THROW) {
   } else if (lex->tk==LEX_R_FUNCTION) {
   } else if (lex->tk==LEX_R_CONTINUE) {
@@ -1151,6 +1579,7 @@ JsVar *jsjParseFunction() {
   if (JSJ_PARSING) { // if no error, re-parse and create code
     jslSeekTo(codeStartPosition);
     jit.phase = JSJP_EMIT; DEBUG_JIT("; ============ EMIT PHASE\n");
+    jsjIntVarsStart();
     bool hadReturnStatement = jsjBlockNoBrackets(true);
     // if this block had a return in it (eg not behind 'if'/etc), hadReturnStatement=true
     // if so, we can skip adding a return statement
@@ -1159,7 +1588,7 @@ JsVar *jsjParseFunction() {
       jsjcLiteral32(0, 0);
       jsjFunctionReturn(false/*isReturnStatement*/);
     } else {
-      jit.stackDepth -= jit.varCount; // jsjFunctionReturn would have pulled these off the stack anyway
+      jit.stackDepth -= jit.varCount + (jit.intVarCount ? jit.intVarCount+1 : 0); // jsjFunctionReturn would have pulled these off the stack anyway
     }
   }
   JsVar *v = jsjcStop();
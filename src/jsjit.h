@@ -27,5 +27,12 @@ JsVar *jsjEvaluate(const char *str);
 // parse a function and return a native string of the code. Assumes '{' has already been parsed
 JsVar *jsjParseFunction();
 
+// Get the address to call for the code at 'ptr' (returned by jsjParseFunction) - Thumb code needs bit 0 set
+#if defined(__x86_64__)
+#define JSJ_CODE_ENTRY(ptr) ((void*)(ptr))
+#else
+#define JSJ_CODE_ENTRY(ptr) ((void*)((char*)(ptr)+1))
+#endif
+
 #endif /* JSJIT_H_ */
 #endif /* ESPR_JIT */
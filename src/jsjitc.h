@@ -19,6 +19,31 @@
 #include "jsjit.h"
 #include "jsvariterator.h"
 
+/* The JIT in jsjit.c only uses the jsjc* functions below to create code. Each
+ * backend (jsjitc_thumb.c, jsjitc_x86.c) implements the instruction-specific
+ * ones for its architecture. Registers are numbered as for ARM - r0..r3 are
+ * function arguments (r0 is also the return value) and are clobbered by
+ * jsjcCall, r4..r7 are preserved across calls. Other backends map these to
+ * their own registers. */
+#if defined(__x86_64__)
+#define JSJ_BACKEND_X86_64
+#else
+#define JSJ_BACKEND_THUMB
+#endif
+
+/// Size in bytes of a register, and of each item we push onto the stack
+#define JSJ_WORD_SIZE ((int)sizeof(size_t))
+
+/** Two values returned from a function called from JIT code, which end up in r0 and r1.
+ * Create these with JSJ_REG_PAIR */
+#ifdef JSJ_BACKEND_X86_64
+typedef struct { size_t r0, r1; } JsjRegPair; // returned in rax:rdx
+#define JSJ_REG_PAIR(R0,R1) ((JsjRegPair){(size_t)(R0),(size_t)(R1)})
+#else
+typedef uint64_t JsjRegPair; // returned in r0:r1
+#define JSJ_REG_PAIR(R0,R1) (((uint64_t)(size_t)(R0)) | (((uint64_t)(size_t)(R1))<<32))
+#endif
+
 // Write debug info to the console
 #define DEBUG_JIT jsjcDebugPrintf
 // Write debug info to the console IF we're in the 'emit' phase
@@ -29,9 +54,10 @@ void jsjcDebugPrintf(const char *fmt, ...);
 #define JSJ_TYPE_STACK_SIZE 64 // Most amount of types stored on stack
 
 typedef enum {
-  JSJVT_INT,
+  JSJVT_INT,          ///< A 32 bit signed integer (JsVarInt)
   JSJVT_JSVAR,        ///< A JsVar
-  JSJVT_JSVAR_NO_NAME ///< A JsVar, and we know it's not a name so it doesn't need SkipName
+  JSJVT_JSVAR_NO_NAME,///< A JsVar, and we know it's not a name so it doesn't need SkipName
+  JSJVT_BOOL          ///< A boolean, 0 or 1
 } PACKED_FLAGS JsjValueType;
 
 typedef enum {
@@ -52,6 +78,8 @@ typedef enum {
   JSJAC_AL, // 14 - Always
   JSJAC_SVC // 15 - SVC control - https://developer.arm.com/documentation/ddi0308/d/Thumb-Instructions/Alphabetical-list-of-Thumb-instructions/B
 } JsjAsmCondition;
+// Names of each condition (3 bytes apart) for debug output
+extern const char *JSJAC_STRINGS;
 #define JSJAC_STRING "EQ\0NE\0CS\0CC\0MI\0PL\0VS\0VC\0HI\0LI\0GE\0LT\0GT\0LE\0AL"
 
 typedef enum {
@@ -86,6 +114,14 @@ typedef struct {
   JsVar *vars;
   /// How many words (not bytes) are on the stack reserved for variables?
   int varCount;
+  /// How many int variables do we have (each has a word on the stack after the variables, followed by a 'boxed' flag)
+  int intVarCount;
+  /// If set, int variables are treated as normal JsVars (see jsjIntVersioned)
+  bool intVarsBoxed;
+  /// Set when code that used an int variable's unboxed value has been emitted
+  bool intVarUsed;
+  /// How many if/loop bodies deep are we in the code we're parsing?
+  int controlDepth;
   /// How much stuff has been pushed on the stack so far? (including variables)
   int stackDepth;
   /// For each item on the stack, we store its type
@@ -97,7 +133,7 @@ extern JsjInfo jit;
 
 typedef enum {
   JSJC_NONE = 0,        ///< emit normally
-  JSJC_FORCE_4BYTE = 1  ///< create 4 byte instruction even if 2 byte would have done
+  JSJC_FORCE_LONG = 1   ///< create the long form of an instruction even if a shorter one would have done
 } JsjsEmitOptions;
 
 // Called before start of JIT output
@@ -114,6 +150,15 @@ JsVar *jsjcStopBlock(JsVar *oldBlock);
 void jsjcEmitBlock(JsVar *block);
 // Get what byte we're at in our code
 int jsjcGetByteCount();
+// Get the name of a type on our stack
+const char *jsjcGetTypeName(JsjValueType t);
+
+// Emit raw code - for use by backends only
+void jsjcEmit8(uint8_t v);
+void jsjcEmit16(uint16_t v);
+void jsjcEmit32(uint32_t v);
+
+// ------------------------------------------------------- Implemented by backends
 
 // Add 8 bit literal
 void jsjcLiteral8(int reg, uint8_t data);
@@ -121,8 +166,10 @@ void jsjcLiteral8(int reg, uint8_t data);
 void jsjcLiteral16(int reg, bool hi16, uint16_t data);
 // Add 32 bit literal
 void jsjcLiteral32(int reg, uint32_t data);
-// Add 64 bit literal in reg,reg+1
+// Add 64 bit literal as a function argument (in reg,reg+1 on 32 bit platforms)
 void jsjcLiteral64(int reg, uint64_t data);
+// Add a pointer as a literal
+void jsjcLiteralPtr(int reg, const void *data);
 // Call a function
 #ifdef DEBUG_JIT_CALLS
 void _jsjcCall(void *c, const char *name);
@@ -132,43 +179,63 @@ void jsjcCall(void *c);
 #endif
 // Store a string of data and put the address in a register. Returns the length
 int jsjcLiteralString(int reg, JsVar *str, bool nullTerminate);
-// Compare a register with a literal. jsjcBranchConditionalRelative can then be called
+/* Compare two registers containing JsVarInts. jsjcBranchConditionalRelative can then
+ * be called with EQ/NE/GE/LT/GT/LE */
+void jsjcCompareReg(int regA, int regB);
+/* Compare a register containing a bool (eg. the result of jsvGetBool) with a literal (0..255).
+ * jsjcBranchConditionalRelative can then be called. Some backends only compare the bottom 8 bits,
+ * as that's all a function returning bool is guaranteed to set */
 void jsjcCompareImm(int reg, int literal);
 // Get length of jsjcBranchRelative in bytes
-int jsjcGetBranchRelativeLength(int bytes);
-// Jump a number of bytes forward or back, return number of bytes used for op
+int jsjcGetBranchRelativeLength(int bytes, JsjsEmitOptions options);
+// Jump a number of bytes forward or back (from the end of this instruction), return number of bytes used for op
 int jsjcBranchRelative(int bytes, JsjsEmitOptions options);
 // Get length of jsjcBranchConditionalRelative in bytes
-int jsjcGetBranchConditionalRelativeLength(int bytes);
-// Jump a number of bytes forward or back, based on condition flags, return number of bytes used for op
+int jsjcGetBranchConditionalRelativeLength(int bytes, JsjsEmitOptions options);
+// Jump a number of bytes forward or back (from the end of this instruction), based on condition flags, return number of bytes used for op
 int jsjcBranchConditionalRelative(JsjAsmCondition cond, int bytes, JsjsEmitOptions options);
 // Move one register to another
 void jsjcMov(int regTo, int regFrom);
 // Add a literal to a number
 void jsjcAdd(int regTo, int regFrom, int lit);
+// regTo = regA + regB (as JsVarInt), setting the overflow flag for JSJAC_VS/JSJAC_VC. regTo!=regB
+void jsjcAddReg(int regTo, int regA, int regB);
+// regTo = regA - regB (as JsVarInt), setting the overflow flag for JSJAC_VS/JSJAC_VC. regTo!=regB
+void jsjcSubReg(int regTo, int regA, int regB);
 // Move negated register
 void jsjcMVN(int regTo, int regFrom);
 // regTo = regTo & regFrom
 void jsjcAND(int regTo, int regFrom);
+// Push a register onto the stack (without keeping track of its type - use jsjcPush)
+void jsjcPushReg(int reg);
+// Pop a register off the stack (without keeping track of its type - use jsjcPop)
+void jsjcPopReg(int reg);
+// Add a value to the stack pointer (only multiple of JSJ_WORD_SIZE)
+void jsjcAddSP(int amt);
+// Subtract a value from the stack pointer (only multiple of JSJ_WORD_SIZE)
+void jsjcSubSP(int amt);
+// reg = mem[regAddr + offset] (regAddr can be JSJAR_SP)
+void jsjcLoadImm(int reg, int regAddr, int offset);
+// mem[regAddr + offset] = reg (regAddr can be JSJAR_SP)
+void jsjcStoreImm(int reg, int regAddr, int offset);
+
+// Function start - save all the registers we're not meant to mess with
+void jsjcPushAll();
+// Function end - restore registers, and return r0
+void jsjcPopAllAndReturn();
+
+// ------------------------------------------------------- Common to all backends
+
 // Convert the var type in the given reg to a JsVar
 void jsjcConvertToJsVar(int reg, JsjValueType varType);
 // Push a register onto the stack
 void jsjcPush(int reg, JsjValueType type);
 // Get the type of the variable on the top of the stack
 JsjValueType jsjcGetTopType();
+// Get the type of the variable 'n' items down from the top of the stack (0 = the top)
+JsjValueType jsjcGetTypeAt(int n);
 // Pop off the stack to a register
 JsjValueType jsjcPop(int reg);
-// Add a value to the stack pointer (only multiple of 4)
-void jsjcAddSP(int amt);
-// Subtract a value from the stack pointer (only multiple of 4)
-void jsjcSubSP(int amt);
-// reg = mem[regAddr + offset]
-void jsjcLoadImm(int reg, int regAddr, int offset);
-// mem[regAddr + offset] = reg
-void jsjcStoreImm(int reg, int regAddr, int offset);
-
-void jsjcPushAll();
-void jsjcPopAllAndReturn();
 
 #endif /* JSJITC_H_ */
 #endif /* ESPR_JIT */
@@ -0,0 +1,359 @@
+/*
+ * This file is part of Espruino, a JavaScript interpreter for Microcontrollers
+ *
+ * Copyright (C) 2013 Gordon Williams <gw@pur3.co.uk>
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ *
+ * ----------------------------------------------------------------------------
+ * Recursive descent JIT - x86-64 backend (System V ABI)
+ * ----------------------------------------------------------------------------
+
+ https://www.felixcloutier.com/x86/
+ https://wiki.osdev.org/X86-64_Instruction_Encoding
+
+ The JIT thinks in terms of ARM registers, so we map them:
+
+   r0..r3 -> rdi, rsi, rdx, rcx  (the first 4 function arguments, clobbered by calls)
+   r4..r7 -> r12, r13, r14, r15  (callee-saved)
+   SP     -> rsp
+
+ rax is used for call addresses and return values (jsjcCall moves the result
+ into rdi, and rdx into rsi so a JsjRegPair ends up in r0,r1), and rbx is
+ used to keep the old stack pointer while we align the stack for a call.
+
+ */
+#include "jsjitc.h"
+#if defined(ESPR_JIT) && defined(JSJ_BACKEND_X86_64)
+
+// x86 register numbers
+#define X86_RAX 0
+#define X86_RCX 1
+#define X86_RDX 2
+#define X86_RBX 3
+#define X86_RSP 4
+#define X86_RSI 6
+#define X86_RDI 7
+
+static const char *jsjcRegNames[16] = {
+  "rax","rcx","rdx","rbx","rsp","rbp","rsi","rdi",
+  "r8","r9","r10","r11","r12","r13","r14","r15"
+};
+
+// Convert one of our (ARM) register numbers to an x86 one
+static int jsjcReg(int reg) {
+  static const uint8_t regs[8] = { X86_RDI, X86_RSI, X86_RDX, X86_RCX, 12, 13, 14, 15 };
+  if (reg==JSJAR_SP) return X86_RSP;
+  assert(reg>=0 && reg<8);
+  return regs[reg];
+}
+
+#define REGNAME(reg) jsjcRegNames[jsjcReg(reg)]
+
+// Emit a REX prefix for a 64 bit operation (reg is in ModRM.reg, rm in ModRM.rm)
+static void jsjcEmitREXW(int x86reg, int x86rm) {
+  jsjcEmit8((uint8_t)(0x48 | ((x86reg&8)?4:0) | ((x86rm&8)?1:0)));
+}
+
+// Emit ModRM for a register-register operation
+static void jsjcEmitModRMReg(int x86reg, int x86rm) {
+  jsjcEmit8((uint8_t)(0xC0 | ((x86reg&7)<<3) | (x86rm&7)));
+}
+
+// Emit ModRM (+SIB) for [x86base + offset]
+static void jsjcEmitModRMMem(int x86reg, int x86base, int offset) {
+  jsjcEmit8((uint8_t)(0x80 | ((x86reg&7)<<3) | (x86base&7))); // disp32
+  if ((x86base&7)==X86_RSP) jsjcEmit8(0x24); // rsp/r12 need a SIB byte
+  jsjcEmit32((uint32_t)offset);
+}
+
+// mov r32,imm32 (zero-extends into the whole register)
+static void jsjcEmitMovImm32(int x86reg, uint32_t data) {
+  if (x86reg&8) jsjcEmit8(0x41);
+  jsjcEmit8((uint8_t)(0xB8 | (x86reg&7)));
+  jsjcEmit32(data);
+}
+
+void jsjcLiteral8(int reg, uint8_t data) {
+  jsjcEmitMovImm32(jsjcReg(reg), data);
+}
+
+void jsjcLiteral16(int reg, bool hi16, uint16_t data) {
+  assert(!hi16); // we don't need MOVT - jsjcLiteral32 does it all in one
+  jsjcEmitMovImm32(jsjcReg(reg), data);
+}
+
+void jsjcLiteral32(int reg, uint32_t data) {
+  DEBUG_JIT("MOV %s,#0x%08x\n", REGNAME(reg), data);
+  jsjcEmitMovImm32(jsjcReg(reg), data);
+}
+
+void jsjcLiteral64(int reg, uint64_t data) {
+  // 64 bit arguments fit in one register
+  if (!(data>>32)) {
+    jsjcLiteral32(reg, (uint32_t)data);
+    return;
+  }
+  DEBUG_JIT("MOVABS %s,#0x%08x%08x\n", REGNAME(reg), (uint32_t)(data>>32), (uint32_t)data);
+  int r = jsjcReg(reg);
+  jsjcEmitREXW(0, r);
+  jsjcEmit8((uint8_t)(0xB8 | (r&7)));
+  jsjcEmit32((uint32_t)data);
+  jsjcEmit32((uint32_t)(data>>32));
+}
+
+void jsjcLiteralPtr(int reg, const void *data) {
+  jsjcLiteral64(reg, (uint64_t)(size_t)data);
+}
+
+int jsjcLiteralString(int reg, JsVar *str, bool nullTerminate) {
+  /* We store the String data here in-line, so get its address relative to the
+   * instruction pointer, then jump forward over the data. */
+  int len = (int)jsvGetStringLength(str);
+  int realLen = len + (nullTerminate?1:0);
+  int branchLen = jsjcGetBranchRelativeLength(realLen, JSJC_NONE);
+  DEBUG_JIT("LEA %s,[rip+%d]\n", REGNAME(reg), branchLen);
+  int r = jsjcReg(reg);
+  jsjcEmitREXW(r, 0);
+  jsjcEmit8(0x8D);
+  jsjcEmit8((uint8_t)(0x05 | ((r&7)<<3))); // [rip + disp32]
+  jsjcEmit32((uint32_t)branchLen);
+  // jump over the data
+  jsjcBranchRelative(realLen, JSJC_NONE);
+  // write the data
+  DEBUG_JIT("... %d bytes data (%q) ...\n", (uint32_t)(realLen), str);
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, str, 0);
+  for (int i=0;i<realLen;i++)
+    jsjcEmit8((uint8_t)jsvStringIteratorGetCharAndNext(&it));
+  jsvStringIteratorFree(&it);
+  return len;
+}
+
+// Compare the bottom 8 bits of a register with a literal. jsjcBranchConditionalRelative can then be called
+void jsjcCompareImm(int reg, int literal) {
+  DEBUG_JIT("CMP %s(low byte),#%d\n", REGNAME(reg), literal);
+  assert(literal>=0 && literal<256);
+  int r = jsjcReg(reg);
+  jsjcEmit8((uint8_t)(0x40 | ((r&8)?1:0))); // REX so we get sil/dil rather than dh/bh
+  jsjcEmit8(0x80);
+  jsjcEmit8((uint8_t)(0xC0 | (7<<3) | (r&7))); // CMP r/m8, imm8
+  jsjcEmit8((uint8_t)literal);
+}
+
+// Compare two registers (as 32 bit). jsjcBranchConditionalRelative can then be called
+void jsjcCompareReg(int regA, int regB) {
+  DEBUG_JIT("CMP %s(32),%s(32)\n", REGNAME(regA), REGNAME(regB));
+  int a = jsjcReg(regA), b = jsjcReg(regB);
+  if ((a|b)&8) jsjcEmit8((uint8_t)(0x40 | ((b&8)?4:0) | ((a&8)?1:0)));
+  jsjcEmit8(0x39); // CMP r/m32, r32
+  jsjcEmitModRMReg(b, a);
+}
+
+// Get length of jsjcBranchRelative in bytes
+int jsjcGetBranchRelativeLength(int bytes, JsjsEmitOptions options) {
+  if (bytes<-128 || bytes>127 || (options&JSJC_FORCE_LONG))
+    return 5;
+  return 2;
+}
+
+// Jump a number of bytes forward or back (from the end of this instruction), return number of bytes used for op
+int jsjcBranchRelative(int bytes, JsjsEmitOptions options) {
+  DEBUG_JIT("JMP %s%d (addr 0x%04x)\n", (bytes>=0)?"+":"", (uint32_t)(bytes), jsjcGetByteCount()+jsjcGetBranchRelativeLength(bytes, options)+bytes);
+  if (jsjcGetBranchRelativeLength(bytes, options)==2) {
+    jsjcEmit8(0xEB);
+    jsjcEmit8((uint8_t)bytes);
+    return 2;
+  } else {
+    jsjcEmit8(0xE9);
+    jsjcEmit32((uint32_t)bytes);
+    return 5;
+  }
+}
+
+// Get length of jsjcBranchConditionalRelative in bytes
+int jsjcGetBranchConditionalRelativeLength(int bytes, JsjsEmitOptions options) {
+  if (bytes<-128 || bytes>127 || (options&JSJC_FORCE_LONG))
+    return 6;
+  return 2;
+}
+
+// Jump a number of bytes forward or back (from the end of this instruction), based on condition flags, return number of bytes used for op
+int jsjcBranchConditionalRelative(JsjAsmCondition cond, int bytes, JsjsEmitOptions options) {
+  // x86 condition codes for each of JSJAC_EQ..JSJAC_LE
+  static const uint8_t conds[14] = { 0x4, 0x5, 0x3, 0x2, 0x8, 0x9, 0x0, 0x1, 0x7, 0x6, 0xD, 0xC, 0xF, 0xE };
+  assert(cond<14);
+  // ARM's carry flag is the inverse of x86's after a compare, so don't allow conditions that use it
+  assert(cond!=JSJAC_CS && cond!=JSJAC_CC && cond!=JSJAC_HI && cond!=JSJAC_LI);
+  DEBUG_JIT("J<%s> %s%d (addr 0x%04x)\n", &JSJAC_STRINGS[cond*3], (bytes>=0)?"+":"", (uint32_t)(bytes), jsjcGetByteCount()+jsjcGetBranchConditionalRelativeLength(bytes, options)+bytes);
+  if (jsjcGetBranchConditionalRelativeLength(bytes, options)==2) {
+    jsjcEmit8((uint8_t)(0x70 | conds[cond]));
+    jsjcEmit8((uint8_t)bytes);
+    return 2;
+  } else {
+    jsjcEmit8(0x0F);
+    jsjcEmit8((uint8_t)(0x80 | conds[cond]));
+    jsjcEmit32((uint32_t)bytes);
+    return 6;
+  }
+}
+
+#ifdef DEBUG_JIT_CALLS
+void _jsjcCall(void *c, const char *name) {
+#else
+void jsjcCall(void *c) {
+#endif
+  uint64_t addr = (uint64_t)(size_t)c;
+  DEBUG_JIT("MOVABS rax,#0x%08x%08x\n", (uint32_t)(addr>>32), (uint32_t)addr);
+  jsjcEmit8(0x48); jsjcEmit8(0xB8);
+  jsjcEmit32((uint32_t)addr);
+  jsjcEmit32((uint32_t)(addr>>32));
+  // The ABI needs a 16 byte aligned stack, but we push/pop 8 bytes at a time
+  DEBUG_JIT("MOV rbx,rsp\n");
+  jsjcEmit8(0x48); jsjcEmit8(0x89); jsjcEmit8(0xE3);
+  DEBUG_JIT("AND rsp,#-16\n");
+  jsjcEmit8(0x48); jsjcEmit8(0x83); jsjcEmit8(0xE4); jsjcEmit8(0xF0);
+#ifdef DEBUG_JIT_CALLS
+  DEBUG_JIT("CALL rax (%s)\n", name);
+#else
+  DEBUG_JIT("CALL rax\n");
+#endif
+  jsjcEmit8(0xFF); jsjcEmit8(0xD0);
+  DEBUG_JIT("MOV rsp,rbx\n");
+  jsjcEmit8(0x48); jsjcEmit8(0x89); jsjcEmit8(0xDC);
+  // return value(s) -> r0,r1
+  DEBUG_JIT("MOV rdi,rax\n");
+  jsjcEmit8(0x48); jsjcEmit8(0x89); jsjcEmit8(0xC7);
+  DEBUG_JIT("MOV rsi,rdx\n");
+  jsjcEmit8(0x48); jsjcEmit8(0x89); jsjcEmit8(0xD6);
+}
+
+void jsjcMov(int regTo, int regFrom) {
+  DEBUG_JIT("MOV %s <- %s\n", REGNAME(regTo), REGNAME(regFrom));
+  int to = jsjcReg(regTo), from = jsjcReg(regFrom);
+  jsjcEmitREXW(from, to);
+  jsjcEmit8(0x89);
+  jsjcEmitModRMReg(from, to);
+}
+
+void jsjcAdd(int regTo, int regFrom, int lit) {
+  if (regTo != regFrom) jsjcMov(regTo, regFrom);
+  DEBUG_JIT("ADD %s,#%d\n", REGNAME(regTo), lit);
+  int r = jsjcReg(regTo);
+  jsjcEmitREXW(0, r);
+  jsjcEmit8(0x81);
+  jsjcEmitModRMReg(0, r);
+  jsjcEmit32((uint32_t)lit);
+}
+
+// Emit a 32 bit register-register op (ints are only 32 bits, and this sets the overflow flag correctly)
+static void jsjcEmitOp32(uint8_t opcode, int x86to, int x86from) {
+  if ((x86to|x86from)&8) jsjcEmit8((uint8_t)(0x40 | ((x86from&8)?4:0) | ((x86to&8)?1:0)));
+  jsjcEmit8(opcode);
+  jsjcEmitModRMReg(x86from, x86to);
+}
+
+void jsjcAddReg(int regTo, int regA, int regB) {
+  assert(regTo != regB);
+  if (regTo != regA) jsjcMov(regTo, regA);
+  DEBUG_JIT("ADD %s(32),%s(32)\n", REGNAME(regTo), REGNAME(regB));
+  jsjcEmitOp32(0x01, jsjcReg(regTo), jsjcReg(regB));
+}
+
+void jsjcSubReg(int regTo, int regA, int regB) {
+  assert(regTo != regB);
+  if (regTo != regA) jsjcMov(regTo, regA);
+  DEBUG_JIT("SUB %s(32),%s(32)\n", REGNAME(regTo), REGNAME(regB));
+  jsjcEmitOp32(0x29, jsjcReg(regTo), jsjcReg(regB));
+}
+
+// Move negated register
+void jsjcMVN(int regTo, int regFrom) {
+  if (regTo != regFrom) jsjcMov(regTo, regFrom);
+  DEBUG_JIT("NOT %s\n", REGNAME(regTo));
+  int r = jsjcReg(regTo);
+  jsjcEmitREXW(0, r);
+  jsjcEmit8(0xF7);
+  jsjcEmitModRMReg(2, r);
+}
+
+// regTo = regTo & regFrom
+void jsjcAND(int regTo, int regFrom) {
+  DEBUG_JIT("AND %s,%s\n", REGNAME(regTo), REGNAME(regFrom));
+  int to = jsjcReg(regTo), from = jsjcReg(regFrom);
+  jsjcEmitREXW(from, to);
+  jsjcEmit8(0x21);
+  jsjcEmitModRMReg(from, to);
+}
+
+void jsjcPushReg(int reg) {
+  DEBUG_JIT("PUSH %s\n", REGNAME(reg));
+  int r = jsjcReg(reg);
+  if (r&8) jsjcEmit8(0x41);
+  jsjcEmit8((uint8_t)(0x50 | (r&7)));
+}
+
+void jsjcPopReg(int reg) {
+  DEBUG_JIT("POP %s\n", REGNAME(reg));
+  int r = jsjcReg(reg);
+  if (r&8) jsjcEmit8(0x41);
+  jsjcEmit8((uint8_t)(0x58 | (r&7)));
+}
+
+void jsjcAddSP(int amt) {
+  assert((amt%JSJ_WORD_SIZE)==0 && amt>0);
+  jit.stackDepth -= amt/JSJ_WORD_SIZE; // stack grows down -> negate
+  DEBUG_JIT("ADD rsp,#%d   (stack depth now %d)\n", amt, jit.stackDepth);
+  jsjcEmit8(0x48); jsjcEmit8(0x81); jsjcEmit8(0xC4);
+  jsjcEmit32((uint32_t)amt);
+}
+
+void jsjcSubSP(int amt) {
+  assert((amt%JSJ_WORD_SIZE)==0 && amt>0);
+  jit.stackDepth += amt/JSJ_WORD_SIZE; // stack grows down -> negate
+  DEBUG_JIT("SUB rsp,#%d   (stack depth now %d)\n", amt, jit.stackDepth);
+  jsjcEmit8(0x48); jsjcEmit8(0x81); jsjcEmit8(0xEC);
+  jsjcEmit32((uint32_t)amt);
+}
+
+void jsjcLoadImm(int reg, int regAddr, int offset) {
+  DEBUG_JIT("MOV %s,[%s+%d]\n", REGNAME(reg), REGNAME(regAddr), offset);
+  int r = jsjcReg(reg), addr = jsjcReg(regAddr);
+  jsjcEmitREXW(r, addr);
+  jsjcEmit8(0x8B);
+  jsjcEmitModRMMem(r, addr, offset);
+}
+
+void jsjcStoreImm(int reg, int regAddr, int offset) {
+  DEBUG_JIT("MOV [%s+%d],%s\n", REGNAME(regAddr), offset, REGNAME(reg));
+  int r = jsjcReg(reg), addr = jsjcReg(regAddr);
+  jsjcEmitREXW(r, addr);
+  jsjcEmit8(0x89);
+  jsjcEmitModRMMem(r, addr, offset);
+}
+
+void jsjcPushAll() {
+  DEBUG_JIT("PUSH rbx,r12,r13,r14,r15\n");
+  jsjcEmit8(0x53);
+  for (int r=12;r<=15;r++) {
+    jsjcEmit8(0x41);
+    jsjcEmit8((uint8_t)(0x50 | (r&7)));
+  }
+}
+
+void jsjcPopAllAndReturn() {
+  DEBUG_JIT("MOV rax,rdi\n");
+  jsjcEmit8(0x48); jsjcEmit8(0x89); jsjcEmit8(0xF8);
+  DEBUG_JIT("POP r15,r14,r13,r12,rbx\n");
+  for (int r=15;r>=12;r--) {
+    jsjcEmit8(0x41);
+    jsjcEmit8((uint8_t)(0x58 | (r&7)));
+  }
+  jsjcEmit8(0x5B);
+  DEBUG_JIT("RET\n");
+  jsjcEmit8(0xC3);
+}
+
+#endif /* ESPR_JIT && JSJ_BACKEND_X86_64 */
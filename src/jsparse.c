@@ -26,6 +26,7 @@
 #ifdef ESPR_JIT
 #include "jsjit.h"
 #endif
+#include "jsbytecode.h"
 
 /* Info about execution when Parsing - this saves passing it on the stack
  * for each call */
@@ -88,9 +89,19 @@ void jspeiClearScopes() {
   execInfo.scopesVar = 0;
 }
 
+#ifndef ESPR_NO_FRAME_CACHE
+static JsVar *jspSpareScopes; ///< An empty scope list (locked) that jspeiRemoveScope finished with, ready for jspeiAddScope
+#endif
+
 bool jspeiAddScope(JsVar *scope) {
-  if (!execInfo.scopesVar)
-    execInfo.scopesVar = jsvNewEmptyArray();
+  if (!execInfo.scopesVar) {
+#ifndef ESPR_NO_FRAME_CACHE
+    execInfo.scopesVar = jspSpareScopes;
+    jspSpareScopes = 0;
+    if (!execInfo.scopesVar)
+#endif
+      execInfo.scopesVar = jsvNewEmptyArray();
+  }
   if (!execInfo.scopesVar) return false;
   jsvArrayPush(execInfo.scopesVar, scope);
   return true;
@@ -106,7 +117,13 @@ void jspeiRemoveScope() {
   }
   jsvUnLock(jsvArrayPop(execInfo.scopesVar));
   if (!jsvGetFirstChild(execInfo.scopesVar)) {
-    jsvUnLock(execInfo.scopesVar);
+#ifndef ESPR_NO_FRAME_CACHE
+    // keep the list for next time (unless something else has it)
+    if (!jspSpareScopes && !jsvGetRefs(execInfo.scopesVar) && jsvGetLocks(execInfo.scopesVar)==1)
+      jspSpareScopes = execInfo.scopesVar;
+    else
+#endif
+      jsvUnLock(execInfo.scopesVar);
     execInfo.scopesVar = 0;
   }
 }
@@ -220,6 +237,115 @@ void jspeiLoadScopesFromVar(JsVar *arr) {
     }
   }
 }
+
+#ifndef ESPR_NO_FRAME_CACHE
+/* Cache of execution scopes ('frames') of recently called functions.
+
+ Every call to a function creates a Function var for its execution scope,
+ plus a Name for each parameter. For JSV_SIMPLE_FUNCTIONs, if nothing else
+ references the scope when the function returns, we remove everything but
+ the parameters, clear their values and keep the scope here (locked, along
+ with the function). The next call to the same function just has to set the
+ parameters' values again.
+
+ Because the cache keeps functions locked, a function that is no longer used
+ (and the scope it was defined in) can't be freed while it's in the cache, so
+ the cache is emptied with jspClearFrameCache before each garbage collection. */
+#ifndef JSP_FRAME_CACHE_SIZE
+#define JSP_FRAME_CACHE_SIZE 4 // must be a power of 2
+#endif
+
+typedef struct {
+  JsVar *function; ///< the function (locked), or 0
+  JsVar *frame;    ///< its execution scope (locked)
+} JspFrameCache;
+
+static JspFrameCache jspFrameCache[JSP_FRAME_CACHE_SIZE];
+
+static JspFrameCache *jspeiGetFrameCache(JsVar *function) {
+  return &jspFrameCache[jsvGetRef(function) & (JSP_FRAME_CACHE_SIZE-1)];
+}
+
+/// Take the cached execution scope for this function (locked), or return 0
+static JsVar *jspeiTakeCachedFrame(JsVar *function) {
+  JspFrameCache *fc = jspeiGetFrameCache(function);
+  if (fc->function != function) return 0;
+  JsVar *frame = fc->frame;
+  jsvUnLock(fc->function);
+  fc->function = 0;
+  fc->frame = 0;
+  return frame;
+}
+
+/// A call to a function has finished - keep its execution scope if we can (and unlock it)
+static void jspeiCacheFrame(JsVar *function, JsVar *frame) {
+  // if anything else is using the scope (eg. a closure) we can't reuse it
+  if (jsvGetRefs(frame) || jsvGetLocks(frame)!=1) {
+    jsvUnLock(frame);
+    return;
+  }
+  // remove local variables, and clear the values of parameters
+  JsVarRef childref = jsvGetFirstChild(frame);
+  while (childref) {
+    JsVar *child = jsvLock(childref);
+    childref = jsvGetNextSibling(child);
+    if (jsvIsFunctionParameter(child))
+      jsvSetValueOfName(child, 0);
+    else
+      jsvRemoveChild(frame, child);
+    jsvUnLock(child);
+  }
+  JspFrameCache *fc = jspeiGetFrameCache(function);
+  jsvUnLock2(fc->function, fc->frame);
+  fc->function = jsvLockAgain(function);
+  fc->frame = frame;
+}
+
+/// Remove any parameters from a cached execution scope that weren't used this time
+static void jspeiRemoveUnusedFunctionParameters(JsVar *functionRoot, JsVarRef *reuse) {
+  while (*reuse) {
+    JsVar *existing = jsvLock(*reuse);
+    *reuse = jsvGetNextSibling(existing);
+    jsvRemoveChild(functionRoot, existing);
+    jsvUnLock(existing);
+  }
+}
+
+/** Set up the next parameter of a function's execution scope. If the scope
+ * came from the frame cache, *reuse is the next parameter it already has */
+static void jspeiAddFunctionParameter(JsVar *functionRoot, JsVarRef *reuse, JsVar *param, JsVar *value) {
+  if (*reuse) {
+    JsVar *existing = jsvLock(*reuse);
+    // extra (unnamed) arguments may not match up with the last call
+    if ((jsvGetCharactersInVar(existing)==0) == (param==0)) {
+      *reuse = jsvGetNextSibling(existing);
+      jsvSetValueOfName(existing, value);
+      jsvUnLock(existing);
+      return;
+    }
+    jsvUnLock(existing);
+    jspeiRemoveUnusedFunctionParameters(functionRoot, reuse);
+  }
+  jsvAddFunctionParameter(functionRoot, param?jsvNewFromStringVar(param,1,JSVAPPENDSTRINGVAR_MAXLENGTH):0, value);
+}
+
+/// Unlock everything in the frame cache
+void jspClearFrameCache() {
+  for (int i=0;i<JSP_FRAME_CACHE_SIZE;i++) {
+    jsvUnLock2(jspFrameCache[i].function, jspFrameCache[i].frame);
+    jspFrameCache[i].function = 0;
+    jspFrameCache[i].frame = 0;
+  }
+  jsvUnLock(jspSpareScopes);
+  jspSpareScopes = 0;
+}
+#else
+void jspClearFrameCache() {
+}
+#define jspeiAddFunctionParameter(functionRoot, reuse, param, value) jsvAddFunctionParameter(functionRoot, (param)?jsvNewFromStringVar(param,1,JSVAPPENDSTRINGVAR_MAXLENGTH):0, value)
+#define jspeiRemoveUnusedFunctionParameters(functionRoot, reuse)
+#endif
+
 // -----------------------------------------------
 /// Check that we have enough stack to recurse. Return true if all ok, error if not.
 bool jspCheckStackPosition() {
@@ -368,8 +494,9 @@ NO_INLINE bool jspeFunctionDefinitionInternal(JsVar *funcVar, bool expressionOnl
           JsVar *funcScopeVar = jspeiGetScopesAsVar();
           if (funcScopeVar)
             jsvAddNamedChildAndUnLock(funcVar, funcScopeVar, JSPARSE_FUNCTION_SCOPE_NAME);
-          JSP_MATCH('}');
           jslCharPosFree(&funcCodeStart);
+          jsvUnLock(tokenValue);
+          JSP_MATCH('}');
           return true;
         } else {
           if (funcCodeVar) {
@@ -407,6 +534,12 @@ NO_INLINE bool jspeFunctionDefinitionInternal(JsVar *funcVar, bool expressionOnl
   jslCharPosNew(&funcBegin, lex->sourceVar, lex->tokenStart);
   int lastTokenEnd = -1;
   lex->hadThisKeyword = lex->tk == LEX_R_THIS;
+#ifndef ESPR_NO_FRAME_CACHE
+  /* If the function has no nested functions and doesn't use 'arguments' or
+   * 'eval', nothing can keep a reference to its execution scope once it
+   * returns - so jspeFunctionCall can reuse the scope for the next call */
+  bool isSimpleFunction = !expressionOnly;
+#endif
   if (!expressionOnly) {
     int brackets = 0;
     JsExecFlags oldExec = execInfo.execute;
@@ -414,6 +547,12 @@ NO_INLINE bool jspeFunctionDefinitionInternal(JsVar *funcVar, bool expressionOnl
     while (lex->tk && (brackets || lex->tk != '}')) {
       if (lex->tk == '{') brackets++;
       if (lex->tk == '}') brackets--;
+#ifndef ESPR_NO_FRAME_CACHE
+      if (lex->tk == LEX_R_FUNCTION || lex->tk == LEX_ARROW_FUNCTION || lex->tk == LEX_R_CLASS ||
+          (lex->tk == LEX_ID && (!strcmp(jslGetTokenValueAsString(), "arguments") ||
+                                 !strcmp(jslGetTokenValueAsString(), "eval"))))
+        isSimpleFunction = false;
+#endif
       lastTokenEnd = (int)jsvStringIteratorGetIndex(&lex->it)-1;
       JSP_ASSERT_MATCH(lex->tk);
     }
@@ -427,6 +566,10 @@ NO_INLINE bool jspeFunctionDefinitionInternal(JsVar *funcVar, bool expressionOnl
     lastTokenEnd = (int)lex->tokenStart;
   }
   bool hadThisKeyword = lex->hadThisKeyword;
+#ifndef ESPR_NO_FRAME_CACHE
+  if (funcVar && isSimpleFunction)
+    funcVar->flags |= JSV_SIMPLE_FUNCTION;
+#endif
   // Then create var and set (if there was any code!)
   if (funcVar && lastTokenEnd>0) {
     // code var
@@ -673,9 +816,16 @@ NO_INLINE JsVar *jspeFunctionCall(JsVar *function, JsVar *functionName, JsVar *t
 
     } else { // ----------------------------------------------------- NOT NATIVE
       // create a new symbol table entry for execution of this function
-      // OPT: can we cache this function execution environment + param variables?
-      // OPT: Probably when calling a function ONCE, use it, otherwise when recursing, make new?
-      JsVar *functionRoot = jsvNewWithFlags(JSV_FUNCTION);
+      JsVar *functionRoot = 0;
+#ifndef ESPR_NO_FRAME_CACHE
+      // or reuse the one from the last time it was called
+      bool isSimpleFunction = (function->flags & JSV_SIMPLE_FUNCTION)!=0;
+      if (isSimpleFunction)
+        functionRoot = jspeiTakeCachedFrame(function);
+      JsVarRef reuseParam = functionRoot ? jsvGetFirstChild(functionRoot) : 0;
+#endif
+      if (!functionRoot)
+        functionRoot = jsvNewWithFlags(JSV_FUNCTION);
       if (!functionRoot) { // out of memory
         jspSetError(false);
         jsvUnLock(thisVar);
@@ -705,7 +855,7 @@ NO_INLINE JsVar *jspeFunctionCall(JsVar *function, JsVar *functionName, JsVar *t
       JsVar *param = jsvObjectIteratorGetKey(&it);
       JsVar *value = jsvObjectIteratorGetValue(&it);
       while (jsvIsFunctionParameter(param) && value) {
-        jsvAddFunctionParameter(functionRoot, jsvNewFromStringVar(param,1,JSVAPPENDSTRINGVAR_MAXLENGTH), value);
+        jspeiAddFunctionParameter(functionRoot, &reuseParam, param, value);
         jsvUnLock2(value, param);
         jsvObjectIteratorNext(&it);
         param = jsvObjectIteratorGetKey(&it);
@@ -727,7 +877,7 @@ NO_INLINE JsVar *jspeFunctionCall(JsVar *function, JsVar *functionName, JsVar *t
               value = jspeAssignmentExpression();
             // and if execute, copy it over
             value = jsvSkipNameAndUnLock(value);
-            jsvAddFunctionParameter(functionRoot, paramDefined?jsvNewFromStringVar(param,1,JSVAPPENDSTRINGVAR_MAXLENGTH):0, value);
+            jspeiAddFunctionParameter(functionRoot, &reuseParam, paramDefined?param:0, value);
             jsvUnLock(value);
             if (lex->tk!=')') JSP_MATCH(',');
           }
@@ -740,7 +890,7 @@ NO_INLINE JsVar *jspeFunctionCall(JsVar *function, JsVar *functionName, JsVar *t
         while (args<argCount) {
           JsVar *param = jsvObjectIteratorGetKey(&it);
           bool paramDefined = jsvIsFunctionParameter(param);
-          jsvAddFunctionParameter(functionRoot, paramDefined?jsvNewFromStringVar(param,1,JSVAPPENDSTRINGVAR_MAXLENGTH):0, argPtr[args]);
+          jspeiAddFunctionParameter(functionRoot, &reuseParam, paramDefined?param:0, argPtr[args]);
           args++;
           jsvUnLock(param);
           if (paramDefined) jsvObjectIteratorNext(&it);
@@ -765,7 +915,7 @@ NO_INLINE JsVar *jspeFunctionCall(JsVar *function, JsVar *functionName, JsVar *t
 #endif
           else if (jsvIsFunctionParameter(param)) {
             JsVar *defaultVal = jsvSkipName(param);
-            jsvAddFunctionParameter(functionRoot, jsvNewFromStringVar(param,1,JSVAPPENDSTRINGVAR_MAXLENGTH), defaultVal);
+            jspeiAddFunctionParameter(functionRoot, &reuseParam, param, defaultVal);
             jsvUnLock(defaultVal);
           }
         }
@@ -773,6 +923,8 @@ NO_INLINE JsVar *jspeFunctionCall(JsVar *function, JsVar *functionName, JsVar *t
         jsvObjectIteratorNext(&it);
       }
       jsvObjectIteratorFree(&it);
+      // if the last call had more arguments, remove them
+      jspeiRemoveUnusedFunctionParameters(functionRoot, &reuseParam);
 
       // setup a the function's name (if a named function)
       if (functionInternalName) {
@@ -814,7 +966,7 @@ NO_INLINE JsVar *jspeFunctionCall(JsVar *function, JsVar *functionName, JsVar *t
           if (functionIsJIT) {
             void *nativePtr = jsvGetFlatStringPointer(functionCode);
             if (nativePtr)
-              returnVar = jsnCallFunction(nativePtr+1/*thumb*/, JSWAT_JSVAR/*JS Variable as return type*/, thisVar, NULL, 0);
+              returnVar = jsnCallFunction(JSJ_CODE_ENTRY(nativePtr), JSWAT_JSVAR/*JS Variable as return type*/, thisVar, NULL, 0);
           } else
 #endif
           /* we just want to execute the block, but something could
@@ -931,7 +1083,13 @@ NO_INLINE JsVar *jspeFunctionCall(JsVar *function, JsVar *functionName, JsVar *t
         jsvUnLock(execInfo.scopesVar);
         execInfo.scopesVar = oldScopeVar;
       }
-      jsvUnLock2(functionCode, functionRoot);
+      jsvUnLock(functionCode);
+#ifndef ESPR_NO_FRAME_CACHE
+      if (isSimpleFunction)
+        jspeiCacheFrame(function, functionRoot);
+      else
+#endif
+        jsvUnLock(functionRoot);
     }
 
     jsvUnLock(thisVar);
@@ -981,6 +1139,50 @@ JsVar *jspGetNamedVariable(const char *tokenName) {
   return a;
 }
 
+/** Given a field found for 'name' in one of object's prototypes (or a built-in), strip
+ * the name if there is one, and create a new name that references 'object' instead. */
+static JsVar *jspNewNameInParentAndUnLock(JsVar *object, const char* name, JsVar *child) {
+  // Get rid of existing name
+  if (jsvIsName(child)) {
+    JsVar *t = jsvGetValueOfName(child);
+    jsvUnLock(child);
+    child = t;
+  }
+  // create a new name
+  JsVar *nameVar = jsvNewNameFromString(name);
+  JsVar *newChild = jsvCreateNewChild(object, nameVar, child);
+  jsvUnLock2(nameVar, child);
+  child = newChild;
+  if (child && jsvIsArray(object) && !strcmp(name,"length"))
+    child->flags |= JSV_CONSTANT;
+  return child;
+}
+
+/// If a field wasn't found anywhere, create it if it's one that should always exist (prototype/__proto__)
+static JsVar *jspCreateMissingField(JsVar *object, const char* name) {
+  JsVar *child = 0;
+  if (jsvIsFunction(object) && strcmp(name, JSPARSE_PROTOTYPE_VAR)==0) {
+    // prototype is supposed to be an object
+    JsVar *proto = jsvNewObject();
+    // make sure it has a 'constructor' variable that points to the object it was part of
+    jsvObjectSetChild(proto, JSPARSE_CONSTRUCTOR_VAR, object);
+    child = jsvAddNamedChild(object, proto, JSPARSE_PROTOTYPE_VAR);
+    jspEnsureIsPrototype(object, child);
+    jsvUnLock(proto);
+  } else if (strcmp(name, JSPARSE_INHERITS_VAR)==0) {
+    const char *objName = jswGetBasicObjectName(object);
+    if (objName) {
+      JsVar *p = jsvSkipNameAndUnLock(jspNewPrototype(objName, false/*prototype*/));
+      // jspNewPrototype returns a 'prototype' name that's already a child of eg. an array
+      // Create a new 'name' called __proto__ that links to it
+      JsVar *i = jsvNewNameFromString(JSPARSE_INHERITS_VAR);
+      if (p) child = jsvCreateNewChild(object, i, p);
+      jsvUnLock2(p, i);
+    }
+  }
+  return child;
+}
+
 /// Used by jspGetNamedField / jspGetVarNamedField
 static NO_INLINE JsVar *jspGetNamedFieldInParents(JsVar *object, const char* name, bool returnName) {
   // Now look in prototypes
@@ -1001,44 +1203,12 @@ static NO_INLINE JsVar *jspGetNamedFieldInParents(JsVar *object, const char* nam
    * a new name that references the object we actually requested the
    * member from..
    */
-  if (child && returnName) {
-    // Get rid of existing name
-    if (jsvIsName(child)) {
-      JsVar *t = jsvGetValueOfName(child);
-      jsvUnLock(child);
-      child = t;
-    }
-    // create a new name
-    JsVar *nameVar = jsvNewNameFromString(name);
-    JsVar *newChild = jsvCreateNewChild(object, nameVar, child);
-    jsvUnLock2(nameVar, child);
-    child = newChild;
-    if (child && jsvIsArray(object) && !strcmp(name,"length"))
-      child->flags |= JSV_CONSTANT;
-  }
+  if (child && returnName)
+    child = jspNewNameInParentAndUnLock(object, name, child);
 
   // If not found and is the prototype, create it
-  if (!child) {
-    if (jsvIsFunction(object) && strcmp(name, JSPARSE_PROTOTYPE_VAR)==0) {
-      // prototype is supposed to be an object
-      JsVar *proto = jsvNewObject();
-      // make sure it has a 'constructor' variable that points to the object it was part of
-      jsvObjectSetChild(proto, JSPARSE_CONSTRUCTOR_VAR, object);
-      child = jsvAddNamedChild(object, proto, JSPARSE_PROTOTYPE_VAR);
-      jspEnsureIsPrototype(object, child);
-      jsvUnLock(proto);
-    } else if (strcmp(name, JSPARSE_INHERITS_VAR)==0) {
-      const char *objName = jswGetBasicObjectName(object);
-      if (objName) {
-        JsVar *p = jsvSkipNameAndUnLock(jspNewPrototype(objName, false/*prototype*/));
-        // jspNewPrototype returns a 'prototype' name that's already a child of eg. an array
-        // Create a new 'name' called __proto__ that links to it
-        JsVar *i = jsvNewNameFromString(JSPARSE_INHERITS_VAR);
-        if (p) child = jsvCreateNewChild(object, i, p);
-        jsvUnLock2(p, i);
-      }
-    }
-  }
+  if (!child)
+    child = jspCreateMissingField(object, name);
 
   return child;
 }
@@ -1114,6 +1284,202 @@ JsVar *jspGetVarNamedField(JsVar *object, JsVar *nameVar, bool returnName) {
   else return jsvSkipNameAndUnLock(child);
 }
 
+#ifndef ESPR_NO_INLINE_CACHE
+/* Inline cache for `a.b` member access. Each access is keyed on the code
+ * string and position of `b` within it, and remembers where `b` was found
+ * last time, which object it was looked up on, and which objects were searched
+ * to find it (the object, its prototypes, and the constructors they were found
+ * through). While none of those objects have had properties added or removed (see
+ * jsvObjectChanged) and jsvPropertyVersion is the same, we can skip searching the
+ * object, its prototypes and the built-in symbol tables. */
+#ifndef JSP_MEMBER_CACHE_SIZE
+#define JSP_MEMBER_CACHE_SIZE 32 // must be a power of 2
+#endif
+
+typedef enum {
+  JSPMC_EMPTY,     ///< nothing cached
+  JSPMC_OWN,       ///< a child of the object itself
+  JSPMC_INHERITED, ///< a child of one of the object's prototypes
+  JSPMC_BUILTIN,   ///< a built-in function
+  JSPMC_MISSING,   ///< not found anywhere
+} PACKED_FLAGS JspMemberCacheType;
+
+typedef struct {
+  unsigned int version;   ///< jsvLookupDepsVersion of 'deps' when this entry was filled in
+  size_t position;        ///< position of the member's name in the code
+  size_t objectKind;      ///< see jspMemberCacheObjectKind
+  uint32_t nameHash;      ///< hash of the member's name
+  JsVarRef code;          ///< lex->sourceVar the member access is in
+  JsVarRef object;        ///< the object the member was looked up on
+  JsVarFlags objectType;  ///< type of the object, in case it was freed and its ref reused
+  JsVarRef deps[JSV_LOOKUP_DEPS]; ///< the objects that were searched
+  unsigned char depCount;
+  JspMemberCacheType type;
+  union {
+    JsVarRef name;        ///< JSPMC_OWN/JSPMC_INHERITED - the name that was found
+    struct {
+      void (*ptr)(void);
+      unsigned short argTypes;
+    } native;             ///< JSPMC_BUILTIN - the function that was found
+  } found;
+} JspMemberCache;
+
+static JspMemberCache jspMemberCache[JSP_MEMBER_CACHE_SIZE];
+unsigned int jspMemberCacheHits = 0;
+
+/// Built-in members also depend on which native function or ArrayBuffer type an object is
+static size_t jspMemberCacheObjectKind(JsVar *object) {
+  if (jsvIsNativeFunction(object)) return (size_t)object->varData.native.ptr;
+  if (jsvIsArrayBuffer(object)) return (size_t)object->varData.arraybuffer.type;
+  return 0;
+}
+
+/// The same as jspGetNamedField(object, name, true), but using the inline cache for the member name at 'position' in the current code
+static NO_INLINE JsVar *jspGetNamedFieldCached(JsVar *object, const char* name, size_t position) {
+  // prototype is created specially if it doesn't exist
+  if (!lex->sourceVar || strcmp(name, JSPARSE_PROTOTYPE_VAR)==0)
+    return jspGetNamedField(object, name, true);
+
+  uint32_t nameHash = jsHashString(name, (size_t)-1);
+  JsVarRef code = jsvGetRef(lex->sourceVar);
+  JsVarRef objectRef = jsvGetRef(object);
+  JsVarFlags objectType = object->flags & JSV_VARTYPEMASK;
+  size_t objectKind = jspMemberCacheObjectKind(object);
+  JspMemberCache *mc = &jspMemberCache[(position ^ ((size_t)code*13)) & (JSP_MEMBER_CACHE_SIZE-1)];
+
+  if (mc->type!=JSPMC_EMPTY &&
+      mc->position==position && mc->code==code &&
+      mc->object==objectRef && mc->objectType==objectType && mc->objectKind==objectKind &&
+      mc->nameHash==nameHash && mc->version==jsvLookupDepsVersion(mc->deps, mc->depCount)) {
+    jspMemberCacheHits++;
+    if (mc->type==JSPMC_MISSING) return 0;
+    if (mc->type==JSPMC_BUILTIN) {
+      JsVar *fn = jsvNewNativeFunction(mc->found.native.ptr, mc->found.native.argTypes);
+      return fn ? jspNewNameInParentAndUnLock(object, name, fn) : 0;
+    }
+    JsVar *child = jsvLock(mc->found.name);
+    if (jsvIsStringEqual(child, name))
+      return (mc->type==JSPMC_OWN) ? child : jspNewNameInParentAndUnLock(object, name, child);
+    jsvUnLock(child);
+  }
+
+  // Not cached - look it up as jspGetNamedField would, but remember where we found it and what we searched
+  JsvLookupDeps deps;
+  deps.count = 0;
+  jsvLookupDeps = &deps;
+  JspMemberCacheType type = JSPMC_MISSING;
+  JsVar *child = jsvHasChildren(object) ? jsvFindChildFromString(object, name) : 0;
+  if (child) {
+    type = JSPMC_OWN;
+    mc->found.name = jsvGetRef(child);
+  } else {
+    child = jspeiFindChildFromStringInParents(object, name);
+    if (child) {
+      type = jsvIsName(child) ? JSPMC_INHERITED : JSPMC_EMPTY;
+      mc->found.name = jsvGetRef(child);
+    } else {
+      child = jswFindBuiltInFunction(object, name);
+      // if the built-in was a native function (not a property) we can just recreate it next time
+      if (child && jsvIsNativeFunction(child) && !jsvGetFirstChild(child)) {
+        type = JSPMC_BUILTIN;
+        mc->found.native.ptr = child->varData.native.ptr;
+        mc->found.native.argTypes = child->varData.native.argTypes;
+      } else if (child)
+        type = JSPMC_EMPTY;
+    }
+    jsvLookupDeps = 0;
+    if (child) {
+      child = jspNewNameInParentAndUnLock(object, name, child);
+    } else {
+      child = jspCreateMissingField(object, name);
+      if (child) type = JSPMC_EMPTY;
+    }
+  }
+  jsvLookupDeps = 0;
+  if (deps.count > JSV_LOOKUP_DEPS) { // searched too much to remember
+    type = JSPMC_EMPTY;
+    deps.count = 0;
+  }
+  // Looking up could have changed things (eg. adding built-in prototypes), so get the version now
+  memcpy(mc->deps, deps.refs, deps.count*sizeof(JsVarRef));
+  mc->depCount = deps.count;
+  mc->version = jsvLookupDepsVersion(deps.refs, deps.count);
+  mc->position = position;
+  mc->objectKind = objectKind;
+  mc->nameHash = nameHash;
+  mc->code = code;
+  mc->object = objectRef;
+  mc->objectType = objectType;
+  mc->type = type;
+  return child;
+}
+#endif
+
+JsVar *jspGetMemberName(JsVar *object, const char *name, size_t position) {
+  JsVar *child = 0;
+  if (object) {
+#ifndef ESPR_NO_INLINE_CACHE
+    child = jspGetNamedFieldCached(object, name, position);
+#else
+    NOT_USED(position);
+    child = jspGetNamedField(object, name, true);
+#endif
+  }
+  if (!child) {
+    if (!jsvIsNullish(object)) {
+      // if no child found, create a pointer to where it could be
+      // as we don't want to allocate it until it's written
+      JsVar *nameVar = jsvNewNameFromString(name);
+      child = jsvCreateNewChild(object, nameVar, 0);
+      jsvUnLock(nameVar);
+    } else {
+      // could have been a string...
+      jsExceptionHere(JSET_ERROR, "Can't read property '%s' of %s", name, jsvIsUndefined(object) ? "undefined" : "null");
+    }
+  }
+  return child;
+}
+
+JsVar *jspGetMemberNameVar(JsVar *object, JsVar *index) {
+  JsVar *child = 0;
+  if (object)
+    child = jspGetVarNamedField(object, index, true);
+  if (!child) {
+    if (jsvHasChildren(object)) {
+      // if no child found, create a pointer to where it could be
+      // as we don't want to allocate it until it's written
+      child = jsvCreateNewChild(object, index, 0);
+    } else {
+      jsExceptionHere(JSET_ERROR, "Field or method %q does not already exist, and can't create it on %t", index, object);
+    }
+  }
+  return child;
+}
+
+JsVar *jspNameWithParentAndUnLock(JsVar *a, JsVar *parent) {
+#ifndef ESPR_NO_GET_SET
+  /* If we've got something that we care about the parent of (eg. a getter/setter)
+   * then we repackage it into a 'NewChild' name that references the parent before
+   * we leave. Note: You can't do this on everything because normally NewChild
+   * forces a new child to be blindly created. It works on Getters/Setters because
+   * we *always* run those rather than adding them.
+   */
+  if (parent && jsvIsBasicName(a) && !jsvIsNewChild(a)) {
+    JsVar *value = jsvLockSafe(jsvGetFirstChild(a));
+    if (jsvIsGetterOrSetter(value)) { // no need to do this for functions since we've just executed whatever we needed to
+      JsVar *nameVar = jsvCopyNameOnly(a,false,true);
+      JsVar *newChild = jsvCreateNewChild(parent, nameVar, value);
+      jsvUnLock2(nameVar, a);
+      a = newChild;
+    }
+    jsvUnLock(value);
+  }
+#else
+  NOT_USED(parent);
+#endif
+  return a;
+}
+
 NO_INLINE JsVar *jspeFactorMember(JsVar *a, JsVar **parentResult) {
   /* The parent if we're executing a method call */
   JsVar *parent = 0;
@@ -1127,21 +1493,7 @@ NO_INLINE JsVar *jspeFactorMember(JsVar *a, JsVar **parentResult) {
           const char *name = jslGetTokenValueAsString();
 
           JsVar *aVar = jsvSkipNameWithParent(a,true,parent);
-          JsVar *child = 0;
-          if (aVar)
-            child = jspGetNamedField(aVar, name, true);
-          if (!child) {
-            if (!jsvIsNullish(aVar)) {
-              // if no child found, create a pointer to where it could be
-              // as we don't want to allocate it until it's written
-              JsVar *nameVar = jsvNewNameFromString(jslGetTokenValueAsString());
-              child = jsvCreateNewChild(aVar, nameVar, 0);
-              jsvUnLock(nameVar);
-            } else {
-              // could have been a string...
-              jsExceptionHere(JSET_ERROR, "Can't read property '%s' of %s", name, jsvIsUndefined(aVar) ? "undefined" : "null");
-            }
-          }
+          JsVar *child = jspGetMemberName(aVar, name, lex->tokenStart);
           jsvUnLock(parent);
           parent = aVar;
           jsvUnLock(a);
@@ -1162,19 +1514,7 @@ NO_INLINE JsVar *jspeFactorMember(JsVar *a, JsVar **parentResult) {
       if (JSP_SHOULD_EXECUTE) {
         index = jsvAsArrayIndexAndUnLock(index);
         JsVar *aVar = jsvSkipNameWithParent(a,true,parent);
-        JsVar *child = 0;
-        if (aVar)
-          child = jspGetVarNamedField(aVar, index, true);
-
-        if (!child) {
-          if (jsvHasChildren(aVar)) {
-            // if no child found, create a pointer to where it could be
-            // as we don't want to allocate it until it's written
-            child = jsvCreateNewChild(aVar, index, 0);
-          } else {
-            jsExceptionHere(JSET_ERROR, "Field or method %q does not already exist, and can't create it on %t", index, aVar);
-          }
-        }
+        JsVar *child = jspGetMemberNameVar(aVar, index);
         jsvUnLock(parent);
         parent = jsvLockAgainSafe(aVar);
         jsvUnLock(a);
@@ -1344,24 +1684,7 @@ NO_INLINE JsVar *jspeFactorFunctionCall() {
     execInfo.currentClassConstructor = 0;
 #endif
 
-#ifndef ESPR_NO_GET_SET
-  /* If we've got something that we care about the parent of (eg. a getter/setter)
-   * then we repackage it into a 'NewChild' name that references the parent before
-   * we leave. Note: You can't do this on everything because normally NewChild
-   * forces a new child to be blindly created. It works on Getters/Setters because
-   * we *always* run those rather than adding them.
-   */
-  if (parent && jsvIsBasicName(a) && !jsvIsNewChild(a)) {
-    JsVar *value = jsvLockSafe(jsvGetFirstChild(a));
-    if (jsvIsGetterOrSetter(value)) { // no need to do this for functions since we've just executed whatever we needed to
-      JsVar *nameVar = jsvCopyNameOnly(a,false,true);
-      JsVar *newChild = jsvCreateNewChild(parent, nameVar, value);
-      jsvUnLock2(nameVar, a);
-      a = newChild;
-    }
-    jsvUnLock(value);
-  }
-#endif
+  a = jspNameWithParentAndUnLock(a, parent);
   jsvUnLock(parent);
   return a;
 }
@@ -2606,6 +2929,15 @@ NO_INLINE JsVar *jspeStatementDoOrWhile(bool isWhile) {
   JslCharPos whileBodyEnd;
   jslCharPosNew(&whileBodyEnd, lex->sourceVar, lex->tokenStart);
 
+#ifndef ESPR_NO_BYTECODE
+  if (!hasHadBreak && loopCond && JSP_SHOULD_EXECUTE) {
+    // Try and compile the rest of the loop to bytecode and run that instead
+    execInfo.execute |= EXEC_IN_LOOP;
+    if (jsbExecuteLoop(isWhile ? JSBLT_WHILE : JSBLT_DO_WHILE, isWhile ? &whileCondStart : &whileBodyStart))
+      loopCond = false;
+    if (!wasInLoop) execInfo.execute &= (JsExecFlags)~EXEC_IN_LOOP;
+  }
+#endif
   int loopCount = 0;
   while (!hasHadBreak && loopCond
 #ifdef JSPARSE_MAX_LOOP_ITERATIONS
@@ -2825,6 +3157,15 @@ NO_INLINE JsVar *jspeStatementFor() {
       jslSeekToP(&forIterStart);
       if (lex->tk != ')') jsvUnLock(jspeExpression());
     }
+#ifndef ESPR_NO_BYTECODE
+    if (!hasHadBreak && JSP_SHOULD_EXECUTE && loopCond) {
+      // Try and compile the rest of the loop to bytecode and run that instead
+      execInfo.execute |= EXEC_IN_LOOP;
+      if (jsbExecuteLoop(JSBLT_FOR, &forCondStart))
+        loopCond = false;
+      if (!wasInLoop) execInfo.execute &= (JsExecFlags)~EXEC_IN_LOOP;
+    }
+#endif
     while (!hasHadBreak && JSP_SHOULD_EXECUTE && loopCond
 #ifdef JSPARSE_MAX_LOOP_ITERATIONS
         && loopCount-->0
@@ -3233,6 +3574,7 @@ void jspSoftInit() {
 }
 
 void jspSoftKill() {
+  jspClearFrameCache();
 #ifndef ESPR_NO_LET_SCOPING
   assert(execInfo.baseScope==execInfo.root);
   assert(execInfo.blockScope==0);
@@ -23,6 +23,8 @@ void jspKill();
 // jspSoft* - 'release' or 'claim' anything we are using, but ensure that it doesn't get freed
 void jspSoftInit(); ///< used when recovering from or saving to flash
 void jspSoftKill(); ///< used when recovering from or saving to flash
+/// Unlock the execution scopes (and functions) kept for reuse by simple functions, so they can be freed
+void jspClearFrameCache();
 /** Returns true if the constructor function given is the same as that
  * of the object with the given name. */
 bool jspIsConstructor(JsVar *constructor, const char *constructorName);
@@ -207,6 +209,20 @@ JsVar *jspGetNamedVariable(const char *tokenName);
 JsVar *jspGetNamedField(JsVar *object, const char* name, bool returnName);
 JsVar *jspGetVarNamedField(JsVar *object, JsVar *nameVar, bool returnName);
 
+/** Get `object.name` as a name (as `a.b` would). If it doesn't exist, a name is returned that
+ * adds it to object when assigned to. 'position' is where 'name' is in the current code,
+ * which is used for caching lookups */
+JsVar *jspGetMemberName(JsVar *object, const char *name, size_t position);
+#ifndef ESPR_NO_INLINE_CACHE
+/// How many times jspGetMemberName has found its result in the inline cache (for tests)
+extern unsigned int jspMemberCacheHits;
+#endif
+/// The same as jspGetMemberName but for `object[index]`. jsvAsArrayIndex should already have been called on index
+JsVar *jspGetMemberNameVar(JsVar *object, JsVar *index);
+/** If name (from jspGetMemberName/etc) refers to a getter or setter, replace it with a name
+ * that references parent so the getter/setter is called with the right `this` */
+JsVar *jspNameWithParentAndUnLock(JsVar *name, JsVar *parent);
+
 // These are exported for the Web IDE's compiler. See exportPtrs in jswrap_process.c
 JsVar *jspeiFindInScopes(const char *name);
 
@@ -614,6 +614,12 @@ char itoch(int val) {
   return (char)('a'+val-10);
 }
 
+uint32_t jsHashString(const char *s, size_t maxLength) {
+  uint32_t hash = JS_HASH_INITIAL;
+  while (maxLength-- && *s) hash = jsHashChar(hash, *(s++));
+  return hash;
+}
+
 void itostr_extra(JsVarInt vals,char *str,bool signedVal, unsigned int base) {
   JsVarIntUnsigned val;
   // handle negative numbers
@@ -823,29 +829,51 @@ void vcbprintf(
         bool quoted = fmtChar!='v';
         bool isJSONStyle = fmtChar=='Q';
         if (quoted) user_callback("\"",user_data);
-        JsVar *v = jsvAsString(va_arg(argp, JsVar*));
+        JsVar *v = va_arg(argp, JsVar*);
+        // we can iterate over the characters in a name (eg. an object's key) directly, so don't copy it
+        v = (jsvHasCharacterData(v) && jsvIsName(v)) ? jsvLockAgain(v) : jsvAsString(v);
         if (jsvIsUTF8String(v)) isJSONStyle=true; // if it's a UTF8 string make sure we escape in UTF8 form to force Espruino to re-create it as a UTF8 string when parsing
-        buf[1] = 0;
         if (jsvIsString(v)) {
+          // characters that don't need escaping are collected in buf and sent in one go
+          size_t bufLen = 0;
           JsvStringIterator it;
           jsvStringIteratorNewUTF8(&it, v, 0);
           if (quoted) {
             int ch = jsvStringIteratorGetUTF8CharAndNext(&it);
             while (jsvStringIteratorHasChar(&it) || ch>=0) {
               int nextCh = jsvStringIteratorGetUTF8CharAndNext(&it);
-              if (quoted) {
-                user_callback(escapeCharacter(ch, nextCh, isJSONStyle), user_data);
+              if (ch>=32 && ch<127 && ch!='"' && ch!='\\') {
+                buf[bufLen++] = (char)ch;
               } else {
+                if (bufLen) {
+                  buf[bufLen] = 0;
+                  user_callback(buf,user_data);
+                  bufLen = 0;
+                }
+                user_callback(escapeCharacter(ch, nextCh, isJSONStyle), user_data);
+              }
+              if (bufLen == sizeof(buf)-1) {
+                buf[bufLen] = 0;
                 user_callback(buf,user_data);
+                bufLen = 0;
               }
               ch = nextCh;
             }
-          } else { // OPT: this could be faster than it is (sending whole blocks at once)
+          } else {
             while (jsvStringIteratorHasChar(&it)) {
-              buf[0] = jsvStringIteratorGetCharAndNext(&it);
-              user_callback(buf,user_data);
+              char ch = jsvStringIteratorGetCharAndNext(&it);
+              if (ch) buf[bufLen++] = ch; // a 0 would terminate buf early (and was never printed anyway)
+              if (bufLen == sizeof(buf)-1) {
+                buf[bufLen] = 0;
+                user_callback(buf,user_data);
+                bufLen = 0;
+              }
             }
           }
+          if (bufLen) {
+            buf[bufLen] = 0;
+            user_callback(buf,user_data);
+          }
           jsvStringIteratorFree(&it);
           jsvUnLock(v);
         }
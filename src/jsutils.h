@@ -54,6 +54,15 @@
 #define ESPR_NO_PRETOKENISE 1
 #define ESPR_NO_TEMPLATE_LITERAL 1
 #define ESPR_NO_SOFTWARE_SERIAL 1
+#define ESPR_NO_INCREMENTAL_GC 1
+#define ESPR_NO_OBJECT_INDEX 1
+#define ESPR_NO_ARRAY_INDEX 1
+#define ESPR_NO_INLINE_CACHE 1
+#define ESPR_NO_BYTECODE 1
+#define ESPR_NO_FRAME_CACHE 1
+#define ESPR_NO_KEY_ATOMS 1
+#define ESPR_NO_JSON_SCANNER 1
+#define ESPR_NO_TIMER_HEAP 1
 #ifndef ESPR_NO_SOFTWARE_I2C
   #define ESPR_NO_SOFTWARE_I2C 1
 #endif
@@ -566,6 +575,14 @@ static ALWAYS_INLINE void itostr(JsVarInt val,char *str,unsigned int base) {
 
 char itoch(int val);
 
+#define JS_HASH_INITIAL 2166136261u ///< Starting value for jsHashChar
+/// Add a character to an FNV-1a hash (start with JS_HASH_INITIAL)
+static ALWAYS_INLINE uint32_t jsHashChar(uint32_t hash, char ch) {
+  return (hash ^ (unsigned char)ch) * 16777619u;
+}
+/// FNV-1a hash of a string that ends at a 0 or after maxLength characters
+uint32_t jsHashString(const char *s, size_t maxLength);
+
 // super ftoa that does fixed point and radix
 void ftoa_bounded_extra(JsVarFloat val,char *str, size_t len, int radix, int fractionalDigits);
 // normal ftoa with bounds checking
@@ -63,6 +63,11 @@ typedef enum {
 volatile bool touchedFreeList = false;
 volatile JsVarRef jsVarFirstEmpty; ///< reference of first unused variable (variables are in a linked list)
 volatile MemBusyType isMemoryBusy; ///< Are we doing garbage collection or similar, so can't access memory?
+#ifndef ESPR_NO_INLINE_CACHE
+unsigned int jsvPropertyVersion = 0; ///< see jsvPropertiesChanged
+unsigned int jsvObjectVersions[JSV_OBJECT_VERSIONS]; ///< see jsvObjectChanged
+JsvLookupDeps *jsvLookupDeps = 0;
+#endif
 
 // ----------------------------------------------------------------------------
 // ----------------------------------------------------------------------------
@@ -126,6 +131,7 @@ unsigned char jsvGetLocks(JsVar *v) { return (unsigned char)((v->flags>>JSV_LOCK
 #define JSV_IS_FLASH_STRING(f) false
 #endif
 #define JSV_IS_NONAPPENDABLE_STRING(f) (JSV_IS_FLAT_STRING(f) || JSV_IS_NATIVE_STRING(f) || JSV_IS_FLASH_STRING(f))
+#define JSV_IS_BLOCK_STRING(f) (JSV_IS_STRING(f) && !JSV_IS_NONAPPENDABLE_STRING(f) && !JSV_IS_UNICODE_STRING(f)) ///< characters are in this var, then a chain of StringExts
 
 bool jsvIsRoot(const JsVar *v) { if (!v) return false; char f = v->flags&JSV_VARTYPEMASK; return JSV_IS_ROOT(f); }
 bool jsvIsPin(const JsVar *v) { if (!v) return false; char f = v->flags&JSV_VARTYPEMASK; NOT_USED(f); return JSV_IS_PIN(f); } // NOT_USED(f) avoids compile warnings for some builds
@@ -244,6 +250,142 @@ JsVar *_jsvGetAddressOf(JsVarRef ref) {
   return jsvGetAddressOf(ref);
 }
 
+#ifndef ESPR_NO_KEY_ATOMS
+/** Object keys can store the characters after their first block in an 'atom'
+ * (a name in the atom table, with a ref) that's shared with other keys, rather
+ * than in their own StringExts - see jsvAtomIntern. If the string's lastChild
+ * is an atom, return it (not locked) */
+static JsVar *jsvGetAtom(const JsVar *v) {
+  JsVarRef ref = jsvGetLastChild(v);
+  if (!ref) return 0;
+  JsVar *atom = jsvGetAddressOf(ref);
+  return jsvIsName(atom) ? atom : 0; // StringExts aren't names
+}
+#endif
+
+/* Garbage collection marking.
+
+ A var with JSV_GARBAGE_COLLECT set is 'white' (not found yet). Clearing
+ the flag makes it grey, and it is pushed onto jsvGCMarkStack until its
+ children have been scanned, at which point it's black. We never recurse,
+ so marking can't run out of C stack however deep the data structure is.
+
+ If the mark stack overflows we just set jsvGCMarkStackOverflow, and once
+ the stack is empty we rescan memory for marked vars with white children. */
+#ifndef JSV_GC_MARK_STACK_SIZE
+#define JSV_GC_MARK_STACK_SIZE 64
+#endif
+
+static JsVarRef jsvGCMarkStack[JSV_GC_MARK_STACK_SIZE];
+static unsigned int jsvGCMarkStackSize;
+static bool jsvGCMarkStackOverflow;
+
+#ifndef ESPR_NO_INCREMENTAL_GC
+/* Incremental garbage collection (see jsvGarbageCollectStep).
+
+ Because JS code runs between steps, we have to stop it hiding a white
+ var somewhere we've already scanned. While marking:
+
+ * jsvRef shades the var being referenced. Every link the GC follows
+ (apart from string data and sibling links, which are owned by the var
+ that holds them) is reference counted, so this catches all new links.
+ * jsvLock/jsvLockAgain shade the var being locked, so vars that are only
+ held from C still count as roots.
+ * New vars are allocated black. */
+typedef enum {
+  JSVGC_IDLE,   ///< No incremental GC in progress
+  JSVGC_FLAG,   ///< Setting JSV_GARBAGE_COLLECT on every used var
+  JSVGC_ROOTS,  ///< Shading every locked var
+  JSVGC_MARK,   ///< Emptying the mark stack
+  JSVGC_RESCAN, ///< Mark stack overflowed - looking for marked vars with white children
+  JSVGC_UNREF,  ///< Unreferencing anything that white vars link to that isn't white itself
+  JSVGC_SWEEP,  ///< Freeing anything that is still white
+} PACKED_FLAGS JsvGCState;
+
+static JsvGCState jsvGCState = JSVGC_IDLE;
+static volatile bool jsvGCIsMarking = false; ///< Write/lock barriers are active
+static JsVarRef jsvGCCursor; ///< Position in memory for the FLAG/ROOTS/RESCAN/SWEEP phases
+static unsigned int jsvGCBudgetUs = 0; ///< Max time for each incremental GC step. 0 = do all GC in one go
+#endif
+
+/// Mark a var as reachable, and push it on the mark stack if it has children
+static void jsvGarbageCollectShade(JsVar *var) {
+  if (!(var->flags & JSV_GARBAGE_COLLECT)) return; // already grey/black
+  var->flags &= (JsVarFlags)~JSV_GARBAGE_COLLECT;
+  if (jsvHasStringExt(var)) {
+    // String data can't point to anything else, so just mark it now
+    JsVarRef child = jsvGetLastChild(var);
+    while (child) {
+      JsVar *childVar = jsvGetAddressOf(child);
+#ifndef ESPR_NO_KEY_ATOMS
+      if (jsvIsName(childVar)) { // a shared atom - mark it (and its StringExts) as a var in its own right
+        jsvGarbageCollectShade(childVar);
+        break;
+      }
+#endif
+      if (!(childVar->flags & JSV_GARBAGE_COLLECT)) break; // the rest was marked already
+      childVar->flags &= (JsVarFlags)~JSV_GARBAGE_COLLECT;
+      child = jsvGetLastChild(childVar);
+    }
+  }
+  if (jsvHasSingleChild(var) || jsvHasChildren(var)) {
+    if (jsvGCMarkStackSize < JSV_GC_MARK_STACK_SIZE && !jshIsInInterrupt())
+      jsvGCMarkStack[jsvGCMarkStackSize++] = jsvGetRef(var);
+    else
+      jsvGCMarkStackOverflow = true; // we'll find it again when we rescan
+  }
+}
+
+/// Shade all children of a grey var (making it black). Returns the amount of work done
+static unsigned int jsvGarbageCollectScan(JsVar *var) {
+  unsigned int work = 1;
+  if (jsvHasSingleChild(var)) {
+    if (jsvGetFirstChild(var))
+      jsvGarbageCollectShade(jsvGetAddressOf(jsvGetFirstChild(var)));
+  } else if (jsvHasChildren(var)) {
+    JsVarRef child = jsvGetFirstChild(var);
+    while (child) {
+      JsVar *childVar = jsvGetAddressOf(child);
+      jsvGarbageCollectShade(childVar);
+      child = jsvGetNextSibling(childVar);
+      work++;
+    }
+#ifndef ESPR_NO_OBJECT_INDEX
+    if (jsvIsObject(var) && jsvGetNextSibling(var)) // hashed index of keys
+      jsvGarbageCollectShade(jsvGetAddressOf(jsvGetNextSibling(var)));
+#endif
+#ifndef ESPR_NO_ARRAY_INDEX
+    if (jsvIsArray(var) && jsvGetNextSibling(var)) // index of elements
+      jsvGarbageCollectShade(jsvGetAddressOf(jsvGetNextSibling(var)));
+#endif
+  }
+  return work;
+}
+
+#ifndef ESPR_NO_INCREMENTAL_GC
+/// Write/lock barrier - called when a var gets referenced or locked
+static ALWAYS_INLINE void jsvGarbageCollectBarrier(JsVar *var) {
+  if (jsvGCIsMarking && (var->flags & JSV_GARBAGE_COLLECT))
+    jsvGarbageCollectShade(var);
+}
+
+/// A var on the mark stack is being freed - remove it
+static void jsvGarbageCollectForget(JsVar *var) {
+  if (!jsvGCIsMarking || (var->flags & JSV_GARBAGE_COLLECT)) return; // white vars are never on the stack
+  JsVarRef ref = jsvGetRef(var);
+  for (unsigned int i=0;i<jsvGCMarkStackSize;i++)
+    if (jsvGCMarkStack[i]==ref) jsvGCMarkStack[i] = 0;
+}
+
+/// Stop any incremental GC that is in progress (flags are left set, but the next GC sets them all anyway)
+static void jsvGarbageCollectAbort() {
+  jsvGCState = JSVGC_IDLE;
+  jsvGCIsMarking = false;
+  jsvGCMarkStackSize = 0;
+  jsvGCMarkStackOverflow = false;
+}
+#endif
+
 // For debugging/testing ONLY - maximum # of vars we are allowed to use
 void jsvSetMaxVarsUsed(unsigned int size) {
 #ifdef RESIZABLE_JSVARS
@@ -263,6 +405,7 @@ void jsvSetMaxVarsUsed(unsigned int size) {
 // maps the empty variables in...
 void jsvCreateEmptyVarList() {
   assert(!isMemoryBusy);
+  jsvPropertiesChanged();
   isMemoryBusy = MEMBUSY_SYSTEM;
   jsVarFirstEmpty = 0;
   JsVar firstVar; // temporary var to simplify code in the loop below
@@ -311,6 +454,9 @@ void jsvSoftInit() {
 }
 
 void jsvSoftKill() {
+#ifndef ESPR_NO_INCREMENTAL_GC
+  jsvGarbageCollectAbort();
+#endif
   jsvClearEmptyVarList();
 }
 
@@ -336,6 +482,9 @@ static JsVarRef jsvInitJsVars(JsVarRef start, unsigned int count) {
 
 void jsvReset() {
   jsVarFirstEmpty = 0; // jsvCreateEmptyVarList in jsvSoftInit sets this
+#ifndef ESPR_NO_INCREMENTAL_GC
+  jsvGarbageCollectAbort();
+#endif
 #ifdef RESIZABLE_JSVARS
   unsigned int i;
   for (i=0;i<jsVarsSize>>JSVAR_BLOCK_SHIFT;i++) {
@@ -621,6 +770,13 @@ JsVar *jsvNewWithFlags(JsVarFlags flags) {
     } while (!__sync_bool_compare_and_swap(&jsVarFirstEmpty, empty, next));
     assert(v->flags == JSV_UNUSED);*/
     jsvResetVariable(v, flags); // setup variable, and add one lock
+#ifndef ESPR_NO_INCREMENTAL_GC
+    /* If we're part way through flagging everything for an incremental GC
+     * we might be behind jsvGCCursor, so flag this too or it could end up
+     * black without its children ever having been scanned */
+    if (jsvGCState == JSVGC_FLAG)
+      v->flags |= JSV_GARBAGE_COLLECT;
+#endif
     // return pointer
     return v;
   }
@@ -631,7 +787,7 @@ JsVar *jsvNewWithFlags(JsVarFlags flags) {
     return 0;
   }
   /* we don't have memory - second last hope - run garbage collector */
-  if (jsvGarbageCollect()) {
+  if (jsvGarbageCollect() || jsVarFirstEmpty) {
     return jsvNewWithFlags(flags); // if it freed something, continue
   }
   /* we don't have memory - last hope - ask jsInteractive to try and free some it
@@ -653,6 +809,9 @@ JsVar *jsvNewWithFlags(JsVarFlags flags) {
 
 static void jsvFreePtrInternal(JsVar *var) {
   assert(jsvGetLocks(var)==0);
+#ifndef ESPR_NO_INCREMENTAL_GC
+  jsvGarbageCollectForget(var);
+#endif
   var->flags = JSV_UNUSED;
   // add this to our free list
   jshInterruptOff(); // to allow this to be used from an IRQ
@@ -665,6 +824,12 @@ static void jsvFreePtrInternal(JsVar *var) {
 void jsvFreePtrStringExt(JsVar* var) {
   JsVarRef ref = jsvGetLastChild(var);
   if (!ref) return;
+#ifndef ESPR_NO_KEY_ATOMS
+  if (jsvGetAtom(var)) { // shared with other names, so just unreference it
+    jsvUnRefRef(ref);
+    return;
+  }
+#endif
   JsVar* ext = jsvGetAddressOf(ref);
   while (true) {
     ext->flags = JSV_UNUSED;
@@ -685,7 +850,8 @@ ALWAYS_INLINE void jsvFreePtr(JsVar *var) {
    * we were, we'd have been freed by jsvGarbageCollect */
   assert((!jsvGetNextSibling(var) && !jsvGetPrevSibling(var)) || // check that next/prevSibling are not set
       jsvIsRefUsedForData(var) ||  // UNLESS we're part of a string and nextSibling/prevSibling are used for string data
-      (jsvIsName(var) && (jsvGetNextSibling(var)==jsvGetPrevSibling(var)))); // UNLESS we're signalling that we're jsvild
+      (jsvIsName(var) && (jsvGetNextSibling(var)==jsvGetPrevSibling(var))) || // UNLESS we're signalling that we're jsvild
+      ((jsvIsObject(var) || jsvIsArray(var)) && !jsvGetPrevSibling(var))); // UNLESS we're an object/array with an index in nextSibling
 
   // Names that Link to other things
   if (jsvIsNameWithValue(var)) {
@@ -759,7 +925,17 @@ ALWAYS_INLINE void jsvFreePtr(JsVar *var) {
     can be ints or strings */
 
   if (jsvHasChildren(var)) {
+#ifndef ESPR_NO_OBJECT_INDEX
+    if (jsvIsObject(var) && jsvGetNextSibling(var)) { // free any hashed index of keys
+      jsvUnRefRef(jsvGetNextSibling(var));
+      jsvSetNextSibling(var, 0);
+    }
+#endif
+#ifndef ESPR_NO_ARRAY_INDEX
+    jsvArrayIndexFree(var); // free any index of elements
+#endif
     JsVarRef childref = jsvGetLastChild(var);
+    jsvObjectChanged(var); // its ref may be reused by something with different children
 #ifdef CLEAR_MEMORY_ON_FREE
     jsvSetFirstChild(var, 0);
     jsvSetLastChild(var, 0);
@@ -814,6 +990,9 @@ JsVar *jsvLock(JsVarRef ref) {
   //var->locks++;
   assert(jsvGetLocks(var) < JSV_LOCK_MAX);
   var->flags += JSV_LOCK_ONE;
+#ifndef ESPR_NO_INCREMENTAL_GC
+  jsvGarbageCollectBarrier(var);
+#endif
 #ifdef DEBUG
   if (jsvGetLocks(var)==0) {
     jsError("Too many locks to Variable!");
@@ -834,6 +1013,9 @@ JsVar *jsvLockAgain(JsVar *var) {
   assert(var);
   assert(jsvGetLocks(var) < JSV_LOCK_MAX);
   var->flags += JSV_LOCK_ONE;
+#ifndef ESPR_NO_INCREMENTAL_GC
+  jsvGarbageCollectBarrier(var);
+#endif
   return var;
 }
 
@@ -903,6 +1085,9 @@ NO_INLINE void jsvUnLockMany(unsigned int count, JsVar **vars) {
 /// Reference - set this variable as used by something
 JsVar *jsvRef(JsVar *var) {
   assert(var && jsvHasRef(var));
+#ifndef ESPR_NO_INCREMENTAL_GC
+  jsvGarbageCollectBarrier(var);
+#endif
   if (jsvGetRefs(var) < JSVARREFCOUNT_MAX) // if we hit max refcounts, just keep them - GC will fix it later
     jsvSetRefs(var, (JsVarRefCounter)(jsvGetRefs(var)+1));
   assert(jsvGetRefs(var));
@@ -1387,6 +1572,58 @@ void *jsvGetNativeFunctionPtr(const JsVar *function) {
 }
 
 
+#ifndef SAVE_ON_FLASH
+/* Compare two Strings/Names a block at a time, using the length stored in
+ * each block's flags and memcmp (without iterators or locking). Returns -1 if
+ * either string isn't made of normal String/StringExt blocks */
+static int jsvIsStringBlocksEqual(JsVar *a, JsVar *b) {
+  unsigned int fa = a->flags&JSV_VARTYPEMASK;
+  unsigned int fb = b->flags&JSV_VARTYPEMASK;
+  if (!JSV_IS_BLOCK_STRING(fa) || !JSV_IS_BLOCK_STRING(fb)) return -1;
+  size_t la = jsvGetCharactersInVar(a);
+  size_t lb = jsvGetCharactersInVar(b);
+  // most object keys fit in one block, so this is all we need
+  if (!jsvGetLastChild(a) && !jsvGetLastChild(b))
+    return la==lb && memcmp(a->varData.str, b->varData.str, la)==0;
+  const char *pa = a->varData.str;
+  const char *pb = b->varData.str;
+  while (true) {
+    JsVarRef next;
+    while (!la && (next = jsvGetLastChild(a))) {
+      a = jsvGetAddressOf(next);
+      la = jsvGetCharactersInVar(a);
+      pa = a->varData.str;
+    }
+    while (!lb && (next = jsvGetLastChild(b))) {
+      b = jsvGetAddressOf(next);
+      lb = jsvGetCharactersInVar(b);
+      pb = b->varData.str;
+    }
+    if (!la || !lb) return !la && !lb;
+    if (pa==pb) return 1; // both got to the same atom, so the rest is the same
+    size_t l = la<lb ? la : lb;
+    if (memcmp(pa, pb, l)) return 0;
+    pa += l; la -= l;
+    pb += l; lb -= l;
+  }
+}
+
+/// Like jsvIsStringEqual, but a block at a time when we already know the length of str
+static bool jsvIsStringEqualWithLength(JsVar *var, const char *str, size_t len) {
+  unsigned int f = var->flags&JSV_VARTYPEMASK;
+  if (!JSV_IS_BLOCK_STRING(f)) return jsvIsStringEqual(var, str);
+  while (true) {
+    size_t l = jsvGetCharactersInVar(var);
+    if (l>len || memcmp(var->varData.str, str, l)) return false;
+    str += l;
+    len -= l;
+    JsVarRef next = jsvGetLastChild(var);
+    if (!next) return len==0;
+    var = jsvGetAddressOf(next);
+  }
+}
+#endif
+
 bool jsvIsBasicVarEqual(JsVar *a, JsVar *b) {
   // quick checks
   if (a==b) return true;
@@ -1411,7 +1648,10 @@ bool jsvIsBasicVarEqual(JsVar *a, JsVar *b) {
       }
     }
   } else if (jsvIsString(a) && jsvIsString(b)) {
-    // OPT: could we do a fast check here with data?
+#ifndef SAVE_ON_FLASH
+    int eq = jsvIsStringBlocksEqual(a, b);
+    if (eq>=0) return eq!=0;
+#endif
     JsvStringIterator ita, itb;
     jsvStringIteratorNew(&ita, a, 0);
     jsvStringIteratorNew(&itb, b, 0);
@@ -1544,12 +1784,23 @@ size_t jsvGetStringChars(const JsVar *v, size_t startChar, char *str, size_t len
   size_t l = len;
   JsvStringIterator it;
   jsvStringIteratorNewConst(&it, v, startChar);
-  while (jsvStringIteratorHasChar(&it)) {
-    if (l--<=0) {
-      jsvStringIteratorFree(&it);
-      return len;
+  if (jsvIsFlashString(v) || jsvIsNativeString(v)) {
+    // Data may have to be read from flash (GetPtrAndNext would refill the buffer before we copied it)
+    while (l && jsvStringIteratorHasChar(&it)) {
+      *(str++) = jsvStringIteratorGetCharAndNext(&it);
+      l--;
+    }
+  } else {
+    // copy a block at a time
+    while (l && jsvStringIteratorHasChar(&it)) {
+      unsigned char *data;
+      unsigned int n;
+      jsvStringIteratorGetPtrAndNext(&it, &data, &n);
+      if (n > l) n = (unsigned int)l;
+      memcpy(str, data, n);
+      str += n;
+      l -= n;
     }
-    *(str++) = jsvStringIteratorGetCharAndNext(&it);
   }
   jsvStringIteratorFree(&it);
   return len-l;
@@ -1564,9 +1815,22 @@ void jsvSetString(JsVar *v, const char *str, size_t len) {
 
   JsvStringIterator it;
   jsvStringIteratorNew(&it, v, 0);
-  size_t i;
-  for (i=0;i<len;i++) {
-    jsvStringIteratorSetCharAndNext(&it, str[i]);
+  if (jsvIsFlashString(v) || jsvIsNativeString(v)) {
+    size_t i;
+    for (i=0;i<len;i++) {
+      jsvStringIteratorSetCharAndNext(&it, str[i]);
+    }
+  } else {
+    // copy a block at a time
+    while (len && jsvStringIteratorHasChar(&it)) {
+      unsigned char *data;
+      unsigned int n;
+      jsvStringIteratorGetPtrAndNext(&it, &data, &n);
+      if (n > len) n = (unsigned int)len;
+      memcpy(data, str, n);
+      str += n;
+      len -= n;
+    }
   }
   jsvStringIteratorFree(&it);
 }
@@ -1878,8 +2142,7 @@ void jsvAppendStringBuf(JsVar *var, const char *str, size_t length) {
 
 /// Special version of append designed for use with vcbprintf_callback (See jsvAppendPrintf)
 void jsvStringIteratorPrintfCallback(const char *str, void *user_data) {
-  while (*str)
-    jsvStringIteratorAppend((JsvStringIterator *)user_data, *(str++));
+  jsvStringIteratorAppendChars((JsvStringIterator *)user_data, str, strlen(str));
 }
 
 void jsvAppendPrintf(JsVar *var, const char *fmt, ...) {
@@ -2765,6 +3028,11 @@ JsVar *jsvCopyNameOnly(JsVar *src, bool linkChildren, bool keepAsName) {
       // If it had extra string data it should have been handled above
       assert(keepAsName || !jsvGetLastChild(src));
       // copy extra bits of string if there were any
+#ifndef ESPR_NO_KEY_ATOMS
+      if (jsvGetAtom(src)) { // atoms are never modified, so can just be shared
+        jsvSetLastChild(dst, jsvRefRef(jsvGetLastChild(src)));
+      } else
+#endif
       if (jsvGetLastChild(src)) {
         JsVar *child = jsvLock(jsvGetLastChild(src));
         JsVar *childCopy = jsvCopy(child, true);
@@ -2832,6 +3100,11 @@ JsVar *jsvCopy(JsVar *src, bool copyChildren) {
     }
   }
 
+#ifndef ESPR_NO_KEY_ATOMS
+  if (jsvIsName(src) && jsvIsString(src) && jsvGetAtom(src)) {
+    jsvSetLastChild(dst, jsvRefRef(jsvGetLastChild(src))); // atoms are never modified, so can just be shared
+  } else
+#endif
   if (jsvHasStringExt(src)) {
     // copy extra bits of string if there were any
     src = jsvLockAgain(src);
@@ -2881,6 +3154,360 @@ JsVar *jsvCopy(JsVar *src, bool copyChildren) {
   return dst;
 }
 
+#ifndef ESPR_NO_OBJECT_INDEX
+/* Hashed index of the keys of big objects.
+
+ Looking up a key normally means walking the object's whole list of
+ children. Once a lookup has had to walk past JSV_OBJECT_INDEX_MIN_CHILDREN
+ children (whether it then found the key or not) we build an index: a flat
+ string containing a header and then an open-addressed hash table of
+ JsVarRefs to the object's String-named children. Objects don't use nextSibling, so that's where the index is
+ linked from (with a ref, so GC and jsvFreePtr deal with it).
+
+ jsvAddName and jsvRemoveChild keep the index up to date. Int-named
+ children aren't indexed, as they never match a String key. */
+#define JSV_OBJECT_INDEX_MIN_CHILDREN 16
+#define JSV_OBJECT_INDEX_MIN_SLOTS 32
+#define JSV_OBJECT_INDEX_TOMBSTONE ((JsVarRef)~(JsVarRef)0) ///< a slot for a child that was removed
+
+typedef struct {
+  uint32_t used; ///< slots that aren't empty (including tombstones)
+  uint32_t size; ///< number of slots, a power of 2
+  JsVarRef slots[];
+} JsvObjectIndex;
+
+/// Hash a name's characters, the same as jsHashString would
+static uint32_t jsvObjectIndexHashVar(JsVar *name) {
+  uint32_t hash = JS_HASH_INITIAL;
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, name, 0);
+  while (jsvStringIteratorHasChar(&it)) {
+    hash = jsHashChar(hash, jsvStringIteratorGetChar(&it));
+    jsvStringIteratorNext(&it);
+  }
+  jsvStringIteratorFree(&it);
+  return hash;
+}
+
+/// Get the index for an object, or 0. The index isn't locked, but it's referenced from the object
+static JsvObjectIndex *jsvObjectIndexGet(JsVar *parent) {
+  if (!jsvIsObject(parent) || !jsvGetNextSibling(parent)) return 0;
+  return (JsvObjectIndex*)jsvGetFlatStringPointer(jsvGetAddressOf(jsvGetNextSibling(parent)));
+}
+
+static void jsvObjectIndexInsert(JsvObjectIndex *index, JsVar *child) {
+  uint32_t mask = index->size-1;
+  uint32_t i = jsvObjectIndexHashVar(child) & mask;
+  while (index->slots[i] && index->slots[i]!=JSV_OBJECT_INDEX_TOMBSTONE)
+    i = (i+1) & mask;
+  if (!index->slots[i]) index->used++;
+  index->slots[i] = jsvGetRef(child);
+}
+
+/// Remove the index from an object (if it had one)
+static void jsvObjectIndexFree(JsVar *parent) {
+  if (!jsvIsObject(parent) || !jsvGetNextSibling(parent)) return;
+  JsVarRef indexRef = jsvGetNextSibling(parent);
+  jsvSetNextSibling(parent, 0);
+  jsvUnRefRef(indexRef);
+}
+
+/// Create (or recreate) the index for an object
+static void jsvObjectIndexBuild(JsVar *parent) {
+  jsvObjectIndexFree(parent);
+  if (jshIsInInterrupt()) return;
+  uint32_t count = 0;
+  JsVarRef childref = jsvGetFirstChild(parent);
+  while (childref) {
+    JsVar *child = jsvGetAddressOf(childref);
+    if (jsvIsString(child)) count++;
+    childref = jsvGetNextSibling(child);
+  }
+  uint32_t size = JSV_OBJECT_INDEX_MIN_SLOTS;
+  while (size < count*2) size <<= 1;
+  size_t bytes = sizeof(JsvObjectIndex) + size*sizeof(JsVarRef);
+  /* This is only a cache, so don't use up the last of our memory on it
+   * (that'd also mean a GC every time we tried and failed) */
+  if (!jsvMoreFreeVariablesThan((unsigned int)(2*bytes/sizeof(JsVar)) + JS_VARS_BEFORE_IDLE_GC))
+    return;
+  JsVar *indexVar = jsvNewFlatStringOfLength((unsigned int)bytes);
+  if (!indexVar) return;
+  JsvObjectIndex *index = (JsvObjectIndex*)jsvGetFlatStringPointer(indexVar);
+  index->used = 0;
+  index->size = size;
+  childref = jsvGetFirstChild(parent);
+  while (childref) {
+    JsVar *child = jsvGetAddressOf(childref);
+    if (jsvIsString(child)) jsvObjectIndexInsert(index, child);
+    childref = jsvGetNextSibling(child);
+  }
+  jsvSetNextSibling(parent, jsvGetRef(jsvRef(indexVar)));
+  jsvUnLock(indexVar);
+}
+
+/// A lookup walked past childrenChecked children (whether it found the key or not) - if that's a lot, make an index so next time is faster
+static void jsvObjectIndexBuildIfSlow(JsVar *parent, unsigned int childrenChecked) {
+  if (childrenChecked >= JSV_OBJECT_INDEX_MIN_CHILDREN && jsvIsObject(parent))
+    jsvObjectIndexBuild(parent);
+}
+
+/// A child has been added to an object - add it to the index
+static void jsvObjectIndexAdd(JsVar *parent, JsVar *child) {
+  JsvObjectIndex *index = jsvObjectIndexGet(parent);
+  if (!index || !jsvIsString(child)) return;
+  if ((index->used+1)*4 > index->size*3) // too full - rebuild at the right size (this adds child)
+    jsvObjectIndexBuild(parent);
+  else
+    jsvObjectIndexInsert(index, child);
+}
+
+/// A child is being removed from an object - remove it from the index
+static void jsvObjectIndexRemove(JsVar *parent, JsVar *child) {
+  JsvObjectIndex *index = jsvObjectIndexGet(parent);
+  if (!index || !jsvIsString(child)) return;
+  JsVarRef childref = jsvGetRef(child);
+  uint32_t mask = index->size-1;
+  uint32_t i = jsvObjectIndexHashVar(child) & mask;
+  while (index->slots[i]) {
+    if (index->slots[i]==childref) {
+      index->slots[i] = JSV_OBJECT_INDEX_TOMBSTONE;
+      return;
+    }
+    i = (i+1) & mask;
+  }
+}
+
+/** Look up a child using the object's index. Returns false if there was
+ * no index, otherwise true and sets *result to the child (locked) or 0 */
+static bool jsvObjectIndexFind(JsVar *parent, const char *name, JsVar *nameVar, JsVar **result) {
+  JsvObjectIndex *index = jsvObjectIndexGet(parent);
+  if (!index) return false;
+  uint32_t mask = index->size-1;
+  uint32_t i = (name ? jsHashString(name, (size_t)-1) : jsvObjectIndexHashVar(nameVar)) & mask;
+  JsVarRef ref;
+  while ((ref = index->slots[i])) {
+    if (ref != JSV_OBJECT_INDEX_TOMBSTONE) {
+      JsVar *child = jsvGetAddressOf(ref);
+      if (name ? jsvIsStringEqual(child, name) : jsvIsBasicVarEqual(child, nameVar)) {
+        *result = jsvLockAgain(child);
+        return true;
+      }
+    }
+    i = (i+1) & mask;
+  }
+  *result = 0;
+  return true;
+}
+
+/// Replace references to a child in the object's index (used when defragmenting)
+static void jsvObjectIndexUpdateRef(JsVar *parent, JsVarRef oldRef, JsVarRef newRef) {
+  JsvObjectIndex *index = jsvObjectIndexGet(parent);
+  if (!index) return;
+  for (uint32_t i=0;i<index->size;i++)
+    if (index->slots[i]==oldRef) index->slots[i] = newRef;
+}
+#endif
+
+#ifndef ESPR_NO_ARRAY_INDEX
+/* Index of the elements of big dense arrays.
+
+ Arrays are a linked list of Int-named children, so finding element i means
+ walking past up to i children. Once a lookup has had to walk past
+ JSV_ARRAY_INDEX_MIN_CHILDREN elements of an array whose elements are
+ 0..n-1 with no holes, we build an index: a flat string containing a header
+ and then the JsVarRef of the name of each element, in order. Like the
+ object index it's linked from the array's nextSibling.
+
+ jsvAddName extends the index when an element is added to the end and
+ jsvRemoveChild shrinks it when the last element is removed. Anything else
+ (making a hole, inserting, renumbering) frees it with jsvArrayIndexFree. */
+#define JSV_ARRAY_INDEX_MIN_CHILDREN 16
+#define JSV_ARRAY_INDEX_MIN_SLOTS 32
+
+typedef struct {
+  uint32_t count; ///< elements 0..count-1 are in slots
+  uint32_t size; ///< number of slots
+  JsVarRef slots[];
+} JsvArrayIndex;
+
+/// Get the index for an array, or 0. The index isn't locked, but it's referenced from the array
+static JsvArrayIndex *jsvArrayIndexGet(JsVar *arr) {
+  if (!jsvIsArray(arr) || !jsvGetNextSibling(arr)) return 0;
+  return (JsvArrayIndex*)jsvGetFlatStringPointer(jsvGetAddressOf(jsvGetNextSibling(arr)));
+}
+
+void jsvArrayIndexFree(JsVar *arr) {
+  if (!jsvIsArray(arr) || !jsvGetNextSibling(arr)) return;
+  JsVarRef indexRef = jsvGetNextSibling(arr);
+  jsvSetNextSibling(arr, 0);
+  jsvUnRefRef(indexRef);
+}
+
+/// Create (or recreate) the index for an array, if its elements have no holes
+static void jsvArrayIndexBuild(JsVar *arr) {
+  jsvArrayIndexFree(arr);
+  if (jshIsInInterrupt()) return;
+  /* Leave room for the array to grow. This is only a cache, so don't use up
+   * the last of our memory on it (that'd also mean a GC every time we tried
+   * and failed) - and check before we go to the effort of scanning the array */
+  JsVarInt length = jsvGetArrayLength(arr);
+  if (length<0 || length>0xFFFFFF) return;
+  uint32_t size = JSV_ARRAY_INDEX_MIN_SLOTS;
+  while (size < (uint32_t)length + (uint32_t)length/2) size += size/2;
+  size_t bytes = sizeof(JsvArrayIndex) + size*sizeof(JsVarRef);
+  if (!jsvMoreFreeVariablesThan((unsigned int)(bytes/sizeof(JsVar)) + JS_VARS_BEFORE_IDLE_GC))
+    return;
+  uint32_t count = 0;
+  JsVarRef childref = jsvGetFirstChild(arr);
+  while (childref) {
+    JsVar *child = jsvGetAddressOf(childref);
+    if (jsvIsInt(child)) {
+      if (child->varData.integer != (JsVarInt)count) return; // not dense
+      count++;
+    }
+    childref = jsvGetNextSibling(child);
+  }
+  JsVar *indexVar = jsvNewFlatStringOfLength((unsigned int)bytes);
+  if (!indexVar) return;
+  JsvArrayIndex *index = (JsvArrayIndex*)jsvGetFlatStringPointer(indexVar);
+  index->count = 0;
+  index->size = size;
+  childref = jsvGetFirstChild(arr);
+  while (childref) {
+    JsVar *child = jsvGetAddressOf(childref);
+    if (jsvIsInt(child)) index->slots[index->count++] = childref;
+    childref = jsvGetNextSibling(child);
+  }
+  jsvSetNextSibling(arr, jsvGetRef(jsvRef(indexVar)));
+  jsvUnLock(indexVar);
+}
+
+/// A child has been added to an array - add it to the index
+static void jsvArrayIndexAdd(JsVar *arr, JsVar *child) {
+  JsvArrayIndex *index = jsvArrayIndexGet(arr);
+  if (!index || !jsvIsInt(child)) return;
+  if (child->varData.integer != (JsVarInt)index->count) // not on the end - a hole or out of order
+    jsvArrayIndexFree(arr);
+  else if (index->count == index->size) // full - rebuild bigger (this adds child)
+    jsvArrayIndexBuild(arr);
+  else
+    index->slots[index->count++] = jsvGetRef(child);
+}
+
+/// A child is being removed from an array - remove it from the index
+static void jsvArrayIndexRemove(JsVar *arr, JsVar *child) {
+  JsvArrayIndex *index = jsvArrayIndexGet(arr);
+  if (!index || !jsvIsInt(child)) return;
+  if (index->count && index->slots[index->count-1]==jsvGetRef(child))
+    index->count--;
+  else // leaves a hole
+    jsvArrayIndexFree(arr);
+}
+
+/** Look up an element using the array's index. Returns false if there was
+ * no index, otherwise true and sets *result to the element's name (locked) or 0 */
+static bool jsvArrayIndexFind(JsVar *arr, JsVarInt i, JsVar **result) {
+  JsvArrayIndex *index = jsvArrayIndexGet(arr);
+  if (!index) return false;
+  if (i<0 || i>=(JsVarInt)index->count) {
+    *result = 0;
+    return true;
+  }
+  JsVar *child = jsvGetAddressOf(index->slots[i]);
+  assert(jsvIsInt(child) && child->varData.integer==i);
+  *result = jsvLockAgain(child);
+  return true;
+}
+
+/// Replace references to a child in the array's index (used when defragmenting)
+static void jsvArrayIndexUpdateRef(JsVar *arr, JsVarRef oldRef, JsVarRef newRef) {
+  JsvArrayIndex *index = jsvArrayIndexGet(arr);
+  if (!index) return;
+  for (uint32_t i=0;i<index->count;i++)
+    if (index->slots[i]==oldRef) index->slots[i] = newRef;
+}
+#endif
+
+#ifndef ESPR_NO_KEY_ATOMS
+/* Atoms for object keys.
+
+ Every object has its own NAME var for each of its keys, and a key too long
+ to fit in the NAME needs one or more StringExts for the rest of its
+ characters. When lots of objects have the same keys (eg. records from
+ JSON.parse or an object literal) those StringExts are all the same, so when
+ a key like this is added to an Object we look the rest of its characters up
+ in the atom table (a hidden Object whose keys are those characters) and
+ make the key's lastChild link to that atom (with a ref) in place of its
+ StringExts. Each object then only needs one var per key, and comparing
+ two keys that share an atom can stop as soon as it gets to it.
+
+ Atoms are never modified. jsvFreePtr and both garbage collectors unref them
+ like any other child, and jsvGarbageCollect removes atoms that no key uses
+ any more from the table (see jsvAtomsFreeUnused) so they get freed. */
+#define JSV_ATOMS_NAME "atom" ///< Name in hiddenRoot. Must fit in a NAME on all builds, or adding it would need an atom
+#define JSV_ATOM_MAX_LENGTH 32 ///< Most characters we'll put in an atom
+
+/// If this key (just added to parent) has StringExts, replace them with a shared atom
+static void jsvAtomIntern(JsVar *parent, JsVar *name) {
+  JsVarRef extRef = jsvGetLastChild(name);
+  if (!extRef || !jsvIsStringExt(jsvGetAddressOf(extRef)) || // nothing to share (or already shared)
+      !execInfo.hiddenRoot || parent==execInfo.hiddenRoot || jshIsInInterrupt())
+    return;
+  char buf[JSV_ATOM_MAX_LENGTH+1];
+  size_t len = jsvGetStringChars(name, jsvGetCharactersInVar(name), buf, sizeof(buf));
+  if (len>JSV_ATOM_MAX_LENGTH || memchr(buf, 0, len)) return; // too long, or we couldn't look it up
+  buf[len] = 0;
+  JsVar *atoms = jsvObjectGetChildIfExists(execInfo.hiddenRoot, JSV_ATOMS_NAME);
+  if (atoms==parent) { // don't make atoms for the atoms themselves!
+    jsvUnLock(atoms);
+    return;
+  }
+  JsVar *atom = atoms ? jsvFindChildFromString(atoms, buf) : 0;
+  if (!atom && jsvMoreFreeVariablesThan(JS_VARS_BEFORE_IDLE_GC)) {
+    if (!atoms) atoms = jsvObjectGetChild(execInfo.hiddenRoot, JSV_ATOMS_NAME, JSV_OBJECT);
+    atom = atoms ? jsvNewNameFromString(buf) : 0;
+    if (atom) jsvAddName(atoms, atom);
+  }
+  jsvUnLock(atoms);
+  if (!atom) return;
+  jsvFreePtrStringExt(name);
+  jsvSetLastChild(name, jsvGetRef(jsvRef(atom)));
+  jsvUnLock(atom);
+}
+
+/// Remove atoms that no key uses from the atom table (so they get freed)
+static void jsvAtomsFreeUnused() {
+  if (!execInfo.hiddenRoot) return;
+  JsVar *atoms = jsvObjectGetChildIfExists(execInfo.hiddenRoot, JSV_ATOMS_NAME);
+  if (!atoms) return;
+  /* Refs can't tell us if an atom is still used, as they stop counting at
+   * JSVARREFCOUNT_MAX. Instead flag every atom that some key links to. */
+  JsVarRef i;
+  for (i=1;i<=jsVarsSize;i++) {
+    JsVar *var = jsvGetAddressOf(i);
+    if (jsvIsFlatString(var)) {
+      i = (JsVarRef)(i+jsvGetFlatStringBlocks(var));
+    } else if (jsvIsName(var) && jsvIsString(var)) {
+      JsVar *atom = jsvGetAtom(var);
+      if (atom) atom->flags |= JSV_IS_RECURSING;
+    }
+  }
+  JsVarRef childref = jsvGetFirstChild(atoms);
+  while (childref) {
+    JsVar *child = jsvLock(childref);
+    childref = jsvGetNextSibling(child);
+    if (child->flags & JSV_IS_RECURSING)
+      child->flags &= (JsVarFlags)~JSV_IS_RECURSING;
+    else if (jsvGetLocks(child)==1) // not being added to a key right now
+      jsvRemoveChild(atoms, child);
+    jsvUnLock(child);
+  }
+  if (!jsvGetFirstChild(atoms))
+    jsvObjectRemoveChild(execInfo.hiddenRoot, JSV_ATOMS_NAME);
+  jsvUnLock(atoms);
+}
+#endif
+
 void jsvAddName(JsVar *parent, JsVar *namedChild) {
   namedChild = jsvRef(namedChild); // ref here VERY important as adding to structure!
   assert(jsvIsName(namedChild));
@@ -2934,6 +3561,17 @@ void jsvAddName(JsVar *parent, JsVar *namedChild) {
     jsvSetFirstChild(parent, r);
     jsvSetLastChild(parent, r);
   }
+#ifndef ESPR_NO_KEY_ATOMS
+  if ((parent->flags&JSV_VARTYPEMASK)==JSV_OBJECT && jsvIsString(namedChild))
+    jsvAtomIntern(parent, namedChild);
+#endif
+#ifndef ESPR_NO_OBJECT_INDEX
+  jsvObjectIndexAdd(parent, namedChild);
+#endif
+#ifndef ESPR_NO_ARRAY_INDEX
+  jsvArrayIndexAdd(parent, namedChild);
+#endif
+  if (jsvIsString(namedChild)) jsvObjectChanged(parent);
 }
 
 JsVar *jsvAddNamedChild(JsVar *parent, JsVar *value, const char *name) {
@@ -2962,8 +3600,18 @@ JsVar *jsvSetValueOfName(JsVar *name, JsVar *src) {
     else
       name->flags = (name->flags & (JsVarFlags)~JSV_VARTYPEMASK) | JSV_NAME_INT;
     jsvSetFirstChild(name, 0);
-  } else if (jsvGetFirstChild(name))
-    jsvUnRefRef(jsvGetFirstChild(name)); // free existing
+  } else if (jsvGetFirstChild(name)) {
+    JsVar *existing = jsvLock(jsvGetFirstChild(name));
+    // replacing a function or prototype could change what objects inherit (or the constructor used for built-ins)
+    if (jsvHasChildren(existing) &&
+        (jsvIsFunction(existing) ||
+         jsvIsStringEqual(name, JSPARSE_PROTOTYPE_VAR) ||
+         jsvIsStringEqual(name, JSPARSE_INHERITS_VAR) ||
+         jsvIsStringEqual(name, JSPARSE_CONSTRUCTOR_VAR)))
+      jsvPropertiesChanged();
+    jsvUnRef(existing); // free existing
+    jsvUnLock(existing);
+  }
   if (src) {
     if (jsvIsInt(name)) {
       if ((jsvIsInt(src) || jsvIsBoolean(src)) && !jsvIsPin(src)) {
@@ -2991,6 +3639,29 @@ JsVar *jsvSetValueOfName(JsVar *name, JsVar *src) {
   return name;
 }
 
+#ifndef ESPR_NO_INLINE_CACHE
+/// Record that a lookup searched the children of 'parent' (see jsvLookupDeps)
+static void jsvLookupDepsAdd(JsVar *parent) {
+  JsVarRef ref = jsvGetRef(parent);
+  unsigned int i;
+  if (jsvLookupDeps->count > JSV_LOOKUP_DEPS) return;
+  for (i=0;i<jsvLookupDeps->count;i++)
+    if (jsvLookupDeps->refs[i]==ref) return;
+  if (jsvLookupDeps->count < JSV_LOOKUP_DEPS)
+    jsvLookupDeps->refs[jsvLookupDeps->count] = ref;
+  jsvLookupDeps->count++;
+}
+
+unsigned int jsvLookupDepsVersion(const JsVarRef *refs, unsigned int count) {
+  // versions only ever go up, so the sum changes if any of them do
+  unsigned int version = jsvPropertyVersion;
+  unsigned int i;
+  for (i=0;i<count;i++)
+    version += jsvObjectVersion(refs[i]);
+  return version;
+}
+#endif
+
 JsVar *jsvFindChildFromString(JsVar *parent, const char *name) {
   /* Pull out first 4 bytes, and ensure that everything
    * is 0 padded so that we can do a nice speedy check. */
@@ -3016,17 +3687,40 @@ JsVar *jsvFindChildFromString(JsVar *parent, const char *name) {
   }
 
   assert(jsvHasChildren(parent));
+#ifndef ESPR_NO_INLINE_CACHE
+  if (jsvLookupDeps) jsvLookupDepsAdd(parent);
+#endif
+#ifndef ESPR_NO_OBJECT_INDEX
+  JsVar *found;
+  if (jsvObjectIndexFind(parent, name, 0, &found))
+    return found;
+  unsigned int childrenChecked = 0;
+#endif
   JsVarRef childref = jsvGetFirstChild(parent);
   if (!superFastCheck) { // more than 4 chars so we MUST use stringequal
+#ifndef SAVE_ON_FLASH
+    size_t nameLen = strlen(name);
+#endif
     while (childref) {
       // Don't Lock here, just use GetAddressOf - to try and speed up the finding
       JsVar *child = jsvGetAddressOf(childref);
       if (*(int*)fastCheck==*(int*)child->varData.str && // speedy check of first 4 bytes
+#ifndef SAVE_ON_FLASH
+          jsvIsStringEqualWithLength(child, name, nameLen)) {
+#else
           jsvIsStringEqual(child, name)) {
+#endif
         // found it! unlock parent but leave child locked
-        return jsvLockAgain(child);
+        child = jsvLockAgain(child);
+#ifndef ESPR_NO_OBJECT_INDEX
+        jsvObjectIndexBuildIfSlow(parent, childrenChecked);
+#endif
+        return child;
       }
       childref = jsvGetNextSibling(child);
+#ifndef ESPR_NO_OBJECT_INDEX
+      childrenChecked++;
+#endif
     }
   } else { // 4 or less chars, so if 4 chars match, there is no StringExt + length matches, then we're good without jsvIsStringEqual
     size_t charsInName = 0;
@@ -3038,11 +3732,21 @@ JsVar *jsvFindChildFromString(JsVar *parent, const char *name) {
           !child->varData.ref.lastChild &&
           jsvGetCharactersInVar(child)==charsInName) { // no extra stringexts - so it really is that small
         // found it! unlock parent but leave child locked
-        return jsvLockAgain(child);
+        child = jsvLockAgain(child);
+#ifndef ESPR_NO_OBJECT_INDEX
+        jsvObjectIndexBuildIfSlow(parent, childrenChecked);
+#endif
+        return child;
       }
       childref = jsvGetNextSibling(child);
+#ifndef ESPR_NO_OBJECT_INDEX
+      childrenChecked++;
+#endif
     }
   }
+#ifndef ESPR_NO_OBJECT_INDEX
+  jsvObjectIndexBuildIfSlow(parent, childrenChecked);
+#endif
   return 0;
 }
 
@@ -3106,8 +3810,26 @@ JsVar *jsvAsName(JsVar *var) {
 
 /** Non-recursive finding */
 JsVar *jsvFindChildFromVar(JsVar *parent, JsVar *childName, bool addIfNotFound) {
-  JsVar *child;
+  JsVar *child = 0;
+#ifndef ESPR_NO_OBJECT_INDEX
+  bool canIndex = jsvIsObject(parent) && jsvIsString(childName);
+  bool usedIndex = canIndex && jsvObjectIndexFind(parent, 0, childName, &child);
+  if (child) return child;
+  unsigned int childrenChecked = 0;
+  JsVarRef childref = usedIndex ? 0 : jsvGetFirstChild(parent);
+#else
   JsVarRef childref = jsvGetFirstChild(parent);
+#endif
+#ifndef ESPR_NO_ARRAY_INDEX
+  bool canArrayIndex = jsvIsArray(parent) && jsvIsInt(childName);
+  if (canArrayIndex && jsvArrayIndexFind(parent, jsvGetInteger(childName), &child)) {
+    if (child) return child;
+    childref = 0;
+  }
+#ifdef ESPR_NO_OBJECT_INDEX
+  unsigned int childrenChecked = 0;
+#endif
+#endif
 
   // TODO: could split this into separate loops looking for Numeric/String
 
@@ -3115,11 +3837,28 @@ JsVar *jsvFindChildFromVar(JsVar *parent, JsVar *childName, bool addIfNotFound)
     child = jsvLock(childref);
     if (jsvIsBasicVarEqual(child, childName)) {
       // found it! unlock parent but leave child locked
+#ifndef ESPR_NO_OBJECT_INDEX
+      if (canIndex) jsvObjectIndexBuildIfSlow(parent, childrenChecked);
+#endif
+#ifndef ESPR_NO_ARRAY_INDEX
+      if (canArrayIndex && childrenChecked >= JSV_ARRAY_INDEX_MIN_CHILDREN)
+        jsvArrayIndexBuild(parent);
+#endif
       return child;
     }
     childref = jsvGetNextSibling(child);
     jsvUnLock(child);
+#if !defined(ESPR_NO_OBJECT_INDEX) || !defined(ESPR_NO_ARRAY_INDEX)
+    childrenChecked++;
+#endif
   }
+#ifndef ESPR_NO_OBJECT_INDEX
+  if (canIndex) jsvObjectIndexBuildIfSlow(parent, childrenChecked);
+#endif
+#ifndef ESPR_NO_ARRAY_INDEX
+  if (canArrayIndex && childrenChecked >= JSV_ARRAY_INDEX_MIN_CHILDREN)
+    jsvArrayIndexBuild(parent);
+#endif
 
   child = 0;
   if (addIfNotFound && childName) {
@@ -3137,6 +3876,13 @@ void jsvRemoveChild(JsVar *parent, JsVar *child) {
 #endif
   JsVarRef childref = jsvGetRef(child);
   bool wasChild = false;
+#ifndef ESPR_NO_OBJECT_INDEX
+  jsvObjectIndexRemove(parent, child);
+#endif
+#ifndef ESPR_NO_ARRAY_INDEX
+  jsvArrayIndexRemove(parent, child);
+#endif
+  if (jsvIsString(child)) jsvObjectChanged(parent);
   // unlink from parent
   if (jsvGetFirstChild(parent) == childref) {
     jsvSetFirstChild(parent, jsvGetNextSibling(child));
@@ -3405,6 +4151,10 @@ static size_t _jsvCountJsVarsUsedRecursive(JsVar *v, bool resetRecursionFlag) {
     count += jsvGetFlatStringBlocks(v);
   if (jsvHasCharacterData(v)) {
     JsVarRef childref = jsvGetLastChild(v);
+#ifndef ESPR_NO_KEY_ATOMS
+    if (jsvIsName(v) && jsvIsString(v) && jsvGetAtom(v))
+      childref = 0; // atoms are shared with other names, so aren't counted here
+#endif
     while (childref) {
       JsVar *child = jsvLock(childref);
       count++;
@@ -3433,6 +4183,12 @@ size_t jsvCountJsVarsUsed(JsVar *v) {
 }
 
 JsVar *jsvGetArrayIndex(const JsVar *arr, JsVarInt index) {
+  JsVar *found = 0;
+#ifndef ESPR_NO_ARRAY_INDEX
+  if (jsvArrayIndexFind((JsVar*)arr, index, &found))
+    return found;
+  unsigned int childrenChecked = 0;
+#endif
   JsVarRef childref = jsvGetLastChild(arr);
   JsVarInt lastArrayIndex = 0;
   // Look at last non-string element!
@@ -3462,10 +4218,14 @@ JsVar *jsvGetArrayIndex(const JsVar *arr, JsVarInt index) {
 
       assert(jsvIsInt(child));
       if (child->varData.integer == index) {
-        return child;
+        found = child;
+        break;
       }
       childref = jsvGetPrevSibling(child);
       jsvUnLock(child);
+#ifndef ESPR_NO_ARRAY_INDEX
+      childrenChecked++;
+#endif
     }
   } else {
     // it's in the first half of the array (probably) - search forwards
@@ -3475,13 +4235,22 @@ JsVar *jsvGetArrayIndex(const JsVar *arr, JsVarInt index) {
 
       assert(jsvIsInt(child));
       if (child->varData.integer == index) {
-        return child;
+        found = child;
+        break;
       }
       childref = jsvGetNextSibling(child);
       jsvUnLock(child);
+#ifndef ESPR_NO_ARRAY_INDEX
+      childrenChecked++;
+#endif
     }
   }
-  return 0; // undefined
+#ifndef ESPR_NO_ARRAY_INDEX
+  // we had to look through a lot of elements - make an index so next time is faster
+  if (childrenChecked >= JSV_ARRAY_INDEX_MIN_CHILDREN && jsvIsArray(arr))
+    jsvArrayIndexBuild((JsVar*)arr);
+#endif
+  return found; // or undefined
 }
 
 JsVar *jsvGetArrayItem(const JsVar *arr, JsVarInt index) {
@@ -3665,8 +4434,10 @@ JsVar *jsvArrayPop(JsVar *arr) {
 /// Removes the first element of an array, and returns that element (or 0 if empty). DOES NOT RENUMBER.
 JsVar *jsvArrayPopFirst(JsVar *arr) {
   assert(jsvIsArray(arr));
+  jsvArrayIndexFree(arr); // everything after will need renumbering
   if (jsvGetFirstChild(arr)) {
     JsVar *child = jsvLock(jsvGetFirstChild(arr));
+    if (jsvIsString(child)) jsvObjectChanged(arr);
     if (jsvGetFirstChild(arr) == jsvGetLastChild(arr))
       jsvSetLastChild(arr, 0); // if 1 item in array
     jsvSetFirstChild(arr, jsvGetNextSibling(child)); // unlink from end of array
@@ -3744,6 +4515,7 @@ JsVar *jsvArrayJoin(JsVar *arr, JsVar *filler, bool ignoreNull) {
 /// Insert a new element before beforeIndex, DOES NOT UPDATE INDICES
 void jsvArrayInsertBefore(JsVar *arr, JsVar *beforeIndex, JsVar *element) {
   if (beforeIndex) {
+    jsvArrayIndexFree(arr);
     JsVar *idxVar = jsvMakeIntoVariableName(jsvNewFromInteger(0), element);
     if (!idxVar) return; // out of memory
 
@@ -4180,47 +4952,53 @@ void jsvTrace(JsVar *var, int indent) {
 }
 
 
-/** Recursively mark the variable. Return false if it fails due to stack. */
-static bool jsvGarbageCollectMarkUsed(JsVar *var) {
-  var->flags &= (JsVarFlags)~JSV_GARBAGE_COLLECT;
-  JsVarRef child;
-  JsVar *childVar;
-
-  if (jsvHasStringExt(var)) {
-    // non-recursively scan strings
-    child = jsvGetLastChild(var);
-    while (child) {
-      childVar = jsvGetAddressOf(child);
-      childVar->flags &= (JsVarFlags)~JSV_GARBAGE_COLLECT;
-      child = jsvGetLastChild(childVar);
-    }
+/// Scan everything on the mark stack until it is empty
+static void jsvGarbageCollectMarkStack() {
+  while (jsvGCMarkStackSize) {
+    JsVarRef ref = jsvGCMarkStack[--jsvGCMarkStackSize];
+    if (ref) jsvGarbageCollectScan(jsvGetAddressOf(ref));
   }
-  // intentionally no else
-  if (jsvHasSingleChild(var)) {
-    if (jsvGetFirstChild(var)) {
-      childVar = jsvGetAddressOf(jsvGetFirstChild(var));
-      if (childVar->flags & JSV_GARBAGE_COLLECT)
-        if (!jsvGarbageCollectMarkUsed(childVar)) return false;
-    }
-  } else if (jsvHasChildren(var)) {
-    if (jsuGetFreeStack() < 256) return false;
+}
 
-    child = jsvGetFirstChild(var);
-    while (child) {
-      childVar = jsvGetAddressOf(child);
-      if (childVar->flags & JSV_GARBAGE_COLLECT)
-        if (!jsvGarbageCollectMarkUsed(childVar)) return false;
-      child = jsvGetNextSibling(childVar);
+/** Scan everything on the mark stack until it is empty. If the stack
+ * overflowed, rescan memory for marked vars with unmarked children. */
+static void jsvGarbageCollectMarkPending() {
+  while (true) {
+    jsvGarbageCollectMarkStack();
+    if (!jsvGCMarkStackOverflow) return;
+    jsvGCMarkStackOverflow = false;
+    JsVarRef i;
+    for (i=1;i<=jsVarsSize;i++) {
+      JsVar *var = jsvGetAddressOf(i);
+      if ((var->flags&JSV_VARTYPEMASK) != JSV_UNUSED) {
+        if (jsvIsFlatString(var)) {
+          i = (JsVarRef)(i+jsvGetFlatStringBlocks(var));
+        } else if (!(var->flags & JSV_GARBAGE_COLLECT)) {
+          jsvGarbageCollectScan(var);
+          jsvGarbageCollectMarkStack(); // empty the stack as we go, so we're less likely to overflow again
+        }
+      }
     }
   }
+}
 
-  return true;
+/** Mark the variable and everything referenced from it */
+static void jsvGarbageCollectMarkUsed(JsVar *var) {
+  jsvGarbageCollectShade(var);
+  jsvGarbageCollectMarkPending();
 }
 
 /** Run a garbage collection sweep - return nonzero if things have been freed */
 int jsvGarbageCollect() {
   if (isMemoryBusy) return 0;
+  jspClearFrameCache(); // so functions that are no longer used can be freed
+#ifndef ESPR_NO_KEY_ATOMS
+  jsvAtomsFreeUnused(); // so atoms that aren't used by any keys can be freed
+#endif
   isMemoryBusy = MEMBUSY_GC;
+#ifndef ESPR_NO_INCREMENTAL_GC
+  jsvGarbageCollectAbort(); // we're doing everything now anyway
+#endif
   JsVarRef i;
   // Add GC flags to anything that is currently used
   for (i=1;i<=jsVarsSize;i++)  {
@@ -4232,22 +5010,19 @@ int jsvGarbageCollect() {
         i = (JsVarRef)(i+jsvGetFlatStringBlocks(var));
     }
   }
-  /* recursively remove anything that is referenced from a var that is locked. */
+  /* remove the flag from anything that is referenced from a var that is locked. */
   for (i=1;i<=jsVarsSize;i++)  {
     JsVar *var = jsvGetAddressOf(i);
     if ((var->flags & JSV_GARBAGE_COLLECT) && // not already GC'd
         jsvGetLocks(var)>0) { // or it is locked
-      if (!jsvGarbageCollectMarkUsed(var)) {
-        // this could fail due to stack exhausted (eg big linked list)
-        // JSV_GARBAGE_COLLECT are left set, but not a big problem as next GC will clear them
-        isMemoryBusy = MEM_NOT_BUSY;
-        return 0;
-      }
+      jsvGarbageCollectShade(var);
+      jsvGarbageCollectMarkStack();
     }
     // if we have a flat string, skip that many blocks
     if (jsvIsFlatString(var))
       i = (JsVarRef)(i+jsvGetFlatStringBlocks(var));
   }
+  jsvGarbageCollectMarkPending();
   /* now sweep for things that we can GC!
    * Also update the free list - this means that every new variable that
    * gets allocated gets allocated towards the start of memory, which
@@ -4294,6 +5069,14 @@ int jsvGarbageCollect() {
               jsvUnRef(child);
           }
         }
+#ifndef ESPR_NO_KEY_ATOMS
+        if (jsvIsName(var) && jsvIsString(var)) {
+          // same for any atom it shared (which is referenced from the atom table)
+          JsVar *atom = jsvGetAtom(var);
+          if (atom && !(atom->flags&JSV_GARBAGE_COLLECT))
+            jsvUnRef(atom);
+        }
+#endif
         /* Sanity checks here. We're making sure that any variables that are
          * linked from this one have either already been garbage collected or
          * are marked for GC */
@@ -4332,10 +5115,201 @@ int jsvGarbageCollect() {
     }
   }
   if (lastEmpty) jsvSetNextSibling(lastEmpty, 0);
+  if (freedCount) jsvPropertiesChanged();
   isMemoryBusy = MEM_NOT_BUSY;
   return (int)freedCount;
 }
 
+#ifndef ESPR_NO_INCREMENTAL_GC
+/// Set the max time in microseconds for each step of incremental GC. 0 disables incremental GC
+void jsvSetGarbageCollectBudget(unsigned int us) {
+  jsvGCBudgetUs = us;
+}
+
+/// Get the max time in microseconds for each step of incremental GC (0 if disabled)
+unsigned int jsvGetGarbageCollectBudget() {
+  return jsvGCBudgetUs;
+}
+
+/// Is an incremental garbage collection in progress?
+bool jsvGarbageCollectInProgress() {
+  return jsvGCState != JSVGC_IDLE;
+}
+
+/** Do some work on an incremental garbage collection, starting one if
+ * none is in progress. This returns after roughly the time set with
+ * jsvSetGarbageCollectBudget, regardless of how much memory there is.
+ * Returns true if the GC is still in progress and this should be called
+ * again. */
+bool jsvGarbageCollectStep() {
+  if (isMemoryBusy) return jsvGCState != JSVGC_IDLE;
+  if (jsvGCState == JSVGC_IDLE)
+    jspClearFrameCache(); // so functions that are no longer used can be freed
+  isMemoryBusy = MEMBUSY_GC;
+  JsSysTime endTime = jshGetSystemTime() + jshGetTimeFromMilliseconds(jsvGCBudgetUs / 1000.0);
+  unsigned int work = 0;
+  // vars we free are added to this list, which is added to the free list at the end
+  JsVarRef freeFirst = 0;
+  JsVar *freeLast = 0;
+
+  if (jsvGCState == JSVGC_IDLE) {
+    jsvGCState = JSVGC_FLAG;
+    jsvGCCursor = 1;
+  }
+  while (jsvGCState != JSVGC_IDLE) {
+    // Check the time every so often
+    if (work >= 32) {
+      if (jshGetSystemTime() > endTime) break;
+      work = 0;
+    }
+    JsVar *var;
+    switch (jsvGCState) {
+    case JSVGC_FLAG: // Add GC flags to anything that is currently used
+      if (jsvGCCursor > jsVarsSize) {
+        jsvGCState = JSVGC_ROOTS;
+        jsvGCCursor = 1;
+        jsvGCIsMarking = true;
+        break;
+      }
+      var = jsvGetAddressOf(jsvGCCursor);
+      if ((var->flags&JSV_VARTYPEMASK) != JSV_UNUSED) {
+        var->flags |= (JsVarFlags)JSV_GARBAGE_COLLECT;
+        if (jsvIsFlatString(var))
+          jsvGCCursor = (JsVarRef)(jsvGCCursor+jsvGetFlatStringBlocks(var));
+      }
+      jsvGCCursor++;
+      work++;
+      break;
+    case JSVGC_ROOTS: // Shade anything that is locked
+    case JSVGC_MARK: // Scan children of everything on the mark stack
+      if (jsvGCMarkStackSize) {
+        JsVarRef ref = jsvGCMarkStack[--jsvGCMarkStackSize];
+        if (ref) { // 0 if it was freed while on the stack
+          var = jsvGetAddressOf(ref);
+          if ((var->flags&JSV_VARTYPEMASK) != JSV_UNUSED)
+            work += jsvGarbageCollectScan(var);
+        }
+        break;
+      }
+      if (jsvGCState == JSVGC_ROOTS) {
+        if (jsvGCCursor > jsVarsSize) {
+          jsvGCState = JSVGC_MARK;
+          break;
+        }
+        var = jsvGetAddressOf(jsvGCCursor);
+        if ((var->flags&JSV_VARTYPEMASK) != JSV_UNUSED) {
+          if (jsvGetLocks(var))
+            jsvGarbageCollectShade(var);
+          if (jsvIsFlatString(var))
+            jsvGCCursor = (JsVarRef)(jsvGCCursor+jsvGetFlatStringBlocks(var));
+        }
+        jsvGCCursor++;
+        work++;
+      } else if (jsvGCMarkStackOverflow) {
+        jsvGCMarkStackOverflow = false;
+        jsvGCState = JSVGC_RESCAN;
+        jsvGCCursor = 1;
+      } else { // Nothing left to mark
+        jsvGCState = JSVGC_UNREF;
+        jsvGCCursor = 1;
+        jsvGCIsMarking = false;
+      }
+      break;
+    case JSVGC_RESCAN: // Scan children of anything that's marked, in case we dropped it from the stack
+      if (jsvGCCursor > jsVarsSize) {
+        jsvGCState = JSVGC_MARK;
+        break;
+      }
+      var = jsvGetAddressOf(jsvGCCursor);
+      if ((var->flags&JSV_VARTYPEMASK) != JSV_UNUSED) {
+        if (jsvIsFlatString(var))
+          jsvGCCursor = (JsVarRef)(jsvGCCursor+jsvGetFlatStringBlocks(var));
+        else if (!(var->flags & JSV_GARBAGE_COLLECT))
+          work += jsvGarbageCollectScan(var);
+      }
+      jsvGCCursor++;
+      work++;
+      break;
+    case JSVGC_UNREF: // Unref any child of something white that isn't white itself (see jsvGarbageCollect)
+      /* This can't be done as we sweep, because what a white var links to might
+       * already have been freed in an earlier step and then reused. Until we
+       * sweep, nothing white is freed, and nothing can link to it. */
+      if (jsvGCCursor > jsVarsSize) {
+        jsvGCState = JSVGC_SWEEP;
+        jsvGCCursor = 1;
+        break;
+      }
+      var = jsvGetAddressOf(jsvGCCursor);
+      if (var->flags & JSV_GARBAGE_COLLECT) {
+        if (jsvIsFlatString(var)) {
+          jsvGCCursor = (JsVarRef)(jsvGCCursor+jsvGetFlatStringBlocks(var));
+        } else if (jsvHasSingleChild(var)) {
+          JsVarRef ch = jsvGetFirstChild(var);
+          if (ch) {
+            JsVar *child = jsvGetAddressOf(ch);
+            if (child->flags!=JSV_UNUSED && !(child->flags&JSV_GARBAGE_COLLECT))
+              jsvUnRef(child);
+          }
+        }
+#ifndef ESPR_NO_KEY_ATOMS
+        if (jsvIsName(var) && jsvIsString(var)) {
+          // same for any atom it shared (which is referenced from the atom table)
+          JsVar *atom = jsvGetAtom(var);
+          if (atom && !(atom->flags&JSV_GARBAGE_COLLECT))
+            jsvUnRef(atom);
+        }
+#endif
+      } else if (jsvIsFlatString(var)) {
+        jsvGCCursor = (JsVarRef)(jsvGCCursor+jsvGetFlatStringBlocks(var));
+      }
+      jsvGCCursor++;
+      work++;
+      break;
+    case JSVGC_SWEEP: { // Free anything still white
+      if (jsvGCCursor > jsVarsSize) {
+        jsvGCState = JSVGC_IDLE;
+        break;
+      }
+      var = jsvGetAddressOf(jsvGCCursor);
+      unsigned int count = 0; // extra blocks to free
+      if (var->flags & JSV_GARBAGE_COLLECT) {
+        if (jsvIsFlatString(var))
+          count = (unsigned int)jsvGetFlatStringBlocks(var);
+        while (true) {
+          var->flags = JSV_UNUSED;
+          if (freeLast) jsvSetNextSibling(freeLast, jsvGCCursor);
+          else freeFirst = jsvGCCursor;
+          freeLast = var;
+          if (!count--) break;
+          var = jsvGetAddressOf(++jsvGCCursor);
+        }
+      } else if (jsvIsFlatString(var)) {
+        jsvGCCursor = (JsVarRef)(jsvGCCursor+jsvGetFlatStringBlocks(var));
+      }
+      jsvGCCursor++;
+      work++;
+      break;
+    }
+    default:
+      assert(0);
+      jsvGarbageCollectAbort();
+      break;
+    }
+  }
+  // Add anything we freed to the start of the free list
+  if (freeLast) {
+    jsvPropertiesChanged();
+    jshInterruptOff();
+    jsvSetNextSibling(freeLast, jsVarFirstEmpty);
+    jsVarFirstEmpty = freeFirst;
+    touchedFreeList = true;
+    jshInterruptOn();
+  }
+  isMemoryBusy = MEM_NOT_BUSY;
+  return jsvGCState != JSVGC_IDLE;
+}
+#endif
+
 #ifndef SAVE_ON_FLASH
 void jsvDefragment() {
   /* FIXME: we should surely be able to go through without `defragVars`,
@@ -4399,6 +5373,12 @@ void jsvDefragment() {
               jsvSetFirstChild(v,defragToRef);
             if (jsvGetLastChild(v)==defragFromRef)
               jsvSetLastChild(v,defragToRef);
+#ifndef ESPR_NO_OBJECT_INDEX
+            jsvObjectIndexUpdateRef(v, defragFromRef, defragToRef);
+#endif
+#ifndef ESPR_NO_ARRAY_INDEX
+            jsvArrayIndexUpdateRef(v, defragFromRef, defragToRef);
+#endif
           }
           if (jsvIsName(v)) {
             if (jsvGetNextSibling(v)==defragFromRef)
@@ -4420,6 +5400,8 @@ void jsvDefragment() {
   // rebuild free var list
   jsvCreateEmptyVarList();
   jshInterruptOn();
+  // timers are looked up by the refs of their names, which we may have moved
+  jsiTimersChanged();
 }
 #endif
 
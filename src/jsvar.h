@@ -97,6 +97,7 @@ typedef enum {
 
     JSV_CONSTANT    = JSV_VARTYPEMASK+1, ///< to specify if this variable is a constant or not. Only used for NAMEs
     JSV_NATIVE      = JSV_CONSTANT<<1, ///< to specify if this is a function parameter
+    JSV_SIMPLE_FUNCTION = JSV_NATIVE, ///< On FUNCTIONs: no nested functions, 'arguments' or 'eval', so its execution scope can be reused (see jspeFunctionDefinitionInternal)
     JSV_GARBAGE_COLLECT = JSV_NATIVE<<1, ///< When garbage collecting, this flag is true IF we should GC!
     JSV_IS_RECURSING = JSV_GARBAGE_COLLECT<<1, ///< used to stop recursive loops in jsvTrace
     JSV_LOCK_ONE    = JSV_IS_RECURSING<<1,
@@ -697,6 +698,44 @@ void jsvRemoveChild(JsVar *parent, JsVar *child);
 void jsvRemoveChildAndUnLock(JsVar *parent, JsVar *child);
 void jsvRemoveAllChildren(JsVar *parent);
 
+#ifndef ESPR_NO_INLINE_CACHE
+/** Incremented when a prototype or constructor is replaced, when the GC frees
+ * anything, or when vars are moved - anything that could change the result of
+ * any property lookup. */
+extern unsigned int jsvPropertyVersion;
+#define jsvPropertiesChanged() jsvPropertyVersion++
+
+#ifndef JSV_OBJECT_VERSIONS // must be a power of 2
+#if defined(LINUX) || defined(ESP32)
+#define JSV_OBJECT_VERSIONS 256
+#else
+#define JSV_OBJECT_VERSIONS 64
+#endif
+#endif
+/** Per-object versions, incremented when a property with a string name is added to
+ * or removed from an object, or the object is freed. There's no room in a JsVar,
+ * so objects share a version with every other object whose ref has the same low bits. */
+extern unsigned int jsvObjectVersions[JSV_OBJECT_VERSIONS];
+#define jsvObjectVersion(ref) jsvObjectVersions[(ref)&(JSV_OBJECT_VERSIONS-1)]
+#define jsvObjectChanged(var) jsvObjectVersion(jsvGetRef(var))++
+
+#ifndef JSV_LOOKUP_DEPS
+#define JSV_LOOKUP_DEPS 6
+#endif
+/// The objects whose children were searched during a property lookup
+typedef struct {
+  JsVarRef refs[JSV_LOOKUP_DEPS];
+  unsigned char count; ///< JSV_LOOKUP_DEPS+1 if there were too many to store
+} JsvLookupDeps;
+/// If set, jsvFindChildFromString records every object it searches in here
+extern JsvLookupDeps *jsvLookupDeps;
+/// Add up the versions of the objects a lookup depended on - if this changes, the lookup may give a different result
+unsigned int jsvLookupDepsVersion(const JsVarRef *refs, unsigned int count);
+#else
+#define jsvPropertiesChanged() do {} while(0)
+#define jsvObjectChanged(var) do {} while(0)
+#endif
+
 /// Get the named child of an object. If createChild!=0 then create the child
 JsVar *jsvObjectGetChild(JsVar *obj, const char *name, JsVarFlags createChild);
 /// Get the named child of an object, or return 0
@@ -749,6 +788,11 @@ JsVar *jsvArrayPopFirst(JsVar *arr); ///< Removes the first element of an array,
 void jsvArrayAddUnique(JsVar *arr, JsVar *v); ///< Adds a new variable element to the end of an array (IF it was not already there). Return true if successful
 JsVar *jsvArrayJoin(JsVar *arr, JsVar *filler, bool ignoreNull); ///< Join all elements of an array together into a string
 void jsvArrayInsertBefore(JsVar *arr, JsVar *beforeIndex, JsVar *element); ///< Insert a new element before beforeIndex, DOES NOT UPDATE INDICES
+#ifndef ESPR_NO_ARRAY_INDEX
+void jsvArrayIndexFree(JsVar *arr); ///< Remove the index of an array's elements - call this before renumbering or rearranging them
+#else
+#define jsvArrayIndexFree(arr)
+#endif
 static ALWAYS_INLINE bool jsvArrayIsEmpty(JsVar *arr) { assert(jsvIsArray(arr)); return !jsvGetFirstChild(arr); } ///< Return true is array is empty
 
 
@@ -759,6 +803,18 @@ void jsvTrace(JsVar *var, int indent);
 /** Run a garbage collection sweep - return nonzero if things have been freed */
 int jsvGarbageCollect();
 
+#ifndef ESPR_NO_INCREMENTAL_GC
+/// Set the max time in microseconds for each step of incremental GC. 0 disables incremental GC
+void jsvSetGarbageCollectBudget(unsigned int us);
+/// Get the max time in microseconds for each step of incremental GC (0 if disabled)
+unsigned int jsvGetGarbageCollectBudget();
+/// Is an incremental garbage collection in progress?
+bool jsvGarbageCollectInProgress();
+/** Do some work on an incremental garbage collection, starting one if none is in progress.
+ * Returns true if the GC is still in progress and this should be called again. */
+bool jsvGarbageCollectStep();
+#endif
+
 /** Defragement memory - this could take a while with interrupts turned off! */
 void jsvDefragment();
 
@@ -481,6 +481,26 @@ void jsvStringIteratorAppend(JsvStringIterator *it, char ch) {
   jsvSetCharactersInVar(it->var, it->charsInVar);
 }
 
+void jsvStringIteratorAppendChars(JsvStringIterator *it, const char *data, size_t len) {
+  while (len && it->var) {
+    size_t idx = it->charsInVar; // where the next character goes
+    size_t maxChars = jsvGetMaxCharactersInVar(it->var);
+    if (idx >= maxChars) { // no space - this will allocate a new block
+      jsvStringIteratorAppend(it, *(data++));
+      len--;
+      continue;
+    }
+    size_t n = maxChars - idx;
+    if (n > len) n = len;
+    memcpy(&it->ptr[idx], data, n);
+    data += n;
+    len -= n;
+    it->charsInVar = idx+n;
+    it->charIdx = it->charsInVar-1;
+    jsvSetCharactersInVar(it->var, it->charsInVar);
+  }
+}
+
 void jsvStringIteratorAppendString(JsvStringIterator *it, JsVar *str, size_t startIdx, int maxLength) {
   JsvStringIterator sit;
   jsvStringIteratorNew(&sit, str, startIdx);
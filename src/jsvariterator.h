@@ -189,6 +189,9 @@ void jsvStringIteratorGotoUTF8(JsvStringIterator *it, JsVar *str, size_t idx);
 /// Append a character TO THE END of a string iterator
 void jsvStringIteratorAppend(JsvStringIterator *it, char ch);
 
+/// Append 'len' characters TO THE END of a string iterator, a block at a time
+void jsvStringIteratorAppendChars(JsvStringIterator *it, const char *data, size_t len);
+
 /// Append an entire JsVar string TO THE END of a string iterator
 void jsvStringIteratorAppendString(JsvStringIterator *it, JsVar *str, size_t startIdx, int maxLength);
 
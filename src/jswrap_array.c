@@ -646,6 +646,7 @@ JsVar *jswrap_array_splice(JsVar *parent, JsVarInt index, JsVar *howManyVar, JsV
   jsvObjectIteratorFree(&itElement);
   jsvUnLock(beforeIndex);
   // And finally renumber
+  jsvArrayIndexFree(parent);
   while (jsvObjectIteratorHasValue(&it)) {
     JsVar *idxVar = jsvObjectIteratorGetKey(&it);
     if (idxVar && jsvIsInt(idxVar)) {
@@ -817,7 +818,9 @@ NO_INLINE static JsVarInt _jswrap_array_sort_compare(JsVar *a, JsVar *b, JsVar *
   }
 }
 
-NO_INLINE static void _jswrap_array_sort(JsvIterator *head, int n, JsVar *compareFn) {
+/* In-place quicksort using iterators. This is only used if there isn't
+ * enough memory to copy the array's elements out for _jswrap_array_sort. */
+NO_INLINE static void _jswrap_array_sort_inplace(JsvIterator *head, int n, JsVar *compareFn) {
   if (n < 2) return; // sort done!
 
   JsvIterator pivot;
@@ -879,14 +882,69 @@ NO_INLINE static void _jswrap_array_sort(JsvIterator *head, int n, JsVar *compar
   // now recurse. Do RHS first because we can
   // free the pivot early if we do this
   jsvIteratorNext(&pivot);
-  _jswrap_array_sort(&pivot, nhigh, compareFn);
+  _jswrap_array_sort_inplace(&pivot, nhigh, compareFn);
   jsvIteratorFree(&pivot);
   // LHS
   /* If the pivot is the lowest number in this chunk of numbers, then
    * we know that anything to the left of it must be joint equal to it.
    * In that casem there's no need to sort it. */
   if (!pivotLowest)
-    _jswrap_array_sort(head, nlo, compareFn);
+    _jswrap_array_sort_inplace(head, nlo, compareFn);
+}
+
+/// An element being sorted
+typedef struct {
+  JsVarRef value;
+  bool isLocked; ///< do we hold a lock on 'value'?
+} JswArraySortItem;
+
+static JsVarInt _jswrap_array_sort_compare_items(JswArraySortItem *a, JswArraySortItem *b, JsVar *compareFn) {
+  return _jswrap_array_sort_compare(
+      a->value ? _jsvGetAddressOf(a->value) : 0,
+      b->value ? _jsvGetAddressOf(b->value) : 0,
+      compareFn);
+}
+
+/** Stable merge sort of n items, using tmp (also n items) as workspace. Runs
+ * of items are insertion sorted first, and runs that are already in order
+ * aren't merged, so sorted data only needs around n compares. */
+static void _jswrap_array_sort(JswArraySortItem *items, JswArraySortItem *tmp, int n, JsVar *compareFn) {
+  const int RUN_SIZE = 8;
+  int lo, i;
+  for (lo=0; lo<n; lo+=RUN_SIZE) {
+    int hi = (lo+RUN_SIZE < n) ? lo+RUN_SIZE : n;
+    for (i=lo+1; i<hi; i++) {
+      JswArraySortItem item = items[i];
+      int j = i;
+      while (j>lo && _jswrap_array_sort_compare_items(&items[j-1], &item, compareFn)>0) {
+        items[j] = items[j-1];
+        j--;
+      }
+      items[j] = item;
+    }
+  }
+  JswArraySortItem *src = items, *dst = tmp;
+  for (int width=RUN_SIZE; width<n && !jspIsInterrupted(); width*=2) {
+    for (lo=0; lo<n; lo+=width*2) {
+      int mid = (lo+width < n) ? lo+width : n;
+      int hi = (lo+width*2 < n) ? lo+width*2 : n;
+      int a = lo, b = mid, k = lo;
+      // if the two runs are already in order we can just copy them
+      if (mid<hi && _jswrap_array_sort_compare_items(&src[mid-1], &src[mid], compareFn)>0) {
+        /* only take from the right if the left is strictly greater, so the sort
+         * is stable - and so comparators that return a boolean (a>b) still work */
+        while (a<mid && b<hi)
+          dst[k++] = (_jswrap_array_sort_compare_items(&src[a], &src[b], compareFn)>0) ? src[b++] : src[a++];
+      }
+      while (a<mid) dst[k++] = src[a++];
+      while (b<hi) dst[k++] = src[b++];
+    }
+    JswArraySortItem *t = src;
+    src = dst;
+    dst = t;
+  }
+  if (src != items)
+    memcpy(items, src, sizeof(JswArraySortItem)*(size_t)n);
 }
 
 /*JSON{
@@ -901,7 +959,8 @@ NO_INLINE static void _jswrap_array_sort(JsvIterator *head, int n, JsVar *compar
   "return" : ["JsVar","This array object"],
   "typescript" : "sort(compareFn?: (a: T, b: T) => number): T[];"
 }
-Do an in-place quicksort of the array
+Sort the array in place. The sort is stable, so elements that compare as equal
+keep their original order.
 
 **Note:** Do not modify the array you're iterating over from inside the callback (`a.sort(()=>a.push(0))`).
 It will cause non-spec-compliant behaviour.
@@ -934,9 +993,57 @@ JsVar *jswrap_array_sort (JsVar *array, JsVar *compareFn) {
     n = (int)jsvGetLength(array);
   }
 
+  if (n<2) return jsvLockAgain(array);
+  if (jsvIsUndefined(compareFn)) compareFn = 0;
+
+  /* Copy references to the elements out, sort them, and write them back. If
+   * there's not enough memory for that, fall back to sorting in place. */
+  size_t itemsSize = sizeof(JswArraySortItem)*(size_t)n*2;
+  JsVar *itemsVar = 0;
+  JswArraySortItem *items = 0;
+  if (n<=32) {
+    items = (JswArraySortItem*)alloca(itemsSize);
+  } else {
+    // flat string data might not be aligned, so leave space to align it ourselves
+    itemsVar = jsvNewFlatStringOfLength((unsigned int)(itemsSize+sizeof(JsVarRef)));
+    if (itemsVar) {
+      size_t ptr = (size_t)jsvGetFlatStringPointer(itemsVar);
+      items = (JswArraySortItem*)((ptr + sizeof(JsVarRef) - 1) & ~(sizeof(JsVarRef)-1));
+    }
+  }
+  if (!items) {
+    jsvIteratorNew(&it, array, JSIF_EVERY_ARRAY_ELEMENT);
+    _jswrap_array_sort_inplace(&it, n, compareFn);
+    jsvIteratorFree(&it);
+    return jsvLockAgain(array);
+  }
+  /* Values stay locked so they can't be freed (or moved by defrag) while the
+   * compare function runs, or when we overwrite their place in the array while
+   * writing back. The same value may be in the array many times, so don't add
+   * more locks to anything that has lots already - it's kept around by the
+   * locks we hold on its other copies. */
+  int i = 0;
   jsvIteratorNew(&it, array, JSIF_EVERY_ARRAY_ELEMENT);
-  _jswrap_array_sort(&it, n, compareFn);
+  while (jsvIteratorHasElement(&it) && i<n) {
+    JsVar *value = jsvIteratorGetValue(&it);
+    items[i].value = value ? jsvGetRef(value) : 0;
+    items[i].isLocked = value && jsvGetLocks(value) <= JSV_LOCK_MAX/2;
+    if (!items[i].isLocked) jsvUnLock(value);
+    i++;
+    jsvIteratorNext(&it);
+  }
+  jsvIteratorFree(&it);
+  n = i;
+  _jswrap_array_sort(items, &items[n], n, compareFn);
+  jsvIteratorNew(&it, array, JSIF_EVERY_ARRAY_ELEMENT);
+  for (i=0; i<n && jsvIteratorHasElement(&it); i++) {
+    jsvIteratorSetValue(&it, items[i].value ? _jsvGetAddressOf(items[i].value) : 0);
+    jsvIteratorNext(&it);
+  }
   jsvIteratorFree(&it);
+  for (i=0; i<n; i++)
+    if (items[i].isLocked) jsvUnLock(_jsvGetAddressOf(items[i].value));
+  jsvUnLock(itemsVar);
   return jsvLockAgain(array);
 }
 
@@ -1081,6 +1188,7 @@ JsVar *jswrap_array_reverse(JsVar *parent) {
 
   int len = 0;
   if (jsvIsArray(parent)) {
+    jsvArrayIndexFree(parent); // we renumber the elements
     /* arrays are sparse, so we must handle them differently.
      * We work out how many NUMERIC keys they have, and we
      * reverse only those. Then, we reverse the key values too */
@@ -1534,6 +1534,10 @@ void jswrap_e_dumpVariables() {
       JsVarRef childref = jsvGetLastChild(v);
       while (childref) {
         JsVar *child = jsvLock(childref);
+        if (jsvIsName(child)) { // an atom shared between names (listed separately)
+          jsvUnLock(child);
+          break;
+        }
         size++;
         childref = jsvGetLastChild(child);
         jsvUnLock(child);
@@ -1579,6 +1583,29 @@ void jswrap_e_dumpVariables() {
 BETA: defragment memory!
 */
 
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "E",
+  "name" : "setGCBudget",
+  "generate" : "jsvSetGarbageCollectBudget",
+  "params" : [
+    ["us","int","The maximum time in microseconds that each step of garbage collection may take, or 0 to disable incremental garbage collection"]
+  ]
+}
+When Espruino is idle and memory is getting low it runs a garbage collection
+to find and free unreferenced variables (for instance objects that reference
+each other). Normally this is done in one go, which means that on devices with
+a lot of memory, events may be delayed while it runs.
+
+If a time budget is set with `E.setGCBudget`, garbage collection is split into
+steps of at most roughly that length, which are run from the idle loop with any
+pending events handled in between. For example `E.setGCBudget(2000)` keeps each
+step under around 2ms.
+
+When memory is completely full, garbage collection is still done in one go.
+*/
+
 /*TYPESCRIPT
 type VariableSizeInformation = {
   name: string;
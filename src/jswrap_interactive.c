@@ -334,6 +334,7 @@ To set the timezone for all new Dates, use `E.setTimeZone(hours)`.
 void jswrap_interactive_setTime(JsVarFloat time) {
   jshInterruptOff();
   JsSysTime stime = jshGetTimeFromMilliseconds(time*1000);
+  JsSysTime timerDiff = stime - jsiLastIdleTime;
   jsiLastIdleTime = stime;
   JsSysTime oldtime = jshGetSystemTime();
   // set system time
@@ -341,6 +342,8 @@ void jswrap_interactive_setTime(JsVarFloat time) {
   // update any currently running timers so they don't get broken
   jstSystemTimeChanged(stime - oldtime);
   jshInterruptOn();
+  // timers store the absolute time they should run at, so move them too
+  jsiTimersAddTime(timerDiff);
 }
 
 
@@ -476,7 +479,7 @@ JsVar *_jswrap_interface_setTimeoutOrInterval(JsVar *func, JsVarFloat interval,
   JsVar *timerPtr = jsvNewObject();
   if (!timerPtr) return 0;
   JsSysTime intervalInt = jshGetTimeFromMilliseconds(interval);
-  jsvObjectSetChildAndUnLock(timerPtr, "time", jsvNewFromLongInteger((jshGetSystemTime() - jsiLastIdleTime) + intervalInt));
+  jsvObjectSetChildAndUnLock(timerPtr, "time", jsvNewFromLongInteger(jshGetSystemTime() + intervalInt));
   if (!isTimeout) {
     jsvObjectSetChildAndUnLock(timerPtr, "intr", jsvNewFromLongInteger(intervalInt));
   }
@@ -487,7 +490,6 @@ JsVar *_jswrap_interface_setTimeoutOrInterval(JsVar *func, JsVarFloat interval,
   // Add to array
   JsVar *itemIndex = jsvNewFromInteger(jsiTimerAdd(timerPtr));
   jsvUnLock(timerPtr);
-  jsiTimersChanged(); // mark timers as changed
   return itemIndex;
 }
 JsVar *jswrap_interface_setInterval(JsVar *func, JsVarFloat timeout, JsVar *args) {
@@ -552,20 +554,20 @@ void _jswrap_interface_clearTimeoutOrInterval(JsVar *idVarArr, bool isTimeout) {
       jsvUnLock2(watchPtr, timerPtr);
     }
     jsvObjectIteratorFree(&it);
+    jsiTimersChanged(); // mark timers as changed
   } else {
     JsVar *idVar = jsvGetArrayItem(idVarArr, 0);
     if (jsvIsUndefined(idVar)) {
       const char *name = isTimeout?"Timeout":"Interval";
       jsExceptionHere(JSET_ERROR, "clear%s(undefined) not allowed. Use clear%s() instead", name, name);
     } else {
-      JsVar *child = jsvIsBasic(idVar) ? jsvFindChildFromVar(timerArrayPtr, idVar, false) : 0;
+      JsVar *child = jsiTimerFindName(idVar);
       if (child)
-        jsvRemoveChildAndUnLock(timerArrayPtr, child);
-      jsvUnLock(idVar);
+        jsiTimerRemove(child);
+      jsvUnLock2(child, idVar);
     }
   }
   jsvUnLock(timerArrayPtr);
-  jsiTimersChanged(); // mark timers as changed
 }
 void jswrap_interface_clearInterval(JsVar *idVarArr) {
   _jswrap_interface_clearTimeoutOrInterval(idVarArr, false);
@@ -595,19 +597,16 @@ regardless of when you call `changeInterval`, the next interval will occur
 1500ms after it.
  */
 void jswrap_interface_changeInterval(JsVar *idVar, JsVarFloat interval) {
-  JsVar *timerArrayPtr = jsvLock(timerArray);
   if (interval<TIMER_MIN_INTERVAL) interval=TIMER_MIN_INTERVAL;
-  JsVar *timerName = jsvIsBasic(idVar) ? jsvFindChildFromVar(timerArrayPtr, idVar, false) : 0;
+  JsVar *timerName = jsiTimerFindName(idVar);
   if (timerName) {
     JsVar *timer = jsvSkipNameAndUnLock(timerName);
     JsSysTime intervalInt = jshGetTimeFromMilliseconds(interval);
     jsvObjectSetChildAndUnLock(timer, "intr", jsvNewFromLongInteger(intervalInt));
-    jsvObjectSetChildAndUnLock(timer, "time", jsvNewFromLongInteger((jshGetSystemTime()-jsiLastIdleTime) + intervalInt));
+    jsiTimerSetTime(timer, jshGetSystemTime() + intervalInt);
     jsvUnLock(timer);
     // timerName already unlocked
-    jsiTimersChanged(); // mark timers as changed
   } else {
     jsExceptionHere(JSET_ERROR, "Unknown Interval");
   }
-  jsvUnLock(timerArrayPtr);
 }
@@ -55,30 +55,532 @@ with JSON.parse or eval.
 * Typed arrays like `new Uint8Array(5)` will be dumped as if they were arrays,
   not as if they were objects (since it is more compact)
  */
+/// Get the flags and whitespace (which must be 11 chars) to use for JSON.stringify's 'space' argument
+static JSONFlags jswrap_json_stringify_flags(JsVar *space, char *whitespace) {
+  JSONFlags flags = JSON_IGNORE_FUNCTIONS|JSON_NO_UNDEFINED|JSON_ARRAYBUFFER_AS_ARRAY|JSON_JSON_COMPATIBILE|JSON_ALLOW_TOJSON;
+  whitespace[0] = 0;
+  if (jsvIsUndefined(space) || jsvIsNull(space)) {
+    // nothing
+  } else if (jsvIsNumeric(space)) {
+    int s = (int)jsvGetInteger(space);
+    if (s<0) s=0;
+    if (s>10) s=10;
+    whitespace[s] = 0;
+    while (s) whitespace[--s]=' ';
+  } else {
+    jsvGetString(space, whitespace, 10);
+  }
+  if (strlen(whitespace)) flags |= JSON_ALL_NEWLINES|JSON_PRETTY;
+  return flags;
+}
+
 JsVar *jswrap_json_stringify(JsVar *v, JsVar *replacer, JsVar *space) {
   NOT_USED(replacer);
-  JSONFlags flags = JSON_IGNORE_FUNCTIONS|JSON_NO_UNDEFINED|JSON_ARRAYBUFFER_AS_ARRAY|JSON_JSON_COMPATIBILE|JSON_ALLOW_TOJSON;
   JsVar *result = jsvNewFromEmptyString();
   if (result) {// could be out of memory
-    char whitespace[11] = "";
-    if (jsvIsUndefined(space) || jsvIsNull(space)) {
-      // nothing
-    } else if (jsvIsNumeric(space)) {
-      int s = (int)jsvGetInteger(space);
-      if (s<0) s=0;
-      if (s>10) s=10;
-      whitespace[s] = 0;
-      while (s) whitespace[--s]=' ';
-    } else {
-      jsvGetString(space, whitespace, sizeof(whitespace)-1);
-    }
-    if (strlen(whitespace)) flags |= JSON_ALL_NEWLINES|JSON_PRETTY;
+    char whitespace[11];
+    JSONFlags flags = jswrap_json_stringify_flags(space, whitespace);
     jsfGetJSONWhitespace(v, result, flags, whitespace);
   }
   return result;
 }
 
+#ifndef SAVE_ON_FLASH
+#define JSON_STREAM_CHUNK_SIZE 256 ///< How many characters we collect before calling .write in JSON.stringifyTo
+
+typedef struct {
+  JsVar *destination; ///< What we're calling .write on
+  JsVar *writeFn; ///< The .write function
+  JsVar *chunk; ///< The String we're building up
+  JsvStringIterator it; ///< Iterator at the end of 'chunk'
+} JsonStreamData;
+
+static void jsonStreamNewChunk(JsonStreamData *d) {
+  d->chunk = jsvNewFromEmptyString();
+  if (d->chunk) {
+    jsvStringIteratorNew(&d->it, d->chunk, 0);
+  } else { // out of memory - jsvStringIteratorAppend will now do nothing
+    memset(&d->it, 0, sizeof(d->it));
+  }
+}
+
+/// Send what we have so far to .write
+static void jsonStreamFlush(JsonStreamData *d) {
+  jsvStringIteratorFree(&d->it);
+  if (jsvGetStringLength(d->chunk) && !jspHasError())
+    jsvUnLock(jspExecuteFunction(d->writeFn, d->destination, 1, &d->chunk));
+  jsvUnLock(d->chunk);
+  d->chunk = 0;
+}
+
+static void jsonStreamCallback(const char *str, void *user_data) {
+  JsonStreamData *d = (JsonStreamData*)user_data;
+  jsvStringIteratorAppendChars(&d->it, str, strlen(str));
+  if (jsvStringIteratorGetIndex(&d->it) >= JSON_STREAM_CHUNK_SIZE) {
+    jsonStreamFlush(d);
+    jsonStreamNewChunk(d);
+  }
+}
+
+/*JSON{
+  "type" : "staticmethod",
+  "ifndef" : "SAVE_ON_FLASH",
+  "class" : "JSON",
+  "name" : "stringifyTo",
+  "generate" : "jswrap_json_stringifyTo",
+  "params" : [
+    ["destination","JsVar","An object with a `write` method, eg. a Socket or `require('Storage').open(filename,'w')`"],
+    ["data","JsVar","The data to be converted to JSON"],
+    ["space","JsVar","[optional] The number of spaces to use for padding, a string, or null/undefined for no whitespace "]
+  ]
+}
+Convert the given object into JSON exactly as `JSON.stringify` would, but
+call `destination.write(...)` with the output a few hundred characters at a
+time, so the whole JSON string never has to be in memory at once.
+
+```
+var f = require("Storage").open("log.json","w");
+JSON.stringifyTo(f, {some:"large", object:[1,2,3]});
+```
+
+**Note:** This is not part of standard JavaScript.
+ */
+void jswrap_json_stringifyTo(JsVar *destination, JsVar *v, JsVar *space) {
+  JsonStreamData d;
+  d.writeFn = jspGetNamedField(destination, "write", false);
+  if (!jsvIsFunction(d.writeFn)) {
+    jsExceptionHere(JSET_TYPEERROR, "Expecting an object with a 'write' method, got %t", destination);
+    jsvUnLock(d.writeFn);
+    return;
+  }
+  d.destination = destination;
+  jsonStreamNewChunk(&d);
+  char whitespace[11];
+  JSONFlags flags = jswrap_json_stringify_flags(space, whitespace);
+  jsfGetJSONWithCallback(v, NULL, flags, whitespace, jsonStreamCallback, &d);
+  jsonStreamFlush(&d);
+  jsvUnLock(d.writeFn);
+}
+#endif
+
+
+#ifndef ESPR_NO_JSON_SCANNER
+/* JSON.parse/Storage.readJSON used to drive the whole JS lexer, which
+   creates a token string for every number/key and checks every word against
+   the reserved words. JSON is simple enough that we can scan it directly off a
+   string iterator and build the values in one pass. */
+typedef struct {
+  JsvStringIterator it; ///< Iterator - points to the character *after* ch
+  char ch; ///< Current character (or 0 at the end of the string)
+  JSONFlags flags; ///< If JSON_DROP_QUOTES we allow unquoted field names
+} JsonScanner;
+
+static ALWAYS_INLINE void jsonNextCh(JsonScanner *js) {
+  if (jsvStringIteratorHasChar(&js->it)) {
+    js->ch = jsvStringIteratorGetChar(&js->it);
+    jsvStringIteratorNextInline(&js->it);
+  } else
+    js->ch = 0;
+}
+
+/// Return the character after the current one (or 0)
+static char jsonPeekCh(JsonScanner *js) {
+  return jsvStringIteratorHasChar(&js->it) ? jsvStringIteratorGetChar(&js->it) : 0;
+}
 
+/// Skip whitespace and comments (which the JS lexer also allowed)
+static void jsonSkipWhitespace(JsonScanner *js) {
+  while (true) {
+    if (isWhitespaceInline(js->ch)) {
+      jsonNextCh(js);
+    } else if (js->ch=='/' && jsonPeekCh(js)=='/') {
+      while (js->ch && js->ch!='\n') jsonNextCh(js);
+    } else if (js->ch=='/' && jsonPeekCh(js)=='*') {
+      jsonNextCh(js);
+      jsonNextCh(js);
+      while (js->ch && !(js->ch=='*' && jsonPeekCh(js)=='/')) jsonNextCh(js);
+      jsonNextCh(js);
+      jsonNextCh(js);
+    } else return;
+  }
+}
+
+static void jsonGetCharAsString(JsonScanner *js, char *buf) {
+  if (js->ch) {
+    buf[0] = '\'';
+    buf[1] = js->ch;
+    buf[2] = '\'';
+    buf[3] = 0;
+  } else strcpy(buf, "EOF");
+}
+
+/// If the current character is 'ch' skip it (and whitespace after), or raise an exception and return false
+static bool jsonMatch(JsonScanner *js, char ch) {
+  if (js->ch != ch) {
+    char got[4];
+    jsonGetCharAsString(js, got);
+    jsExceptionHere(JSET_SYNTAXERROR, "Got %s expected '%c'", got, ch);
+    return false;
+  }
+  jsonNextCh(js);
+  jsonSkipWhitespace(js);
+  return true;
+}
+
+#ifdef ESPR_UNICODE_SUPPORT
+/// We just found out the string we're building is UTF8 - re-encode any chars >=128 we already added as UTF8
+static JsVar *jsonConvertStringUTF8(JsVar *str, JsvStringIterator *it) {
+  jsvStringIteratorFree(it);
+  str = jsvConvertToUTF8AndUnLock(str);
+  jsvStringIteratorNew(it, str, 0);
+  jsvStringIteratorGotoEnd(it);
+  return str;
+}
+#endif
+
+/// Scan a quoted string. This handles escape codes and UTF8 exactly as jslLexString does
+static JsVar *jsonScanString(JsonScanner *js) {
+  char delim = js->ch;
+  JsVar *str = jsvNewFromEmptyString();
+  if (!str) return 0;
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, str, 0);
+  jsonNextCh(js);
+#ifdef ESPR_UNICODE_SUPPORT
+  bool isUTF8 = false;
+  bool hadCharsInUTF8Range = false;
+  int highSurrogate = 0;
+#endif
+  while (js->ch && js->ch!=delim && js->ch!='\n') {
+    char ch = js->ch;
+    jsonNextCh(js);
+    if (ch == '\\') {
+      ch = js->ch;
+      jsonNextCh(js);
+      switch (ch) {
+      case 'n'  : ch = 0x0A; break;
+      case 'b'  : ch = 0x08; break;
+      case 'f'  : ch = 0x0C; break;
+      case 'r'  : ch = 0x0D; break;
+      case 't'  : ch = 0x09; break;
+      case 'v'  : ch = 0x0B; break;
+      case 'u'  :
+      case 'x'  : { // hex digits
+        char buf[5];
+        bool isUnicode = ch=='u';
+        unsigned int len = isUnicode?4:2, n=0;
+        while (len--) {
+          if (!isHexadecimal(js->ch)) {
+            jsExceptionHere(JSET_ERROR, "Invalid escape sequence");
+            break;
+          }
+          buf[n++] = js->ch;
+          jsonNextCh(js);
+        }
+        buf[n] = 0;
+        int codepoint = (int)stringToIntWithRadix(buf,16,NULL,NULL);
+#ifdef ESPR_UNICODE_SUPPORT
+        // As in jslLexString, \x## is copied in verbatim (unless the string is already UTF8) but \u#### is UTF8 encoded
+        if (isUnicode) {
+          if (highSurrogate) {
+            if (jsUnicodeIsLowSurrogate(codepoint)) {
+              codepoint = 0x10000 + ((codepoint & 0x03FF) | ((highSurrogate & 0x03FF) << 10));
+            } else {
+              jsExceptionHere(JSET_ERROR, "Unmatched Unicode surrogate");
+              if (jsUnicodeIsHighSurrogate(codepoint)) {
+                highSurrogate = codepoint;
+                continue;
+              }
+            }
+            highSurrogate = 0;
+          } else if (jsUnicodeIsHighSurrogate(codepoint)) {
+            highSurrogate = codepoint;
+            continue;
+          } else if (jsUnicodeIsLowSurrogate(codepoint)) {
+            jsExceptionHere(JSET_ERROR, "Unmatched Unicode surrogate");
+          }
+        }
+        if (isUnicode || isUTF8) {
+          len = jsUTF8Encode(codepoint, buf);
+          if (jsUTF8IsStartChar(buf[0])) {
+            if (!isUTF8 && hadCharsInUTF8Range)
+              str = jsonConvertStringUTF8(str, &it);
+            isUTF8 = true;
+          }
+          for (n=0;n<len-1;n++)
+            jsvStringIteratorAppend(&it, buf[n]);
+          ch = buf[len-1];
+        } else {
+          hadCharsInUTF8Range |= jsUTF8IsStartChar((char)codepoint);
+          ch = (char)codepoint;
+        }
+#else
+        ch = (char)codepoint;
+#endif
+      } break;
+      default:
+        if (ch>='0' && ch<='7') { // octal digits
+          int n = ch-'0';
+          if (js->ch>='0' && js->ch<='7') {
+            n = n*8 + js->ch-'0';
+            jsonNextCh(js);
+            if (js->ch>='0' && js->ch<='7') {
+              n = n*8 + js->ch-'0';
+              jsonNextCh(js);
+            }
+          }
+          ch = (char)n;
+        } // anything else is just pushed through
+        break;
+      }
+    }
+#ifdef ESPR_UNICODE_SUPPORT
+    else if (jsUTF8IsStartChar(ch)) {
+      char buf[4];
+      buf[0] = ch;
+      bool isValidUTF8 = true;
+      unsigned int len = jsUTF8LengthFromChar(ch);
+      for (unsigned int i=1;i<len;i++) {
+        buf[i] = js->ch;
+        if ((js->ch&0xC0) != 0x80) {
+          // not a valid UTF8 sequence - carry on as a non-UTF8 Espruino would
+          isValidUTF8 = false;
+          len = i;
+          break;
+        }
+        jsonNextCh(js);
+      }
+      if (isValidUTF8) {
+        if (!isUTF8 && hadCharsInUTF8Range)
+          str = jsonConvertStringUTF8(str, &it);
+        isUTF8 = true;
+      } else
+        hadCharsInUTF8Range = true;
+      for (unsigned int i=0;i<len-1;i++)
+        jsvStringIteratorAppend(&it, buf[i]);
+      ch = buf[len-1];
+    }
+    if (highSurrogate) {
+      jsExceptionHere(JSET_ERROR, "Unmatched Unicode surrogate");
+      highSurrogate = 0;
+    }
+#endif
+    jsvStringIteratorAppend(&it, ch);
+  }
+  jsvStringIteratorFree(&it);
+  if (js->ch!=delim) {
+    jsExceptionHere(JSET_SYNTAXERROR, "Unfinished string");
+    jsvUnLock(str);
+    return 0;
+  }
+  jsonNextCh(js);
+  jsonSkipWhitespace(js);
+#ifdef ESPR_UNICODE_SUPPORT
+  if (isUTF8) // If the parsed string was UTF8, we should wrap it up
+    str = jsvNewUTF8StringAndUnLock(str);
+#endif
+  return str;
+}
+
+/// Scan an unquoted field name (only allowed with JSON_DROP_QUOTES)
+static JsVar *jsonScanFieldName(JsonScanner *js) {
+  JsVar *str = jsvNewFromEmptyString();
+  if (!str) return 0;
+  JsvStringIterator it;
+  jsvStringIteratorNew(&it, str, 0);
+  while (isAlphaInline(js->ch) || isNumericInline(js->ch) || js->ch=='$') {
+    jsvStringIteratorAppend(&it, js->ch);
+    jsonNextCh(js);
+  }
+  jsvStringIteratorFree(&it);
+  jsonSkipWhitespace(js);
+  return str;
+}
+
+#define JSON_NUMBER_MAX_EXPONENT 1000 ///< Exponents beyond this are clamped (a 64 char number can't bring them back into range)
+#define JSON_NUMBER_EXPONENT_LENGTH 7 ///< Space needed in the buffer for '.' and 'e-1000'
+
+/// Scan a number, accumulating integers directly and only using a buffer for floats/hex/etc
+static JsVar *jsonScanNumber(JsonScanner *js) {
+  char buf[JSLEX_MAX_TOKEN_LENGTH];
+  size_t len = 0;
+  bool negative = js->ch=='-';
+  if (negative) jsonNextCh(js);
+  bool leadingDot = js->ch=='.' && isNumericInline(jsonPeekCh(js)); // '.5' - the JS lexer allows it
+  if (!isNumericInline(js->ch) && !leadingDot) {
+    // JSON doesn't allow '-Infinity', or space after the '-' (the JS lexer did)
+    char got[4];
+    jsonGetCharAsString(js, got);
+    jsExceptionHere(JSET_SYNTAXERROR, negative ? "Expecting a number after '-', got %s" : "Expecting valid value, got %s", got);
+    return 0;
+  }
+  JsVar *v;
+  char radix = (js->ch=='0') ? (char)(jsonPeekCh(js)|0x20) : 0;
+  if (radix=='x' || radix=='b' || radix=='o') { // 0x.., 0b.., 0o.. - allowed by the JS lexer so we allow them too
+    while ((isAlphaInline(js->ch) || isNumericInline(js->ch)) && len<sizeof(buf)-1) {
+      buf[len++] = js->ch;
+      jsonNextCh(js);
+    }
+    buf[len] = 0;
+    long long i = stringToInt(buf);
+    v = jsvNewFromLongInteger(negative ? -i : i);
+  } else {
+    /* Integers are accumulated negatively, so -9223372036854775808 fits. For
+     * floats, buf gets the digits - leaving room to add the exponent. Integer
+     * digits that don't fit are counted into the exponent instead, and
+     * fractional digits that don't fit are too small to matter. */
+    const size_t maxDigits = sizeof(buf)-1-JSON_NUMBER_EXPONENT_LENGTH;
+    long long i = 0;
+    int exponent = 0;
+    bool isFloat = false;
+    while (isNumericInline(js->ch)) {
+      int digit = js->ch-'0';
+      if (i < (-0x7FFFFFFFFFFFFFFFLL-1+digit)/10) isFloat = true; // too big for a long long
+      else i = i*10 - digit;
+      if (len==1 && buf[0]=='0') len = 0; // leading zeros mustn't fill up buf
+      if (len<maxDigits) buf[len++] = js->ch;
+      else exponent++;
+      jsonNextCh(js);
+    }
+    if (!negative) {
+      if (i==-0x7FFFFFFFFFFFFFFFLL-1) isFloat = true; // 9223372036854775808 has no positive long long
+      else i = -i;
+    }
+    if (js->ch=='.') {
+      isFloat = true;
+      bool significant = len && buf[0]!='0';
+      buf[len++] = '.'; // there's always room, as maxDigits leaves space
+      size_t fractionStart = len;
+      jsonNextCh(js);
+      while (isNumericInline(js->ch)) {
+        if (js->ch!='0') significant = true;
+        if (len>=maxDigits && !significant) { // 0.0000...01 - move the zeros we have into the exponent
+          exponent -= (int)(len-fractionStart);
+          len = fractionStart;
+        }
+        if (len<maxDigits) buf[len++] = js->ch;
+        jsonNextCh(js);
+      }
+    }
+    if (js->ch=='e' || js->ch=='E') {
+      isFloat = true;
+      jsonNextCh(js);
+      bool negativeExponent = js->ch=='-';
+      if (js->ch=='+' || js->ch=='-')
+        jsonNextCh(js);
+      int e = 0;
+      while (isNumericInline(js->ch)) {
+        if (e < JSON_NUMBER_MAX_EXPONENT) e = e*10 + js->ch-'0';
+        jsonNextCh(js);
+      }
+      exponent += negativeExponent ? -e : e;
+    }
+    if (isFloat) {
+      // anything past this is Infinity or 0 whatever digits we have
+      if (exponent > JSON_NUMBER_MAX_EXPONENT) exponent = JSON_NUMBER_MAX_EXPONENT;
+      if (exponent < -JSON_NUMBER_MAX_EXPONENT) exponent = -JSON_NUMBER_MAX_EXPONENT;
+      if (exponent) {
+        buf[len++] = 'e';
+        itostr(exponent, &buf[len], 10);
+      } else
+        buf[len] = 0;
+      JsVarFloat f = stringToFloat(buf);
+      v = jsvNewFromFloat(negative ? -f : f);
+    } else
+      v = jsvNewFromLongInteger(i);
+  }
+  jsonSkipWhitespace(js);
+  return v;
+}
+
+static JsVar *jsonParseValue(JsonScanner *js) {
+  if (!jspCheckStackPosition()) return 0;
+  switch (js->ch) {
+  case '"':
+  case '\'': return jsonScanString(js);
+  case '[': {
+    JsVar *arr = jsvNewEmptyArray(); if (!arr) return 0;
+    jsonMatch(js, '[');
+    while (js->ch != ']' && !jspHasError()) {
+      JsVar *value = jsonParseValue(js);
+      if (!value ||
+          (js->ch!=']' && !jsonMatch(js, ','))) {
+        jsvUnLock2(value, arr);
+        return 0;
+      }
+      jsvArrayPush(arr, value);
+      jsvUnLock(value);
+    }
+    if (!jsonMatch(js, ']')) {
+      jsvUnLock(arr);
+      return 0;
+    }
+    return arr;
+  }
+  case '{': {
+    JsVar *obj = jsvNewObject(); if (!obj) return 0;
+    jsonMatch(js, '{');
+    while (js->ch != '}' && !jspHasError()) {
+      JsVar *key = 0;
+      if (js->ch=='"' || js->ch=='\'')
+        key = jsonScanString(js);
+      else if ((js->flags&JSON_DROP_QUOTES) && (isAlphaInline(js->ch) || isNumericInline(js->ch) || js->ch=='$'))
+        key = jsonScanFieldName(js);
+      else {
+        char got[4];
+        jsonGetCharAsString(js, got);
+        jsExceptionHere(JSET_SYNTAXERROR, "Got %s expected STRING", got);
+      }
+      key = jsvAsArrayIndexAndUnLock(key);
+      JsVar *value = 0;
+      if (!key || !jsonMatch(js, ':') ||
+          !(value=jsonParseValue(js)) ||
+          (js->ch!='}' && !jsonMatch(js, ','))) {
+        jsvUnLock3(key, value, obj);
+        return 0;
+      }
+      jsvAddName(obj, jsvMakeIntoVariableName(key, value));
+      jsvUnLock2(value, key);
+    }
+    if (!jsonMatch(js, '}')) {
+      jsvUnLock(obj);
+      return 0;
+    }
+    return obj;
+  }
+  default: {
+    if (js->ch=='-' || isNumericInline(js->ch) || js->ch=='.')
+      return jsonScanNumber(js);
+    // true/false/null - or any other word, which we report in the error like the JS lexer would
+    char word[JSLEX_MAX_TOKEN_LENGTH];
+    size_t len = 0;
+    while ((isAlphaInline(js->ch) || (len && isNumericInline(js->ch))) && len<sizeof(word)-1) {
+      word[len++] = js->ch;
+      jsonNextCh(js);
+    }
+    word[len] = 0;
+    if (len && !isAlphaInline(js->ch)) {
+      JsVar *v = 0;
+      if (!strcmp(word, "true")) v = jsvNewFromBool(true);
+      else if (!strcmp(word, "false")) v = jsvNewFromBool(false);
+      else if (!strcmp(word, "null")) v = jsvNewWithFlags(JSV_NULL);
+      if (v) {
+        jsonSkipWhitespace(js);
+        return v;
+      }
+    }
+    if (len) {
+      jsExceptionHere(JSET_SYNTAXERROR, "Expecting valid value, got ID %s", word);
+    } else {
+      char got[4];
+      jsonGetCharAsString(js, got);
+      jsExceptionHere(JSET_SYNTAXERROR, "Expecting valid value, got %s", got);
+    }
+    return 0; // undefined = error
+  }
+  }
+}
+#else
 /* Parse JSON from the current lexer. unquoted fields aren't normally allowed,
    but if flags&JSON_DROP_QUOTES we'll allow them */
 JsVar *jswrap_json_parse_internal(JSONFlags flags) {
@@ -167,6 +669,7 @@ JsVar *jswrap_json_parse_internal(JSONFlags flags) {
   }
   }
 }
+#endif
 
 /*JSON{
   "type" : "staticmethod",
@@ -181,6 +684,19 @@ JsVar *jswrap_json_parse_internal(JSONFlags flags) {
 Parse the given JSON string into a JavaScript object
  */
 JsVar *jswrap_json_parse_ext(JsVar *v, JSONFlags flags) {
+#ifndef ESPR_NO_JSON_SCANNER
+  JsVar *str = jsvAsString(v);
+  if (!str) return 0;
+  JsonScanner js;
+  js.flags = flags;
+  jsvStringIteratorNew(&js.it, str, 0);
+  jsonNextCh(&js);
+  jsonSkipWhitespace(&js);
+  JsVar *res = jsonParseValue(&js);
+  jsvStringIteratorFree(&js.it);
+  jsvUnLock(str);
+  return res;
+#else
   JsLex lex;
   JsVar *str = jsvAsString(v);
   JsLex *oldLex = jslSetLex(&lex);
@@ -190,6 +706,7 @@ JsVar *jswrap_json_parse_ext(JsVar *v, JSONFlags flags) {
   jslKill();
   jslSetLex(oldLex);
   return res;
+#endif
 }
 JsVar *jswrap_json_parse(JsVar *v) {
   return jswrap_json_parse_ext(v, 0);
@@ -508,6 +1025,11 @@ void jsfGetJSONWithCallback(JsVar *var, JsVar *varName, JSONFlags flags, const c
     }
   } else if ((flags&JSON_NO_NAN) && jsvIsFloat(var) && !isfinite(jsvGetFloat(var))) {
     cbprintf(user_callback, user_data, "null");
+  } else if ((jsvIsSimpleInt(var) || jsvIsFloat(var) || jsvIsBoolean(var) || jsvIsNull(var)) && !jsvIsName(var)) {
+    // format directly rather than creating a new string with %v
+    char buf[JS_NUMBER_BUFFER_SIZE];
+    jsvGetString(var, buf, sizeof(buf));
+    user_callback(buf, user_data);
   } else {
     cbprintf(user_callback, user_data, "%v", var);
   }
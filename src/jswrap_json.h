@@ -38,6 +38,7 @@ typedef enum {
 } JSONFlags;
 
 JsVar *jswrap_json_stringify(JsVar *v, JsVar *replacer, JsVar *space);
+void jswrap_json_stringifyTo(JsVar *destination, JsVar *v, JsVar *space);
 JsVar *jswrap_json_parse_ext(JsVar *v, JSONFlags flags);
 /// Parse whatever we can (even if not 100% JSON). If noExceptions, we don't set any exceptions on error, just return 0
 JsVar *jswrap_json_parse_liberal(JsVar *v, bool noExceptions);
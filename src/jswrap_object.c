@@ -1149,6 +1149,11 @@ void jswrap_function_replaceWith(JsVar *oldFunc, JsVar *newFunc) {
     else
       oldFunc->flags = (oldFunc->flags&~JSV_VARTYPEMASK) | JSV_FUNCTION;
   }
+#ifndef ESPR_NO_FRAME_CACHE
+  // The new code may not be a simple function, and any cached execution scope has the old parameters
+  oldFunc->flags = (oldFunc->flags&~JSV_SIMPLE_FUNCTION) | (newFunc->flags&JSV_SIMPLE_FUNCTION);
+  jspClearFrameCache();
+#endif
 
   // Grab scope and prototype - the things we want to keep
   JsVar *scope = jsvFindChildFromString(oldFunc, JSPARSE_FUNCTION_SCOPE_NAME);
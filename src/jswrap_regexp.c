@@ -25,246 +25,633 @@
  * lastIndex support?
  */
 
+/* RegExps are compiled (the first time they're used) into a program for a
+ * simple 'Pike VM' which is stored in a flat string on the RegExp object. The
+ * VM steps through the string one character at a time keeping a list of every
+ * place in the program a match could be at, so unlike a backtracking matcher
+ * the time taken is linear in the length of the string.
+ *
+ * See https://swtch.com/~rsc/regexp/regexp2.html */
+
 #define MAX_GROUPS 9
-#define NO_RANGE  256
+#define REGEXP_PROGRAM_NAME JS_HIDDEN_CHAR_STR"prg" ///< Compiled program for this RegExp
+#define REGEXP_MAX_CODE 0x7FFF ///< Jumps are stored as signed 16 bit offsets
+
+/// Program header
+#define REGEXP_HDR_FLAGS 0 ///< REGEXP_FLAG_*
+#define REGEXP_HDR_GROUPS 1 ///< Amount of capture groups
+#define REGEXP_HDR_FIRSTCHAR 2 ///< If REGEXP_FLAG_FIRSTCHAR, any match must start with this character
+#define REGEXP_HDR_INSTRUCTIONS 3 ///< 16 bit count of instructions in the program
+#define REGEXP_HDR_SIZE 5
+
+#define REGEXP_FLAG_IGNORECASE 1
+#define REGEXP_FLAG_ANCHORED 2 ///< Starts with '^' so can only match at the start of the string
+#define REGEXP_FLAG_FIRSTCHAR 4
+
+typedef enum {
+  RE_MATCH,
+  RE_CHAR,   ///< [char] match one character (lowercase if REGEXP_FLAG_IGNORECASE)
+  RE_ANY,    ///< match any character
+  RE_CLASS,  ///< [32 byte bitmap] match any character in the set
+  RE_SPLIT,  ///< [int16 a][int16 b] carry on at both a and b, preferring a
+  RE_JMP,    ///< [int16 a] carry on at a
+  RE_SAVE,   ///< [slot] store the current index for a capture group
+  RE_BOL,    ///< start of the string
+  RE_EOL,    ///< end of the string
+  RE_WORDB,  ///< word boundary
+  RE_NWORDB, ///< not a word boundary
+  RE_LOOK,   ///< [int16 a] lookahead - carry on at a if the code after this (up to its RE_MATCH) matches here
+  RE_NLOOK,  ///< [int16 a] negative lookahead - carry on at a if the code after this doesn't match here
+} RegExpOp;
+
+static unsigned int regexpOpSize(unsigned char op) {
+  switch (op) {
+    case RE_CHAR: case RE_SAVE: return 2;
+    case RE_CLASS: return 33;
+    case RE_SPLIT: return 5;
+    case RE_JMP: case RE_LOOK: case RE_NLOOK: return 3;
+    default: return 1;
+  }
+}
+
+static int regexpGetOffset(const unsigned char *code) {
+  return (int16_t)(code[0] | (code[1]<<8));
+}
+
+static bool regexpIsWordChar(char ch) {
+  return isNumeric(ch) || isAlpha(ch);
+}
 
+// ------------------------------------------------------------------ Compiler
+
+/* The compiler is run twice - once with code==0 to find out how big the
+ * program is, and again to write it into memory we've allocated */
 typedef struct {
-  JsVar *sourceStr;
-  size_t startIndex;
-  bool ignoreCase;
-  bool rangeMatch;
-  short rangeFirstChar;
+  const char *re; ///< where we are in the RegExp source
+  unsigned char *code; ///< where we're writing code to (or 0 if we're just measuring)
+  size_t len; ///< length of code so far
+  int instructions;
   int groups;
-  size_t groupStart[MAX_GROUPS];
-  size_t groupEnd[MAX_GROUPS];
-} matchInfo;
+  bool ignoreCase;
+} RegExpCompiler;
 
-static JsVar *matchhere(char *regexp, JsvStringIterator *txtIt, matchInfo info);
+/// Insert bytes of code at 'pos' - so we can put jumps in front of code we've already compiled
+static void regexpInsert(RegExpCompiler *c, size_t pos, const unsigned char *data, unsigned int len) {
+  if (c->code) {
+    memmove(&c->code[pos+len], &c->code[pos], c->len-pos);
+    memcpy(&c->code[pos], data, len);
+  }
+  c->len += len;
+  c->instructions++;
+}
 
-static JsVar *matchfound(JsvStringIterator *txtIt, matchInfo info) {
-  JsVar *rmatch = jsvNewEmptyArray();
-  size_t endIndex = jsvStringIteratorGetIndex(txtIt);
-  JsVar *matchStr = jsvNewFromStringVar(info.sourceStr, info.startIndex, endIndex-info.startIndex);
-  jsvSetArrayItem(rmatch, 0, matchStr);
-  jsvUnLock(matchStr);
-  int i;
-  for (i=0;i<info.groups;i++) {
-    matchStr = jsvNewFromStringVar(info.sourceStr, info.groupStart[i], info.groupEnd[i]-info.groupStart[i]);
-    jsvSetArrayItem(rmatch, i+1, matchStr);
-    jsvUnLock(matchStr);
+static void regexpEmit(RegExpCompiler *c, const unsigned char *data, unsigned int len) {
+  regexpInsert(c, c->len, data, len);
+}
+
+static void regexpEmitOp(RegExpCompiler *c, RegExpOp op, int arg) {
+  unsigned char data[2] = { (unsigned char)op, (unsigned char)arg };
+  regexpEmit(c, data, regexpOpSize((unsigned char)op));
+}
+
+static void regexpInsertJump(RegExpCompiler *c, size_t pos, RegExpOp op, int a, int b) {
+  unsigned char data[5] = { (unsigned char)op, (unsigned char)a, (unsigned char)(a>>8), (unsigned char)b, (unsigned char)(b>>8) };
+  regexpInsert(c, pos, data, regexpOpSize((unsigned char)op));
+}
+
+static void regexpClassAdd(unsigned char *set, int from, int to) {
+  for (int ch=from; ch<=to; ch++)
+    set[ch>>3] |= (unsigned char)(1<<(ch&7));
+}
+
+/// Add a class like \d or \W to the set. Returns false if it's not a class
+static bool regexpClassAddEscape(unsigned char *set, char esc) {
+  bool inverted = esc>='A' && esc<='Z';
+  esc = charToLowerCase(esc);
+  if (esc!='d' && esc!='s' && esc!='w') return false;
+  for (int ch=0; ch<256; ch++) {
+    bool match;
+    if (esc=='d') match = isNumeric((char)ch);
+    else if (esc=='s') match = isWhitespace((char)ch);
+    else match = regexpIsWordChar((char)ch);
+    if (match != inverted) regexpClassAdd(set, ch, ch);
   }
-  jsvObjectSetChildAndUnLock(rmatch, "index", jsvNewFromInteger((JsVarInt)info.startIndex));
-  jsvObjectSetChild(rmatch, "input", info.sourceStr);
+  return true;
+}
 
-  return rmatch;
+/// Parse a (possibly escaped) character. Returns -1 on error
+static int regexpCompileChar(RegExpCompiler *c) {
+  char ch = *(c->re++);
+  if (ch!='\\') return (unsigned char)ch;
+  ch = *(c->re++);
+  switch (ch) {
+    case 0: c->re--; jsExceptionHere(JSET_ERROR, "Unfinished escape in RegEx"); return -1;
+    case 'b': return 0x08;
+    case 'f': return 0x0C;
+    case 'n': return 0x0A;
+    case 'r': return 0x0D;
+    case 't': return 0x09;
+    case 'v': return 0x0B;
+    case '0': return 0;
+    case 'x':
+      if (isHexadecimal(c->re[0]) && isHexadecimal(c->re[1])) {
+        c->re += 2;
+        return hexToByte(c->re[-2], c->re[-1]);
+      }
+      return 'x';
+  }
+  if (ch>='1' && ch<='9') {
+    jsExceptionHere(JSET_ERROR, "Backreferences not supported");
+    return -1;
+  }
+  return (unsigned char)ch;
 }
 
-// No match found, so search to end of regex to see if there's an '|'
-static JsVar *nomatchfound(char *regexp, matchInfo info) {
-  if (!jspCheckStackPosition()) return 0;
-  // TODO: | inside a group?
-  while (*regexp && *regexp!='|') {
-    if (*regexp=='\\') {
-      regexp++; // end of regex after escape char!
-      if (!*regexp) return 0;
+static void regexpEmitClass(RegExpCompiler *c, unsigned char *set, bool inverted) {
+  if (c->ignoreCase) {
+    for (int ch=0; ch<256; ch++) {
+      if (set[ch>>3] & (1<<(ch&7))) {
+        int l = (unsigned char)charToLowerCase((char)ch);
+        int u = (unsigned char)charToUpperCase((char)ch);
+        regexpClassAdd(set, l, l);
+        regexpClassAdd(set, u, u);
+      }
     }
-    regexp++;
   }
-  if (*regexp != '|') return 0;
-  regexp++;
-
-  JsvStringIterator txtIt;
-  jsvStringIteratorNew(&txtIt,  info.sourceStr, info.startIndex);
-  JsVar *rmatch = matchhere(regexp, &txtIt, info);
-  jsvStringIteratorFree(&txtIt);
-  return rmatch;
+  unsigned char data[33];
+  data[0] = RE_CLASS;
+  for (int i=0; i<32; i++)
+    data[i+1] = inverted ? (unsigned char)~set[i] : set[i];
+  regexpEmit(c, data, sizeof(data));
 }
 
-/* match: search for regexp anywhere in text */
-static JsVar *match(char *regexp, JsVar *str, size_t startIndex, bool ignoreCase) {
-  matchInfo info;
-  info.sourceStr = str;
-  info.startIndex = startIndex;
-  info.ignoreCase = ignoreCase;
-  info.rangeMatch = false;
-  info.rangeFirstChar = NO_RANGE;
-  info.groups = 0;
-
-  JsVar *rmatch;
-  JsvStringIterator txtIt, txtIt2;
-  jsvStringIteratorNew(&txtIt, str, startIndex);
-  /* must look even if string is empty */
-  jsvStringIteratorClone(&txtIt2, &txtIt);
-  rmatch = matchhere(regexp, &txtIt2, info);
-  jsvStringIteratorFree(&txtIt2);
-  jsvStringIteratorNext(&txtIt);
-  while (!rmatch && jsvStringIteratorHasChar(&txtIt)) {
-    info.startIndex++;
-    jsvStringIteratorClone(&txtIt2, &txtIt);
-    rmatch = matchhere(regexp, &txtIt2, info);
-    jsvStringIteratorFree(&txtIt2);
-    jsvStringIteratorNext(&txtIt);
+/// Compile a character set, after the '['
+static bool regexpCompileClass(RegExpCompiler *c) {
+  unsigned char set[32];
+  memset(set, 0, sizeof(set));
+  bool inverted = *c->re=='^';
+  if (inverted) c->re++;
+  while (*c->re && *c->re!=']') {
+    if (c->re[0]=='\\' && regexpClassAddEscape(set, c->re[1])) {
+      c->re += 2;
+      continue;
+    }
+    int from = regexpCompileChar(c);
+    if (from<0) return false;
+    int to = from;
+    if (c->re[0]=='-' && c->re[1] && c->re[1]!=']') { // range
+      c->re++;
+      to = regexpCompileChar(c);
+      if (to<0) return false;
+    }
+    regexpClassAdd(set, from, to);
   }
-  jsvStringIteratorFree(&txtIt);
-  return rmatch;
+  if (*c->re!=']') {
+    jsExceptionHere(JSET_ERROR, "Unfinished character set in RegEx");
+    return false;
+  }
+  c->re++;
+  regexpEmitClass(c, set, inverted);
+  return true;
 }
 
-/* Match one character. Doesn't modify txtIt, returns length of regexp char in *length  */
-bool matchcharacter(char *regexp, JsvStringIterator *txtIt, int *length, matchInfo *info) {
-  *length = 1;
-  char ch = jsvStringIteratorGetChar(txtIt);
-  if (regexp[0]=='.') return true;
-  if (regexp[0]=='[') { // Character set (any char inside '[]')
-    info->rangeMatch = true;
-    bool inverted = regexp[1]=='^';
-    if (inverted) (*length)++;
-    bool matchAny = false;
-    while (regexp[*length] && regexp[*length]!=']') {
-      int matchLen;
-      if (regexp[*length]=='.') { // https://github.com/espruino/Espruino/issues/1948
-        matchAny |= ch=='.';
-        (*length)++;
-      } else {
-        matchAny |= matchcharacter(&regexp[*length], txtIt, &matchLen, info);
-        (*length) += matchLen;
+static bool regexpCompileAlternatives(RegExpCompiler *c);
+
+/// Compile a single item - a character, class, group, etc
+static bool regexpCompileAtom(RegExpCompiler *c) {
+  char ch = *c->re;
+  if (ch=='(') {
+    if (!jspCheckStackPosition()) return false;
+    c->re++;
+    int group = 0;
+    if (c->re[0]=='?' && (c->re[1]=='=' || c->re[1]=='!')) {
+      // (?=x) -> LOOK next; x; MATCH; next:
+      bool negative = c->re[1]=='!';
+      c->re += 2;
+      size_t start = c->len;
+      if (!regexpCompileAlternatives(c)) return false;
+      if (*c->re!=')') {
+        jsExceptionHere(JSET_ERROR, "Unfinished group in RegEx");
+        return false;
       }
+      c->re++;
+      regexpEmitOp(c, RE_MATCH, 0);
+      regexpInsertJump(c, start, negative ? RE_NLOOK : RE_LOOK, (int)(c->len-start)+3, 0);
+      return true;
     }
-    if (regexp[*length]==']') {
-      (*length)++;
-    } else {
-      jsExceptionHere(JSET_ERROR, "Unfinished character set in RegEx");
+    if (c->re[0]=='?') {
+      if (c->re[1]!=':') {
+        jsExceptionHere(JSET_ERROR, (c->re[1]=='<') ? "Lookbehind not supported" : "Unknown group type in RegEx");
+        return false;
+      }
+      c->re += 2;
+    } else if (c->groups<MAX_GROUPS)
+      group = ++c->groups;
+    if (group) regexpEmitOp(c, RE_SAVE, group*2);
+    if (!regexpCompileAlternatives(c)) return false;
+    if (*c->re!=')') {
+      jsExceptionHere(JSET_ERROR, "Unfinished group in RegEx");
       return false;
     }
-    info->rangeMatch = false;
-    return matchAny != inverted;
+    c->re++;
+    if (group) regexpEmitOp(c, RE_SAVE, group*2+1);
+    return true;
   }
-  char cH = regexp[0];
-  if (cH=='\\') { // escape character
-    *length = 2;
-    // fallback to the quoted character (e.g. /,-,? etc.)
-    cH = regexp[1];
-    // missing quite a few here
-    // https://developer.mozilla.org/en-US/docs/Web/JavaScript/Guide/Regular_Expressions
-    if (cH=='d') return isNumeric(ch);
-    if (cH=='D') return !isNumeric(ch);
-    if (cH=='f') { cH=0x0C; goto haveCode; }
-    if (cH=='b') { cH=0x08; goto haveCode; }
-    if (cH=='n') { cH=0x0A; goto haveCode; }
-    if (cH=='r') { cH=0x0D; goto haveCode; }
-    if (cH=='s') return isWhitespace(ch);
-    if (cH=='S') return !isWhitespace(ch);
-    if (cH=='t') { cH=0x09; goto haveCode; }
-    if (cH=='v') { cH=0x0B; goto haveCode; }
-    if (cH=='w') return isNumeric(ch) || isAlpha(ch) || ch=='_';
-    if (cH=='W') return !(isNumeric(ch) || isAlpha(ch) || ch=='_');
-    if (cH=='0') { cH=0; goto haveCode; }
-    if (cH>='1' && cH<='9') {
-      jsExceptionHere(JSET_ERROR, "Backreferences not supported");
-      return false;
-      // we could implement this if needed by matching against info->groupStart/End
+  if (ch=='[') {
+    c->re++;
+    return regexpCompileClass(c);
+  }
+  if (ch=='.' || ch=='^' || ch=='$') {
+    c->re++;
+    regexpEmitOp(c, (ch=='.') ? RE_ANY : ((ch=='^') ? RE_BOL : RE_EOL), 0);
+    return true;
+  }
+  if (ch=='\\') {
+    char esc = c->re[1];
+    if (esc=='b' || esc=='B') {
+      c->re += 2;
+      regexpEmitOp(c, (esc=='b') ? RE_WORDB : RE_NWORDB, 0);
+      return true;
     }
-    if (cH=='x' && regexp[2] && regexp[3]) {
-      *length = 4;
-      cH = (char)hexToByte(regexp[2],regexp[3]);
-      goto haveCode;
+    unsigned char set[32];
+    memset(set, 0, sizeof(set));
+    if (regexpClassAddEscape(set, esc)) {
+      c->re += 2;
+      regexpEmitClass(c, set, false);
+      return true;
     }
   }
-haveCode:
-  if (info->rangeMatch && regexp[*length] == '-' && regexp[1+*length] != ']') { // Character set range start
-    info->rangeFirstChar = cH;
-    (*length)++;
-    int matchLen;
-    bool match = matchcharacter(&regexp[*length], txtIt, &matchLen, info);
-    (*length)+=matchLen;
-    return match;
+  int chr = regexpCompileChar(c);
+  if (chr<0) return false;
+  if (c->ignoreCase) chr = (unsigned char)charToLowerCase((char)chr);
+  regexpEmitOp(c, RE_CHAR, chr);
+  return true;
+}
+
+/// Compile a list of items with their quantifiers, up to a '|' or ')'
+static bool regexpCompileSequence(RegExpCompiler *c) {
+  while (*c->re && *c->re!='|' && *c->re!=')') {
+    size_t start = c->len;
+    if (!regexpCompileAtom(c)) return false;
+    char q = *c->re;
+    if (q!='*' && q!='+' && q!='?') continue;
+    c->re++;
+    bool lazy = *c->re=='?';
+    if (lazy) c->re++;
+    int len = (int)(c->len - start);
+    if (q=='+') { // x+ -> L: x, SPLIT L, next
+      int a = -len, b = 5;
+      regexpInsertJump(c, c->len, RE_SPLIT, lazy?b:a, lazy?a:b);
+    } else if (q=='*') { // x* -> L: SPLIT x, next; x; JMP L
+      int a = 5, b = 5+len+3;
+      regexpInsertJump(c, start, RE_SPLIT, lazy?b:a, lazy?a:b);
+      regexpInsertJump(c, c->len, RE_JMP, -(len+5), 0);
+    } else { // x? -> SPLIT x, next; x
+      int a = 5, b = 5+len;
+      regexpInsertJump(c, start, RE_SPLIT, lazy?b:a, lazy?a:b);
+    }
   }
-  if (info->ignoreCase) {
-    ch = charToLowerCase(ch);
-    cH = charToLowerCase(cH);
+  return true;
+}
+
+/// Compile a|b|c... -> SPLIT a, L1; a; JMP end; L1: SPLIT b, L2; ...
+static bool regexpCompileAlternatives(RegExpCompiler *c) {
+  size_t start = c->len;
+  if (!regexpCompileSequence(c)) return false;
+  if (*c->re!='|') return true;
+  c->re++;
+  if (!jspCheckStackPosition()) return false;
+  int len = (int)(c->len - start);
+  regexpInsertJump(c, start, RE_SPLIT, 5, 5+len+3);
+  size_t jmp = c->len;
+  regexpInsertJump(c, jmp, RE_JMP, 0, 0);
+  if (!regexpCompileAlternatives(c)) return false;
+  if (c->code) {
+    int offset = (int)(c->len - jmp);
+    c->code[jmp+1] = (unsigned char)offset;
+    c->code[jmp+2] = (unsigned char)(offset>>8);
   }
-  if (info->rangeFirstChar != NO_RANGE) { // Character set range
-    char cL = (char)info->rangeFirstChar;
-    if (info->ignoreCase) {
-      cL = charToLowerCase(cL);
-    }
-    info->rangeFirstChar = NO_RANGE;
-    return (ch >= cL && ch <= cH && cL < cH);
+  return true;
+}
+
+static bool regexpCompileProgram(RegExpCompiler *c, const char *source) {
+  c->re = source;
+  c->len = 0;
+  c->instructions = 0;
+  c->groups = 0;
+  if (!regexpCompileAlternatives(c)) return false;
+  if (*c->re==')') {
+    jsExceptionHere(JSET_ERROR, "Unmatched ')' in RegEx");
+    return false;
+  }
+  regexpEmitOp(c, RE_MATCH, 0);
+  if (c->len > REGEXP_MAX_CODE) {
+    jsExceptionHere(JSET_ERROR, "RegEx too large");
+    return false;
   }
-  return cH==ch;
+  return true;
 }
 
-/* matchhere: search for regexp at beginning of text. Only handles up to '|' character. Modifies txtIt */
-static JsVar *matchhere(char *regexp, JsvStringIterator *txtIt, matchInfo info) {
-  if (jspIsInterrupted()) return 0;
-  if (regexp[0] == '\0' || // end of regex
-      regexp[0] == '|') // end of this 'or' section of regex
-    return matchfound(txtIt, info);
-  if (regexp[0] == '^') { // must be beginning of String
-    if (jsvStringIteratorGetIndex(txtIt)!=0)
-      return 0; // no match
-    if (!jspCheckStackPosition()) return 0;
-    return matchhere(regexp+1, txtIt, info);
+/// Get the compiled program for this RegExp, compiling it if it hasn't been already
+static JsVar *regexpGetProgram(JsVar *regexp) {
+  JsVar *prog = jsvObjectGetChildIfExists(regexp, REGEXP_PROGRAM_NAME);
+  if (prog) return prog;
+  JsVar *source = jsvObjectGetChildIfExists(regexp, "source");
+  if (!jsvIsString(source)) {
+    jsvUnLock(source);
+    return 0;
   }
-  // Marker for end of String
-  if (regexp[0] == '$') {
-    if (!jsvStringIteratorHasChar(txtIt))
-      return matchhere(regexp+1, txtIt, info);
-    else
-      return nomatchfound(regexp+1, info); // not the end, it's a fail
+  size_t sourceLen = jsvGetStringLength(source);
+  char *sourcePtr = (char *)alloca(sourceLen+1);
+  jsvGetString(source, sourcePtr, sourceLen+1);
+  jsvUnLock(source);
+
+  RegExpCompiler c;
+  c.code = 0;
+  c.ignoreCase = jswrap_regexp_hasFlag(regexp,'i');
+  if (!regexpCompileProgram(&c, sourcePtr)) return 0;
+  prog = jsvNewFlatStringOfLength((unsigned int)(REGEXP_HDR_SIZE + c.len));
+  if (!prog) {
+    jsExceptionHere(JSET_ERROR, "Not enough memory to compile RegEx");
+    return 0;
   }
-  if (regexp[0] == '(') {
-    info.groupStart[info.groups] = jsvStringIteratorGetIndex(txtIt);
-    info.groupEnd[info.groups] = info.groupStart[info.groups];
-    if (info.groups<MAX_GROUPS) info.groups++;
-    if (!jspCheckStackPosition()) return 0;
-    return matchhere(regexp+1, txtIt, info);
+  unsigned char *p = (unsigned char*)jsvGetFlatStringPointer(prog);
+  c.code = &p[REGEXP_HDR_SIZE];
+  regexpCompileProgram(&c, sourcePtr);
+  unsigned char flags = 0;
+  if (c.ignoreCase) flags |= REGEXP_FLAG_IGNORECASE;
+  if (c.code[0]==RE_BOL) flags |= REGEXP_FLAG_ANCHORED;
+  if (c.code[0]==RE_CHAR && !(c.ignoreCase && charToUpperCase((char)c.code[1])!=(char)c.code[1])) {
+    flags |= REGEXP_FLAG_FIRSTCHAR;
+    p[REGEXP_HDR_FIRSTCHAR] = c.code[1];
   }
-  if (regexp[0] == ')') {
-    if (info.groups>0)
-      info.groupEnd[info.groups-1] = jsvStringIteratorGetIndex(txtIt);
-    if (!jspCheckStackPosition()) return 0;
-    return matchhere(regexp+1, txtIt, info);
+  p[REGEXP_HDR_FLAGS] = flags;
+  p[REGEXP_HDR_GROUPS] = (unsigned char)c.groups;
+  p[REGEXP_HDR_INSTRUCTIONS] = (unsigned char)c.instructions;
+  p[REGEXP_HDR_INSTRUCTIONS+1] = (unsigned char)(c.instructions>>8);
+  jsvObjectSetChild(regexp, REGEXP_PROGRAM_NAME, prog);
+  return prog;
+}
+
+// ------------------------------------------------------------------ Pike VM
+
+/// A list of threads (positions in the program) all at the same point in the string
+typedef struct {
+  int count;
+  uint16_t *pc;
+  int *slots; ///< capture slots for each thread
+  unsigned char *visited; ///< bitmap of which bytes of code we've already added threads for
+} RegExpThreadList;
+
+typedef struct {
+  const unsigned char *prog; ///< the whole program, including its header
+  size_t progLen;
+  JsVar *str; ///< the string we're matching
+  const unsigned char *code;
+  size_t codeLen;
+  int slotCount; ///< 2 per group, plus 2 for the whole match
+  bool ignoreCase;
+  int *stack; ///< for regexpAddThread - 2 ints for each of 2*instructions+1 entries
+  // State of the string at the index threads are being added for
+  int index;
+  bool atEnd;
+  char prevChar, thisChar;
+} RegExpVM;
+
+static bool regexpRun(const unsigned char *prog, size_t progLen, JsVar *str, size_t startIndex, int startPc, int *matchSlots);
+
+/// Add a thread, following jumps and assertions until we get to something that needs a character
+static void regexpAddThread(RegExpVM *vm, RegExpThreadList *l, int pc, int *slots) {
+  /* Rather than recursing, we keep a stack of pcs still to follow, in priority order. When
+   * we SAVE we also push the old slot value (as -1-slot, value) so it's restored once everything
+   * after the SAVE has been followed. We only follow each pc once, so each instruction can only
+   * push twice (for SPLIT), and this can never have more than 2*instructions+1 entries. */
+  int *stack = vm->stack;
+  int sp = 0;
+  stack[sp++] = pc;
+  stack[sp++] = 0;
+  while (sp) {
+    sp -= 2;
+    pc = stack[sp];
+    if (pc<0) { // restore a slot after a SAVE
+      slots[-1-pc] = stack[sp+1];
+      continue;
+    }
+    if (l->visited[pc>>3] & (1<<(pc&7))) continue;
+    l->visited[pc>>3] |= (unsigned char)(1<<(pc&7));
+    const unsigned char *code = &vm->code[pc];
+    int next = -1;
+    switch (code[0]) {
+      case RE_JMP:
+        next = pc+regexpGetOffset(&code[1]);
+        break;
+      case RE_SPLIT: // push the lower priority branch first, so it's followed last
+        stack[sp++] = pc+regexpGetOffset(&code[3]);
+        stack[sp++] = 0;
+        next = pc+regexpGetOffset(&code[1]);
+        break;
+      case RE_SAVE:
+        stack[sp++] = -1-code[1];
+        stack[sp++] = slots[code[1]];
+        slots[code[1]] = vm->index;
+        next = pc+2;
+        break;
+      case RE_BOL:
+        if (vm->index==0) next = pc+1;
+        break;
+      case RE_EOL:
+        if (vm->atEnd) next = pc+1;
+        break;
+      case RE_WORDB:
+      case RE_NWORDB: {
+        bool boundary = (vm->index>0 && regexpIsWordChar(vm->prevChar)) !=
+                        (!vm->atEnd && regexpIsWordChar(vm->thisChar));
+        if (boundary == (code[0]==RE_WORDB)) next = pc+1;
+        break;
+      }
+      case RE_LOOK:
+      case RE_NLOOK: { // run the lookahead's code on its own, starting here
+        int lookSlots[2+2*MAX_GROUPS];
+        bool found = regexpRun(vm->prog, vm->progLen, vm->str, (size_t)vm->index, pc+3, lookSlots);
+        if (found == (code[0]==RE_LOOK)) next = pc+regexpGetOffset(&code[1]);
+        break;
+      }
+      default: // needs a character, so it's a thread
+        l->pc[l->count] = (uint16_t)pc;
+        memcpy(&l->slots[l->count*vm->slotCount], slots, sizeof(int)*(size_t)vm->slotCount);
+        l->count++;
+        break;
+    }
+    if (next>=0) {
+      stack[sp++] = next;
+      stack[sp++] = 0;
+    }
   }
-  int charLength;
-  bool charMatched = matchcharacter(regexp, txtIt, &charLength, &info);
-  if (regexp[charLength] == '*' || regexp[charLength] == '+') {
-    char op = regexp[charLength];
-    if (!charMatched && op=='+') {
-      // with '+' operator it has to match at least once
-      return nomatchfound(&regexp[charLength+1], info);
+}
+
+/// Does the instruction at pc match character ch?
+static bool regexpMatchChar(RegExpVM *vm, int pc, char ch) {
+  const unsigned char *code = &vm->code[pc];
+  switch (code[0]) {
+    case RE_ANY: return true;
+    case RE_CHAR: return (unsigned char)(vm->ignoreCase ? charToLowerCase(ch) : ch) == code[1];
+    case RE_CLASS: return (code[1+((unsigned char)ch>>3)] & (1<<(ch&7))) != 0;
+    default: return false;
+  }
+}
+
+/// Move the iterator on to the next instance of ch
+static void regexpSkipToChar(JsvStringIterator *it, char ch) {
+  while (jsvStringIteratorHasChar(it)) {
+    if (jsvIsNativeString(it->var)) { // might be in flash, so can't use memchr
+      if (jsvStringIteratorGetChar(it)==ch) return;
+      jsvStringIteratorNext(it);
+      continue;
+    }
+    char *p = memchr(&it->ptr[it->charIdx], ch, it->charsInVar - it->charIdx);
+    if (p) {
+      it->charIdx = (size_t)(p - it->ptr);
+      return;
+    }
+    it->charIdx = it->charsInVar - 1;
+    jsvStringIteratorNext(it);
+  }
+}
+
+/** Run the program on str from startIndex. Returns true and fills in matchSlots if there's a match.
+ * If startPc isn't 0 we're running a lookahead, which starts at startPc and only matches at startIndex */
+static bool regexpRun(const unsigned char *prog, size_t progLen, JsVar *str, size_t startIndex, int startPc, int *matchSlots) {
+  RegExpVM vm;
+  vm.prog = prog;
+  vm.progLen = progLen;
+  vm.str = str;
+  vm.code = &prog[REGEXP_HDR_SIZE];
+  vm.codeLen = progLen - REGEXP_HDR_SIZE;
+  vm.slotCount = 2 + 2*prog[REGEXP_HDR_GROUPS];
+  vm.ignoreCase = (prog[REGEXP_HDR_FLAGS] & REGEXP_FLAG_IGNORECASE) != 0;
+  bool anchored = (prog[REGEXP_HDR_FLAGS] & REGEXP_FLAG_ANCHORED) != 0;
+  bool hasFirstChar = !startPc && (prog[REGEXP_HDR_FLAGS] & REGEXP_FLAG_FIRSTCHAR) != 0;
+  char firstChar = (char)prog[REGEXP_HDR_FIRSTCHAR];
+  // we can never have more threads than instructions
+  int maxThreads = prog[REGEXP_HDR_INSTRUCTIONS] | (prog[REGEXP_HDR_INSTRUCTIONS+1]<<8);
+  size_t visitedLen = (vm.codeLen+7)>>3;
+  size_t slotsLen = (size_t)(maxThreads*vm.slotCount);
+  size_t stackLen = (size_t)(2*maxThreads+1)*2;
+  size_t memSize = sizeof(int)*(slotsLen*2 + (size_t)vm.slotCount + stackLen) +
+                   sizeof(uint16_t)*(size_t)maxThreads*2 + visitedLen*2;
+  /* Allocate memory for both thread lists on the stack if there's space
+   * or in a flat string */
+  JsVar *memVar = 0;
+  int *mem;
+  if (memSize + 512 < jsuGetFreeStack()) {
+    mem = (int*)alloca(memSize);
+  } else {
+    // flat string data might not be aligned, so leave space to align it ourselves
+    memVar = jsvNewFlatStringOfLength((unsigned int)(memSize+sizeof(int)));
+    if (!memVar) {
+      jsExceptionHere(JSET_ERROR, "Not enough memory to run RegEx");
+      return false;
     }
-    char *regexpAfterStar = regexp+charLength+1;
-    JsvStringIterator txtIt2;
-    // Try and match everything after right now
-    jsvStringIteratorClone(&txtIt2, txtIt);
-    JsVar *lastrmatch = matchhere(regexpAfterStar, &txtIt2, info);
-    jsvStringIteratorFree(&txtIt2);
-    // Otherwise try and match more than one
-    while (jsvStringIteratorHasChar(txtIt) && charMatched) {
-      // We had this character matched, so move on and see if we can match with the new one
-      jsvStringIteratorNext(txtIt);
-      charMatched = matchcharacter(regexp, txtIt, &charLength, &info);
-      // See if we can match after the character...
-      jsvStringIteratorClone(&txtIt2, txtIt);
-      JsVar *rmatch = matchhere(regexpAfterStar, &txtIt2, info);
-      jsvStringIteratorFree(&txtIt2);
-      // can't match with this - use the last one
-      if (rmatch) {
-        jsvUnLock(lastrmatch);
-        lastrmatch = rmatch;
+    size_t ptr = (size_t)jsvGetFlatStringPointer(memVar);
+    mem = (int*)((ptr + sizeof(int) - 1) & ~(sizeof(int)-1));
+  }
+  RegExpThreadList lists[2];
+  RegExpThreadList *clist = &lists[0], *nlist = &lists[1];
+  int *slots = mem;
+  vm.stack = &mem[vm.slotCount];
+  clist->slots = &vm.stack[stackLen];
+  nlist->slots = &clist->slots[slotsLen];
+  clist->pc = (uint16_t*)&nlist->slots[slotsLen];
+  nlist->pc = &clist->pc[maxThreads];
+  clist->visited = (unsigned char*)&nlist->pc[maxThreads];
+  nlist->visited = &clist->visited[visitedLen];
+  clist->count = 0;
+  memset(clist->visited, 0, visitedLen);
+
+  JsvStringIterator it;
+  vm.index = (int)startIndex;
+  vm.prevChar = 0;
+  if (startIndex>0) { // we need the previous character for \b
+    jsvStringIteratorNew(&it, str, startIndex-1);
+    vm.prevChar = jsvStringIteratorGetChar(&it);
+    jsvStringIteratorNext(&it);
+  } else
+    jsvStringIteratorNew(&it, str, startIndex);
+  vm.atEnd = !jsvStringIteratorHasChar(&it);
+  vm.thisChar = jsvStringIteratorGetChar(&it);
+
+  bool matched = false;
+  while (!jspIsInterrupted()) {
+    if (!matched && (!startPc || vm.index==(int)startIndex)) {
+      if (!clist->count) {
+        // nothing in progress, so skip forward to somewhere a match could start
+        if (anchored && vm.index>0) break;
+        if (hasFirstChar && vm.thisChar!=firstChar) {
+          regexpSkipToChar(&it, firstChar);
+          if (!jsvStringIteratorHasChar(&it)) break;
+          vm.index = (int)jsvStringIteratorGetIndex(&it);
+          vm.thisChar = firstChar;
+          memset(clist->visited, 0, visitedLen);
+        }
+      }
+      // Start a new match here - at lower priority than any match that started earlier
+      for (int i=0; i<vm.slotCount; i++) slots[i] = -1;
+      slots[0] = vm.index;
+      regexpAddThread(&vm, clist, startPc, slots);
+    } else if (!clist->count)
+      break;
+    // Move on to the next character
+    int index = vm.index;
+    bool atEnd = vm.atEnd;
+    char ch = vm.thisChar;
+    if (!atEnd) {
+      jsvStringIteratorNext(&it);
+      vm.index++;
+      vm.prevChar = ch;
+      vm.atEnd = !jsvStringIteratorHasChar(&it);
+      vm.thisChar = jsvStringIteratorGetChar(&it);
+    }
+    // Step every thread (in priority order) on past this character
+    nlist->count = 0;
+    memset(nlist->visited, 0, visitedLen);
+    for (int t=0; t<clist->count; t++) {
+      int pc = clist->pc[t];
+      int *threadSlots = &clist->slots[t*vm.slotCount];
+      if (vm.code[pc]==RE_MATCH) {
+        // Any threads after this are lower priority, so we can stop
+        memcpy(matchSlots, threadSlots, sizeof(int)*(size_t)vm.slotCount);
+        matchSlots[1] = index;
+        matched = true;
+        break;
       }
+      if (!atEnd && regexpMatchChar(&vm, pc, ch))
+        regexpAddThread(&vm, nlist, pc+(int)regexpOpSize(vm.code[pc]), threadSlots);
     }
-    return lastrmatch;
+    RegExpThreadList *t = clist;
+    clist = nlist;
+    nlist = t;
+    if (atEnd) break;
   }
+  jsvStringIteratorFree(&it);
+  jsvUnLock(memVar);
+  return matched;
+}
 
-  // This character is matched
-  if (jsvStringIteratorHasChar(txtIt) && charMatched) {
-    jsvStringIteratorNext(txtIt);
-    if (!jspCheckStackPosition()) return 0;
-    return matchhere(regexp+charLength, txtIt, info);
+/// Create the result array for a match
+static JsVar *regexpMatchResult(JsVar *str, int *slots, int groups) {
+  JsVar *rmatch = jsvNewEmptyArray();
+  if (!rmatch) return 0;
+  for (int i=0;i<=groups;i++) {
+    int start = slots[i*2], end = slots[i*2+1];
+    JsVar *matchStr = 0;
+    if (start>=0 && end>=start) // unmatched groups are undefined
+      matchStr = jsvNewFromStringVar(str, (size_t)start, (size_t)(end-start));
+    jsvSetArrayItem(rmatch, i, matchStr);
+    jsvUnLock(matchStr);
   }
-  // No match
-  return nomatchfound(&regexp[charLength], info);
+  jsvObjectSetChildAndUnLock(rmatch, "index", jsvNewFromInteger(slots[0]));
+  jsvObjectSetChild(rmatch, "input", str);
+  return rmatch;
 }
 
 /*JSON{
@@ -277,9 +664,14 @@ The built-in class for handling Regular Expressions
 **Note:** Espruino's regular expression parser does not contain all the features
 present in a full ES6 JS engine. however some parts of the spec are not implemented:
 
-* [Assertions](https://developer.mozilla.org/en-US/docs/Web/JavaScript/Guide/Regular_Expressions/Assertions) other than `^` and `$`
+* Lookbehind assertions (`(?<=x)` and `(?<!x)`), and capture groups inside
+  lookahead (`(?=(x))`), which are always `undefined`
+* Backreferences
 * [Numeric quantifiers](https://developer.mozilla.org/en-US/docs/Web/JavaScript/Guide/Regular_Expressions/Quantifiers) (eg `x{3}`)
 
+RegExps are compiled the first time they are used, and matching takes time
+proportional to the length of the string (there is no backtracking).
+
 There's a GitHub issue [concerning RegExp features here](https://github.com/espruino/Espruino/issues/1257)
 
 */
@@ -359,21 +751,17 @@ Or with groups `/W(o)rld/.exec("Hello World")` returns:
 JsVar *jswrap_regexp_exec(JsVar *parent, JsVar *arg) {
   JsVar *str = jsvAsString(arg);
   JsVarInt lastIndex = jsvObjectGetIntegerChild(parent, "lastIndex");
-  JsVar *regex = jsvObjectGetChildIfExists(parent, "source");
-  if (!jsvIsString(regex) || lastIndex>(JsVarInt)jsvGetStringLength(str)) {
-    jsvUnLock2(str,regex);
-    return 0;
-  }
-  size_t regexLen = jsvGetStringLength(regex);
-  char *regexPtr = (char *)alloca(regexLen+1);
-  if (!regexPtr) {
-    jsvUnLock2(str,regex);
+  JsVar *prog = regexpGetProgram(parent);
+  if (!prog || lastIndex>(JsVarInt)jsvGetStringLength(str)) {
+    jsvUnLock2(str,prog);
     return 0;
   }
-  jsvGetString(regex, regexPtr, regexLen+1);
-  jsvUnLock(regex);
-  JsVar *rmatch = match(regexPtr, str, (size_t)lastIndex, jswrap_regexp_hasFlag(parent,'i'));
-  jsvUnLock(str);
+  const unsigned char *progPtr = (const unsigned char*)jsvGetFlatStringPointer(prog);
+  int slots[2+2*MAX_GROUPS];
+  JsVar *rmatch = 0;
+  if (regexpRun(progPtr, jsvGetStringLength(prog), str, (size_t)lastIndex, 0, slots))
+    rmatch = regexpMatchResult(str, slots, progPtr[REGEXP_HDR_GROUPS]);
+  jsvUnLock2(str, prog);
   if (!rmatch) {
     rmatch = jsvNewWithFlags(JSV_NULL);
     lastIndex = 0;
@@ -344,9 +344,11 @@ static JsVar *_jswrap_string_replace(JsVar *parent, JsVar *subStr, JsVar *newSub
         unsigned int argCount = 0;
         JsVar *args[13];
         args[argCount++] = jsvLockAgain(matchStr);
-        JsVar *v;
-        while ((v = jsvGetArrayItem(match, (JsVarInt)argCount)) && argCount<11)
-          args[argCount++] = v;
+        unsigned int groups = (unsigned int)jsvGetArrayLength(match);
+        while (argCount<groups && argCount<11) { // groups that didn't match are undefined
+          args[argCount] = jsvGetArrayItem(match, (JsVarInt)argCount);
+          argCount++;
+        }
         args[argCount++] = jsvObjectGetChildIfExists(match,"index");
         args[argCount++] = jsvObjectGetChildIfExists(match,"input");
         JsVar *result = jsvAsStringAndUnLock(jspeFunctionCall(replace, 0, 0, false, (JsVarInt)argCount, args));
@@ -360,11 +362,9 @@ static JsVar *_jswrap_string_replace(JsVar *parent, JsVar *subStr, JsVar *newSub
           char ch = jsvStringIteratorGetCharAndNext(&src);
           if (ch=='$') {
             ch = jsvStringIteratorGetCharAndNext(&src);
-            JsVar *group = 0;
-            if (ch>'0' && ch<='9')
-              group = jsvGetArrayItem(match, ch-'0');
-            if (group) {
-              jsvStringIteratorAppendString(&dst, group, 0, JSVAPPENDSTRINGVAR_MAXLENGTH);
+            if (ch>'0' && ch<='9' && ch-'0'<jsvGetArrayLength(match)) {
+              JsVar *group = jsvGetArrayItem(match, ch-'0'); // undefined if the group didn't match
+              if (group) jsvStringIteratorAppendString(&dst, group, 0, JSVAPPENDSTRINGVAR_MAXLENGTH);
               jsvUnLock(group);
             } else {
               jsvStringIteratorAppend(&dst, '$');
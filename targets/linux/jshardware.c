@@ -20,6 +20,7 @@
  #include <conio.h>
 #else//!__MINGW32__
  #include <sys/select.h>
+ #include <sys/mman.h>
  #include <termios.h>
  #include <fcntl.h>
 #endif//__MINGW32__
@@ -33,11 +34,22 @@
 #include "jsinteractive.h"
 
 #include <pthread.h>
+#ifdef LINUX_USE_EPOLL
+#include <errno.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#endif
 
 #define FAKE_FLASH_FILENAME  "espruino.flash"
 #define FAKE_FLASH_BLOCKSIZE FLASH_PAGE_SIZE
 #define FAKE_FLASH_BLOCKS    (FLASH_TOTAL/FLASH_PAGE_SIZE)
 
+#ifndef __MINGW32__
+static void jshFlashUnmap();
+#endif
+
 #ifndef FLASH_64BITS_ALIGNMENT
 #define FLASH_UNITARY_WRITE_SIZE 4
 #else
@@ -68,6 +80,9 @@ JshPinState gpioState[JSH_PIN_COUNT]; // will be set to UNDEFINED if it isn't ex
 
 bool gpioShouldWatch[JSH_PIN_COUNT]; // whether we should watch this pin for changes
 bool gpioLastState[JSH_PIN_COUNT]; // the last state of this pin
+#ifdef LINUX_USE_EPOLL
+int gpioWatchFd[JSH_PIN_COUNT]; // if >=0, the pin's 'value' file, which we can poll() for changes
+#endif
 
 
 // functions for accessing the sysfs GPIO
@@ -105,6 +120,30 @@ JsVarInt sysfs_read_int(const char *path) {
   sysfs_read(path, buf, sizeof(buf));
   return stringToIntWithRadix(buf, 10, NULL, NULL);
 }
+
+#ifdef LINUX_USE_EPOLL
+/// Set a pin up to interrupt on both edges and return its 'value' file so we can poll() it, or -1 if we can't
+static int sysfs_open_watch(Pin pin) {
+  char path[64] = SYSFS_GPIO_DIR"/gpio";
+  itostr(pin, &path[strlen(path)], 10);
+  size_t l = strlen(path);
+  strcpy(&path[l], "/edge");
+  sysfs_write(path, "both");
+  char edge[8];
+  sysfs_read(path, edge, sizeof(edge));
+  if (strncmp(edge, "both", 4)) return -1; // not supported - we'll have to keep polling
+  strcpy(&path[l], "/value");
+  return open(path, O_RDONLY | O_NONBLOCK);
+}
+
+/// Read the value of a pin opened with sysfs_open_watch (this also clears the poll() state)
+static bool sysfs_read_watch(int fd) {
+  char ch = '0';
+  lseek(fd, 0, SEEK_SET);
+  read(fd, &ch, 1);
+  return ch=='1';
+}
+#endif
 #endif
 
 // ----------------------------------------------------------------------------
@@ -237,12 +276,15 @@ int kbhit()
     return select(STDIN_FILENO+1, &fds, NULL, NULL, &tv);
 }
 
+#define GETCH_EOF (-2)
 int getch()
 {
     int r;
     unsigned char c;
     if ((r = (int)read(STDIN_FILENO, &c, sizeof(c))) < 0) {
         return r;
+    } else if (r == 0) {
+        return GETCH_EOF;
     } else {
         return c;
     }
@@ -252,9 +294,89 @@ int getch()
 pthread_t inputThread;
 bool isInitialised;
 
+#ifdef LINUX_USE_EPOLL
+/* Rather than waking up every 50ms to see if anything has happened, jshSleep blocks
+in epoll_wait until the input thread has pushed an event (it calls jshHadEvent, which
+writes to eventFd), a socket has data (see jshLinuxWatchFd), or timerFd says the next
+timer is due. The input thread itself blocks in poll() on stdin, serial devices,
+watched GPIO pins and inputWakeFd (which we write to when it has data to send or
+needs to exit). */
+static int epollFd = -1;
+static int eventFd = -1;
+static int timerFd = -1;
+static int inputWakeFd = -1;
+static int watchedFdCount = 0;
+static bool stdinClosed = false;
+bool jshLinuxSleepUntilInput = false;
+
+static void jshWakeFd(int fd) {
+  uint64_t v = 1;
+  if (fd>=0) write(fd, &v, sizeof(v));
+}
+
+static void jshClearFd(int fd) {
+  uint64_t v;
+  read(fd, &v, sizeof(v)); // eventfd/timerfd are non-blocking, so this is fine even if nothing happened
+}
+
+void jshHadEvent() {
+  jshWakeFd(eventFd);
+}
+
+void jshLinuxWatchFd(int fd, bool watch) {
+  if (epollFd<0 || fd<0) return;
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+  if (epoll_ctl(epollFd, watch ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, fd, &ev)==0)
+    watchedFdCount += watch ? 1 : -1;
+}
+
+bool jshLinuxHasWatchedFds() {
+  return watchedFdCount>0;
+}
+
+/// Wait in the input thread until there's something to read, or the timeout (in ms, -1 = forever) expires
+static void jshInputThreadWait(int timeout) {
+  struct pollfd fds[2+EV_DEVICE_MAX+1+JSH_PIN_COUNT];
+  int n = 0;
+  fds[n].fd = inputWakeFd;
+  fds[n++].events = POLLIN;
+  // don't wait for input if we have nowhere to put it
+  if (jshGetEventsUsed() < IOBUFFERMASK/2) {
+    if (!stdinClosed) {
+      fds[n].fd = STDIN_FILENO;
+      fds[n++].events = POLLIN;
+    }
+    int i;
+    for (i=0;i<=EV_DEVICE_MAX;i++)
+      if (ioDevices[i]) {
+        fds[n].fd = ioDevices[i];
+        fds[n++].events = POLLIN;
+      }
+  } else if (timeout<0 || timeout>1)
+    timeout = 1; // check again soon, in case space has been freed up
+#ifdef SYSFS_GPIO_DIR
+  Pin pin;
+  for (pin=0;pin<JSH_PIN_COUNT;pin++)
+    if (gpioShouldWatch[pin] && gpioWatchFd[pin]>=0) {
+      fds[n].fd = gpioWatchFd[pin];
+      fds[n++].events = POLLPRI | POLLERR;
+    }
+#endif
+  poll(fds, (nfds_t)n, timeout);
+  if (fds[0].revents & POLLIN)
+    jshClearFd(inputWakeFd);
+}
+#endif
+
 void jshInputThread() {
   while (isInitialised) {
     bool shortSleep = false;
+#ifdef LINUX_USE_EPOLL
+    bool hadEvent = false;
+#endif
     /* Handle the delayed Ctrl-C -> interrupt behaviour (see description by EXEC_CTRL_C's definition)  */
     if (execInfo.execute & EXEC_CTRL_C_WAIT)
       execInfo.execute = (execInfo.execute & ~EXEC_CTRL_C_WAIT) | EXEC_INTERRUPTED;
@@ -263,9 +385,17 @@ void jshInputThread() {
     // Read from the console if we have space
     while (kbhit() && (jshGetEventsUsed()<IOBUFFERMASK/2)) {
       int ch = getch();
-      if (ch<0) break;
+      if (ch<0) {
+#ifdef LINUX_USE_EPOLL
+        if (ch==GETCH_EOF) stdinClosed = true; // don't keep waking up for a closed stdin
+#endif
+        break;
+      }
       if (ch==4) exit(0); // exit on Ctrl-D
       jshPushIOCharEvent(EV_USBSERIAL, (char)ch);
+#ifdef LINUX_USE_EPOLL
+      hadEvent = true;
+#endif
     }
     // Read from any open devices - if we have space
     if (jshGetEventsUsed() < IOBUFFERMASK/2) {
@@ -279,6 +409,9 @@ void jshInputThread() {
             //int j; for (j=0;j<bytes;j++) printf("]] '%c'\r\n", buf[j]);
             jshPushIOCharEvents(i, buf, (unsigned int)bytes);
             shortSleep = true;
+#ifdef LINUX_USE_EPOLL
+            hadEvent = true;
+#endif
           }
         }
       }
@@ -286,10 +419,10 @@ void jshInputThread() {
     // Write any data we have
     IOEventFlags device = jshGetDeviceToTransmit();
     while (device != EV_NONE) {
-      char ch = (char)jshGetCharToTransmit(device);
-      //printf("[[ '%c'\r\n", ch);
+      unsigned char buf[64];
+      unsigned int bytes = jshGetTransmitBlock(device, buf, sizeof(buf));
       if (ioDevices[device]) {
-        write(ioDevices[device], &ch, 1);
+        write(ioDevices[device], buf, bytes);
         shortSleep = true;
       }
       device = jshGetDeviceToTransmit();
@@ -300,16 +433,34 @@ void jshInputThread() {
     Pin pin;
     for (pin=0;pin<JSH_PIN_COUNT;pin++)
       if (gpioShouldWatch[pin]) {
+#ifdef LINUX_USE_EPOLL
+        int fd = gpioWatchFd[pin];
+        if (fd<0) shortSleep = true; // can't wait for changes, so have to keep polling
+        bool state = (fd>=0) ? sysfs_read_watch(fd) : jshPinGetValue(pin);
+#else
         shortSleep = true;
         bool state = jshPinGetValue(pin);
+#endif
         if (state != gpioLastState[pin]) {
           jshPushIOEvent(pinToEVEXTI(pin) | (state?EV_EXTI_IS_HIGH:0), jshGetSystemTime());
           gpioLastState[pin] = state;
+#ifdef LINUX_USE_EPOLL
+          hadEvent = true;
+#endif
         }
       }
 #endif
 
+#ifdef LINUX_USE_EPOLL
+    if (hadEvent) jshHadEvent(); // wake up jshSleep
+    int timeout = shortSleep ? 1 : -1;
+    // if Ctrl-C was pressed we need to come back to turn it into an interrupt if JS doesn't stop
+    if (timeout<0 && (execInfo.execute & EXEC_CTRL_C_MASK))
+      timeout = 50;
+    jshInputThreadWait(timeout);
+#else
     jshDelayMicroseconds(shortSleep ? 1000 : 50000);
+#endif
   }
 }
 
@@ -354,6 +505,30 @@ void jshInit() {
 #ifdef SYSFS_GPIO_DIR
   for (i=0;i<JSH_PIN_COUNT;i++) {
     gpioShouldWatch[i] = false;
+#ifdef LINUX_USE_EPOLL
+    gpioWatchFd[i] = -1;
+#endif
+  }
+#endif
+#ifdef LINUX_USE_EPOLL
+  stdinClosed = false;
+  watchedFdCount = 0;
+  epollFd = epoll_create1(EPOLL_CLOEXEC);
+  eventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  inputWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (epollFd>=0 && eventFd>=0 && timerFd>=0) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = eventFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, eventFd, &ev);
+    ev.data.fd = timerFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, timerFd, &ev);
+  } else {
+    printf("Unable to create epoll/eventfd/timerfd, %s\n", strerror(errno));
+    if (epollFd>=0) close(epollFd);
+    epollFd = -1; // jshSleep falls back to just sleeping
   }
 #endif
 
@@ -372,8 +547,20 @@ void jshKill() {
 
   // Request that the input thread finishes
   isInitialised = false;
+#ifdef LINUX_USE_EPOLL
+  jshWakeFd(inputWakeFd);
+#endif
   // wait for thread to finish
   pthread_join(inputThread, NULL);
+#ifdef LINUX_USE_EPOLL
+  int *fds[] = { &epollFd, &eventFd, &timerFd, &inputWakeFd };
+  for (i=0;i<(int)(sizeof(fds)/sizeof(int*));i++)
+    if (*fds[i]>=0) {
+      close(*fds[i]);
+      *fds[i] = -1;
+    }
+  watchedFdCount = 0;
+#endif
 
   for (i=0;i<=EV_DEVICE_MAX;i++)
     if (ioDevices[i]) {
@@ -382,12 +569,22 @@ void jshKill() {
     }
 
 #ifdef SYSFS_GPIO_DIR
+#ifdef LINUX_USE_EPOLL
+  for (i=0;i<JSH_PIN_COUNT;i++)
+    if (gpioWatchFd[i]>=0) {
+      close(gpioWatchFd[i]);
+      gpioWatchFd[i] = -1;
+    }
+#endif
 
   // unexport any GPIO that we exported
   for (i=0;i<JSH_PIN_COUNT;i++)
     if (gpioState[i] != JSHPINSTATE_UNDEFINED)
       sysfs_write_int(SYSFS_GPIO_DIR"/unexport", i);
 #endif
+#ifndef __MINGW32__
+  jshFlashUnmap();
+#endif
 }
 
 void jshIdle() {
@@ -596,6 +793,10 @@ IOEventFlags jshPinWatch(Pin pin, bool shouldWatch, JshPinWatchFlags flags) {
         gpioEventFlags[pin] = exti;
         jshPinSetState(pin, JSHPINSTATE_GPIO_IN);
 #ifdef SYSFS_GPIO_DIR
+#ifdef LINUX_USE_EPOLL
+        if (gpioWatchFd[pin]<0)
+          gpioWatchFd[pin] = sysfs_open_watch(pin);
+#endif
         gpioShouldWatch[pin] = true;
         gpioLastState[pin] = jshPinGetValue(pin);
 #endif
@@ -609,12 +810,21 @@ IOEventFlags jshPinWatch(Pin pin, bool shouldWatch, JshPinWatchFlags flags) {
       gpioEventFlags[pin] = 0;
 #ifdef SYSFS_GPIO_DIR
       gpioShouldWatch[pin] = false;
+#ifdef LINUX_USE_EPOLL
+      if (gpioWatchFd[pin]>=0) {
+        close(gpioWatchFd[pin]);
+        gpioWatchFd[pin] = -1;
+      }
+#endif
 #endif
 #ifdef USE_WIRINGPI
       wiringPiISR(pin, INT_EDGE_BOTH, irqEXTIDoNothing);
 #endif
 
     }
+#ifdef LINUX_USE_EPOLL
+    jshWakeFd(inputWakeFd); // so the input thread starts/stops waiting on this pin
+#endif
     return shouldWatch ? exti : EV_NONE;
   } else jsError("Invalid pin");
   return EV_NONE;
@@ -726,7 +936,10 @@ void jshUSARTSetup(IOEventFlags device, JshUSARTInfo *inf) {
  * to set up interrupts */
 void jshUSARTKick(IOEventFlags device) {
   assert(DEVICE_IS_USART(device) || DEVICE_IS_SPI(device));
-  // all done by the idle loop
+  // all done by the input thread
+#ifdef LINUX_USE_EPOLL
+  jshWakeFd(inputWakeFd); // wake it up so it sends the data
+#endif
 }
 
 void jshSPISetup(IOEventFlags device, JshSPIInfo *inf) {
@@ -784,6 +997,29 @@ void jshI2CRead(IOEventFlags device, unsigned char address, int nBytes, unsigned
 
 /// Enter simple sleep mode (can be woken up by interrupts). Returns true on success
 bool jshSleep(JsSysTime timeUntilWake) {
+#ifdef LINUX_USE_EPOLL
+  if (epollFd>=0) {
+    if (timeUntilWake<=0) return true;
+    if (!jshLinuxSleepUntilInput && !watchedFdCount && timeUntilWake>50000)
+      timeUntilWake = 50000; // nothing but a timer can wake us, and we may be about to exit
+    // Set timerFd to fire when the next timer is due (all zeros disarms it)
+    struct itimerspec timer;
+    memset(&timer, 0, sizeof(timer));
+    if (timeUntilWake < JSSYSTIME_MAX) {
+      timer.it_value.tv_sec = (time_t)(timeUntilWake / 1000000);
+      timer.it_value.tv_nsec = (long)(timeUntilWake % 1000000) * 1000;
+    }
+    timerfd_settime(timerFd, 0, &timer, NULL);
+    // Now wait for the timer, an event from the input thread, or socket activity
+    struct epoll_event events[8];
+    int n = epoll_wait(epollFd, events, sizeof(events)/sizeof(events[0]), -1);
+    int i;
+    for (i=0;i<n;i++)
+      if (events[i].data.fd==eventFd || events[i].data.fd==timerFd)
+        jshClearFd(events[i].data.fd);
+    return true;
+  }
+#endif
   bool hasWatches = false;
 #ifdef SYSFS_GPIO_DIR
   Pin pin;
@@ -849,6 +1085,7 @@ JsVar *jshFlashGetFree() {
   return jsFreeFlash;
 }
 
+#ifdef __MINGW32__
 static FILE *jshFlashOpenFile(bool dontCreate) {
   FILE *f = fopen(FAKE_FLASH_FILENAME, "r+b");
   if (!f && dontCreate) return 0;
@@ -942,10 +1179,103 @@ void jshFlashWrite(void *buf, uint32_t addr, uint32_t len) {
   fclose(f);
 }
 
-// No - we can't memory-map the flash memory under Linux (well, we could but for testing it's handy not to)
+// No - we can't memory-map the flash memory under Windows
+size_t jshFlashGetMemMapAddress(size_t ptr) {
+  return 0;
+}
+#else // !__MINGW32__
+/* The flash file is memory-mapped the first time it's needed, and stays mapped
+(at the same address) until jshKill, so we can hand out pointers into it
+like we would on a real device. */
+static char *flashMemory = 0;
+#ifdef LINUX_FLASH_NO_MEMMAP
+bool jshLinuxFlashNoMemMap = true;
+#else
+bool jshLinuxFlashNoMemMap = false;
+#endif
+
+/// Map the flash file into memory, and return a pointer to FLASH_START (or 0 if no file and !create)
+static char *jshFlashMap(bool create) {
+  if (flashMemory) return flashMemory;
+  int fd = open(FAKE_FLASH_FILENAME, O_RDWR | (create ? O_CREAT : 0), 0666);
+  if (fd<0) return 0;
+  size_t len = FAKE_FLASH_BLOCKSIZE*FAKE_FLASH_BLOCKS;
+  off_t fileLen = lseek(fd, 0, SEEK_END);
+  if (fileLen>=0 && (size_t)fileLen<len) { // pad the file out with 'erased' flash
+    size_t pad = len-(size_t)fileLen;
+    char *buf = malloc(pad);
+    memset(buf, 0xFF, pad);
+    if (write(fd, buf, pad)!=(ssize_t)pad) fileLen = -1;
+    free(buf);
+  }
+  void *mem = (fileLen>=0) ? mmap(0, len, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+  close(fd); // the mapping keeps the file open
+  if (mem==MAP_FAILED) return 0;
+  flashMemory = (char*)mem;
+  return flashMemory;
+}
+
+/// Unmap the flash file (on exit)
+static void jshFlashUnmap() {
+  if (!flashMemory) return;
+  munmap(flashMemory, FAKE_FLASH_BLOCKSIZE*FAKE_FLASH_BLOCKS);
+  flashMemory = 0;
+}
+
+void jshFlashErasePage(uint32_t addr) {
+  //jsDebug(DBG_VERBOSE,"FlashErasePage 0x%08x\n", addr);
+  char *mem = jshFlashMap(false);
+  if (!mem) return; // if no file and we're erasing, we don't have to do anything
+  uint32_t startAddr, pageSize;
+  if (jshFlashGetPage(addr, &startAddr, &pageSize))
+    memset(&mem[startAddr - FLASH_START], 0xFF, pageSize);
+}
+void jshFlashRead(void *buf, uint32_t addr, uint32_t len) {
+  //jsDebug(DBG_VERBOSE,"FlashRead 0x%08x %d\n", addr,len);
+  //assert(!(addr&(FLASH_UNITARY_WRITE_SIZE-1))); // sanity checks here to mirror real hardware
+  //assert(!(len&(FLASH_UNITARY_WRITE_SIZE-1))); // sanity checks here to mirror real hardware
+  if (addr<FLASH_START || addr>=FLASH_START+FLASH_TOTAL) {
+    assert(0); // out of range
+    return;
+  }
+  addr -= FLASH_START;
+  assert(addr+len <= FLASH_TOTAL);
+  char *mem = jshFlashMap(false);
+  if (!mem) { // no file, so it's all 0xFF
+    memset(buf, 0xFF, len);
+    return;
+  }
+  memcpy(buf, &mem[addr], len);
+}
+void jshFlashWrite(void *buf, uint32_t addr, uint32_t len) {
+  //jsDebug(DBG_VERBOSE,"FlashWrite 0x%08x %d\n", addr,len);
+  uint32_t i;
+#ifndef SPIFLASH_BASE // for debug
+  assert(!(addr&(FLASH_UNITARY_WRITE_SIZE-1))); // sanity checks here to mirror real hardware
+  assert(!(len&(FLASH_UNITARY_WRITE_SIZE-1))); // sanity checks here to mirror real hardware
+#endif
+  if (addr<FLASH_START || addr>=FLASH_START+FLASH_TOTAL) {
+    assert(0); // out of range
+    return;
+  }
+  addr -= FLASH_START;
+  assert(addr+len <= FLASH_TOTAL);
+  char *mem = jshFlashMap(true);
+  if (!mem) return;
+  for (i=0;i<len;i++) // like real flash, we can only clear bits
+    mem[addr+i] &= ((char*)buf)[i];
+}
+
+/* Flash is memory-mapped, so we can return native strings that point right at it
+(unless jshLinuxFlashNoMemMap, which forces everything through jshFlashRead for testing) */
 size_t jshFlashGetMemMapAddress(size_t ptr) {
+  if (!jshLinuxFlashNoMemMap && ptr>=FLASH_START && ptr<FLASH_START+FLASH_TOTAL) {
+    char *mem = jshFlashMap(false);
+    if (mem) return (size_t)&mem[ptr - FLASH_START];
+  }
   return 0;
 }
+#endif // __MINGW32__
 
 unsigned int jshSetSystemClock(JsVar *options) {
   return 0;
@@ -30,6 +30,16 @@
 bool isRunning = true;
 struct filelist test_files;
 
+/* When running a script, should we keep going even if we're not busy? With epoll,
+ * open sockets no longer keep the idle loop busy, as we sleep until they have data */
+static bool hasOpenSockets() {
+#ifdef LINUX_USE_EPOLL
+  return jshLinuxHasWatchedFds();
+#else
+  return false;
+#endif
+}
+
 void warning(const char *, ...) __attribute__((__format__(__warning__, 1, 2)));
 void fatal(int, const char *, ...)
     __attribute__((__format__(__warning__, 2, 3)));
@@ -134,6 +144,15 @@ void nativeQuit() { isRunning = false; }
 
 void nativeInterrupt() { jspSetInterrupted(true); }
 
+#ifndef ESPR_NO_INLINE_CACHE
+int nativeMemberCacheHits() { return (int)jspMemberCacheHits; }
+#endif
+
+#ifdef LINUX_USE_EPOLL
+/// Sleep like the interactive console does - the test must call quit() when it's done
+void nativeSleepUntilInput() { jshLinuxSleepUntilInput = true; }
+#endif
+
 static char *read_file(const char *filename) {
   FILE *f;
   char *buf;
@@ -187,6 +206,13 @@ bool run_test(const char *filename) {
 
   addNativeFunction("quit", nativeQuit);
   addNativeFunction("interrupt", nativeInterrupt);
+#ifdef LINUX_USE_EPOLL
+  addNativeFunction("sleepUntilInput", nativeSleepUntilInput);
+#endif
+#ifndef ESPR_NO_INLINE_CACHE
+  jsvObjectSetChildAndUnLock(execInfo.root, "memberCacheHits",
+                             jsvNewNativeFunction((void (*)(void))nativeMemberCacheHits, JSWAT_INT32));
+#endif
   // reset flags
   jsfSetFlag(JSF_PRETOKENISE, 0);
 
@@ -194,8 +220,11 @@ bool run_test(const char *filename) {
 
   isRunning = true;
   bool isBusy = true;
-  while (isRunning && (jsiHasTimers() || isBusy))
+  while (isRunning && (jsiHasTimers() || isBusy || hasOpenSockets()))
     isBusy = jsiLoop();
+#ifdef LINUX_USE_EPOLL
+  jshLinuxSleepUntilInput = false;
+#endif
 
   JsVar *result = jsvObjectGetChildIfExists(execInfo.root, "result");
   bool pass = jsvGetBool(result);
@@ -284,6 +313,24 @@ bool run_all_tests() {
   bool rc;
   enumerate_tests(TEST_DIR);
   rc = run_test_list(&test_files);
+#ifndef __MINGW32__
+  /* Flash is memory-mapped on Linux, but it isn't on many boards - so run the
+   * Storage tests again with that turned off to test the path they use too */
+  if (!jshLinuxFlashNoMemMap) {
+    struct filelist storageTests;
+    memset(&storageTests, 0, sizeof(storageTests));
+    struct filelist *fl = &test_files;
+    filelist_foreach(fl, fn) {
+      if (strstr(fn, "/test_storage"))
+        filelist_add(&storageTests, fn);
+    }
+    warning("Running Storage tests again without memory-mapped flash");
+    jshLinuxFlashNoMemMap = true;
+    if (!run_test_list(&storageTests)) rc = false;
+    jshLinuxFlashNoMemMap = false;
+    filelist_free(&storageTests);
+  }
+#endif
   filelist_free(&test_files);
   return rc;
 }
@@ -298,10 +345,78 @@ bool run_jit_tests() {
   addNativeFunction("quit", nativeQuit);
   addNativeFunction("interrupt", nativeInterrupt);
 
-  JsVar *v = jsjEvaluate("1+2");
-  jsiConsolePrintf("RESULT : %j\n", v);
-  jsvUnLock(v);
+  /* Each test defines a function called 'jit' that should be compiled
+   * and then returns true if it worked. Most are from README_JIT.md */
+  const char *tests[] = {
+    "function jit() {'jit';return 1;};jit()==1",
+    "function jit() {'jit';return 1+2+3+4+5;};jit()==15",
+    "function jit() {'jit';return 'Hello';};jit()==\"Hello\"",
+    "function jit() {'jit';return true;};jit()==true",
+    "var test = \"Hello world\";function jit() {'jit';return test;};jit()==\"Hello world\"",
+    "function jit() {'jit';return 10000000000;};jit()==10000000000",
+    "function jit(a) {'jit';return a?5:10;};jit(1)==5 && jit(0)==10",
+    "function jit() {'jit';return !123;};jit()==false",
+    "function jit() {'jit';return !0;};jit()==true",
+    "function jit() {'jit';return ~0;};jit()==-1",
+    "function jit() {'jit';return -(1);};jit()==-1",
+    "function jit() {'jit';return +\"0123\";};jit()==83",
+    "function t() { return \"Hello\"; };function jit() {'jit'; return t()+\" world\";};jit()==\"Hello world\"",
+    "function jit() {'jit';return i++;};i=0;jit()==0 && i==1",
+    "function jit() {'jit';return ++i;};i=0;jit()==1 && i==1",
+    "function jit() {'jit';return i+=\" world\";};i=\"hello\";jit()==\"hello world\" && i==\"hello world\"",
+    "function jit() {'jit';return i-=2;};i=3;jit()==1 && i==1",
+    "function jit() {'jit';i=42;};jit();i==42",
+    "function jit() {'jit';return 1<2;};jit()==true",
+    "function jit() {\"jit\";if (i<3) r=\"T\"; else r=\"X\";};i=2;jit();var a=r;i=5;jit();a+r==\"TX\"",
+    "function jit() {\"jit\";for (i=0;i<5;i=i+1) r+=i;};r=\"\";jit();r==\"01234\"",
+    "function jit() {\"jit\";for (var i=0;i<5;++i) r+=i;};r=\"\";jit();r==\"01234\"",
+    "function jit() {\"jit\";while (0) {}};jit()===undefined",
+    "function jit() {\"jit\";while (1) return 42;};jit()==42",
+    "function jit() {\"jit\";while (0) return 0;return 42;};jit()==42",
+    "function jit(i) {\"jit\";while (i--) r+=i;};r=\"\";jit(5);r==\"43210\"",
+    "function jit() {\"jit\";do { r+=i; } while (i--);};r=\"\";i=5;jit();r==\"543210\"",
+    "a = {b:42,c:function(){return this.b+1;}};function jit() {\"jit\";return a.b;};jit()==42",
+    "a = {b:42};function jit() {\"jit\";return a[\"b\"];};jit()==42",
+    "a = {b:42,c:function(){return this.b+1;}};function jit() {\"jit\";return a.c();};jit()==43",
+    "a=new Uint8Array([42]);function jit(){\"jit\";var i=0;return a[i];};jit()==42",
+    "function jit(a,b) {'jit';return a+\"Hello world\"+b;};jit(1,2)==\"1Hello world2\"",
+    "function jit() {'jit';return [1,2,1+2,\"Hello\",\"World\"];};jit()==\"1,2,3,Hello,World\"",
+    "function jit() {'jit';return {a:42,b:10,12:5};};JSON.stringify(jit()) == '{\"a\":42,\"b\":10,\"12\":5}'",
+    "function jit() {'jit';return 0&&2;};jit()==0",
+    "function jit() {'jit';return 3&&2;};jit()==2",
+    "function jit() {'jit';return 0||2;};jit()==2",
+    "function jit() {'jit';return 3||2;};jit()==3",
+    "function jit(){'jit';return this.a;};var o={a:42,f:jit};o.f()==42",
+    "function jit() {'jit';return Math.max(1,5,3,2);};jit()==5",
+    "function jit() {'jit';return 1.5*2;};jit()==3",
+    // int variables
+    "function jit() {'jit';var s=0;for (var i=0;i<10;i++) s+=i;return s;};jit()==45",
+    "function jit() {'jit';var c=0,i=0;while (i<100) { i+=3; c++; } return c*1000+i;};jit()==34102",
+    "function jit() {'jit';var n=0;for (var i=0;i<5;i++) { if (i&1) n++; } return n;};jit()==2",
+    "function jit() {'jit';var i=0;do { i++; } while (i!=7);return i;};jit()==7",
+    "function jit() {'jit';var i=3;return i>2 ? 'y' : 'n';};jit()=='y'",
+    "function jit() {'jit';var a=[5,6,7],r='';for (var i=0;i<a.length;i++) r+=a[i];return r;};jit()=='567'",
+    "function jit() {'jit';var i=2147483646;i++;i++;return i;};jit()==2147483648", // overflow, so box all ints
+    "function jit() {'jit';var j=5,i=-2147483647;i-=5;j++;return [i,j];};jit()=='-2147483652,6'",
+  };
   bool pass = true;
+  for (unsigned int i=0;i<sizeof(tests)/sizeof(tests[0]);i++) {
+    JsVar *v = jspEvaluate(tests[i], true);
+    bool ok = jsvIsBoolean(v) && jsvGetBool(v);
+    jsvUnLock(v);
+    // check we really did compile it, rather than falling back to the interpreter
+    JsVar *fn = jsvObjectGetChildIfExists(execInfo.root, "jit");
+    JsVar *code = jsvIsFunction(fn) ? jsvFindChildFromString(fn, JSPARSE_FUNCTION_JIT_CODE_NAME) : 0;
+    if (!code) ok = false;
+    jsvUnLock2(code, fn);
+    if (jspHasError()) {
+      jsvUnLock(jspGetException());
+      ok = false;
+    }
+    jsiConsolePrintf("%s : %s\n", ok ? "PASS" : "FAIL", tests[i]);
+    if (!ok) pass = false;
+  }
+  jsvObjectRemoveChild(execInfo.root, "jit");
 
   warning("BEFORE: %d Memory Records Used", jsvGetMemoryUsage());
   // jsvTrace(execInfo.root, 0);
@@ -368,6 +483,10 @@ void show_help() {
 #ifdef USE_TELNET
   warning(
       "   --telnet                Enable internal telnet server on port 2323");
+#endif
+#ifndef __MINGW32__
+  warning("   --flash-no-memmap       Don't memory-map flash (like most boards) - "
+          "put before other options");
 #endif
   warning("   --test-all              Run all tests (in 'tests' directory)");
   warning("   --test-dir dir          Run all tests in directory 'dir'");
@@ -432,7 +551,7 @@ int main(int argc, char **argv) {
         int errCode = handleErrors();
         isRunning = !errCode;
         bool isBusy = true;
-        while (isRunning && (jsiHasTimers() || isBusy))
+        while (isRunning && (jsiHasTimers() || isBusy || hasOpenSockets()))
           isBusy = jsiLoop();
         jsiKill();
         jsvKill();
@@ -460,6 +579,10 @@ int main(int argc, char **argv) {
         bool ok = run_test_list(&test_files);
         filelist_free(&test_files);
         exit(ok ? 0 : 1);
+#ifndef __MINGW32__
+      } else if (!strcmp(a, "--flash-no-memmap")) {
+        jshLinuxFlashNoMemMap = true;
+#endif
       } else if (!strcmp(a, "--test-all")) {
         bool ok = run_all_tests();
         exit(ok ? 0 : 1);
@@ -519,7 +642,7 @@ int main(int argc, char **argv) {
     free(buffer);
     isRunning = !errCode;
     bool isBusy = true;
-    while (isRunning && (jsiHasTimers() || isBusy))
+    while (isRunning && (jsiHasTimers() || isBusy || hasOpenSockets()))
       isBusy = jsiLoop();
     jsiKill();
     jsvKill();
@@ -561,6 +684,9 @@ int main(int argc, char **argv) {
   addNativeFunction("quit", nativeQuit);
   addNativeFunction("interrupt", nativeInterrupt);
 
+#ifdef LINUX_USE_EPOLL
+  jshLinuxSleepUntilInput = true; // we're interactive, so sleep until there's something to do
+#endif
   while (isRunning) {
     jsiLoop();
   }
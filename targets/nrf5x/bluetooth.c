@@ -971,15 +971,8 @@ void nus_transmit_string() {
   int max_data_len = MIN((m_peripheral_effective_mtu-3),BLE_NUS_MAX_DATA_LEN);
   for (int packet=0;packet<1;packet++) {
     // No data? try and get some from our queue
-    if (!nuxTxBufLength) {
-      nuxTxBufLength = 0;
-      int ch = jshGetCharToTransmit(EV_BLUETOOTH);
-      while (ch>=0) {
-        nusTxBuf[nuxTxBufLength++] = ch;
-        if (nuxTxBufLength>=max_data_len) break;
-        ch = jshGetCharToTransmit(EV_BLUETOOTH);
-      }
-    }
+    if (!nuxTxBufLength)
+      nuxTxBufLength = (uint16_t)jshGetTransmitBlock(EV_BLUETOOTH, nusTxBuf, (unsigned int)max_data_len);
     // If there's no data in the queue, nothing to do - leave
     if (!nuxTxBufLength) return;
     jsble_peripheral_activity(); // flag that we've been busy
@@ -1964,10 +1964,7 @@ void jshUSARTKick(IOEventFlags device) {
 #endif
 #ifdef USB
   if (device == EV_USBSERIAL && m_usb_open && !m_usb_transmitting) {
-    unsigned int l = 0;
-    int c;
-    while ((l<sizeof(m_tx_buffer)) && ((c = jshGetCharToTransmit(EV_USBSERIAL))>=0))
-      m_tx_buffer[l++] = c;
+    unsigned int l = jshGetTransmitBlock(EV_USBSERIAL, (unsigned char*)m_tx_buffer, sizeof(m_tx_buffer));
     if (l) {
       // This is asynchronous call. We wait for @ref APP_USBD_CDC_ACM_USER_EVT_TX_DONE event
       uint32_t ret = app_usbd_cdc_acm_write(&m_app_cdc_acm, m_tx_buffer, l);
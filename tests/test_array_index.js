@@ -0,0 +1,38 @@
+// Large arrays get an index of their elements - check it stays correct as they change
+
+function check(a) { // every element forEach finds can be looked up by index
+  var ok = true;
+  a.forEach(function(v,i) { if (a[i]!==v) ok = false; });
+  return ok;
+}
+
+var a = [];
+for (var i=0;i<200;i++) a.push(i*2);
+var ok = a[150]==300 && a[199]==398 && a[200]===undefined && a[-1]===undefined;
+a.push(1); a[a.length] = 2; // add to the end
+ok = ok && a[200]==1 && a[201]==2 && a.length==202 && check(a);
+a.pop(); // remove from the end
+ok = ok && a[201]===undefined && a.length==201 && check(a);
+a.shift(); a.unshift(7,8); // renumber
+ok = ok && a[0]==7 && a[1]==8 && a[2]==2 && a[150]==298 && check(a);
+a.splice(10,5,"x"); // renumber
+ok = ok && a[10]=="x" && a[11]==28 && a.length==198 && check(a);
+a.reverse();
+ok = ok && a[0]==1 && a[197]==7 && check(a);
+a.sort(function(x,y) { return (0|x)-(0|y); });
+ok = ok && a[0]=="x" && a[1]==1 && a[197]==398 && check(a);
+a[500] = "hole"; // make a hole
+ok = ok && a[500]=="hole" && a[499]===undefined && a[100]!==undefined && check(a);
+delete a[50]; // and another
+ok = ok && a[50]===undefined && a[51]!==undefined && check(a);
+a.splice(20, a.length); // truncate
+ok = ok && a[19]!==undefined && a[20]===undefined && a[500]===undefined && check(a);
+
+// defragmenting moves elements around
+var b = [];
+for (var i=0;i<100;i++) b.push("s"+i);
+E.defrag();
+ok = ok && b[90]=="s90" && b[10]=="s10" && check(b);
+b = undefined;
+
+result = ok;
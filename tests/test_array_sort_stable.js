@@ -0,0 +1,38 @@
+// Array.sort should be stable, and not degrade on already ordered data
+
+// stability - elements comparing equal keep their order
+var a = [];
+for (var i=0;i<100;i++) a.push({k:i%3, i:i});
+a.sort(function(x,y) { return x.k-y.k; });
+var stable = true;
+for (var i=1;i<a.length;i++)
+  if (a[i-1].k>a[i].k || (a[i-1].k==a[i].k && a[i-1].i>a[i].i)) stable = false;
+
+// reverse ordered
+var r = [];
+for (var i=0;i<500;i++) r.push(500-i);
+r.sort(function(x,y) { return x-y; });
+var reversed = true;
+for (var i=0;i<r.length;i++) if (r[i]!=i+1) reversed = false;
+
+// undefined always goes at the end, default sort is by string
+var u = [3,undefined,10,1,undefined,2].sort();
+
+// the same object many times (more than we could lock individually)
+var o = {x:1}, d = [];
+for (var i=0;i<100;i++) d.push((i&1) ? o : {x:i&3});
+d.sort(function(x,y) { return x.x-y.x; });
+var dups = d.filter(function(e) { return e===o; }).length==50;
+for (var i=1;i<d.length;i++) if (d[i-1].x>d[i].x) dups = false;
+
+// comparators that return a boolean (never negative) still sort
+var b = [5,3,8,1,9,2,7].sort(function(x,y) { return x>y; });
+var big = [];
+for (var i=0;i<100;i++) big.push((i*37)%100);
+big.sort(function(x,y) { return x>y; });
+var bools = true;
+for (var i=0;i<big.length;i++) if (big[i]!=i) bools = false;
+
+result = stable && reversed && dups && bools &&
+  JSON.stringify(u)=="[1,10,2,3,null,null]" &&
+  JSON.stringify(b)=="[1,2,3,5,7,8,9]";
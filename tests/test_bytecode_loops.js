@@ -0,0 +1,108 @@
+// Check that loops compiled to bytecode (see jsbytecode.c) behave the same as the parser
+var r = [];
+
+// simple loops
+var s = 0;
+for (var i=0;i<100;i++) s += i;
+r.push(s==4950 && i==100);
+var n = 0;
+while (n<50) n++;
+r.push(n==50);
+n = 0;
+do { n += 2; } while (n<10);
+r.push(n==10);
+
+// break and continue, and nested loops
+s = 0;
+for (i=0;i<10;i++) {
+  if (i==2) continue;
+  if (i==7) break;
+  for (var j=0;j<3;j++) {
+    if (j==1) continue;
+    s += j;
+  }
+  s += i*100;
+}
+r.push(s==1912 && i==7 && j==3);
+n = 0;
+do { n++; if (n>5) break; continue; } while (true);
+r.push(n==6);
+
+// strings and appending
+var str = "";
+for (i=0;i<5;i++) str += "a"+i;
+r.push(str=="a0a1a2a3a4");
+var str2 = "x";
+for (i=0;i<3;i++) str2 += str2;
+r.push(str2=="xxxxxxxx");
+
+// arrays, typed arrays and methods
+var arr = [];
+for (i=0;i<5;i++) arr.push(i*i);
+r.push(arr.join(",")=="0,1,4,9,16");
+for (i=0;i<arr.length;i++) arr[i] = arr[i]+1;
+r.push(arr.join(",")=="1,2,5,10,17");
+var ta = new Uint8Array(4);
+for (i=0;i<10;i++) ta[i&3] += 100;
+r.push(ta.join(",")=="44,44,200,200");
+var obj = {a:1, count:0};
+for (i=0;i<5;i++) { obj.count++; obj["b"+i] = i; }
+r.push(obj.count==5 && obj.b4==4);
+
+// return from a loop inside a function, and locals
+function find(a, v) {
+  for (var k=0;k<a.length;k++)
+    if (a[k]==v) return k;
+  return -1;
+}
+r.push(find(arr,10)==3 && find(arr,3)==-1);
+
+// operators
+var b = [];
+for (i=0;i<4;i++) b.push((i&1) ? "odd" : "even", i>1 && i, i<2 || -i, !i, ~i, -i, i%3, i/2, i>>>1);
+r.push(JSON.stringify(b)=='["even",false,true,true,-1,0,0,0,0,"odd",false,true,false,-2,-1,1,0.5,0,"even",2,-2,false,-3,-2,2,1,1,"odd",3,-3,false,-4,-3,0,1.5,1]');
+
+// integers overflowing into floats, and % by zero
+var big = 2147483640;
+for (i=0;i<10;i++) big++;
+r.push(big==2147483650);
+var m = 1;
+for (i=0;i<40;i++) m *= 2;
+r.push(m==1099511627776);
+var nan;
+for (i=0;i<2;i++) nan = 5%0;
+r.push(isNaN(nan));
+
+// exceptions stop the loop
+n = 0;
+try {
+  for (i=0;i<10;i++) { n++; if (i==3) undefinedFunction(); }
+} catch (e) {
+  r.push(n==4 && e instanceof ReferenceError);
+}
+const c = 1;
+try {
+  for (i=0;i<3;i++) c++;
+} catch (e) {
+}
+r.push(c==1);
+
+// writing to properties inherited from a prototype adds them to the object
+var proto = {q:1,w:1,e:1};
+var o = Object.create(proto);
+for (i=0;i<3;i++) { if (i==1) o.q=7; }
+r.push(o.q==7 && proto.q==1 && JSON.stringify(Object.keys(o))=='["q"]');
+for (i=0;i<3;i++) o.w++;
+for (i=0;i<3;i++) o.e+=5;
+r.push(o.w==4 && o.e==16 && proto.w==1 && proto.e==1);
+
+// a loop that doesn't compile mustn't declare variables from `var` statements that never run
+var fns = [];
+for (i=0;i<3;i++) { if (i>10) { var neverRun = 1; } fns.push(() => i); }
+r.push(fns.length==3 && !("neverRun" in this));
+// but a loop that does compile declares them
+var sum = 0;
+for (i=0;i<5;i++) { var sq = i*i; sum += sq; }
+r.push(sum==30 && sq==16);
+
+result = r.length==22 && r.every(x=>x);
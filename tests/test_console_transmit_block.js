@@ -0,0 +1,17 @@
+// Console output is now sent in blocks - check newlines still get '\r'
+// added and nothing is lost or reordered. Keep it short, as the loopback
+// can only buffer so much before we get around the idle loop.
+var received = "";
+LoopbackB.on('data', function(d) { received += d; });
+var lines = [];
+for (var i=0;i<20;i++) lines.push("Line number "+i);
+var text = lines.join("\n");
+LoopbackA.setConsole(true);
+print(text);
+console.log("done\nok");
+USB.setConsole();
+setTimeout(function() {
+  var expected = lines.join("\r\n")+"\r\ndone\r\nok\r\n";
+  result = received.indexOf(expected)>=0;
+  if (!result) print(JSON.stringify(received.substr(-200)));
+}, 10);
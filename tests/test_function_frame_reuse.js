@@ -0,0 +1,51 @@
+// Simple functions reuse their execution scope between calls - check nothing leaks from one call to the next
+
+var r = [];
+function add(a,b) { return a+b; }
+function count() { var n = 0; for (var i=0;i<arguments.length;i++) n++; return n; }
+function opt(a,b) { return b===undefined ? "u" : b; }
+function local(x) { if (x) var y = x; return typeof y; }
+function fib(n) { return n<2 ? n : fib(n-1)+fib(n-2); }
+function thrower(x) { var t = x; if (x) throw "oops"; return t; }
+function method(v) { this.v = v; return this; }
+function maker(x) { var y = x*2; return { get: function() { return y; } }; }
+
+// the same function with different numbers of arguments
+r.push(add(1,2), add(3), add(4,5,6), add("a","b"), add());
+r.push(opt(1,2), opt(1), opt(1,2,3), opt(1));
+// local vars don't survive between calls
+r.push(local(1), local(0), local("s"));
+r.push(fib(7));
+// exceptions half way through
+try { thrower(1); } catch (e) { r.push(e); }
+r.push(thrower(0));
+// 'this'
+var o = {m:method};
+r.push(o.m(3).v, method.call({}, 4).v);
+// bound arguments
+var add10 = add.bind(null, 10);
+r.push(add10(1), add10(2), add10());
+// closures keep their own scopes
+var m1 = maker(1), m2 = maker(2);
+r.push(m1.get(), m2.get());
+// called from native code
+r.push([1,2,3].map(function(x) { return add(x,x); }).join(","));
+var sum = 0;
+[1,2,3].forEach(function(x) { sum = add(sum, x); });
+r.push(sum);
+// replaceWith with a function that isn't simple (and has different parameters)
+function repl(a) { return a; }
+repl(1);
+repl.replaceWith(function(b,c) { return arguments.length+":"+c; });
+r.push(repl(5,6,7), repl(1));
+// a function that's been called and then thrown away can still be freed, along with its scope
+function maker2() { var a = []; for (var i=0;i<100;i++) a.push(i); return function(x) { return a.length+x; }; }
+var mem = process.memory().usage;
+var m3 = maker2();
+m3(1);
+m3 = undefined;
+r.push(process.memory().usage - mem < 20);
+
+var expected = [3,NaN,9,"ab",NaN, 2,"u",2,"u", "number","undefined","string", 13, "oops",0, 3,4, 11,12,NaN, 2,4, "2,4,6", 6, "3:6","2:undefined", true];
+result = JSON.stringify(r)==JSON.stringify(expected);
+if (!result) print(JSON.stringify(r), JSON.stringify(expected));
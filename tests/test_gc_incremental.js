@@ -0,0 +1,30 @@
+// Check that incremental garbage collection frees loops of variables,
+// without freeing anything that is still in use
+
+E.setGCBudget(1); // tiny steps, so the GC gets split up as much as possible
+
+function makeLoop(n) {
+  // 'sharedLongKeyName' is stored as an atom, so freeing these must unref it
+  var a = { n : n, s : "Hello World - this is a longer string "+n, sharedLongKeyName : n };
+  a.b = { c : a };
+  return a;
+}
+
+var live = [];
+for (var i=0;i<20;i++) live.push({ n : i, data : [i, "item "+i], loop : makeLoop(i) });
+
+// fill memory up with garbage so the idle loop starts a GC. Keep the last
+// memory info in 'mem' so freeing it doesn't leave enough free vars that
+// the idle loop decides a GC isn't needed
+var mem;
+while ((mem = process.memory(false)).free > 20) makeLoop(0);
+var freeBefore = mem.free;
+
+setTimeout(function() {
+  var ok = true;
+  live.forEach(function(o,i) {
+    if (o.n!=i || o.data[0]!=i || o.data[1]!="item "+i ||
+        o.loop.n!=i || o.loop.b.c!=o.loop || o.loop.sharedLongKeyName!=i) ok = false;
+  });
+  result = ok && process.memory(false).free > freeBefore+100;
+}, 50);
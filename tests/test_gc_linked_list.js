@@ -0,0 +1,11 @@
+// Check that GC can free a long linked list containing a loop (previously
+// marking was recursive and could give up when it ran low on stack)
+
+var before = process.memory().usage;
+var head = {v:0}, list = head;
+for (var i=1;i<20000;i++) list = {v:i, next:list};
+head.next = list; // make a loop so it can't be freed by reference counting
+list = head = undefined;
+var after = process.memory().usage;
+
+result = after <= before+10;
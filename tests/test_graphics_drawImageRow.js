@@ -0,0 +1,89 @@
+// Check drawImage/blit (which write whole rows of pixels where they can) match what we'd get by setting each pixel in turn
+result = 1;
+
+// draw a reference by copying each pixel of 'src' scaled by 's' to x,y
+function drawRef(r, src, x, y, s, transparent, palette) {
+  for (var py=0;py<src.getHeight()*s;py++)
+    for (var px=0;px<src.getWidth()*s;px++) {
+      var c = src.getPixel(0|(px/s), 0|(py/s));
+      if (c===transparent) continue;
+      if (palette) c = palette[c];
+      r.setPixel(x+px, y+py, c);
+    }
+}
+
+[1,2,4,8,16].forEach(function(bpp) {
+  [true,false].forEach(function(msb) {
+    var name = bpp+"bpp "+(msb?"msb":"lsb");
+    var mask = (1<<bpp)-1;
+    // 37 pixels wide so we have more than one span and unaligned pixels
+    var src = Graphics.createArrayBuffer(37,5,bpp,{msb:true});
+    for (var y=0;y<5;y++)
+      for (var x=0;x<37;x++)
+        src.setPixel(x,y,(x*7+y*3+(x>>2))&mask);
+    var opts = {msb:msb};
+    var g = Graphics.createArrayBuffer(45,12,bpp,opts);
+    var r = Graphics.createArrayBuffer(45,12,bpp,opts);
+
+    // plain, clipped at left and right
+    g.clear().drawImage(src.asImage(),-3,1);
+    r.clear(); drawRef(r, src, -3, 1, 1);
+    g.drawImage(src.asImage(),20,6);
+    drawRef(r, src, 20, 6, 1);
+    if (btoa(g.buffer)!=btoa(r.buffer)) { result = 0; print(name+" plain drawn wrong"); }
+
+    // transparent (gaps in the spans)
+    var img = src.asImage();
+    img.transparent = 1;
+    g.clear().drawImage(img,3,2);
+    r.clear(); drawRef(r, src, 3, 2, 1, 1);
+    if (btoa(g.buffer)!=btoa(r.buffer)) { result = 0; print(name+" transparent drawn wrong"); }
+
+    // clip rect
+    g.clear().setClipRect(5,3,30,5).drawImage(img,1,1).reset();
+    r.clear().setClipRect(5,3,30,5); drawRef(r, src, 1, 1, 1, 1); r.reset();
+    if (btoa(g.buffer)!=btoa(r.buffer)) { result = 0; print(name+" cliprect drawn wrong"); }
+
+    // integer scale
+    g.clear().drawImage(img,-10,0,{scale:2});
+    r.clear(); drawRef(r, src, -10, 0, 2, 1);
+    if (btoa(g.buffer)!=btoa(r.buffer)) { result = 0; print(name+" scaled drawn wrong"); }
+
+    // palette
+    if (bpp<=8) {
+      var pal = new Uint16Array(256); // big enough to be allocated flat
+      for (var i=0;i<pal.length;i++) pal[i] = (pal.length-1-i)&mask;
+      img = src.asImage();
+      img.palette = pal;
+      g.clear().drawImage(img,2,3);
+      r.clear(); drawRef(r, src, 2, 3, 1, undefined, pal);
+      if (btoa(g.buffer)!=btoa(r.buffer)) { result = 0; print(name+" palette drawn wrong"); }
+    }
+
+    // overlapping blits in each direction
+    [[0,0,4,1],[4,1,0,0],[0,2,6,2],[6,2,0,2]].forEach(function(b) {
+      g.clear().drawImage(src.asImage(),0,0);
+      r.clear(); drawRef(r, src, 0, 0, 1);
+      g.blit({x1:b[0],y1:b[1],w:37,h:5,x2:b[2],y2:b[3]});
+      var area = [];
+      for (var y=0;y<5;y++)
+        for (var x=0;x<37;x++)
+          area.push(r.getPixel(b[0]+x,b[1]+y));
+      for (var y=0;y<5;y++)
+        for (var x=0;x<37;x++)
+          r.setPixel(b[2]+x,b[3]+y,area[x+y*37]);
+      if (btoa(g.buffer)!=btoa(r.buffer)) { result = 0; print(name+" blit "+b+" wrong"); }
+    });
+  });
+});
+
+// Inline images clipped at the bottom must still leave drawString pointing at the next character
+var img = Graphics.createArrayBuffer(23,7,1,{msb:true}).asImage("string");
+var g = Graphics.createArrayBuffer(50,20,1,{msb:true});
+g.setClipRect(0,0,49,11);
+try {
+  g.drawString("a\0"+img+"b\0"+img+"c",18,6);
+} catch (e) {
+  result = 0;
+  print("drawString failed", e);
+}
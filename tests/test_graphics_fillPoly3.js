@@ -0,0 +1,84 @@
+// fillPoly with self-intersecting and concave polygons, where many edges cross each scanline
+var g = Graphics.createArrayBuffer(24,16,8);
+g.dump = _=>{
+  var s = "";
+  var b = new Uint8Array(g.buffer);
+  var n = 0;
+  for (var y=0;y<g.getHeight();y++) {
+    s+="\n";
+    for (var x=0;x<g.getWidth();x++)
+      s+=".#"[b[n++]?1:0];
+  }
+  return s;
+}
+var ok = true;
+function SHOULD_BE(a) {
+  var b = g.dump();
+  if (a!=b) {
+    console.log("GOT :"+b+"\nSHOULD BE:"+a+"\n================");
+    ok = false;
+  }
+}
+
+// pentagram - self-intersecting, and the middle is filled
+g.clear().fillPoly([12,0, 19,15, 1,5, 23,5, 5,15]);
+SHOULD_BE(`
+........................
+............#...........
+............#...........
+...........###..........
+...........###..........
+.######################.
+...###################..
+.....###############....
+.......###########......
+........#########.......
+........#########.......
+.......###########......
+.......####...####......
+......###.......###.....
+......#...........#.....
+........................`);
+// comb - lots of edges crossing each scanline
+var p = [0,15];
+for (var x=0;x<24;x+=4) p.push(x,1, x+2,1, x+2,11);
+p.push(23,15);
+g.clear().fillPoly(p);
+SHOULD_BE(`
+........................
+##..##..##..##..##..##..
+##..##..##..##..##..##..
+##..##..##..##..##..##..
+##..##..##..##..##..##..
+##..##..##..##..##..##..
+##.###.###.###.###.###..
+##.###.###.###.###.###..
+##.###.###.###.###.###..
+##.###.###.###.###.###..
+##.###.###.###.###.###..
+######################..
+#######################.
+#######################.
+#######################.
+........................`);
+// fractional coordinates
+g.clear().fillPoly([2.5,1.25, 21.75,3.5, 17.3,14.8, 4.1,10.6]);
+SHOULD_BE(`
+........................
+........................
+...######...............
+...###############......
+...###################..
+....##################..
+....#################...
+....#################...
+....################....
+....################....
+....################....
+......#############.....
+.........##########.....
+............######......
+...............###......
+........................`);
+
+result = ok;
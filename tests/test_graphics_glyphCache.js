@@ -0,0 +1,92 @@
+// Check that drawing characters from the glyph cache gives the same result as rendering them
+result = 1;
+
+var g = Graphics.createArrayBuffer(24,12,8);
+g.dump = _=>{
+  var s = "";
+  var b = new Uint8Array(g.buffer);
+  var n = 0;
+  for (var y=0;y<g.getHeight();y++) {
+    s+="\n";
+    for (var x=0;x<g.getWidth();x++)
+      s+=b[n++]?"#":".";
+  }
+  return s;
+}
+var AB = `
+........................
+....##....#####.........
+...###....#...##........
+...###....#...##........
+...#.##...######........
+..##..#...######........
+..#####...#....##.......
+..#...##..#....##.......
+.##....#..######........
+.##....#..#####.........
+........................
+........................`;
+// first draw renders the characters, second uses the cache
+g.setFont("Vector",12).drawString("AB",1,0);
+if (g.dump()!=AB) { result = 0; print("first draw wrong"); }
+g.clear().drawString("AB",1,0);
+if (g.dump()!=AB) { result = 0; print("cached draw wrong"); }
+
+// Draw the same text at different sizes (so characters get thrown out of the cache) and places
+var str = "Hello World 0123456789 ()!@#$%&*+-=[]{}<>?";
+g = Graphics.createArrayBuffer(200,100,8);
+function draw(sz,x,y) {
+  g.clear().setFont("Vector",sz).drawString(str,x,y);
+  return E.CRC32(g.buffer);
+}
+var sizes = [6,10,13,20,31,50], crcs = {};
+sizes.forEach(sz=>crcs[sz] = draw(sz,0,0));
+sizes.forEach(sz=>{ if (draw(sz,0,0)!=crcs[sz]) { result = 0; print("size "+sz+" wrong"); } });
+sizes.reverse().forEach(sz=>{ if (draw(sz,0,0)!=crcs[sz]) { result = 0; print("size "+sz+" wrong"); } });
+// moving by whole pixels moves the whole image
+g.clear().setFont("Vector",20).drawString(str,5,7);
+var moved = new Uint8Array(new Uint8Array(g.buffer));
+g.clear().drawString(str,0,0);
+var b = new Uint8Array(g.buffer), diffs = 0;
+for (var y=0;y<93;y++)
+  if (E.CRC32(new Uint8Array(moved.buffer,(y+7)*200+5,195)) != E.CRC32(new Uint8Array(b.buffer,y*200,195))) diffs++;
+if (diffs!=0) { result = 0; print("moved wrong"); }
+// clipping only removes pixels outside the clip rect
+g.clear().drawString(str,-3,-4);
+var full = new Uint8Array(new Uint8Array(g.buffer));
+g.clear().setClipRect(10,5,120,15).drawString(str,-3,-4);
+var clipped = new Uint8Array(b);
+b.fill(0);
+for (var y=5;y<=15;y++) b.set(new Uint8Array(full.buffer,y*200+10,111), y*200+10);
+if (E.CRC32(clipped)!=E.CRC32(b)) { result = 0; print("clipped wrong"); }
+// character widths match what we draw
+g.reset().clear().setFont("Vector",17);
+g.drawString(str+str,0,0);
+if (g.stringWidth(str)!=g.stringWidth(str.substr(0,10))+g.stringWidth(str.substr(10))) { result = 0; print("width cached wrong"); }
+
+// PBF fonts - glyphs drawn twice and from different places in the string come out the same
+function makeFont(count) {
+  var glyphs = [], offsets = [], off = 0, seed = 1234;
+  function rnd() { seed = (seed*1103515245+12345)&0x7FFFFFFF; return seed>>8; }
+  for (var i=0;i<count;i++) {
+    var w = 1+rnd()%12, h = 1+rnd()%14, bpp2 = (i%5)==4;
+    var glyph = [w,h,rnd()%3,rnd()%4,(w+1)|(bpp2?128:0)];
+    for (var n=(w*h*(bpp2?2:1)+7)>>3;n>0;n--) glyph.push(rnd()&255);
+    offsets.push(off); off += glyph.length; glyphs.push(glyph);
+  }
+  // version 3, 16 bit offsets, one hash table entry
+  var d = [3,16,count,0,32,0,1,2,10,1, 0,count,0,0];
+  for (i=0;i<count;i++) d.push(32+i,0,offsets[i]&255,offsets[i]>>8);
+  glyphs.forEach(glyph=>d=d.concat(glyph));
+  return E.toString(d);
+}
+var font = makeFont(90);
+g.reset().clear().setFontPBF(font);
+g.setBgColor(3).drawString("#Wq",0,0,true);
+var pbf = new Uint8Array(new Uint8Array(g.buffer, 0, 200*20));
+g.clear();
+for (var i=0;i<90;i++) g.drawString(String.fromCharCode(32+i),0,30);
+var w = g.stringWidth("#Wq");
+g.setBgColor(0).clear().setBgColor(3).drawString("#Wq",0,0,true);
+if (E.CRC32(new Uint8Array(g.buffer, 0, 200*20))!=E.CRC32(pbf)) { result = 0; print("pbf wrong"); }
+if (g.stringWidth("#Wq")!=w) { result = 0; print("pbf width wrong"); }
@@ -0,0 +1,57 @@
+// Check g.getModifiedRects returns separate modified areas that cover everything drawn
+result = 1;
+
+var g = Graphics.createArrayBuffer(100,100,8);
+if (g.getModifiedRects().length) { result = 0; print("empty wrong"); }
+// opposite corners give 2 small rects, not one big one
+g.setPixel(1,2);
+g.fillRect(90,91,95,97);
+if (JSON.stringify(g.getModifiedRects())!=JSON.stringify([{x1:1,y1:2,x2:1,y2:2},{x1:90,y1:91,x2:95,y2:97}])) { result = 0; print("corners wrong"); }
+if (JSON.stringify(g.getModified())!=JSON.stringify({x1:1,y1:2,x2:95,y2:97})) { result = 0; print("bounds wrong"); }
+// drawing inside an existing rect changes nothing
+g.setPixel(92,92);
+if (g.getModifiedRects().length!=2) { result = 0; print("inside wrong"); }
+// close areas are merged
+g.setPixel(2,2);
+g.setPixel(3,4);
+if (JSON.stringify(g.getModifiedRects(true))!=JSON.stringify([{x1:1,y1:2,x2:3,y2:4},{x1:90,y1:91,x2:95,y2:97}])) { result = 0; print("merge wrong"); }
+if (g.getModifiedRects().length) { result = 0; print("reset wrong"); }
+if (g.getModified()!==undefined) { result = 0; print("reset bounds wrong"); }
+// clipped/offscreen draws
+g.fillRect(-10,-10,5,5);
+g.fillRect(200,200,300,300);
+if (JSON.stringify(g.getModifiedRects(true))!=JSON.stringify([{x1:0,y1:0,x2:5,y2:5}])) { result = 0; print("clipped wrong"); }
+// rects are in device coordinates
+g.setRotation(1);
+g.setPixel(0,0);
+if (JSON.stringify(g.getModifiedRects(true))!=JSON.stringify([{x1:99,y1:0,x2:99,y2:0}])) { result = 0; print("rotated wrong"); }
+g.setRotation(0);
+// blit marks exactly the destination area
+g.blit({x1:0,y1:0,w:10,h:5,x2:50,y2:60,setModified:true});
+if (JSON.stringify(g.getModifiedRects(true))!=JSON.stringify([{x1:50,y1:60,x2:59,y2:64}])) { result = 0; print("blit wrong"); }
+
+// Lots of random drawing - we never have more than 4 rects and every pixel drawn must be in one
+g.clear().reset();
+g.getModifiedRects(true);
+for (var i=0;i<200;i++) {
+  var x = Math.floor(Math.random()*120)-10, y = Math.floor(Math.random()*120)-10;
+  switch (i%4) {
+    case 0: g.setPixel(x,y,1); break;
+    case 1: g.drawLine(x,y,Math.floor(Math.random()*100),Math.floor(Math.random()*100)); break;
+    case 2: g.fillRect(x,y,x+Math.floor(Math.random()*8),y+Math.floor(Math.random()*8)); break;
+    case 3: g.drawString("Hi",x,y); break;
+  }
+  if (i%20==19) {
+    var rects = g.getModifiedRects(true);
+    if (rects.length>4) { result = 0; print("too many rects", rects); }
+    for (var py=0;py<100;py++) for (var px=0;px<100;px++) {
+      if (!g.getPixel(px,py)) continue;
+      if (!rects.some(r=>px>=r.x1 && px<=r.x2 && py>=r.y1 && py<=r.y2)) {
+        result = 0;
+        print("pixel "+px+","+py+" not in", rects);
+      }
+    }
+    g.clear().reset();
+    g.getModifiedRects(true);
+  }
+}
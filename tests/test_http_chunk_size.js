@@ -0,0 +1,34 @@
+// HTTP chunk sizes too big for a JsVarInt must error and close the connection, not hang
+
+var result = 0;
+var http = require("http");
+var net = require("net");
+
+var serverErrors = [];
+var server = http.createServer(function (req, res) {
+  req.on('error', function(e) { serverErrors.push(e.code); });
+});
+server.listen(8080);
+
+var clientClosed = 0;
+function sendChunkSize(size) {
+  var client = net.connect({host: "localhost", port: 8080}, function() {
+    client.write("POST / HTTP/1.1\r\nHost: x\r\nTransfer-Encoding: chunked\r\n\r\n"+size+"\r\nabc\r\n");
+  });
+  client.on('close', function() {
+    if (++clientClosed < 2) return;
+    // now check a client receiving a huge chunk from a server
+    server.close();
+    var rawServer = net.createServer(function(c) {
+      c.write("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\nFFFFFFFF5\r\nabc\r\n");
+    });
+    rawServer.listen(8081);
+    var req = http.get("http://localhost:8081/", function(res) {});
+    req.on('error', function(e) {
+      rawServer.close();
+      result = serverErrors.length==2 && serverErrors[0]==-16 && serverErrors[1]==-16 && e.code==-16;
+    });
+  });
+}
+sendChunkSize("100000008");
+sendChunkSize("FFFFFFFF5");
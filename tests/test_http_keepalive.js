@@ -0,0 +1,35 @@
+// HTTP keep-alive with pipelined requests (one of them chunked, with a trailer) on one connection
+
+var result = 0;
+var http = require("http");
+var net = require("net");
+
+var requests = 0;
+var server = http.createServer(function (req, res) {
+  requests++;
+  var body = '';
+  req.on('data', function(data) { body += data; });
+  req.on('end', function() {
+    var r = req.method+" "+req.url+" "+body;
+    res.writeHead(200, {'Content-Length': r.length});
+    res.end(r);
+  });
+});
+server.listen(8080);
+
+var received = "";
+var client = net.connect({host: "localhost", port: 8080}, function() {
+  client.write("GET /a HTTP/1.1\r\nHost: x\r\n\r\n"+
+               "POST /b HTTP/1.1\r\nHost: x\r\nTransfer-Encoding: chunked\r\n\r\n"+
+               "3\r\nabc\r\n10;ext=1\r\n0123456789abcdef\r\n0\r\nX-Trailer: 1\r\n\r\n"+
+               "POST /c HTTP/1.1\r\nHost: x\r\nContent-Length: 5\r\nConnection: close\r\n\r\nhello");
+});
+client.on('data', function(data) { received += data; });
+client.on('close', function() {
+  var head = "HTTP/1.1 200 OK\r\nServer: Espruino "+process.version+"\r\n";
+  result = requests==3 && received ==
+    head+"Content-Length: 7\r\nConnection: keep-alive\r\n\r\nGET /a "+
+    head+"Content-Length: 27\r\nConnection: keep-alive\r\n\r\nPOST /b abc0123456789abcdef"+
+    head+"Connection: close\r\nContent-Length: 13\r\n\r\nPOST /c hello";
+  server.close();
+});
@@ -0,0 +1,31 @@
+// HTTP server sending a large response made of big and small writes
+
+var result = 0;
+var http = require("http");
+
+var big = "";
+for (var i=0;i<1000;i++) big += String.fromCharCode(65+(i%26));
+var expected = "";
+for (var i=0;i<50;i++) expected += big+"["+i+"]";
+
+var server = http.createServer(function (req, res) {
+  res.writeHead(200, {'Content-Type': 'text/plain', 'Content-Length': expected.length});
+  for (var i=0;i<50;i++) {
+    res.write(big); // queued by reference
+    res.write("["+i+"]"); // appended
+  }
+  res.end();
+});
+server.listen(8080);
+
+var received = "";
+http.get("http://localhost:8080/big.txt", function(res) {
+  res.on('data', function(data) {
+    received += data;
+  });
+  res.on('close', function() {
+    console.log("Received "+received.length+" of "+expected.length);
+    result = received==expected;
+    server.close();
+  });
+});
@@ -0,0 +1,40 @@
+// Member access caches must notice when where a member is found changes
+
+var r = [];
+function get(o) { return o.foo; }
+function Foo() {}
+Foo.prototype.foo = "proto";
+var a = new Foo();
+for (var i=0;i<3;i++) r.push(get(a)); // inherited
+a.foo = "own";
+r.push(get(a)); // now own
+delete a.foo;
+r.push(get(a)); // inherited again
+Foo.prototype.foo = "changed";
+r.push(get(a)); // value changed in prototype
+a.__proto__ = { foo : "other" };
+r.push(get(a)); // prototype replaced
+r.push(get({foo:"literal"})); // different object, same place
+r.push(get({})); // not found
+r.push(get("str")); // not found on a string
+
+// built-ins, and overriding them
+function push(arr) { arr.push(1); return arr.length; }
+var arr = [];
+push(arr); push(arr);
+Array.prototype.push = function() { return "nope"; };
+push(arr);
+arr.push = function(x) { this[this.length] = x*2; };
+push(arr);
+delete Array.prototype.push;
+delete arr.push;
+push(arr);
+r.push(JSON.stringify(arr));
+
+function sin(m) { return m.sin(0); }
+r.push(sin(Math), sin(Math));
+Math.sin = function() { return "user"; };
+r.push(sin(Math));
+
+result = JSON.stringify(r) == JSON.stringify(["proto","proto","proto","own","proto","changed","other","literal",undefined,undefined,"[1,1,2,1]",0,0,"user"]);
+if (!result) console.log(r);
@@ -0,0 +1,25 @@
+// Member access caches must keep hitting when unrelated objects (function
+// scopes, locals, object literals) get properties added and are then freed
+
+function Point(x,y) { this.x = x; this.y = y; }
+Point.prototype.len = function() { var l = this.x+this.y; return l; };
+var p = new Point(1,2);
+var buf = [];
+
+function step(i) {
+  var o = { a : i, b : i*2 }; // new object with new keys
+  buf.push(o.a);              // built-in, via a local
+  return p.len() + Math.abs(o.b); // inherited member, and a built-in on an object
+}
+
+var s = 0;
+for (var i=0;i<10;i++) s += step(i);
+var hits = global.memberCacheHits ? memberCacheHits() : 0;
+for (var i=0;i<100;i++) s += step(i);
+if (global.memberCacheHits) hits = memberCacheHits() - hits;
+
+// 100 calls each doing 7 member accesses (o.a, buf.push, p.len, this.x, this.y, Math.abs, o.b)
+// o.a and o.b are on a new object each time, so can't hit - but the other 5 should. Objects share
+// versions (see JSV_OBJECT_VERSIONS), so some of the objects we free will make a few of them miss
+result = buf.length==110 && s==(10*3+45*2)+(100*3+4950*2) && (!global.memberCacheHits || hits>=350);
+if (!result) console.log(s, hits);
@@ -0,0 +1,62 @@
+// JSON.parse has its own scanner (not the JS lexer) - check it copes with everything JSON can contain
+
+var r = [];
+function p(s) {
+  try {
+    return JSON.parse(s);
+  } catch (e) {
+    return "ERR";
+  }
+}
+
+var o = p(' { "a" : 1, "b":[1, -2, 3.5, -0.25, 1e3, 2E-2, 123456789012], "c":{"d":null,"e":true,"f":false}, "g":"" } ');
+r.push(JSON.stringify(o));
+r.push(p('"tab\\tnl\\nq\\"bs\\\\sl\\/"'));
+r.push(p('"\\u0041\\u00e9"').length, p('"\\u0041\\u00e9"').charCodeAt(1));
+r.push(p('"\\uD83C\\uDF54"').length);
+r.push(p('-12'), p('0'), p('-0.5'), p('1.5e2'), p('12345678901234567890') > 1e19);
+// integers that fit in 64 bits are parsed exactly, and leading '.' is allowed as the JS lexer does
+r.push(p('1234567890123456789')==1234567890123456789, p('-9223372036854775807')==-9223372036854775807, p('99999999999999999999999')>9e22);
+r.push(p('.5'), p('-.5'), p('[.25]')[0]);
+// the smallest 64 bit integer, and numbers with more digits than the scanner's buffer holds
+var digits73 = "1234567890123456789012345678901234567890123456789012345678901234567890123";
+r.push(String(p('-9223372036854775808')), p(digits73)==1.234567890123456789e72, p('-'+digits73+'.5e-3')==-1.234567890123456789e69);
+r.push(p('0.'+"0".repeat(80)+'1')==1e-81, p('1e99999999999')===Infinity, p('0.003')==0.003);
+// error messages include the whole word
+function err(s) { try { JSON.parse(s); } catch (e) { return e.message; } }
+r.push(err('Infinity'), err('undefined'));
+// JSON doesn't allow -Infinity or a space after '-' - the old parser (using the JS lexer) did
+r.push(err('-Infinity'), err('- 1'), err('-NaN'));
+r.push(p('[[],[[]],{}]').length);
+var k = p('{"1":"one","x1":2,"long key name":3}');
+r.push(k[1], k["x1"], k["long key name"]);
+// a long string spanning many blocks
+var long = "";
+for (var i=0;i<100;i++) long += "abc"+i;
+r.push(p(JSON.stringify({s:long})).s == long);
+// errors
+r.push(p('{"a":1'), p('[1,2'), p('{a:1}'), p('"unterminated'), p('tru'), p('nul'), p(''), p('{"a" 1}'), p('-'), p('[1 2]'));
+// Storage.readJSON-style liberal parsing allows unquoted field names
+r.push(JSON.stringify(require("Storage").write("jp.json",'{a:1,b_2:"x",$c:[true]}') && require("Storage").readJSON("jp.json")));
+require("Storage").erase("jp.json");
+
+var expected = [
+  '{"a":1,"b":[1,-2,3.5,-0.25,1000,0.02,123456789012],"c":{"d":null,"e":true,"f":false},"g":""}',
+  'tab\tnl\nq"bs\\sl/',
+  2, 233,
+  1, // one UTF8 character in Espruino
+  -12, 0, -0.5, 150, true,
+  true, true, true,
+  0.5, -0.5, 0.25,
+  "-9223372036854775808", true, true,
+  true, true, true,
+  "Expecting valid value, got ID Infinity", "Expecting valid value, got ID undefined",
+  "Expecting a number after '-', got 'I'", "Expecting a number after '-', got ' '", "Expecting a number after '-', got 'N'",
+  3,
+  "one", 2, 3,
+  true,
+  "ERR","ERR","ERR","ERR","ERR","ERR","ERR","ERR","ERR","ERR",
+  '{"a":1,"b_2":"x","$c":[true]}'
+];
+result = JSON.stringify(r) == JSON.stringify(expected);
+if (!result) { print(JSON.stringify(r)); print(JSON.stringify(expected)); }
@@ -0,0 +1,29 @@
+// JSON.stringifyTo should write exactly what JSON.stringify returns, in chunks
+
+var data = { a:1, b:[1.5,-2,true,null,"str\"ing\n"], c:{ d:"Fön", e:undefined, f:function(){} } };
+for (var i=0;i<50;i++) data["key"+i] = "value number "+i;
+
+var chunks = [];
+JSON.stringifyTo({ write : function(d) { chunks.push(d); } }, data);
+var r1 = chunks.join("") == JSON.stringify(data);
+var r2 = chunks.length > 1;
+
+chunks = [];
+JSON.stringifyTo({ write : function(d) { chunks.push(d); } }, data, 2);
+var r3 = chunks.join("") == JSON.stringify(data, null, 2);
+
+// to a file
+var f = require("Storage").open("jsonto.txt","w");
+JSON.stringifyTo(f, data);
+var r4 = require("Storage").open("jsonto.txt","r").read(10000) == JSON.stringify(data);
+require("Storage").open("jsonto.txt","r").erase();
+
+// something without .write should throw
+var r5 = false;
+try { JSON.stringifyTo({}, data); } catch (e) { r5 = e instanceof TypeError; }
+
+// the faster paths in JSON.stringify/%q should still produce the same output
+var r6 = JSON.stringify({"a\u0001b":"\t\\\"xé", n:[0,-1,1e20,0.125,NaN,Infinity]}) == '{"a\\u0001b":"\\t\\\\\\"x\\u00E9","n":[0,-1,100000000000000000000,0.125,null,null]}';
+
+result = r1 && r2 && r3 && r4 && r5 && r6;
+if (!result) print([r1,r2,r3,r4,r5,r6]);
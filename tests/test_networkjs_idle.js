@@ -0,0 +1,33 @@
+// A NetworkJS HTTP server must still be polled at the interactive console, where
+// jshSleep waits for input and there are no timers or Linux sockets to wake it
+
+var result = 0;
+var polls = 0, sent = "";
+var request = "GET /hello HTTP/1.1\r\nHost: x\r\nConnection: close\r\n\r\n";
+require("NetworkJS").create({
+  create : function(host, port, socketType, options) { return 1; },
+  close : function(sckt) { },
+  accept : function(sckt) {
+    // only connect after we've been polled a few times with nothing else to do
+    if (polls++ == 10) return 2;
+    return -1;
+  },
+  recv : function(sckt, maxLen, socketType) {
+    var r = request;
+    request = "";
+    return r;
+  },
+  send : function(sckt, data, socketType) {
+    sent += data;
+    result = sent.indexOf("HTTP/1.1 200 OK")==0 && sent.indexOf("\r\n\r\n/hello")>0;
+    if (result) quit();
+    return data.length;
+  }
+});
+
+var server = require("http").createServer(function (req, res) {
+  res.writeHead(200);
+  res.end(req.url);
+});
+server.listen(80);
+if (global.sleepUntilInput) sleepUntilInput();
@@ -0,0 +1,40 @@
+// Objects with lots of keys get a hashed index - check lookups stay correct
+// as keys are added and removed
+
+var o = {};
+var ok = true;
+for (var i=0;i<300;i++) o["key"+i] = i;
+for (i=0;i<300;i++) if (o["key"+i]!==i) ok = false;
+if (o.missing!==undefined || ("missing" in o)) ok = false;
+// delete some keys, then look them all up again
+for (i=0;i<300;i+=3) delete o["key"+i];
+for (i=0;i<300;i++) if (o["key"+i]!==(i%3 ? i : undefined)) ok = false;
+// add them back, and short (<=4 char) keys too
+for (i=0;i<300;i+=3) o["key"+i] = -i;
+for (i=0;i<100;i++) o["k"+i] = i*2;
+for (i=0;i<300;i++) if (o["key"+i]!==(i%3 ? i : -i)) ok = false;
+for (i=0;i<100;i++) if (o["k"+i]!==i*2) ok = false;
+if (Object.keys(o).length!=400) ok = false;
+// integer keys aren't in the index, but should still work
+o[5] = "five";
+if (o[5]!="five" || o["5"]!="five") ok = false;
+delete o[5];
+// copies shouldn't share an index
+var c = Object.assign({}, o);
+delete o.key1;
+if (c.key1!==1 || o.key1!==undefined) ok = false;
+// defragmenting memory moves things around
+E.defrag();
+for (i=0;i<300;i++) if (o["key"+i]!==(i==1 ? undefined : (i%3 ? i : -i))) ok = false;
+
+// objects that never missed a lookup (eg. from JSON.parse) get an index once a lookup that hits has to go deep
+var p = JSON.parse(JSON.stringify(c));
+var u = process.memory().usage;
+if (p.key2!==2) ok = false; // near the start - no index
+var shallow = process.memory().usage - u;
+u = process.memory().usage;
+if (p.key299!==299) ok = false; // a long way down - builds the index
+var deep = process.memory().usage - u;
+if (deep<=shallow || p.key298!==298 || p.k99!==198) ok = false;
+
+result = ok;
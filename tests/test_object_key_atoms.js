@@ -0,0 +1,56 @@
+// Long object keys that are used in many objects share one copy of the
+// end of the key (an 'atom') rather than each having their own
+
+var keys = ["timestamp","temperature","humidity","pressure","battery","latitude","longitude","altitude","heading","satellites"];
+var N = 50;
+
+function make(i, suffix) {
+  var o = {};
+  keys.forEach(function(k,j) { o[k+suffix] = i*100+j; });
+  return o;
+}
+function usedBy(fn) {
+  var u = process.memory().usage;
+  var a = [];
+  for (var i=0;i<N;i++) a.push(fn(i));
+  return { a : a, vars : (process.memory().usage-u)/N };
+}
+function atomsLeft() { // atoms for this test's keys, which all end in capitals
+  var atoms = global["\xFF"].atom;
+  return atoms ? Object.keys(atoms).filter(function(k) {
+    var c = k[k.length-1];
+    return c>="A" && c<="Z";
+  }).length : 0;
+}
+
+// records with the same keys share atoms
+var shared = usedBy(function(i) { return make(i, "AA"); });
+// keys of the same length that are never reused can't share anything
+var unique = usedBy(function(i) { return make(i, String.fromCharCode(65+(i%26), 65+(i/26|0))); });
+
+function check(o, i, suffix) {
+  var ok = Object.keys(o).join(",")==keys.map(function(k) { return k+suffix; }).join(",");
+  keys.forEach(function(k,j) {
+    if (o[k+suffix]!==i*100+j) ok = false;
+    if (o[E.toString(k+suffix)]!==i*100+j) ok = false; // flat string
+  });
+  return ok;
+}
+
+var ok = shared.vars < unique.vars;
+shared.a.forEach(function(o,i) { if (!check(o, i, "AA")) ok = false; });
+// copies and JSON round trips still have the right keys
+var copy = Object.assign({}, shared.a[3]);
+var parsed = JSON.parse(JSON.stringify(shared.a))[7];
+ok = ok && check(copy, 3, "AA") && check(parsed, 7, "AA");
+// deleting a key from one object leaves the rest alone
+delete shared.a[4].temperatureAA;
+shared.a[5].temperatureAA = 42;
+ok = ok && shared.a[4].temperatureAA===undefined && shared.a[5].temperatureAA===42 &&
+     shared.a[6].temperatureAA===601 && Object.keys(shared.a[4]).length==9;
+
+// once nothing uses them, atoms get freed by the next GC
+shared = unique = copy = parsed = undefined;
+process.memory();
+
+result = ok && atomsLeft()==0;
@@ -0,0 +1,28 @@
+// Object keys are compared a block at a time - check keys of all lengths,
+// and keys that are only the same up to a point
+
+var keys = [""];
+var k = "";
+for (var i=0;i<40;i++) { k += String.fromCharCode(97+(i%26)); keys.push(k); }
+var missing = ["abcdefghiX", "abcdefghijklmnopqrstuvwxyzabcX", "b", "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopq"];
+
+function check(o, n) { // o has the first n keys
+  var ok = true;
+  keys.concat(missing).forEach(function(k,i) {
+    var expected = i<n ? i : undefined;
+    if (o[k]!==expected) ok = false;
+    if (k.length && o[E.toString(k)]!==expected) ok = false; // flat string
+    if (o[(k+"!").substr(0,k.length)]!==expected) ok = false; // built up string
+  });
+  // names compared with names
+  Object.keys(o).forEach(function(k) {
+    if (o[k]!==keys.indexOf(k)) ok = false;
+  });
+  return ok && Object.keys(o).length==n;
+}
+
+var small = {}, big = {}; // big will get a hashed index of its keys
+for (var i=0;i<10;i++) small[keys[i]] = i;
+for (var i=0;i<keys.length;i++) big[keys[i]] = i;
+
+result = check(small, 10) && check(big, keys.length) && big.abcdefghijklmnop==16 && small.abcde==5;
@@ -0,0 +1,69 @@
+// RegExps compiled to a program and run on a Pike VM
+tests=0;
+testPass=0;
+
+function test(a, b) {
+  tests++;
+  a = JSON.stringify(a);
+  b = JSON.stringify(b);
+  if (a==b) {
+    return testPass++;
+  }
+  console.log("Test "+tests+" failed - ",a,"vs",b);
+}
+
+// quantifiers on groups, and '|' inside groups
+test(/(a|b)+c/.exec("xxababcx").slice(), ["ababc","b"]);
+test(/(a|ab)(c|bcd)/.exec("abcd").slice(), ["abcd","a","bcd"]);
+test(/(?:ab)+/.exec("ababx")[0], "abab");
+// optional and lazy
+test(/colou?r/.test("color"), true);
+test(/<.*?>/.exec("<a><b>")[0], "<a>");
+test(/<.*>/.exec("<a><b>")[0], "<a><b>");
+test("aaa".match(/a*?/)[0], "");
+// leftmost, then first alternative
+test(/a|ab|abc/.exec("xabc").slice(), ["a"]);
+// word boundaries
+test(/\bfoo\b/.test("a foo b"), true);
+test(/\bfoo\b/.test("afoob"), false);
+test(/\Boo/.exec("foo").index, 1);
+// groups that don't match are undefined
+test(/(a)|(b)/.exec("b").slice(), ["b",null,"b"]);
+test("b".replace(/(a)|(b)/, "[$1|$2]"), "[|b]");
+test("b".replace(/(a)|(b)/, function(m,a,b,idx) { return typeof a+b+idx; }), "undefinedb0");
+// case insensitive
+test(/X/i.exec("aaax").index, 3);
+test(/[^a]/i.test("A"), false);
+// program is only compiled once
+var re = /\$GP(\w+),(\d*)/g;
+var s = "junk$GPGGA,123,$GPRMC,456";
+test(re.exec(s).slice(), ["$GPGGA,123","GGA","123"]);
+test(re.exec(s).slice(), ["$GPRMC,456","RMC","456"]);
+// errors
+try { /(ab/.test("x"); test("no error", true); } catch (e) { test(e.message, "Unfinished group in RegEx"); }
+// this would take far too long with a backtracking matcher
+var a = "";
+for (var i=0;i<40;i++) a += "a";
+test(/a*a*a*a*a*a*a*b/.test(a), false);
+test(/(x+x+)+y/.test(a+"xxxxxxxxxxxxxxxxxxxxxxxxxxxxxx"), false);
+// long chains of optional items and alternatives mustn't use stack for each one
+var p = "";
+for (var i=0;i<1000;i++) p += "(?:a?)";
+test(new RegExp(p+"b").exec("xaab")[0], "aab");
+var alt = [];
+for (var i=0;i<1000;i++) alt.push("x"+i);
+test(new RegExp("(?:"+alt.join("|")+")y").exec("zzx999y")[0], "x999y");
+
+// lookahead
+test("aXb".match(/a(?=X)/)[0], "a");
+test("aYb".match(/a(?=X)/), null);
+test("aXb aYb".match(/a(?!X)./)[0], "aY");
+test("price: 100USD 200EUR".match(/\d+(?=EUR)/)[0], "200");
+test(/^(?=.*\d)(?=.*[a-z])\w+$/.test("abc123"), true);
+test(/^(?=.*\d)(?=.*[a-z])\w+$/.test("abcdef"), false);
+test("foobar".match(/(foo)(?=bar)(\w*)/).slice(), ["foobar","foo","bar"]);
+test("a1b2".replace(/(?=\d)/g,"-"), "a-1b-2");
+test([/a(?=b(?!c))/.test("abc"), /a(?=b(?!c))/.test("abd")], [false,true]);
+
+result = tests==testPass;
+console.log(result?"Pass":"Fail",":",tests,"tests total");
@@ -0,0 +1,44 @@
+// Check Storage file lookups stay correct with lots of files (exercises the filename index on Linux)
+var tests=0,testsPass=0;
+function test(a,b) {
+  tests++;
+  if (a===b) testsPass++;
+  else console.log("Test "+tests+" failed - "+JSON.stringify(a)+" vs "+JSON.stringify(b));
+}
+
+var s = require("Storage");
+s.eraseAll();
+test(s.read("f1"), undefined);
+for (var i=0;i<300;i++)
+  s.write("f"+i, "file"+i);
+test(s.list().length, 300);
+test(s.read("f0"), "file0");
+test(s.read("f299"), "file299");
+test(s.read("f300"), undefined);
+// overwrite and erase (>200 changes also creates a new FILENAME_TABLE)
+for (var i=0;i<300;i+=2)
+  s.write("f"+i, "new"+i);
+for (var i=1;i<300;i+=3)
+  s.erase("f"+i);
+var ok = true;
+for (var i=0;i<300;i++) {
+  var expected = (i%3)==1 ? undefined : ((i&1) ? "file"+i : "new"+i);
+  if (s.read("f"+i)!==expected) ok = false;
+}
+test(ok, true);
+test(s.list().length, 200);
+// compacting moves all the files
+s.compact();
+test(s.read("f0"), "new0");
+test(s.read("f1"), undefined);
+test(s.read("f3"), "file3");
+test(s.read("f296"), "new296");
+test(s.read("f298"), undefined);
+test(s.list().length, 200);
+s.write("f1", "back");
+test(s.read("f1"), "back");
+s.eraseAll();
+test(s.read("f1"), undefined);
+test(s.list().length, 0);
+
+result = tests==testsPass;
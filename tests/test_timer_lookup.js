@@ -0,0 +1,32 @@
+// Timers are found by ID (and IDs by timer) through a hash map - check that
+// clearTimeout/changeInterval still find the right timer with lots of them,
+// after others have been removed, and after memory has been defragmented.
+var fired = [];
+var ids = [];
+for (var i=0;i<200;i++) (function(i) {
+  ids.push(setTimeout(function() { fired.push(i); }, 20+i%10));
+})(i);
+// clear every other timer, some of them from inside another timer
+for (var i=0;i<100;i+=2) clearTimeout(ids[i]);
+setTimeout(function() {
+  for (var i=100;i<200;i+=2) clearTimeout(ids[i]);
+}, 5);
+// move the names of the timers around in memory
+if (E.defrag) E.defrag();
+// an interval we slow down - and one we've already cleared
+var ticks = 0;
+var slow = setInterval(function() { ticks++; }, 2);
+changeInterval(slow, 60);
+var gone = setInterval(function() { ticks += 100; }, 2);
+clearInterval(gone);
+var unknown = false;
+try { changeInterval(gone, 10); } catch (e) { unknown = true; }
+
+setTimeout(function() {
+  clearInterval(slow);
+  fired.sort(function(a,b) { return a-b; });
+  var expected = [];
+  for (var i=1;i<200;i+=2) expected.push(i);
+  result = fired.join(",")==expected.join(",") && ticks==1 && unknown;
+  if (!result) print(fired.join(","), ticks, unknown);
+}, 100);
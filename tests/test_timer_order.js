@@ -0,0 +1,28 @@
+// Timers are kept in a heap ordered by when they should run - check they
+// fire in time order, that ties run in the order they were added, and that
+// cleared/changed timers don't fire at their old times.
+var order = [];
+for (var i=0;i<40;i++) (function(i) {
+  setTimeout(function() { order.push(i); }, (40-i)*2);
+})(i);
+// same time - should run in the order they were added
+setTimeout(function() { order.push("a"); }, 100);
+setTimeout(function() { order.push("b"); }, 100);
+// cleared before it runs
+var cleared = setTimeout(function() { order.push("cleared"); }, 30);
+clearTimeout(cleared);
+// changed so it runs after the others
+var ticks = 0;
+var changed = setInterval(function() {
+  if (ticks++==0) order.push("changed");
+  clearInterval(changed);
+}, 5);
+changeInterval(changed, 110);
+
+setTimeout(function() {
+  var expected = [];
+  for (var i=39;i>=0;i--) expected.push(i);
+  expected.push("a","b","changed");
+  result = order.join(",")==expected.join(",") && ticks==1;
+  if (!result) print(order.join(","));
+}, 150);